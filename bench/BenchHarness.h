@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fontmaster {
+namespace bench {
+
+/// Не даёт компилятору выбросить вычисление, результат которого не используется
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct HarnessOptions {
+    double minTime = 0.05;               // секунд на одно повторение замера
+    size_t repetitions = 5;
+    std::string filter;                  // подстрока имени; пусто - все замеры
+};
+
+/**
+ * Минимальный harness микробенчмарков: число итераций подбирается так, чтобы повторение
+ * длилось не меньше minTime, затем замер повторяется repetitions раз; по повторениям
+ * считаются min/median/max времени итерации. JSON повторяет основные поля формата
+ * Google Benchmark (name, iterations, real_time, time_unit), чтобы его читали те же скрипты.
+ */
+class Harness {
+public:
+    struct Result {
+        std::string name;
+        size_t glyphs = 0;
+        size_t fontBytes = 0;
+        uint64_t iterations = 0;         // в одном повторении
+        double minNs = 0;
+        double medianNs = 0;
+        double maxNs = 0;
+        double itemsPerIteration = 0;    // для items_per_second; 0 - не выводить
+        double bytesPerIteration = 0;    // для bytes_per_second; 0 - не выводить
+    };
+
+    explicit Harness(HarnessOptions options) : options(std::move(options)) {}
+
+    bool enabled(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    /// body() - одна итерация; items и bytes - объём работы итерации для производных метрик
+    template <typename Body>
+    void run(const std::string& name, size_t glyphs, size_t fontBytes, double items, double bytes, Body&& body) {
+        if (!enabled(name)) return;
+
+        uint64_t iterations = 1;
+        while (true) {
+            double elapsed = timeBatch(iterations, body);
+            if (elapsed >= options.minTime || iterations >= (uint64_t(1) << 40)) break;
+            // Оценка по прошлому прогону с запасом, но не больше чем в 10 раз за шаг
+            double scale = elapsed > 0 ? options.minTime * 1.2 / elapsed : 10.0;
+            iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::min(10.0, std::max(2.0, scale)));
+        }
+
+        std::vector<double> perIteration;
+        for (size_t r = 0; r < std::max<size_t>(1, options.repetitions); ++r) {
+            perIteration.push_back(timeBatch(iterations, body) * 1e9 / static_cast<double>(iterations));
+        }
+        std::sort(perIteration.begin(), perIteration.end());
+
+        Result result;
+        result.name = name;
+        result.glyphs = glyphs;
+        result.fontBytes = fontBytes;
+        result.iterations = iterations;
+        result.minNs = perIteration.front();
+        result.maxNs = perIteration.back();
+        size_t count = perIteration.size();
+        result.medianNs = count % 2 ? perIteration[count / 2] : (perIteration[count / 2 - 1] + perIteration[count / 2]) / 2;
+        result.itemsPerIteration = items;
+        result.bytesPerIteration = bytes;
+        results.push_back(result);
+    }
+
+    const std::vector<Result>& getResults() const { return results; }
+
+    void printTable(std::ostream& out) const {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-40s %12s %14s %14s %14s\n", "benchmark", "iterations", "min ns", "median ns",
+                      "max ns");
+        out << line;
+        for (const Result& result : results) {
+            std::snprintf(line, sizeof(line), "%-40s %12llu %14.1f %14.1f %14.1f\n", result.name.c_str(),
+                          static_cast<unsigned long long>(result.iterations), result.minNs, result.medianNs, result.maxNs);
+            out << line;
+        }
+    }
+
+    void printJson(std::ostream& out, const std::string& contextJson) const {
+        out << "{\n  \"context\": " << contextJson << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            char numbers[512];
+            std::snprintf(numbers, sizeof(numbers),
+                          "\"iterations\": %llu, \"repetitions\": %zu, \"real_time\": %.1f, \"min_time\": %.1f, "
+                          "\"max_time\": %.1f, \"time_unit\": \"ns\", \"glyphs\": %zu, \"font_bytes\": %zu",
+                          static_cast<unsigned long long>(result.iterations), options.repetitions, result.medianNs,
+                          result.minNs, result.maxNs, result.glyphs, result.fontBytes);
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", " << numbers;
+            if (result.itemsPerIteration > 0) {
+                out << ", \"items_per_second\": " << static_cast<uint64_t>(result.itemsPerIteration * 1e9 / result.medianNs);
+            }
+            if (result.bytesPerIteration > 0) {
+                out << ", \"bytes_per_second\": " << static_cast<uint64_t>(result.bytesPerIteration * 1e9 / result.medianNs);
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    HarnessOptions options;
+    std::vector<Result> results;
+
+    template <typename Body>
+    static double timeBatch(uint64_t iterations, Body& body) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+} // namespace bench
+} // namespace fontmaster
@@ -0,0 +1,344 @@
+#include "SyntheticFont.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/FontAssembler.h"
+#include <cstdio>
+#include <string>
+
+namespace fontmaster {
+namespace bench {
+
+namespace {
+
+using utils::ByteWriter;
+
+const uint16_t UNITS_PER_EM = 2048;
+const uint16_t ADVANCE = 2048;
+const uint8_t IMAGE_SIZE = 16;
+
+// Последовательность кодов с одинаковым шагом глифов - сегмент формата 4 или группа формата 12
+struct CodeRun {
+    uint32_t firstCode;
+    uint32_t lastCode;
+    uint16_t firstGlyph;
+};
+
+std::vector<CodeRun> codeRuns(uint16_t numGlyphs) {
+    std::vector<CodeRun> runs;
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        uint32_t code = syntheticCodepoint(glyph, numGlyphs);
+        if (!runs.empty() && runs.back().lastCode + 1 == code) {
+            runs.back().lastCode = code;
+        } else {
+            runs.push_back({code, code, glyph});
+        }
+    }
+    return runs;
+}
+
+// Габариты квадрата глифа немного различаются, чтобы пересборка считала реальные метрики
+int16_t glyphInset(uint16_t glyph) {
+    return static_cast<int16_t>(64 + glyph % 256);
+}
+
+std::vector<uint8_t> makeHead() {
+    ByteWriter writer(54);
+    writer.writeUInt32(0x00010000);      // version
+    writer.writeUInt32(0x00010000);      // fontRevision
+    writer.writeUInt32(0);               // checkSumAdjustment
+    writer.writeUInt32(0x5F0F3CF5);      // magicNumber
+    writer.writeUInt16(0x000B);          // flags
+    writer.writeUInt16(UNITS_PER_EM);
+    writer.writeZeros(16);               // created, modified
+    writer.writeInt16(64);               // xMin
+    writer.writeInt16(64);               // yMin
+    writer.writeInt16(static_cast<int16_t>(UNITS_PER_EM - 64));
+    writer.writeInt16(static_cast<int16_t>(UNITS_PER_EM - 64));
+    writer.writeUInt16(0);               // macStyle
+    writer.writeUInt16(8);               // lowestRecPPEM
+    writer.writeInt16(2);                // fontDirectionHint
+    writer.writeInt16(1);                // indexToLocFormat: длинная loca
+    writer.writeInt16(0);                // glyphDataFormat
+    return writer.take();
+}
+
+std::vector<uint8_t> makeHhea(uint16_t numGlyphs) {
+    ByteWriter writer(36);
+    writer.writeUInt32(0x00010000);
+    writer.writeInt16(static_cast<int16_t>(UNITS_PER_EM * 4 / 5));   // ascender
+    writer.writeInt16(static_cast<int16_t>(-UNITS_PER_EM / 5));      // descender
+    writer.writeInt16(0);                                            // lineGap
+    writer.writeUInt16(ADVANCE);                                     // advanceWidthMax
+    writer.writeInt16(64);                                           // minLeftSideBearing
+    writer.writeInt16(64);                                           // minRightSideBearing
+    writer.writeInt16(static_cast<int16_t>(UNITS_PER_EM - 64));      // xMaxExtent
+    writer.writeInt16(1);                                            // caretSlopeRise
+    writer.writeInt16(0);                                            // caretSlopeRun
+    writer.writeZeros(12);                                           // caretOffset, reserved
+    writer.writeInt16(0);                                            // metricDataFormat
+    writer.writeUInt16(numGlyphs);                                   // numberOfHMetrics
+    return writer.take();
+}
+
+std::vector<uint8_t> makeMaxp(uint16_t numGlyphs) {
+    ByteWriter writer(32);
+    writer.writeUInt32(0x00010000);
+    writer.writeUInt16(numGlyphs);
+    writer.writeUInt16(4);               // maxPoints
+    writer.writeUInt16(1);               // maxContours
+    writer.writeZeros(4);                // maxCompositePoints, maxCompositeContours
+    writer.writeUInt16(2);               // maxZones
+    writer.writeZeros(18);
+    return writer.take();
+}
+
+// Квадрат из четырёх точек на кривой; .notdef пустой
+void makeOutlines(uint16_t numGlyphs, std::vector<uint8_t>& glyf, std::vector<uint8_t>& loca,
+                  std::vector<uint8_t>& hmtx) {
+    ByteWriter glyfWriter(static_cast<size_t>(numGlyphs) * 36);
+    ByteWriter locaWriter((numGlyphs + 1u) * 4);
+    ByteWriter hmtxWriter(numGlyphs * 4u);
+
+    locaWriter.writeUInt32(0);
+    hmtxWriter.writeUInt16(ADVANCE);
+    hmtxWriter.writeInt16(0);
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        int16_t low = glyphInset(glyph);
+        int16_t high = static_cast<int16_t>(UNITS_PER_EM - low);
+        locaWriter.writeUInt32(static_cast<uint32_t>(glyfWriter.size()));
+        glyfWriter.writeInt16(1);        // numberOfContours
+        glyfWriter.writeInt16(low);
+        glyfWriter.writeInt16(low);
+        glyfWriter.writeInt16(high);
+        glyfWriter.writeInt16(high);
+        glyfWriter.writeUInt16(3);       // endPtsOfContours[0]
+        glyfWriter.writeUInt16(0);       // instructionLength
+        for (int i = 0; i < 4; ++i) glyfWriter.writeUInt8(0x01);
+        // Координаты - приращения: (low,low) (0,+d) (+d,0) (0,-d)
+        int16_t side = static_cast<int16_t>(high - low);
+        const int16_t dx[4] = {low, 0, side, 0};
+        const int16_t dy[4] = {low, side, 0, static_cast<int16_t>(-side)};
+        for (int16_t x : dx) glyfWriter.writeInt16(x);
+        for (int16_t y : dy) glyfWriter.writeInt16(y);
+        glyfWriter.align(4);
+
+        hmtxWriter.writeUInt16(ADVANCE);
+        hmtxWriter.writeInt16(low);
+    }
+    locaWriter.writeUInt32(static_cast<uint32_t>(glyfWriter.size()));
+
+    glyf = glyfWriter.take();
+    loca = locaWriter.take();
+    hmtx = hmtxWriter.take();
+}
+
+std::vector<uint8_t> makeCmap(uint16_t numGlyphs) {
+    std::vector<CodeRun> runs = codeRuns(numGlyphs);
+    std::vector<CodeRun> bmpRuns;
+    for (const CodeRun& run : runs) {
+        if (run.lastCode <= 0xFFFF) bmpRuns.push_back(run);
+    }
+
+    uint16_t segCount = static_cast<uint16_t>(bmpRuns.size() + 1);   // плюс завершающий 0xFFFF
+    uint16_t entrySelector = 0;
+    while ((2u << entrySelector) <= segCount) ++entrySelector;
+    uint16_t searchRange = static_cast<uint16_t>(2u << entrySelector);
+
+    ByteWriter format4(16 + segCount * 8u);
+    format4.writeUInt16(4);
+    format4.writeUInt16(static_cast<uint16_t>(16 + segCount * 8u));
+    format4.writeUInt16(0);              // language
+    format4.writeUInt16(static_cast<uint16_t>(segCount * 2));
+    format4.writeUInt16(searchRange);
+    format4.writeUInt16(entrySelector);
+    format4.writeUInt16(static_cast<uint16_t>(segCount * 2 - searchRange));
+    for (const CodeRun& run : bmpRuns) format4.writeUInt16(static_cast<uint16_t>(run.lastCode));
+    format4.writeUInt16(0xFFFF);
+    format4.writeUInt16(0);              // reservedPad
+    for (const CodeRun& run : bmpRuns) format4.writeUInt16(static_cast<uint16_t>(run.firstCode));
+    format4.writeUInt16(0xFFFF);
+    for (const CodeRun& run : bmpRuns) format4.writeUInt16(static_cast<uint16_t>(run.firstGlyph - run.firstCode));
+    format4.writeUInt16(1);
+    format4.writeZeros(segCount * 2u);   // idRangeOffset
+
+    ByteWriter format12(16 + runs.size() * 12);
+    format12.writeUInt16(12);
+    format12.writeUInt16(0);
+    format12.writeUInt32(static_cast<uint32_t>(16 + runs.size() * 12));
+    format12.writeUInt32(0);             // language
+    format12.writeUInt32(static_cast<uint32_t>(runs.size()));
+    for (const CodeRun& run : runs) {
+        format12.writeUInt32(run.firstCode);
+        format12.writeUInt32(run.lastCode);
+        format12.writeUInt32(run.firstGlyph);
+    }
+
+    ByteWriter cmap(20 + format4.size() + format12.size());
+    cmap.writeUInt16(0);
+    cmap.writeUInt16(2);
+    cmap.writeUInt16(3);
+    cmap.writeUInt16(1);
+    cmap.writeUInt32(20);
+    cmap.writeUInt16(3);
+    cmap.writeUInt16(10);
+    cmap.writeUInt32(static_cast<uint32_t>(20 + format4.size()));
+    cmap.writeBytes(format4.data(), format4.size());
+    cmap.writeBytes(format12.data(), format12.size());
+    return cmap.take();
+}
+
+std::vector<uint8_t> makePost(uint16_t numGlyphs) {
+    ByteWriter writer(34 + numGlyphs * 12u);
+    writer.writeUInt32(0x00020000);
+    writer.writeZeros(28);               // italicAngle ... maxMemType1
+    writer.writeUInt16(numGlyphs);
+    writer.writeUInt16(0);               // .notdef - стандартное имя
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        writer.writeUInt16(static_cast<uint16_t>(258 + glyph - 1));
+    }
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        char name[16];
+        int length = std::snprintf(name, sizeof(name), "glyph%05u", static_cast<unsigned>(glyph));
+        writer.writeUInt8(static_cast<uint8_t>(length));
+        writer.writeBytes(name, static_cast<size_t>(length));
+    }
+    return writer.take();
+}
+
+// Сигнатура и IHDR; CRC и IDAT не нужны - парсеры читают только заголовок
+std::vector<uint8_t> makePngStub(uint16_t glyph) {
+    ByteWriter writer(33);
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    writer.writeBytes(SIGNATURE, sizeof(SIGNATURE));
+    writer.writeUInt32(13);
+    writer.writeBytes("IHDR", 4);
+    writer.writeUInt32(IMAGE_SIZE);
+    writer.writeUInt32(IMAGE_SIZE);
+    writer.writeUInt8(8);                // bit depth
+    writer.writeUInt8(6);                // RGBA
+    writer.writeZeros(3);
+    writer.writeUInt32(glyph);           // вместо CRC: изображения различаются
+    return writer.take();
+}
+
+void makeCbdtCblc(uint16_t numGlyphs, std::vector<uint8_t>& cblc, std::vector<uint8_t>& cbdt) {
+    ByteWriter cbdtWriter(4 + numGlyphs * 42u);
+    cbdtWriter.writeUInt32(0x00030000);
+    std::vector<uint32_t> offsets;
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        offsets.push_back(static_cast<uint32_t>(cbdtWriter.size()));
+        std::vector<uint8_t> png = makePngStub(glyph);
+        // smallGlyphMetrics: height, width, bearingX, bearingY, advance
+        cbdtWriter.writeUInt8(IMAGE_SIZE);
+        cbdtWriter.writeUInt8(IMAGE_SIZE);
+        cbdtWriter.writeInt8(0);
+        cbdtWriter.writeInt8(static_cast<int8_t>(IMAGE_SIZE - 2));
+        cbdtWriter.writeUInt8(IMAGE_SIZE);
+        cbdtWriter.writeUInt32(static_cast<uint32_t>(png.size()));
+        cbdtWriter.writeBytes(png.data(), png.size());
+    }
+    offsets.push_back(static_cast<uint32_t>(cbdtWriter.size()));
+
+    // CBLC: заголовок, один BitmapSize, массив из одного подындекса, подындекс формата 1
+    ByteWriter cblcWriter(8 + 48 + 8 + 8 + offsets.size() * 4);
+    cblcWriter.writeUInt32(0x00030000);
+    cblcWriter.writeUInt32(1);
+    uint32_t arrayOffset = 8 + 48;
+    uint32_t subtableSize = 8 + static_cast<uint32_t>(offsets.size()) * 4;
+    cblcWriter.writeUInt32(arrayOffset);
+    cblcWriter.writeUInt32(8 + subtableSize);   // indexTablesSize
+    cblcWriter.writeUInt32(1);                  // numberOfIndexSubTables
+    cblcWriter.writeUInt32(0);                  // colorRef
+    const int8_t lineMetrics[12] = {static_cast<int8_t>(IMAGE_SIZE - 2), -2, static_cast<int8_t>(IMAGE_SIZE), 0, 0, 0,
+                                    0, 0, 0, 0, 0, 0};
+    cblcWriter.writeBytes(lineMetrics, sizeof(lineMetrics));   // hori
+    cblcWriter.writeBytes(lineMetrics, sizeof(lineMetrics));   // vert
+    cblcWriter.writeUInt16(1);                                  // startGlyphIndex
+    cblcWriter.writeUInt16(static_cast<uint16_t>(numGlyphs - 1));
+    cblcWriter.writeUInt8(IMAGE_SIZE);                          // ppemX
+    cblcWriter.writeUInt8(IMAGE_SIZE);                          // ppemY
+    cblcWriter.writeUInt8(32);                                  // bitDepth
+    cblcWriter.writeInt8(1);                                    // flags: горизонтальные метрики
+
+    cblcWriter.writeUInt16(1);                                  // firstGlyphIndex
+    cblcWriter.writeUInt16(static_cast<uint16_t>(numGlyphs - 1));
+    cblcWriter.writeUInt32(8);                                  // от начала массива
+    cblcWriter.writeUInt16(1);                                  // indexFormat
+    cblcWriter.writeUInt16(17);                                 // imageFormat
+    cblcWriter.writeUInt32(0);                                  // imageDataOffset
+    for (uint32_t offset : offsets) cblcWriter.writeUInt32(offset);
+
+    cblc = cblcWriter.take();
+    cbdt = cbdtWriter.take();
+}
+
+std::vector<uint8_t> makeSbix(uint16_t numGlyphs) {
+    const uint16_t ppems[] = {32, 64};
+    const size_t numStrikes = sizeof(ppems) / sizeof(ppems[0]);
+
+    std::vector<std::vector<uint8_t>> strikes;
+    for (uint16_t ppem : ppems) {
+        ByteWriter strike(4 + (numGlyphs + 1u) * 4 + numGlyphs * 41u);
+        strike.writeUInt16(ppem);
+        strike.writeUInt16(72);
+        size_t offsetsPosition = strike.size();
+        strike.writeZeros((numGlyphs + 1u) * 4);
+        for (uint16_t glyph = 0; glyph < numGlyphs; ++glyph) {
+            strike.patchUInt32(offsetsPosition + glyph * 4u, static_cast<uint32_t>(strike.size()));
+            if (glyph == 0) continue;
+            std::vector<uint8_t> png = makePngStub(glyph);
+            strike.writeInt16(0);
+            strike.writeInt16(0);
+            strike.writeBytes("png ", 4);
+            strike.writeBytes(png.data(), png.size());
+        }
+        strike.patchUInt32(offsetsPosition + numGlyphs * 4u, static_cast<uint32_t>(strike.size()));
+        strikes.push_back(strike.take());
+    }
+
+    ByteWriter sbix(8 + numStrikes * 4 + strikes[0].size() * numStrikes);
+    sbix.writeUInt16(1);                 // version
+    sbix.writeUInt16(1);                 // flags
+    sbix.writeUInt32(static_cast<uint32_t>(numStrikes));
+    uint32_t offset = static_cast<uint32_t>(8 + numStrikes * 4);
+    for (const auto& strike : strikes) {
+        sbix.writeUInt32(offset);
+        offset += static_cast<uint32_t>(strike.size());
+    }
+    for (const auto& strike : strikes) sbix.writeBytes(strike.data(), strike.size());
+    return sbix.take();
+}
+
+} // namespace
+
+uint32_t syntheticCodepoint(uint16_t glyphID, uint16_t numGlyphs) {
+    // Разрыв после каждых 16 кодов даёт много сегментов, как в настоящих шрифтах
+    uint32_t spaced = static_cast<uint32_t>(glyphID) + glyphID / 16u;
+    return glyphID < numGlyphs / 2 ? 0x4E00 + spaced : 0x20000 + spaced;
+}
+
+std::vector<uint8_t> makeSyntheticFont(uint16_t numGlyphs, ColorTables colorTables) {
+    std::vector<uint8_t> glyf, loca, hmtx;
+    makeOutlines(numGlyphs, glyf, loca, hmtx);
+
+    utils::FontAssembler assembler;
+    assembler.addTable("head", makeHead());
+    assembler.addTable("hhea", makeHhea(numGlyphs));
+    assembler.addTable("maxp", makeMaxp(numGlyphs));
+    assembler.addTable("hmtx", std::move(hmtx));
+    assembler.addTable("cmap", makeCmap(numGlyphs));
+    assembler.addTable("loca", std::move(loca));
+    assembler.addTable("glyf", std::move(glyf));
+    assembler.addTable("post", makePost(numGlyphs));
+    if (colorTables == ColorTables::CBDT_CBLC) {
+        std::vector<uint8_t> cblc, cbdt;
+        makeCbdtCblc(numGlyphs, cblc, cbdt);
+        assembler.addTable("CBDT", std::move(cbdt));
+        assembler.addTable("CBLC", std::move(cblc));
+    } else {
+        assembler.addTable("sbix", makeSbix(numGlyphs));
+    }
+    return assembler.assemble();
+}
+
+} // namespace bench
+} // namespace fontmaster
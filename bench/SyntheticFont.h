@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace fontmaster {
+namespace bench {
+
+/// Цветные таблицы синтетического шрифта
+enum class ColorTables {
+    CBDT_CBLC,
+    SBIX
+};
+
+/**
+ * Синтетический TrueType-шрифт из numGlyphs глифов для замеров: контуры-квадраты
+ * (glyf/loca/hmtx), cmap с подтаблицами формата 4 и 12, post версии 2 с собственными
+ * именами всех глифов и изображения всех глифов, кроме .notdef, - один страйк CBDT/CBLC
+ * (формат 17, индекс формата 1) или два страйка sbix. PNG - только сигнатура и IHDR 16x16:
+ * парсеры читают заголовок, но не распаковывают изображение.
+ */
+std::vector<uint8_t> makeSyntheticFont(uint16_t numGlyphs, ColorTables colorTables);
+
+/// Код, отображённый на глиф: первая половина глифов в BMP (формат 4), вторая - в плоскости 2
+uint32_t syntheticCodepoint(uint16_t glyphID, uint16_t numGlyphs);
+
+} // namespace bench
+} // namespace fontmaster
@@ -0,0 +1,229 @@
+#include "BenchHarness.h"
+#include "CliSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/CBDT_CBLC_Parser.h"
+#include "fontmaster/CMAPParser.h"
+#include "fontmaster/Checksum.h"
+#include "fontmaster/FileIO.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/POSTParser.h"
+#include "fontmaster/TTFRebuilder.h"
+#include "fontmaster/TTFUtils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Микробенчмарки разбора, поиска и пересборки на синтетических шрифтах растущего размера.
+ * Вывод библиотеки подавляется, результаты - таблицей или JSON (--json) в stdout:
+ *
+ *   fontmaster_bench [--json] [--filter <подстрока>] [--sizes 256,4096,32768]
+ *                    [--min-time <сек>] [--repetitions <n>]
+ */
+
+using namespace fontmaster;
+
+namespace {
+
+// Пересборка без правок формата: все этапы TTFRebuilder
+class SyntheticRebuilder : public TTFRebuilder {
+public:
+    using TTFRebuilder::TTFRebuilder;
+    std::vector<uint8_t> rebuild() override { return assembleTables().assemble(); }
+};
+
+struct TempFile {
+    std::string path;
+    explicit TempFile(const std::string& name)
+        : path((std::filesystem::temp_directory_path() / name).string()) {}
+    ~TempFile() { std::remove(path.c_str()); }
+};
+
+utils::TableRecord tableRecord(const std::vector<uint8_t>& font, const char* tag) {
+    std::vector<utils::TableRecord> tables = utils::parseTTFTables(font);
+    const utils::TableRecord* record = utils::findTable(tables, tag);
+    if (!record) throw std::runtime_error(std::string("synthetic font has no ") + tag);
+    return *record;
+}
+
+std::vector<uint8_t> tableBytes(const std::vector<uint8_t>& font, const char* tag) {
+    utils::TableRecord record = tableRecord(font, tag);
+    return utils::ByteSpan(font).subspan(record.offset, record.length).toVector();
+}
+
+uint32_t tableOffset(const std::vector<uint8_t>& font, const char* tag) {
+    return tableRecord(font, tag).offset;
+}
+
+void writeFontFile(const std::string& path, const std::vector<uint8_t>& font) {
+    if (!utils::writeFileAtomic(path, {utils::ByteSpan(font)})) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+void runSuite(bench::Harness& harness, uint16_t numGlyphs) {
+    const std::string suffix = "/" + std::to_string(numGlyphs);
+    const std::vector<uint8_t> cbdtFont = bench::makeSyntheticFont(numGlyphs, bench::ColorTables::CBDT_CBLC);
+    const std::vector<uint8_t> sbixFont = bench::makeSyntheticFont(numGlyphs, bench::ColorTables::SBIX);
+    const size_t glyphs = numGlyphs;
+    const size_t fontBytes = cbdtFont.size();
+
+    harness.run("parseTTFTables" + suffix, glyphs, fontBytes, 0, 0, [&] {
+        bench::doNotOptimize(utils::parseTTFTables(cbdtFont));
+    });
+
+    const std::vector<uint8_t> cmap = tableBytes(cbdtFont, "cmap");
+    harness.run("CMAPParser/parse" + suffix, glyphs, fontBytes, 0, static_cast<double>(cmap.size()), [&] {
+        utils::CMAPParser parser(cmap);
+        parser.parse();
+        bench::doNotOptimize(parser.getCharToGlyphMap().size());
+    });
+
+    utils::CMAPParser cmapParser(cmap);
+    cmapParser.parse();
+    std::vector<uint32_t> codepoints;
+    for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) {
+        codepoints.push_back(bench::syntheticCodepoint(glyph, numGlyphs));
+    }
+    harness.run("CMAPParser/forward" + suffix, glyphs, fontBytes, static_cast<double>(codepoints.size()), 0, [&] {
+        uint32_t sum = 0;
+        for (uint32_t codepoint : codepoints) sum += cmapParser.getGlyphIndex(codepoint);
+        bench::doNotOptimize(sum);
+    });
+    harness.run("CMAPParser/reverse" + suffix, glyphs, fontBytes, static_cast<double>(numGlyphs - 1), 0, [&] {
+        size_t total = 0;
+        for (uint16_t glyph = 1; glyph < numGlyphs; ++glyph) total += cmapParser.getCharCodes(glyph).size();
+        bench::doNotOptimize(total);
+    });
+
+    const uint32_t postOffset = tableOffset(cbdtFont, "post");
+    harness.run("POSTParser/parse" + suffix, glyphs, fontBytes, static_cast<double>(numGlyphs), 0, [&] {
+        utils::POSTParser parser(cbdtFont, postOffset, numGlyphs);
+        parser.parse();
+        bench::doNotOptimize(parser.getGlyphNames().size());
+    });
+
+    harness.run("CBDT_CBLC_Parser/parse" + suffix, glyphs, fontBytes, static_cast<double>(numGlyphs - 1),
+                static_cast<double>(fontBytes), [&] {
+        CBDT_CBLC_Parser parser(cbdtFont);
+        parser.parse();
+        bench::doNotOptimize(parser.getStrikes().size());
+    });
+
+    // SBIX работает с файлами: загрузка читает его, сохранение пишет новый
+    if (harness.enabled("SBIX/load" + suffix) || harness.enabled("SBIX/save" + suffix)) {
+        TempFile source("fontmaster_bench_sbix" + suffix.substr(1) + ".ttf");
+        TempFile output("fontmaster_bench_sbix" + suffix.substr(1) + ".out.ttf");
+        writeFontFile(source.path, sbixFont);
+        harness.run("SBIX/load" + suffix, glyphs, sbixFont.size(), static_cast<double>(numGlyphs - 1),
+                    static_cast<double>(sbixFont.size()), [&] {
+            bench::doNotOptimize(Font::load(source.path));
+        });
+        std::unique_ptr<Font> sbix = Font::load(source.path);
+        harness.run("SBIX/save" + suffix, glyphs, sbixFont.size(), 0, static_cast<double>(sbixFont.size()), [&] {
+            bench::doNotOptimize(sbix->save(output.path));
+        });
+    }
+
+    harness.run("TTFRebuilder/rebuild" + suffix, glyphs, fontBytes, static_cast<double>(numGlyphs), 0, [&] {
+        SyntheticRebuilder rebuilder(cbdtFont);
+        rebuilder.markTableModified("glyf");
+        bench::doNotOptimize(rebuilder.rebuild());
+    });
+
+    harness.run("tableChecksum" + suffix, glyphs, fontBytes, 0, static_cast<double>(fontBytes), [&] {
+        bench::doNotOptimize(utils::tableChecksum(utils::ByteSpan(cbdtFont)));
+    });
+}
+
+std::string contextJson(const std::vector<uint16_t>& sizes, const bench::HarnessOptions& options) {
+    std::ostringstream out;
+    out << "{\"library_version\": \"" << FONTMASTER_VERSION << "\", \"compiler\": \"" <<
+#if defined(__clang__)
+        "clang " << __clang_major__ << "." << __clang_minor__
+#elif defined(__GNUC__)
+        "gcc " << __GNUC__ << "." << __GNUC_MINOR__
+#elif defined(_MSC_VER)
+        "msvc " << _MSC_VER
+#else
+        "unknown"
+#endif
+        << "\", \"build_type\": \"" << FONTMASTER_BUILD_TYPE << "\", \"sizes\": [";
+    for (size_t i = 0; i < sizes.size(); ++i) out << (i ? ", " : "") << sizes[i];
+    out << "], \"min_time\": " << options.minTime << ", \"repetitions\": " << options.repetitions << "}";
+    return out.str();
+}
+
+bool parseSizes(const std::string& text, std::vector<uint16_t>& sizes) {
+    sizes.clear();
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.empty() || item.find_first_not_of("0123456789") != std::string::npos || item.size() > 5) return false;
+        unsigned long value = std::stoul(item);
+        if (value < 2 || value > 0xFFFF) return false;
+        sizes.push_back(static_cast<uint16_t>(value));
+    }
+    return !sizes.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bench::HarnessOptions options;
+    std::vector<uint16_t> sizes = {256, 4096, 32768};
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            if (!parseSizes(argv[++i], sizes)) {
+                std::cerr << "Error: --sizes expects glyph counts 2..65535 separated by commas" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minTime = std::atof(argv[++i]);
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            options.repetitions = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "Usage: fontmaster_bench [--json] [--filter <substring>] [--sizes <n,n,...>] "
+                         "[--min-time <seconds>] [--repetitions <n>]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Вывод библиотеки не должен попадать ни в замеры, ни в JSON
+    std::ostream results(std::cout.rdbuf());
+    std::ostream progress(std::cerr.rdbuf());
+
+    bench::Harness harness(options);
+    int status = 0;
+    {
+        OutputSilencer silencer(true);
+        try {
+            for (uint16_t size : sizes) {
+                runSuite(harness, size);
+                progress << "fontmaster_bench: " << size << " glyphs done" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            progress << "Error: " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+
+    if (json) {
+        harness.printJson(results, contextJson(sizes, options));
+    } else {
+        harness.printTable(results);
+    }
+    return status;
+}
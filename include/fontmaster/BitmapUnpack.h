@@ -0,0 +1,25 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Размер растра EBDT/CBDT в байтах.
+ * bitAligned - строки идут подряд без выравнивания на байт (форматы 2, 5, 7).
+ */
+size_t bitmapDataSize(uint32_t width, uint32_t height, uint8_t bitDepth, bool bitAligned);
+
+/**
+ * Развернуть растр EBDT/CBDT в premultiplied RGBA8.
+ * bitDepth 1/2/4/8 - маска покрытия (0 - прозрачно), выводится чёрным с альфой;
+ * bitDepth 32 - premultiplied BGRA. dstStride - шаг строки результата в байтах.
+ * Бросает std::runtime_error, если данных меньше bitmapDataSize().
+ */
+void unpackBitmap(ByteSpan data, uint32_t width, uint32_t height, uint8_t bitDepth, bool bitAligned,
+                  uint8_t* rgba, size_t dstStride);
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Невладеющее представление участка памяти (аналог std::span<const uint8_t>).
+ * Данные должны жить дольше самого span.
+ */
+class ByteSpan {
+public:
+    ByteSpan() = default;
+    ByteSpan(const uint8_t* data, size_t size) : ptr(data), len(size) {}
+    ByteSpan(const std::vector<uint8_t>& data) : ptr(data.data()), len(data.size()) {}
+
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    const uint8_t* begin() const { return ptr; }
+    const uint8_t* end() const { return ptr + len; }
+    uint8_t operator[](size_t index) const { return ptr[index]; }
+
+    ByteSpan subspan(size_t offset, size_t count) const {
+        if (offset > len || count > len - offset) {
+            throw std::out_of_range("ByteSpan: subspan out of range");
+        }
+        return ByteSpan(ptr + offset, count);
+    }
+
+    ByteSpan subspan(size_t offset) const {
+        if (offset > len) {
+            throw std::out_of_range("ByteSpan: subspan out of range");
+        }
+        return ByteSpan(ptr + offset, len - offset);
+    }
+
+    std::vector<uint8_t> toVector() const {
+        return std::vector<uint8_t>(ptr, ptr + len);
+    }
+
+    // Чтение big-endian значений с проверкой границ
+    uint8_t readUInt8(size_t offset) const {
+        if (offset >= len) throw std::out_of_range("ByteSpan: read beyond buffer");
+        return ptr[offset];
+    }
+
+    uint16_t readUInt16(size_t offset) const {
+        if (offset + 2 > len) throw std::out_of_range("ByteSpan: read beyond buffer");
+        return static_cast<uint16_t>((ptr[offset] << 8) | ptr[offset + 1]);
+    }
+
+    int16_t readInt16(size_t offset) const {
+        return static_cast<int16_t>(readUInt16(offset));
+    }
+
+    uint32_t readUInt32(size_t offset) const {
+        if (offset + 4 > len) throw std::out_of_range("ByteSpan: read beyond buffer");
+        return (static_cast<uint32_t>(ptr[offset]) << 24) |
+               (static_cast<uint32_t>(ptr[offset + 1]) << 16) |
+               (static_cast<uint32_t>(ptr[offset + 2]) << 8) |
+               static_cast<uint32_t>(ptr[offset + 3]);
+    }
+
+    // Little-endian - для вложенных форматов вроде TIFF с порядком байт "II"
+    uint16_t readUInt16LE(size_t offset) const {
+        if (offset + 2 > len) throw std::out_of_range("ByteSpan: read beyond buffer");
+        return static_cast<uint16_t>(ptr[offset] | (ptr[offset + 1] << 8));
+    }
+
+    uint32_t readUInt32LE(size_t offset) const {
+        if (offset + 4 > len) throw std::out_of_range("ByteSpan: read beyond buffer");
+        return static_cast<uint32_t>(ptr[offset]) |
+               (static_cast<uint32_t>(ptr[offset + 1]) << 8) |
+               (static_cast<uint32_t>(ptr[offset + 2]) << 16) |
+               (static_cast<uint32_t>(ptr[offset + 3]) << 24);
+    }
+
+private:
+    const uint8_t* ptr = nullptr;
+    size_t len = 0;
+};
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,134 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <stdlib.h>
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+inline uint16_t byteSwap16(uint16_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap16(value);
+#elif defined(_MSC_VER)
+    return _byteswap_ushort(value);
+#else
+    return static_cast<uint16_t>((value << 8) | (value >> 8));
+#endif
+}
+
+inline uint32_t byteSwap32(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(value);
+#elif defined(_MSC_VER)
+    return _byteswap_ulong(value);
+#else
+    return (value << 24) | ((value << 8) & 0x00FF0000u) | ((value >> 8) & 0x0000FF00u) | (value >> 24);
+#endif
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+inline uint16_t toBigEndian16(uint16_t value) { return value; }
+inline uint32_t toBigEndian32(uint32_t value) { return value; }
+#else
+inline uint16_t toBigEndian16(uint16_t value) { return byteSwap16(value); }
+inline uint32_t toBigEndian32(uint32_t value) { return byteSwap32(value); }
+#endif
+
+// Запись big-endian по произвольному (в том числе невыровненному) адресу без проверок
+inline void storeUInt16(uint8_t* p, uint16_t value) {
+    value = toBigEndian16(value);
+    std::memcpy(p, &value, 2);
+}
+
+inline void storeUInt32(uint8_t* p, uint32_t value) {
+    value = toBigEndian32(value);
+    std::memcpy(p, &value, 4);
+}
+
+/**
+ * Буфер для сериализации таблиц в big-endian. Растёт геометрически, поэтому запись
+ * значения - одна проверка ёмкости и одно сохранение; reserve снимает и её.
+ * Байты за концом записанного всегда нулевые: выравнивание и writeZeros ничего не копируют.
+ * Смещения, известные только после записи данных, резервируются через Slot и
+ * заполняются patch'ем.
+ */
+class ByteWriter {
+public:
+    /// Зарезервированное поле: позиция в буфере, ширина задаётся типом
+    struct Slot16 { size_t position; };
+    struct Slot32 { size_t position; };
+
+    ByteWriter() = default;
+    explicit ByteWriter(size_t capacity) { reserve(capacity); }
+
+    void reserve(size_t capacity) {
+        if (capacity > buffer.size()) buffer.resize(capacity);
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    uint8_t* data() { return buffer.data(); }
+    const uint8_t* data() const { return buffer.data(); }
+    ByteSpan view() const { return ByteSpan(buffer.data(), length); }
+
+    /// Удлинить буфер на count нулевых байт и вернуть указатель на них для прямой записи
+    uint8_t* extend(size_t count) {
+        if (buffer.size() - length < count) grow(count);
+        uint8_t* p = buffer.data() + length;
+        length += count;
+        return p;
+    }
+
+    void writeUInt8(uint8_t value) { *extend(1) = value; }
+    void writeInt8(int8_t value) { writeUInt8(static_cast<uint8_t>(value)); }
+    void writeUInt16(uint16_t value) { storeUInt16(extend(2), value); }
+    void writeInt16(int16_t value) { writeUInt16(static_cast<uint16_t>(value)); }
+    void writeUInt32(uint32_t value) { storeUInt32(extend(4), value); }
+    void writeInt32(int32_t value) { writeUInt32(static_cast<uint32_t>(value)); }
+
+    void writeBytes(const void* bytes, size_t count) {
+        if (count) std::memcpy(extend(count), bytes, count);
+    }
+    void writeBytes(ByteSpan bytes) { writeBytes(bytes.data(), bytes.size()); }
+    void writeZeros(size_t count) { extend(count); }
+
+    /// Массивы значений в big-endian; цикл без ветвлений векторизуется в перестановку байтов
+    void writeBE16(const uint16_t* values, size_t count);
+    void writeBE32(const uint32_t* values, size_t count);
+
+    /// Дополнить нулями до кратного alignment (степень двойки)
+    void align(size_t alignment) { extend((alignment - (length & (alignment - 1))) & (alignment - 1)); }
+
+    Slot16 reserveUInt16() { Slot16 slot{length}; extend(2); return slot; }
+    Slot32 reserveUInt32() { Slot32 slot{length}; extend(4); return slot; }
+    void patch(Slot16 slot, uint16_t value) { storeUInt16(buffer.data() + slot.position, value); }
+    void patch(Slot32 slot, uint32_t value) { storeUInt32(buffer.data() + slot.position, value); }
+
+    /// Перезаписать уже записанные байты; position + размер не должны выходить за size()
+    void patchUInt16(size_t position, uint16_t value) { storeUInt16(buffer.data() + position, value); }
+    void patchUInt32(size_t position, uint32_t value) { storeUInt32(buffer.data() + position, value); }
+
+    /// Забрать результат без копирования; writer остаётся пустым
+    std::vector<uint8_t> take() {
+        std::vector<uint8_t> result;
+        result.swap(buffer);
+        result.resize(length);
+        length = 0;
+        return result;
+    }
+
+private:
+    void grow(size_t count);
+
+    std::vector<uint8_t> buffer;   // размер вектора - ёмкость, записано первые length байт
+    size_t length = 0;
+};
+
+} // namespace utils
+} // namespace fontmaster
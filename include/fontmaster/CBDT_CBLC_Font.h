@@ -3,7 +3,11 @@
 
 #include "fontmaster/FontMaster.h"
 #include "fontmaster/CBDT_CBLC_Parser.h"
+#include "fontmaster/FileIO.h"
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace fontmaster {
@@ -15,6 +19,7 @@ public:
     
     bool load() override;
     bool save(const std::string& filepath) override;
+    bool saveInPlace() override;
     
     const std::vector<uint8_t>& getFontData() const override;
     void setFontData(const std::vector<uint8_t>& data) override;
@@ -23,24 +28,46 @@ public:
     bool removeGlyph(uint32_t unicode) override;
     bool replaceGlyphImage(const std::string& glyphName, 
                           const std::vector<uint8_t>& newImage) override;
+    /// Только PNG до 255x255 (small metrics); изображение одно на все страйки
+    bool addGlyphImage(const std::string& glyphName, const std::vector<uint8_t>& image) override;
+    bool canAddGlyphImage(const std::string& glyphName) const override;
+    std::unique_ptr<GlyphEditState> saveGlyphEditState(const std::string& glyphName) const override;
+    void restoreGlyphEditState(const GlyphEditState& state) override;
     std::vector<GlyphInfo> listGlyphs() const override;
     GlyphInfo getGlyphInfo(const std::string& glyphName) const override;
     std::string findGlyphName(uint32_t unicode) const override;
     // CBDT/CBLC specific methods
     const std::map<uint16_t, StrikeRecord>& getStrikes() const { return parser.getStrikes(); }
-    const std::vector<uint16_t>& getRemovedGlyphs() const { return parser.getRemovedGlyphs(); }
+    /// Глифы, удалённые через removeGlyph; при сохранении их нет ни в одном страйке
+    std::vector<uint16_t> getRemovedGlyphs() const { return {removedGlyphIDs.begin(), removedGlyphIDs.end()}; }
+    
+protected:
+    RGBAImage decodeGlyphImage(uint16_t glyphID, uint16_t strikeIndex) const override;
     
 private:
     std::string filepath;
     std::vector<uint8_t> fontData;
+    utils::FileStamp sourceStamp;   // fontData совпадает с файлом filepath, пока отпечаток валиден
     CBDT_CBLC_Parser parser;
-    std::string getGlyphName(uint16_t glyphID, const std::map<uint16_t				, std::string>& postGlyphNames) const;
-    std::map<uint16_t, std::string> getPostGlyphNames() const;
-    uint16_t getMaxpGlyphCount() const;
+    std::set<uint16_t> removedGlyphIDs;
+    // Имена из post и cmap разбираются один раз при загрузке
+    uint16_t numGlyphs = 0;
+    std::map<uint16_t, std::string> glyphNames;
+    std::unordered_map<std::string, uint16_t> glyphIDsByName;
+    std::map<uint32_t, uint16_t> unicodeToGlyph;
+    std::map<uint16_t, uint32_t> glyphToUnicode;     // наименьший код глифа
+    void buildGlyphLookup();
+    std::string getGlyphName(uint16_t glyphID) const;
+    bool hasGlyphImage(uint16_t glyphID) const;
+    // PNG в запись формата 17: в страйках, где глиф есть, или (addMissing) во всех остальных
+    bool storeGlyphPNG(uint16_t glyphID, const std::vector<uint8_t>& png, bool addMissing);
     uint16_t findGlyphID(const std::string& glyphName) const;
     uint16_t findGlyphIDByUnicode(uint32_t unicode) const;
     uint32_t getUnicodeFromGlyphID(uint16_t glyphID) const;
-    std::string getImageFormatString(uint16_t imageFormat) const;    
+    std::string getImageFormatString(uint16_t imageFormat) const;
+    void fillImageInfo(GlyphInfo& info, const StrikeRecord& strike, const GlyphImage& glyphImage) const;
+    // Растр (форматы 1, 2, 5-9) в premultiplied RGBA; depth ограничивает вложенность компонентов
+    RGBAImage decodeBitmapGlyph(const StrikeRecord& strike, const GlyphImage& glyphImage, int depth) const;
 };
 
 } // namespace fontmaster
@@ -24,6 +24,8 @@ public:
      * В парсере мы используем индекс-номер страйка (0..N-1).
      */
     const std::map<uint16_t, StrikeRecord>& getStrikes() const { return strikes; }
+    /// Для правок глифов шрифтом-владельцем
+    std::map<uint16_t, StrikeRecord>& getStrikes() { return strikes; }
 
     /**
      * Список глифов, которые парсер считает "removed" (не имеют cmap-отображения).
@@ -38,33 +40,17 @@ private:
     // Основные шаги
     bool parseCBLCTable(uint32_t offset, uint32_t length);
     bool parseCBDTTable(uint32_t offset, uint32_t length);
-    bool parseStrike(uint32_t offset, uint16_t strikeIndex);
-    bool parseIndexSubtable(uint32_t offset, StrikeRecord& strike);
+    bool parseStrike(uint32_t cblcOffset, uint32_t cblcLength, uint32_t recordOffset, uint16_t strikeIndex);
+    bool parseIndexSubtable(uint32_t offset, uint32_t end, StrikeRecord& strike,
+                            uint16_t firstGlyph, uint16_t lastGlyph);
 
-    // Форматы индексов
-    bool parseIndexFormat1(uint32_t offset, StrikeRecord& strike,
-                           uint16_t firstGlyph, uint16_t lastGlyph,
-                           uint16_t imageFormat, uint32_t imageDataOffset);
-    bool parseIndexFormat2(uint32_t offset, StrikeRecord& strike,
-                           uint16_t firstGlyph, uint16_t lastGlyph,
-                           uint16_t imageFormat, uint32_t imageDataOffset);
-    bool parseIndexFormat5(uint32_t offset, StrikeRecord& strike,
-                           uint16_t firstGlyph, uint16_t lastGlyph,
-                           uint16_t imageFormat, uint32_t imageDataOffset);
-
-    // Извлечение данных изображения
-    bool extractGlyphImageData(uint32_t imageOffset, GlyphImage& image, uint32_t cbdtBase, uint32_t cbdtLength);
-    bool extractBitmapData(const uint8_t* data, size_t available, GlyphImage& image);
-    bool extractPNGData(const uint8_t* data, size_t available, GlyphImage& image);
-    bool extractJPEGData(const uint8_t* data, size_t available, GlyphImage& image);
-    bool extractTIFFData(const uint8_t* data, size_t available, GlyphImage& image);
-    bool parseTIFFDirectory(const uint8_t* data, size_t available, uint32_t ifdOffset, GlyphImage& image, bool bigEndian);
+    // Small или big метрики из записи CBDT или из индекса (форматы 2 и 5)
+    void readGlyphMetrics(const uint8_t* p, GlyphImage& image, bool bigMetrics) const;
+    void addGlyph(StrikeRecord& strike, GlyphImage&& image);
 
     // Вспомогательные чтения (big endian)
     uint32_t readUInt32(const uint8_t* p) const;
     uint16_t readUInt16(const uint8_t* p) const;
-    uint16_t readUInt16(const uint8_t* p, bool bigEndian) const;
-    uint32_t readUInt32(const uint8_t* p, bool bigEndian) const;
 
     // Парсинг cmap (опционально использует utils::CMAPParser при наличии)
     bool parseCMAPTable(uint32_t offset, uint32_t length);
@@ -1,5 +1,7 @@
 #pragma once
 #include "fontmaster/CBDT_CBLC_Types.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/ByteWriter.h"
 #include <cstdint>
 #include <vector>
 #include <unordered_map>
@@ -19,6 +21,9 @@ public:
                        const std::map<uint16_t, StrikeRecord>& strikes, 
                        const std::vector<uint16_t>& removedGlyphs)
         : fontData(fontData), strikes(strikes), removedGlyphs(removedGlyphs) {}
+    /// fontData хранится по ссылке: временный буфер не принимаем
+    CBDT_CBLC_Rebuilder(std::vector<uint8_t>&&, const std::map<uint16_t, StrikeRecord>&,
+                        const std::vector<uint16_t>&) = delete;
     /**
      * @brief Добавить страйк (набор глифов)
      */
@@ -39,19 +44,31 @@ public:
      */
     std::vector<uint8_t> rebuild();
 
+    /**
+     * @brief То же без склейки в памяти: неизменённые таблицы остаются видами на fontData.
+     * Используется для записи через FontAssembler::writeFile.
+     * keepSlots - если глифы не удалялись и не добавлялись, а каждый заменённый PNG с прежними
+     * метриками помещается в свою исходную запись, CBLC остаётся как был, а новые записи
+     * пишутся на старые места с нулями в хвосте (длина PNG указана явно). Иначе - полная раскладка.
+     */
+    utils::FontAssembler assemble(bool keepSlots = false);
+
 private:
     const std::vector<uint8_t>& fontData;
     std::map<uint16_t, StrikeRecord> strikes;
     std::vector<uint16_t> removedGlyphs;
 
-    void rebuildCBLCTable(std::vector<uint8_t>& cblc);
-    void rebuildCBDTTable(std::vector<uint8_t>& cbdt);
-    void rebuildStrike(std::vector<uint8_t>& buf, const StrikeRecord& strike);
-    void rebuildIndexSubtable1(std::vector<uint8_t>& buf, const StrikeRecord& strike,
-                               uint16_t firstGlyph, uint16_t lastGlyph);
+    /**
+     * CBLC и CBDT вместе: глифы страйка делятся на прогоны, для каждого выбирается
+     * индекс 1, 2, 3 или 5 и формат PNG 17, 18 или 19 с наименьшим суммарным размером.
+     */
+    void rebuildTables(utils::ByteWriter& cblc, utils::ByteWriter& cbdt);
+
+    /// Исходный CBDT с заменёнными записями на прежних местах; false - раскладку не сохранить
+    bool rewriteSlots(std::vector<uint8_t>& cbdt) const;
 
-    std::vector<uint8_t> createUpdatedFont(const std::vector<uint8_t>& newCBLCTable,
-                                           const std::vector<uint8_t>& newCBDTTable);
+    utils::FontAssembler createUpdatedFont(std::vector<uint8_t>&& newCBLCTable,
+                                           std::vector<uint8_t>&& newCBDTTable);
 };
 
 } // namespace fontmaster
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <map>
@@ -13,22 +14,37 @@ namespace fontmaster {
 struct GlyphImage {
     uint16_t glyphID = 0;
     uint16_t imageFormat = 0;
-    uint32_t offset = 0;
+    uint16_t indexFormat = 0;
+    // Запись в исходном CBDT: после замены изображения не меняется, по ней сохранение
+    // на месте находит прежний слот. length == 0 - в исходном шрифте записи не было
+    uint32_t offset = 0;        // от начала CBDT
     uint32_t length = 0;
-    std::vector<uint8_t> data;
+    uint16_t sourceImageFormat = 0;
+    std::vector<uint8_t> data;  // запись глифа в CBDT целиком (с метриками)
     uint16_t width = 0;
     uint16_t height = 0;
     int16_t bearingX = 0;
     int16_t bearingY = 0;
     uint16_t advance = 0;
+    // Вертикальные метрики есть только в big metrics; из small остаются нулями
+    int16_t vertBearingX = 0;
+    int16_t vertBearingY = 0;
+    uint16_t vertAdvance = 0;
 };
 
 /**
  * Описание страйка (strike)
  */
 struct StrikeRecord {
-    uint16_t ppem = 0;
+    uint16_t ppem = 0;          // ppemY
+    uint16_t ppemX = 0;         // 0 - как ppem
     uint16_t resolution = 72;
+    uint8_t bitDepth = 32;      // 1/2/4/8 - оттенки серого, 32 - BGRA
+    uint8_t flags = 0;
+    // SbitLineMetrics из BitmapSize как есть; без них пишутся посчитанные по глифам
+    bool hasLineMetrics = false;
+    std::array<uint8_t, 12> hori = {};
+    std::array<uint8_t, 12> vert = {};
     std::vector<uint16_t> glyphIDs;
     std::map<uint16_t, GlyphImage> glyphImages;
 };
@@ -0,0 +1,62 @@
+#pragma once
+#include "fontmaster/CFFParser.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+class ThreadPool;
+
+/**
+ * Результат выполнения charstring одного глифа
+ */
+struct CFFGlyphMetrics {
+    double xMin = 0;
+    double yMin = 0;
+    double xMax = 0;
+    double yMax = 0;
+    bool isEmpty = true;       // у глифа нет ни одного нарисованного сегмента
+    double advanceWidth = 0;   // ширина из charstring (или defaultWidthX)
+    uint32_t numPoints = 0;    // точки контуров: moveto/lineto - 1, кривая - 3
+    uint16_t numContours = 0;
+};
+
+/**
+ * Интерпретатор Type 2 charstring для расчёта точных габаритов глифов.
+ *
+ * Габариты считаются по экстремумам кривых, а не по контрольным точкам.
+ * Вклад подпрограмм (global/local subrs) кэшируется в координатах
+ * относительно точки входа, если результат не зависит от состояния вызывающего:
+ * стек при входе пуст, ширина уже прочитана, подпрограмма не трогает хинты,
+ * transient array и random, не завершает глиф и ничего не оставляет на стеке.
+ * Кэш общий и безопасен для параллельного анализа разных глифов.
+ */
+class CFFCharstringInterpreter {
+public:
+    /// parser должен быть успешно разобран и жить дольше интерпретатора
+    explicit CFFCharstringInterpreter(const CFFParser& parser);
+    ~CFFCharstringInterpreter();
+
+    CFFGlyphMetrics analyzeGlyph(uint16_t glyphID) const;
+
+    /// Анализ всех глифов; при pool != nullptr - параллельно
+    std::vector<CFFGlyphMetrics> analyzeAllGlyphs(ThreadPool* pool = nullptr) const;
+
+    /// Число подпрограмм, вклад которых уже закэширован
+    size_t getCachedSubroutineCount() const;
+
+    struct SubrCache;
+    struct Context;
+
+private:
+    const CFFParser& parser;
+    std::unique_ptr<SubrCache> globalCache;
+    std::vector<std::unique_ptr<SubrCache>> localCaches; // по одному на Font DICT
+
+    const SubrCache* localCacheFor(uint16_t glyphID) const;
+};
+
+} // namespace utils
+} // namespace fontmaster
@@ -1,24 +1,119 @@
 #ifndef CFFPARSER_H
 #define CFFPARSER_H
 
+#include "fontmaster/ByteSpan.h"
 #include <vector>
+#include <string>
 #include <cstdint>
+#include <cstddef>
 
 namespace fontmaster {
 namespace utils {
 
+/**
+ * CFF INDEX без копирования данных.
+ * При создании читается только заголовок (count, offSize) и последнее смещение;
+ * элементы достаются за O(1) чтением двух соседних смещений.
+ */
+class CFFIndex {
+public:
+    CFFIndex() = default;
+
+    /// data начинается с поля count; хвост после INDEX допустим
+    explicit CFFIndex(ByteSpan data);
+
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /// Полный размер INDEX в байтах (заголовок + смещения + данные)
+    size_t byteLength() const { return totalLength; }
+
+    ByteSpan at(uint32_t index) const;
+    ByteSpan operator[](uint32_t index) const { return at(index); }
+
+private:
+    ByteSpan bytes;
+    uint32_t count = 0;
+    uint8_t offSize = 0;
+    size_t dataStart = 0;
+    size_t totalLength = 2;
+
+    uint32_t readOffset(uint32_t index) const;
+};
+
+/**
+ * Private DICT (для CID-шрифтов - свой у каждого Font DICT из FDArray)
+ */
+struct CFFPrivateDict {
+    CFFIndex localSubrs;
+    double defaultWidthX = 0;
+    double nominalWidthX = 0;
+};
+
+/**
+ * Читатель таблицы CFF.
+ * Разбирает заголовок, Top DICT, Private DICT и FDArray/FDSelect;
+ * charstrings и subrs отдаются как ByteSpan внутрь исходных данных,
+ * поэтому данные шрифта должны жить дольше парсера.
+ */
 class CFFParser {
 public:
-    CFFParser(const std::vector<uint8_t>& data, uint32_t offset = 0);
-    
+    /// offset - начало таблицы CFF в данных шрифта; length == 0 означает "до конца данных"
+    CFFParser(const std::vector<uint8_t>& data, uint32_t offset = 0, uint32_t length = 0);
+    explicit CFFParser(ByteSpan cffTable);
+    /// Charstrings смотрят в data: временный буфер умер бы раньше них
+    CFFParser(std::vector<uint8_t>&&, uint32_t = 0, uint32_t = 0) = delete;
+
     bool parse();
-    
+
+    const std::string& getFontName() const { return fontName; }
+    bool isCIDFont() const { return cidFont; }
+    int getCharstringType() const { return charstringType; }
+
+    uint32_t getNumGlyphs() const { return charStrings.size(); }
+    ByteSpan getCharString(uint16_t glyphID) const { return charStrings.at(glyphID); }
+
+    const CFFIndex& getCharStrings() const { return charStrings; }
+    const CFFIndex& getGlobalSubrs() const { return globalSubrs; }
+    const CFFIndex& getStrings() const { return strings; }
+
+    /// Private DICT, действующий для глифа (через FDSelect у CID-шрифтов)
+    const CFFPrivateDict& getPrivateDict(uint16_t glyphID) const;
+    const CFFIndex& getLocalSubrs(uint16_t glyphID) const { return getPrivateDict(glyphID).localSubrs; }
+
+    /// Номер Font DICT для глифа; 0 для не-CID шрифтов
+    uint8_t getFDIndex(uint16_t glyphID) const;
+    size_t getFontDictCount() const { return cidFont ? fdPrivateDicts.size() : 1; }
+    const CFFPrivateDict& getFontDictPrivate(size_t fd) const {
+        return cidFont ? fdPrivateDicts.at(fd) : privateDict;
+    }
+
 private:
-    std::vector<uint8_t> fontData;
-    uint32_t baseOffset;
+    ByteSpan cff;
+    std::string fontName;
+    bool cidFont = false;
+    int charstringType = 2;
+
+    CFFIndex names;
+    CFFIndex topDicts;
+    CFFIndex strings;
+    CFFIndex globalSubrs;
+    CFFIndex charStrings;
+
+    CFFPrivateDict privateDict;
+    std::vector<CFFPrivateDict> fdPrivateDicts;
+    ByteSpan fdSelect;
+    uint8_t fdSelectFormat = 0;
+
+    struct DictEntry {
+        uint16_t op;                 // 12 x кодируется как 0x0C00 | x
+        std::vector<double> operands;
+    };
 
-    bool parseIndex(size_t& offset);
-    uint32_t readOffset(const uint8_t* data, uint8_t offSize);
+    static std::vector<DictEntry> parseDict(ByteSpan dict);
+    static const DictEntry* findEntry(const std::vector<DictEntry>& entries, uint16_t op, size_t minOperands);
+    CFFIndex indexAt(size_t offset) const;
+    bool parsePrivateDict(const std::vector<DictEntry>& fontDict, CFFPrivateDict& result) const;
 };
 
 } // namespace utils
@@ -0,0 +1,80 @@
+#pragma once
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/ByteSpan.h"
+#include "fontmaster/GlyfOutline.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+/// Запись BaseGlyphRecord таблицы COLR v0
+struct COLRBaseGlyph {
+    uint16_t glyphID;
+    uint16_t firstLayerIndex;
+    uint16_t numLayers;
+};
+
+/// Запись LayerRecord таблицы COLR v0
+struct COLRLayerRecord {
+    uint16_t glyphID;
+    uint16_t paletteIndex;   // 0xFFFF - цвет текста
+};
+
+/// Слой с уже разрешённым цветом: 0xRRGGBBAA, straight alpha
+struct ColorLayerPaint {
+    uint16_t glyphID;
+    uint32_t rgba;
+};
+
+/**
+ * Рендер цветных глифов COLR v0 / CPAL.
+ * Слои растеризуются по контурам glyf и накладываются друг на друга
+ * (premultiplied source-over). Таблицы не копируются: данные шрифта
+ * должны жить дольше рендерера. render() потокобезопасен.
+ */
+class COLRRenderer {
+public:
+    static const uint16_t FOREGROUND_PALETTE_INDEX = 0xFFFF;
+
+    /// Бросает std::runtime_error, если COLR/CPAL отсутствуют или повреждены
+    explicit COLRRenderer(const std::vector<uint8_t>& fontData);
+
+    const std::vector<COLRBaseGlyph>& getBaseGlyphs() const { return baseGlyphs; }
+    bool hasColorGlyph(uint16_t glyphID) const { return findBaseGlyph(glyphID) != nullptr; }
+    const COLRBaseGlyph* findBaseGlyph(uint16_t glyphID) const;
+
+    std::vector<COLRLayerRecord> getLayerRecords(uint16_t glyphID) const;
+
+    uint16_t getPaletteCount() const { return numPalettes; }
+    uint16_t getPaletteSize() const { return numPaletteEntries; }
+    /// Цвет записи палитры в виде 0xRRGGBBAA
+    uint32_t getPaletteColor(uint16_t palette, uint16_t entry) const;
+
+    /// Слои глифа с цветами выбранной палитры; для не-цветного глифа - сам глиф цветом текста
+    std::vector<ColorLayerPaint> getLayers(uint16_t glyphID, uint16_t palette = 0,
+                                           uint32_t foreground = 0x000000FF) const;
+
+    /// Отрисовать глиф; pixelSize - размер em в пикселях
+    RGBAImage render(uint16_t glyphID, uint16_t pixelSize, uint16_t palette = 0,
+                     uint32_t foreground = 0x000000FF) const;
+    RGBAImage renderLayers(const std::vector<ColorLayerPaint>& layers, uint16_t pixelSize) const;
+
+    bool canRenderOutlines() const { return outlines != nullptr; }
+
+private:
+    ByteSpan layerRecords;
+    ByteSpan colorRecords;
+    std::vector<COLRBaseGlyph> baseGlyphs;
+    std::vector<uint16_t> paletteStarts;
+    uint16_t numPalettes = 0;
+    uint16_t numPaletteEntries = 0;
+    std::unique_ptr<GlyfOutlineDecoder> outlines;
+
+    void parseCOLR(ByteSpan colr);
+    void parseCPAL(ByteSpan cpal);
+};
+
+} // namespace utils
+} // namespace fontmaster
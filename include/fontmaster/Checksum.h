@@ -0,0 +1,16 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Контрольная сумма таблицы sfnt: сумма big-endian uint32 по модулю 2^32,
+ * неполное последнее слово дополняется нулями.
+ * Блоки по 16/32 байта складываются SIMD (SSE2, AVX2 с выбором во время выполнения, NEON).
+ */
+uint32_t tableChecksum(ByteSpan data);
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,68 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Отпечаток файла: устройство, inode, размер и время изменения.
+ * Совпадение отпечатков означает, что файл не подменяли и не переписывали с момента чтения.
+ */
+struct FileStamp {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    bool valid = false;
+
+    /// Невалидный отпечаток, если файл недоступен
+    static FileStamp of(const std::string& path);
+
+    bool operator==(const FileStamp& other) const {
+        return valid && other.valid && device == other.device && inode == other.inode &&
+               size == other.size && mtimeNs == other.mtimeNs;
+    }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+/**
+ * Исходный файл шрифта и его содержимое в памяти. Фрагменты записи, лежащие внутри
+ * contents, можно копировать из файла средствами ядра вместо записи из памяти.
+ */
+struct SourceFile {
+    std::string path;
+    FileStamp stamp;     // снят при чтении contents
+    ByteSpan contents;
+};
+
+/// Прочитать файл целиком; stamp (если задан) невалиден, если файл менялся во время чтения
+bool readFile(const std::string& path, std::vector<uint8_t>& data, FileStamp* stamp = nullptr);
+
+/**
+ * Записать фрагменты в path без риска оставить обрезанный файл: данные пишутся во
+ * временный файл того же каталога (O_TMPFILE, где есть), затем fsync и атомарный rename.
+ * Фрагменты из source->contents копируются из исходного файла через copy_file_range
+ * (на CoW-ФС это reflink), если отпечаток source совпадает; иначе - из памяти.
+ * При ошибке path не меняется, временный файл удаляется.
+ */
+bool writeFileAtomic(const std::string& path, const std::vector<ByteSpan>& parts,
+                     const SourceFile* source = nullptr);
+
+/// Участок файла для перезаписи на месте
+struct FilePatch {
+    uint64_t offset = 0;
+    ByteSpan data;
+};
+
+/**
+ * Перезаписать участки source.path через pwrite, не трогая остальной файл, затем fsync.
+ * Файл открывается, только если его отпечаток совпадает с source.stamp. Запись не
+ * атомарна: при сбое файл может остаться частично изменённым.
+ */
+bool patchFile(const SourceFile& source, const std::vector<FilePatch>& patches);
+
+} // namespace utils
+} // namespace fontmaster
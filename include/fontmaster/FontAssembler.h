@@ -0,0 +1,79 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include "fontmaster/FileIO.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Сборка sfnt-файла из набора таблиц без промежуточных копий.
+ * Таблица задаётся либо видом на чужой буфер (живёт до конца сборки), либо собственным буфером.
+ * Директория (отсортированная по тегу), выравнивание, контрольные суммы и
+ * head.checkSumAdjustment считаются за один проход; checkSumAdjustment складывается
+ * из сумм таблиц, а не из повторного прохода по файлу.
+ * Результат - один буфер точного размера, список фрагментов или атомарно записанный файл.
+ */
+class FontAssembler {
+public:
+    explicit FontAssembler(uint32_t sfntVersion = 0x00010000) : sfntVersion(sfntVersion) {}
+
+    /// Неизменённая таблица; бросает std::runtime_error при повторе тега
+    void addTable(const std::string& tag, ByteSpan data);
+    /// То же с известной контрольной суммой (из исходной директории) - таблица не перечитывается
+    void addTable(const std::string& tag, ByteSpan data, uint32_t checksum);
+    /// Новая таблица; буфер переходит во владение сборщика
+    void addTable(const std::string& tag, std::vector<uint8_t>&& data);
+
+    size_t tableCount() const { return tables.size(); }
+    /// Итоговый размер файла в байтах
+    size_t size();
+
+    /// Весь файл одним выделением памяти
+    std::vector<uint8_t> assemble();
+    /// Фрагменты файла по порядку: директория, таблицы и их выравнивание
+    std::vector<ByteSpan> slices();
+    /**
+     * Записать файл без сборки в памяти, через writeFileAtomic: при сбое остаётся прежний файл.
+     * Таблицы-виды на source->contents копируются из исходного файла ядром.
+     */
+    bool writeFile(const std::string& path, const SourceFile* source = nullptr);
+    /**
+     * Обновить source.path на месте, если набор таблиц тот же, а каждая изменённая таблица
+     * помещается в своё прежнее место (с выравниванием). Пишутся только отличающиеся от
+     * source.contents участки, изменённые записи директории и head.checkSumAdjustment;
+     * сумма файла пересчитывается по разнице слов от прежнего checkSumAdjustment. Запись не атомарна,
+     * поэтому правка больше четверти файла не пишется на месте.
+     * false - таблицы не помещаются, правка слишком велика, файл изменился после чтения
+     * или ошибка записи; тогда нужен writeFile.
+     */
+    bool patchFile(const SourceFile& source);
+
+private:
+    struct Table {
+        std::string tag;
+        ByteSpan source;
+        std::vector<uint8_t> owned;
+        bool isOwned = false;
+        bool checksumKnown = false;
+        uint32_t checksum = 0;
+        uint32_t offset = 0;
+
+        ByteSpan bytes() const { return isOwned ? ByteSpan(owned) : source; }
+    };
+
+    uint32_t sfntVersion;
+    std::vector<Table> tables;       // в порядке добавления - так же лягут данные
+    std::vector<uint8_t> directory;  // заголовок sfnt и записи таблиц
+    size_t totalSize = 0;
+    bool laidOut = false;
+
+    Table& addEntry(const std::string& tag);
+    void layout();
+};
+
+} // namespace utils
+} // namespace fontmaster
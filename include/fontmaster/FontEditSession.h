@@ -0,0 +1,112 @@
+#pragma once
+#include "fontmaster/FontMaster.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fontmaster {
+
+/// Какие глифы затрагивает правка: имя, ID, код или диапазон кодов
+struct GlyphSelector {
+    enum class Kind {
+        NAME,
+        GLYPH_ID,
+        CODEPOINT,
+        CODEPOINT_RANGE
+    };
+
+    Kind kind = Kind::NAME;
+    std::string name;
+    uint32_t first = 0;              // ID, код или начало диапазона
+    uint32_t last = 0;               // конец диапазона включительно
+
+    static GlyphSelector byName(const std::string& glyphName);
+    static GlyphSelector byGlyphID(uint16_t glyphID);
+    static GlyphSelector byCodepoint(uint32_t codepoint);
+    static GlyphSelector byRange(uint32_t firstCodepoint, uint32_t lastCodepoint);
+
+    /**
+     * "U+1F600", "U+1F600-1F64F" (или "U+1F600..U+1F64F"), "gid:42"; всё остальное - имя.
+     * Бросает FontException, если код или диапазон записан неверно.
+     */
+    static GlyphSelector parse(const std::string& text);
+
+    std::string toString() const;
+};
+
+/// Проверка пакета правок не прошла; шрифт не изменён
+class FontEditException : public FontException {
+public:
+    explicit FontEditException(std::vector<std::string> problems);
+    const std::vector<std::string>& problems() const { return problemList; }
+
+private:
+    std::vector<std::string> problemList;
+};
+
+/**
+ * Пакет правок шрифта с одной пересборкой. Операции только записываются (O(1) на операцию),
+ * при commit все селекторы разрешаются по одному списку глифов, пакет проверяется целиком
+ * (несуществующие глифы, пустые диапазоны, конфликты правок одного глифа), и только затем
+ * правки применяются и шрифт сохраняется один раз. Если формат всё же отвергнет правку,
+ * уже применённые откатываются (Font::restoreGlyphEditState), а FontException называет
+ * номер операции и глиф. Если не удалось сохранение, откатывается весь пакет: шрифт в памяти
+ * остаётся как до commit, операции сессии сохраняются, FontSaveException сообщает об откате.
+ */
+class FontEditSession {
+public:
+    explicit FontEditSession(Font& font);
+
+    void remove(const GlyphSelector& target);
+    /// Одно изображение на все глифы селектора
+    void replace(const GlyphSelector& target, std::vector<uint8_t> image);
+    /// Изображение для глифа, у которого его нет (см. Font::addGlyphImage)
+    void add(const GlyphSelector& target, std::vector<uint8_t> image);
+
+    size_t size() const { return operations.size(); }
+    bool empty() const { return operations.empty(); }
+    void clear() { operations.clear(); }
+
+    /// Все найденные проблемы пакета; пустой список - можно применять
+    std::vector<std::string> validate() const;
+
+    /// Применить и сохранить в outputPath; возвращает число изменённых глифов
+    size_t commit(const std::string& outputPath);
+    /// То же с сохранением через Font::saveInPlace
+    size_t commitInPlace();
+
+private:
+    enum class Action {
+        REMOVE,
+        REPLACE,
+        ADD
+    };
+
+    struct Operation {
+        Action action;
+        GlyphSelector target;
+        std::vector<uint8_t> image;
+    };
+
+    // Правка одного глифа после разрешения селектора
+    struct GlyphEdit {
+        Action action;
+        std::string glyphName;
+        size_t operation;            // индекс в operations
+    };
+
+    // Состояния глифов до правок пакета в порядке применения
+    using UndoLog = std::vector<std::unique_ptr<Font::GlyphEditState>>;
+
+    Font& font;
+    std::vector<Operation> operations;
+
+    std::vector<GlyphEdit> resolve(std::vector<std::string>& problems) const;
+    UndoLog apply();
+    void rollback(const UndoLog& undo);
+    size_t applyAndSave(const std::string& target, const std::function<bool()>& save);
+};
+
+} // namespace fontmaster
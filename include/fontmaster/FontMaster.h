@@ -18,10 +18,23 @@ enum class FontFormat {
 
 struct GlyphInfo {
     std::string name;
+    uint16_t glyph_id = 0;
     uint32_t unicode;
     std::vector<uint8_t> image_data;
-    std::string format; // "png", "svg", "colr"
+    std::string format; // "png" (image_data - сам PNG), "svg", "colr"
     size_t data_size;
+    // Из заголовка изображения или метрик страйка; 0 - неизвестно
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bit_depth = 0;
+    uint16_t ppem = 0;
+};
+
+// Растровое изображение глифа: RGBA8 без premultiply, строки без выравнивания
+struct RGBAImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
 };
 
 // Предварительные объявления
@@ -60,7 +73,7 @@ public:
 
 class Font {
 public:
-    virtual ~Font() = default;
+    virtual ~Font();
     
     virtual bool load() = 0;
     virtual const std::vector<uint8_t>& getFontData() const = 0;
@@ -70,12 +83,31 @@ public:
     
     virtual FontFormat getFormat() const = 0;
     virtual bool save(const std::string& filepath) = 0;
+    /**
+     * Сохранить правки в файл, из которого шрифт загружен. Если изменённые таблицы
+     * помещаются на прежние места, переписываются только отличающиеся байты, директория
+     * и head.checkSumAdjustment (не атомарно); иначе файл пересобирается, как в save.
+     */
+    virtual bool saveInPlace();
     
     // Основные операции
     virtual bool removeGlyph(const std::string& glyphName) = 0;
     virtual bool removeGlyph(uint32_t unicode) = 0;
     virtual bool replaceGlyphImage(const std::string& glyphName, 
                                   const std::vector<uint8_t>& newImage) = 0;
+    /// Изображение для глифа, который есть в шрифте, но без изображения; по умолчанию не поддерживается
+    virtual bool addGlyphImage(const std::string& glyphName, const std::vector<uint8_t>& image);
+    /// Проверка для addGlyphImage без изменений шрифта
+    virtual bool canAddGlyphImage(const std::string& glyphName) const;
+    
+    /// Правки одного глифа до изменения; по ним FontEditSession откатывает частично применённый пакет
+    class GlyphEditState {
+    public:
+        virtual ~GlyphEditState() = default;
+    };
+    /// Снимок принадлежит этому шрифту; по умолчанию откат не поддерживается
+    virtual std::unique_ptr<GlyphEditState> saveGlyphEditState(const std::string& glyphName) const;
+    virtual void restoreGlyphEditState(const GlyphEditState& state);
     
     // Информация
     virtual std::vector<GlyphInfo> listGlyphs() const = 0;
@@ -83,6 +115,27 @@ public:
     
     // Утилиты
     virtual std::string findGlyphName(uint32_t unicode) const = 0;
+    
+    /**
+     * Изображение глифа в RGBA8. strike - индекс страйка (CBDT/sbix)
+     * или размер em в пикселях (COLR, должен быть больше 0). Результат кэшируется в общем
+     * LRU-кэше по (шрифт, поколение правок, strike, glyphID).
+     */
+    std::shared_ptr<const RGBAImage> decodeGlyph(uint16_t glyphID, uint16_t strike = 0) const;
+    
+protected:
+    // Декодирование без кэша; по умолчанию формат не поддерживается
+    virtual RGBAImage decodeGlyphImage(uint16_t glyphID, uint16_t strike) const;
+    
+    // Сбросить закэшированные изображения шрифта после правок
+    void invalidateDecodedGlyphs() const;
+    
+private:
+    static uint64_t nextDecodedGeneration();
+    
+    // Поколение в ключе кэша: после правки старые изображения не находятся
+    // и вытесняются LRU сами, без обхода всего кэша
+    mutable uint64_t decodedGeneration = nextDecodedGeneration();
 };
 
 class FontFormatHandler {
@@ -93,4 +146,7 @@ public:
     virtual FontFormat getFormat() const = 0;
 };
 
+// Добавить обработчик в реестр Font::load; обработчики пробуются в порядке регистрации
+void registerFontFormatHandler(std::unique_ptr<FontFormatHandler> handler);
+
 } // namespace fontmaster
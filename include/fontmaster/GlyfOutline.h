@@ -0,0 +1,94 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <vector>
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+struct GlyphPoint {
+    float x;
+    float y;
+    bool onCurve;
+};
+
+/**
+ * Контуры TrueType-глифа в единицах шрифта (составные глифы уже развернуты)
+ */
+struct GlyphOutline {
+    std::vector<GlyphPoint> points;
+    std::vector<uint16_t> contourEnds;   // индекс последней точки каждого контура
+    int16_t xMin = 0;
+    int16_t yMin = 0;
+    int16_t xMax = 0;
+    int16_t yMax = 0;
+
+    void clear() {
+        points.clear();
+        contourEnds.clear();
+        xMin = yMin = xMax = yMax = 0;
+    }
+};
+
+/// Габариты глифа в единицах шрифта
+struct GlyphBounds {
+    int16_t xMin = 0;
+    int16_t yMin = 0;
+    int16_t xMax = 0;
+    int16_t yMax = 0;
+};
+
+/**
+ * Габариты простого глифа по координатам точек, без построения контуров: флаги
+ * разворачиваются сериями, координаты восстанавливаются векторной префиксной суммой дельт.
+ * false - глиф составной, без точек или повреждён.
+ */
+bool simpleGlyphBounds(ByteSpan glyphData, GlyphBounds& bounds);
+
+/**
+ * Декодер контуров из таблиц glyf/loca.
+ * Данные не копируются: декодер хранит span'ы внутрь данных шрифта.
+ */
+class GlyfOutlineDecoder {
+public:
+    /// Находит head/maxp/loca/glyf в данных шрифта; бросает std::runtime_error, если их нет
+    explicit GlyfOutlineDecoder(const std::vector<uint8_t>& fontData);
+    GlyfOutlineDecoder(ByteSpan glyfTable, ByteSpan locaTable, bool longLocaFormat,
+                       uint16_t numGlyphs, uint16_t unitsPerEm);
+    /// Смещения глифов заданы явно (numGlyphs + 1 значений), например пока loca не пересобрана
+    GlyfOutlineDecoder(ByteSpan glyfTable, std::vector<uint32_t> glyphOffsets, uint16_t unitsPerEm);
+
+    uint16_t getNumGlyphs() const { return numGlyphs; }
+    uint16_t getUnitsPerEm() const { return unitsPerEm; }
+
+    /// Сырые данные глифа; пустой span для глифа без контуров
+    ByteSpan getGlyphData(uint16_t glyphID) const;
+
+    /**
+     * Декодировать глиф в outline (результат дописывается после очистки).
+     * Возвращает false для пустого или повреждённого глифа.
+     */
+    bool decode(uint16_t glyphID, GlyphOutline& outline) const;
+
+    /**
+     * Точные габариты по точкам, а не из заголовка глифа. Составной глиф разворачивается
+     * с преобразованиями компонентов, границы округляются до ближайшего целого.
+     * false - глиф пустой или повреждён.
+     */
+    bool computeBounds(uint16_t glyphID, GlyphBounds& bounds) const;
+
+private:
+    ByteSpan glyf;
+    ByteSpan loca;
+    std::vector<uint32_t> offsets;       // если не пусто - вместо loca
+    bool longLoca = false;
+    uint16_t numGlyphs = 0;
+    uint16_t unitsPerEm = 1000;
+
+    bool decodeInto(uint16_t glyphID, GlyphOutline& outline, int depth) const;
+    bool decodeSimple(ByteSpan data, int16_t numberOfContours, GlyphOutline& outline) const;
+    bool decodeComposite(ByteSpan data, GlyphOutline& outline, int depth) const;
+};
+
+} // namespace utils
+} // namespace fontmaster
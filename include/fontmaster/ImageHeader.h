@@ -0,0 +1,26 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <cstdint>
+#include <string>
+
+namespace fontmaster {
+namespace utils {
+
+/// Параметры изображения, прочитанные из заголовка без декодирования
+struct ImageHeader {
+    std::string format = "unknown";  // "png", "jpg", "tiff", "unknown"
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 0;            // бит на канал
+    uint8_t channels = 0;            // каналов на пиксель (палитра PNG - 1)
+};
+
+/**
+ * Прочитать размеры и глубину из PNG IHDR, JPEG SOFn или первого TIFF IFD.
+ * Не бросает: если формат распознан по сигнатуре, но заголовок повреждён,
+ * format заполнен, а размеры нулевые.
+ */
+ImageHeader probeImageHeader(ByteSpan data);
+
+} // namespace utils
+} // namespace fontmaster
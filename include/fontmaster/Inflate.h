@@ -0,0 +1,36 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fontmaster {
+namespace utils {
+
+enum class CompressionFormat {
+    ZLIB,   // RFC 1950 (PNG IDAT)
+    GZIP    // RFC 1952 (сжатые SVG-документы)
+};
+
+/**
+ * Проверить сигнатуру gzip (1F 8B).
+ */
+bool isGzipData(ByteSpan data);
+
+/**
+ * Распаковать данные через zlib.
+ * sizeHint - ожидаемый размер результата (0 если неизвестен),
+ * maxSize - предел размера результата (защита от "zip-бомб").
+ * Бросает std::runtime_error при повреждённых данных или превышении предела.
+ */
+std::vector<uint8_t> inflateData(ByteSpan input, CompressionFormat format,
+                                 size_t sizeHint = 0,
+                                 size_t maxSize = 64 * 1024 * 1024);
+
+/**
+ * Размер распакованных данных из трейлера gzip (ISIZE, по модулю 2^32).
+ */
+size_t gzipUncompressedSize(ByteSpan data);
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,130 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Потокобезопасный LRU-кэш, ограниченный суммарной "стоимостью" записей
+ * (обычно размером в байтах). Значения хранятся как shared_ptr, поэтому
+ * вытесненная запись остаётся валидной, пока её держит вызывающий код.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache {
+public:
+    using ValuePtr = std::shared_ptr<const Value>;
+
+    explicit LRUCache(size_t maxCost) : capacity(maxCost) {}
+
+    ValuePtr get(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) return nullptr;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->value;
+    }
+
+    /**
+     * Вставить значение. Если ключ уже есть (его успел вставить другой поток),
+     * возвращается существующее значение.
+     */
+    ValuePtr put(const Key& key, ValuePtr value, size_t cost) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->value;
+        }
+
+        // Записи дороже всего кэша не сохраняем, но отдаём вызывающему
+        if (cost > capacity) return value;
+
+        entries.push_front(Entry{key, value, cost});
+        index[key] = entries.begin();
+        totalCost += cost;
+        evict();
+        return value;
+    }
+
+    /**
+     * Получить значение из кэша или построить его через factory.
+     * factory вызывается без блокировки; factory возвращает пару {значение, стоимость}.
+     */
+    template <typename Factory>
+    ValuePtr getOrCreate(const Key& key, Factory&& factory) {
+        if (ValuePtr cached = get(key)) return cached;
+        std::pair<ValuePtr, size_t> created = factory();
+        if (!created.first) return nullptr;
+        return put(key, created.first, created.second);
+    }
+
+    void erase(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) return;
+        totalCost -= it->second->cost;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    template <typename Predicate>
+    void eraseIf(Predicate&& predicate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (predicate(it->key)) {
+                totalCost -= it->cost;
+                index.erase(it->key);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        totalCost = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    size_t cost() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totalCost;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        ValuePtr value;
+        size_t cost;
+    };
+
+    void evict() {
+        while (totalCost > capacity && !entries.empty()) {
+            const Entry& last = entries.back();
+            totalCost -= last.cost;
+            index.erase(last.key);
+            entries.pop_back();
+        }
+    }
+
+    size_t capacity;
+    size_t totalCost = 0;
+    std::list<Entry> entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+    mutable std::mutex mutex;
+};
+
+} // namespace utils
+} // namespace fontmaster
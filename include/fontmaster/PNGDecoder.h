@@ -0,0 +1,33 @@
+#pragma once
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/ByteSpan.h"
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+/// Поля IHDR
+struct PNGInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 0;
+    uint8_t colorType = 0;
+    uint8_t interlace = 0;
+};
+
+/// Проверить 8-байтовую сигнатуру PNG
+bool isPNGData(ByteSpan data);
+
+/// Прочитать IHDR без распаковки; бросает std::runtime_error
+PNGInfo readPNGInfo(ByteSpan data);
+
+/**
+ * Декодировать PNG в RGBA8 (straight alpha).
+ * Поддерживаются все типы цвета и глубины, tRNS и Adam7.
+ * Фильтры Sub/Up/Average/Paeth снимаются SIMD (SSE2/AVX2/NEON) для 3- и 4-байтовых пикселей.
+ * maxPixels ограничивает размер результата. Бросает std::runtime_error.
+ */
+RGBAImage decodePNG(ByteSpan data, size_t maxPixels = 64 * 1024 * 1024);
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fontmaster {
+namespace utils {
+
+class ScopedPhase;
+
+/**
+ * Время этапов обработки шрифта: чтение файла, директория таблиц, cmap, post, страйки,
+ * изображения, пересборка, контрольные суммы, запись. Профиль подключается к потоку
+ * через attach; без профиля ScopedPhase стоит одного чтения thread_local.
+ * Этапы вкладываются, и этапу засчитывается время без вложенных в него этапов, так что
+ * сумма этапов не больше общего времени. Работа в потоках пула засчитывается этапу,
+ * который её запустил.
+ */
+class PhaseProfile {
+public:
+    struct Phase {
+        std::string name;
+        uint64_t nanoseconds = 0;
+        uint64_t calls = 0;
+    };
+
+    /// Подключить профиль к текущему потоку; nullptr - отключить
+    static void attach(PhaseProfile* profile);
+    static PhaseProfile* current();
+
+    /// В порядке первого появления
+    const std::vector<Phase>& phases() const { return entries; }
+    void clear() { entries.clear(); }
+
+private:
+    friend class ScopedPhase;
+
+    std::vector<Phase> entries;
+    ScopedPhase* active = nullptr;       // самый вложенный открытый этап
+
+    void record(const char* name, uint64_t nanoseconds);
+};
+
+/// Замер этапа до конца области видимости; name - строковый литерал
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* name);
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    PhaseProfile* profile;
+    ScopedPhase* parent = nullptr;
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    uint64_t nested = 0;                 // время вложенных этапов
+};
+
+} // namespace utils
+} // namespace fontmaster
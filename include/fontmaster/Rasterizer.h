@@ -0,0 +1,59 @@
+#pragma once
+#include "fontmaster/GlyfOutline.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Растеризатор контуров со сглаживанием.
+ * Отрезки накапливают знаковую площадь в буфере float (по ячейке на пиксель),
+ * покрытие получается префиксной суммой по строке (SSE2/NEON, иначе скалярно).
+ * Заливка - |winding|, ограниченный единицей (совпадает с nonzero для
+ * непересекающихся контуров одного направления).
+ */
+class Rasterizer {
+public:
+    Rasterizer() = default;
+    Rasterizer(uint32_t width, uint32_t height) { reset(width, height); }
+
+    /// Задать размер и очистить буфер
+    void reset(uint32_t width, uint32_t height);
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+
+    /// Координаты в пикселях, ось y направлена вниз
+    void drawLine(float x0, float y0, float x1, float y1);
+    void drawQuad(float x0, float y0, float x1, float y1, float x2, float y2);
+
+    /**
+     * Добавить TrueType-контуры: пиксель = (x * scale + dx, dy - y * scale).
+     * Неявные on-curve точки между соседними off-curve восстанавливаются.
+     */
+    void addOutline(const GlyphOutline& outline, float scale, float dx, float dy);
+
+    /// Записать покрытие 0..255 (width * height байт) и очистить буфер накопления
+    void resolve(uint8_t* coverage);
+
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t stride = 0;
+    std::vector<float> accumulation;
+};
+
+/**
+ * Залить premultiplied RGBA8 буфер цветом с маской покрытия:
+ * dst = color * coverage + dst * (1 - color.a * coverage).
+ * color - straight RGBA в виде 0xRRGGBBAA.
+ */
+void blendSolidColor(uint8_t* premultipliedRGBA, const uint8_t* coverage, size_t pixelCount, uint32_t color);
+
+/// Перевести premultiplied RGBA8 в обычный (straight alpha) на месте
+void unpremultiplyAlpha(uint8_t* rgba, size_t pixelCount);
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,83 @@
+#pragma once
+#include "fontmaster/ByteSpan.h"
+#include "fontmaster/LRUCache.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Запись индекса документов таблицы 'SVG ' (SVGDocumentRecord).
+ * offset отсчитывается от начала списка документов, как в спецификации.
+ */
+struct SVGDocumentRecord {
+    uint16_t startGlyphID;
+    uint16_t endGlyphID;
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+ * Глифы, которые запись действительно отдаёт. Диапазоны не пересекаются и идут
+ * по возрастанию: при пересечении записей глиф достаётся первой из них.
+ */
+struct SVGGlyphRange {
+    uint16_t startGlyphID;
+    uint16_t endGlyphID;
+    const SVGDocumentRecord* record;
+};
+
+/**
+ * SVG-документ. bytes указывает либо прямо в данные шрифта (несжатый документ),
+ * либо в распакованный буфер, которым владеет owner.
+ */
+struct SVGDocument {
+    ByteSpan bytes;
+    std::shared_ptr<const std::vector<uint8_t>> owner;
+    bool compressed = false;
+};
+
+/**
+ * Индекс документов таблицы 'SVG '.
+ * Разбор ограничивается заголовком и массивом записей; документы не копируются.
+ * gzip-документы распаковываются лениво и кэшируются по смещению документа,
+ * поэтому документ, общий для нескольких глифов, распаковывается один раз.
+ */
+class SVGDocumentIndex {
+public:
+    /// svgTable должен указывать на данные, которые живут дольше индекса
+    explicit SVGDocumentIndex(ByteSpan svgTable, size_t cacheBytes = 8 * 1024 * 1024);
+
+    const std::vector<SVGDocumentRecord>& getRecords() const { return records; }
+    size_t getDocumentCount() const { return records.size(); }
+
+    /// Обход глифов с документами - общий для списка глифов и пересборки таблицы
+    const std::vector<SVGGlyphRange>& getGlyphRanges() const { return glyphRanges; }
+
+    /// Двоичный поиск по getGlyphRanges(); nullptr если у глифа нет SVG
+    const SVGDocumentRecord* findRecord(uint16_t glyphID) const;
+    bool hasGlyph(uint16_t glyphID) const { return findRecord(glyphID) != nullptr; }
+
+    /// Исходные (возможно сжатые) байты документа без копирования
+    ByteSpan getRawDocument(const SVGDocumentRecord& record) const;
+
+    /// Документ в виде текста SVG; gzip распаковывается через кэш
+    SVGDocument getDocument(const SVGDocumentRecord& record) const;
+    SVGDocument getDocument(uint16_t glyphID) const;
+
+    size_t getCachedBytes() const { return cache.cost(); }
+
+private:
+    ByteSpan table;
+    ByteSpan documentList;
+    std::vector<SVGDocumentRecord> records;
+    std::vector<SVGGlyphRange> glyphRanges;
+    mutable LRUCache<uint32_t, std::vector<uint8_t>> cache;
+
+    void parse();
+};
+
+} // namespace utils
+} // namespace fontmaster
@@ -4,12 +4,17 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <functional>
 #include <cstdint>
+#include "fontmaster/ByteSpan.h"
+#include "fontmaster/FontAssembler.h"
 
 namespace fontmaster {
 
 namespace utils {
+    class ThreadPool;
+    class GlyfOutlineDecoder;
     struct TTFHeader;
     struct TableRecord;
     std::vector<TableRecord> parseTTFTables(const std::vector<uint8_t>& data);
@@ -19,10 +24,16 @@ class TTFRebuilder {
 public:
     struct GlyphInfo {
         uint32_t offset;
-        uint32_t length;
-        uint16_t advanceWidth;
+        uint32_t length;                 // до начала следующего глифа, вместе с выравниванием
+        uint16_t advanceWidth;           // из исходной hmtx
         int16_t leftSideBearing;
         bool isEmpty;
+        // Габариты по точкам контура (для CFF - по charstring'ам); без контура нули и hasBounds == false
+        int16_t xMin = 0;
+        int16_t yMin = 0;
+        int16_t xMax = 0;
+        int16_t yMax = 0;
+        bool hasBounds = false;
     };
 
     struct NameRecord {
@@ -34,6 +45,7 @@ public:
         uint16_t offset;
     };
 
+    /// Для составного глифа: точки и контуры всех листьев, число прямых компонентов, глубина вложенности
     struct CompositeGlyphStats {
         uint16_t maxPoints;
         uint16_t maxContours;
@@ -45,21 +57,71 @@ public:
         std::string tag;
         uint32_t originalOffset;
         uint32_t originalLength;
-        uint32_t newOffset;
+        uint32_t originalChecksum;       // из исходной директории; годится, пока таблица не изменена
         uint32_t newLength;
         bool modified;
-        std::vector<uint8_t> data;
+        utils::ByteSpan source;          // вид на исходный буфер шрифта
+        std::vector<uint8_t> owned;      // собственная копия, появляется при первом изменении
+        bool materialized = false;
+
+        utils::ByteSpan bytes() const { return materialized ? utils::ByteSpan(owned) : source; }
+
+        // Копирует исходные байты только при первой записи
+        std::vector<uint8_t>& mutableData() {
+            if (!materialized) {
+                owned.assign(source.begin(), source.end());
+                materialized = true;
+            }
+            return owned;
+        }
+
+        void assign(std::vector<uint8_t> data) {
+            owned = std::move(data);
+            materialized = true;
+        }
     };
 
+    /// Таблицы не копируются: fontData должен жить дольше rebuilder'а
     TTFRebuilder(const std::vector<uint8_t>& fontData);
+    /// Временный буфер умер бы раньше span'ов на его таблицы
+    TTFRebuilder(std::vector<uint8_t>&&) = delete;
     
+    /// Пересборка затрагивает только этапы, зависящие от изменённых данных; остальное копируется как есть
     void markTableModified(const std::string& tag);
     void setTableData(const std::string& tag, const std::vector<uint8_t>& data);
-    const std::vector<uint8_t>* getTableData(const std::string& tag) const;
+    void setTableData(const std::string& tag, std::vector<uint8_t>&& data);
+    /// Пустой span, если таблицы нет (см. hasTable)
+    utils::ByteSpan getTableData(const std::string& tag) const;
     bool hasTable(const std::string& tag) const;
+    /**
+     * Обработчик без объявленных зависимостей может читать и писать что угодно: он ждёт все
+     * предыдущие этапы, следующие ждут его, и параллельно с ним ничего не выполняется.
+     * Для новой таблицы этап идёт после всех встроенных; у встроенной остаётся её место в порядке.
+     */
     void setTableRebuildHandler(const std::string& tag, std::function<void(const std::string&)> handler);
+    /**
+     * Обработчик с объявленными зависимостями: этапы пересборки выполняются параллельно,
+     * поэтому он должен читать только inputs и писать только outputs. Кроме тегов таблиц
+     * можно указать промежуточные данные: "#glyphs" (смещения и метрики глифов),
+     * "#hmetrics" (numberOfHMetrics), "#locaFormat".
+     */
+    void setTableRebuildHandler(const std::string& tag, std::function<void(const std::string&)> handler,
+                                std::vector<std::string> inputs, std::vector<std::string> outputs);
+    /// Пул для этапов пересборки; по умолчанию ThreadPool::shared(). Результат от числа потоков не зависит
+    void setThreadPool(utils::ThreadPool* pool) { threadPool = pool; }
     
     virtual std::vector<uint8_t> rebuild() = 0;
+    /// Пересобрать изменённые таблицы и вернуть сборщик файла; виды в нём живут вместе с rebuilder'ом
+    utils::FontAssembler assembleTables();
+    
+    /**
+     * Заменить данные одного глифа в glyf без полного разбора таблицы: глиф, который
+     * помещается на старое место, пишется туда же, иначе смещения следующих глифов
+     * сдвигаются; габариты считаются по точкам только для этого глифа и пишутся в его заголовок,
+     * ширина из hmtx сохраняется. При сборке обновляются loca и maxp, а head/hmtx/hhea/OS/2 -
+     * только если сменились габариты.
+     */
+    void replaceGlyph(uint16_t glyphId, utils::ByteSpan glyphData);
     
     void setNumGlyphs(uint16_t newNumGlyphs);
     void setNumberOfHMetrics(uint16_t newNumHMetrics);
@@ -72,24 +134,58 @@ public:
     void updateMaxpTable(const std::string& maxpTag = "maxp");
 
 private:
-    std::vector<uint8_t> originalData;
-    std::vector<uint8_t> newData;
+    // Разобранный заголовок глифа для maxp; сбрасывается при изменении глифа
+    struct GlyphOutlineStats {
+        uint16_t points = 0;
+        uint16_t contours = 0;
+        uint16_t instructions = 0;
+        bool composite = false;
+        bool known = false;
+        std::vector<uint16_t> components;
+    };
+
+    struct RebuildHandler {
+        std::function<void(const std::string&)> run;
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        std::vector<std::string> triggers;   // изменение чего требует запуска; пусто - tag и inputs
+        bool exclusive = false;              // зависимости не объявлены: этап - барьер в графе
+    };
+
+    const std::vector<uint8_t>& originalData;
     std::map<std::string, TableInfo> tables;
     std::vector<std::string> tableOrder;
-    std::map<std::string, std::function<void(const std::string&)>> rebuildHandlers;
+    std::map<std::string, RebuildHandler> rebuildHandlers;
+    utils::ThreadPool* threadPool = nullptr;
+    std::set<std::string> dirty;             // изменённые таблицы и промежуточные данные
     
     std::vector<GlyphInfo> glyphOffsets;
+    std::vector<GlyphOutlineStats> outlineStats;
+    bool locaMatchesGlyf = true;             // текущая loca описывает текущий glyf
+    bool glyphOffsetsStale = false;          // glyf или loca заменены целиком после расчёта смещений
+    bool glyphMetricsKnown = false;          // ширины и габариты в glyphOffsets посчитаны для всех глифов
     uint16_t numGlyphs;
     uint16_t numHMetrics;
     bool locaShortFormat;
+    // Следующие индексы имён post для новых глифов; задаются в начале каждой пересборки post,
+    // поэтому имена зависят только от шрифта, а не от предыдущих пересборок
+    uint32_t nextUnicodeNameIndex = 0;
+    uint32_t nextCompositeNameIndex = 0;
+    uint32_t nextDefaultNameIndex = 0;
 
-    // Вспомогательные методы для работы с данными
-    uint16_t getUInt16(const std::vector<uint8_t>& data, size_t offset) const;
-    uint32_t getUInt32(const std::vector<uint8_t>& data, size_t offset) const;
-    int16_t getInt16(const std::vector<uint8_t>& data, size_t offset) const;
+    // Чтение и точечная правка полей; таблицы целиком пишутся через utils::ByteWriter
+    uint16_t getUInt16(utils::ByteSpan data, size_t offset) const;
+    uint32_t getUInt32(utils::ByteSpan data, size_t offset) const;
+    int16_t getInt16(utils::ByteSpan data, size_t offset) const;
     void setUInt16(std::vector<uint8_t>& data, size_t offset, uint16_t value);
     void setUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value);
     void setInt16(std::vector<uint8_t>& data, size_t offset, int16_t value);
+    utils::ThreadPool& pool() const;
+    void noteOutlinesReplaced(const std::string& tag);
+    /// Смещения глифов по требованию: первый раз, после замены glyf/loca или смены числа глифов
+    void ensureGlyphOffsets();
+    /// Ширины и габариты всех глифов - только этапам, которым они нужны (glyf, hmtx, hhea, head, OS/2)
+    void ensureGlyphMetrics();
     
     // Методы парсинга оригинальной структуры
     void parseOriginalStructure();
@@ -97,9 +193,12 @@ private:
     bool parseMaxpTable();
     bool parseHheaTable();
     bool parseLocaTable();
-    void parseGlyfTable();
     
     // Методы пересборки таблиц
+    bool isStageTriggered(const std::string& tag) const;
+    bool runStageIfDirty(const std::string& tag);
+    std::vector<std::string> planRebuild();
+    void runRebuildStages(const std::vector<std::string>& stages);
     void rebuildTable(const std::string& tag);
     void rebuildGlyfTable(const std::string& tag);
     void rebuildLocaTable(const std::string& tag);
@@ -110,22 +209,32 @@ private:
     void rebuildOS2Table(const std::string& tag);
     void rebuildHeadTable(const std::string& tag);
     void rebuildPostTable(const std::string& tag);
+    void rebuildCFFTable(const std::string& tag);
     
     // Методы расчета и обновления
+    /// Смещения из loca; если loca не описывает текущий glyf - последовательным разбором глифов
     void calculateGlyphOffsets();
-    uint32_t parseSimpleGlyphLength(const std::vector<uint8_t>& data, uint32_t offset) const;
-    uint32_t parseCompositeGlyphLength(const std::vector<uint8_t>& data, uint32_t offset) const;
+    void calculateGlyphOffsetsFromOutlines();
+    uint32_t parseSimpleGlyphLength(utils::ByteSpan data, uint32_t offset) const;
+    uint32_t parseCompositeGlyphLength(utils::ByteSpan data, uint32_t offset) const;
+    /// Ширины из hmtx, габариты и lsb - по точкам глифов
     void calculateGlyphMetrics();
+    /// Габариты одного глифа; outlines нужен только составным, ширина не меняется
+    void calculateGlyphMetrics(GlyphInfo& glyph, size_t index, utils::ByteSpan glyfData,
+                               const utils::GlyfOutlineDecoder* outlines) const;
+    utils::GlyfOutlineDecoder makeOutlineDecoder(utils::ByteSpan glyfData) const;
+    void writeGlyphBounds(std::vector<uint8_t>& glyfData, const GlyphInfo& glyph) const;
+    void calculateCFFGlyphMetrics();
     void calculateHMetrics();
-    void recalculateFontMetrics();
     void updateHheaMetrics();
     void updateOS2Metrics();
     void updateMaxpTableValues();
     
     // Методы для работы с точками и контурами
-    uint16_t calculateSimpleGlyphPoints(const std::vector<uint8_t>& data, uint32_t offset) const;
-    CompositeGlyphStats calculateCompositeGlyphStats(const std::vector<uint8_t>& data, uint32_t offset) const;
-    CompositeGlyphStats analyzeGlyphForComposite(const std::vector<uint8_t>& data, uint32_t offset) const;
+    uint16_t calculateSimpleGlyphPoints(utils::ByteSpan data, uint32_t offset) const;
+    void decodeOutlineStats(utils::ByteSpan data, size_t index, GlyphOutlineStats& stats) const;
+    /// Статистика всех составных глифов за один проход по графу компонентов, O(глифов + ссылок)
+    std::vector<CompositeGlyphStats> resolveCompositeStats() const;
     
     // Методы для работы с таблицей имен
     void updateNameTableChecksum();
@@ -136,8 +245,8 @@ private:
     void updatePostTableFormat2();
     uint16_t calculateStandardGlyphNameIndex(uint16_t glyphIndex);
     uint16_t getUnicodeFromCmap(uint16_t glyphIndex);
-    uint16_t findGlyphInFormat4Subtable(const std::vector<uint8_t>& cmapData, uint32_t offset, uint16_t glyphIndex);
-    uint16_t findGlyphInFormat12Subtable(const std::vector<uint8_t>& cmapData, uint32_t offset, uint16_t glyphIndex);
+    uint16_t findGlyphInFormat4Subtable(utils::ByteSpan cmapData, uint32_t offset, uint16_t glyphIndex);
+    uint16_t findGlyphInFormat12Subtable(utils::ByteSpan cmapData, uint32_t offset, uint16_t glyphIndex);
     bool isCompositeGlyph(uint16_t glyphIndex);
     uint16_t generateUnicodeGlyphNameIndex(uint16_t unicodeValue);
     uint16_t generateCompositeGlyphName(uint16_t glyphIndex);
@@ -146,13 +255,6 @@ private:
     // Методы валидации
     void validateTableData(const std::string& tag, size_t minSize) const;
     void validateGlyphData() const;
-    
-    // Методы для сборки финального файла
-    void updateTableOffsets();
-    void rebuildTableDirectory();
-    void updateHeadTableChecksumAdjustment();
-    uint32_t calculateTableChecksum(const std::vector<uint8_t>& data) const;
-    uint32_t calculateChecksum(const std::vector<uint8_t>& data) const;
 };
 
 } // namespace fontmaster
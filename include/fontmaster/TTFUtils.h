@@ -92,6 +92,8 @@ public:
 std::vector<TableRecord> parseTTFTables(const std::vector<uint8_t>& fontData);
 bool hasTable(const std::vector<TableRecord>& tables, const std::string& tableTag);
 const TableRecord* findTable(const std::vector<TableRecord>& tables, const std::string& tableTag);
+/// Указатель смотрит в tables: временный вектор умер бы раньше него
+const TableRecord* findTable(std::vector<TableRecord>&&, const std::string&) = delete;
 
 
 }
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+namespace fontmaster {
+namespace utils {
+
+/**
+ * Простой пул потоков для параллельной обработки глифов и таблиц.
+ * Вызывающий поток тоже участвует в работе parallelFor, поэтому вложенные
+ * вызовы и пул из одного потока не приводят к взаимоблокировке.
+ */
+class ThreadPool {
+public:
+    /// threadCount == 0 - по числу аппаратных потоков
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Число потоков, включая вызывающий
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * Выполнить body(begin, end) для поддиапазонов [first, last) размером не больше grain.
+     * Возвращается, когда все поддиапазоны обработаны; первое исключение пробрасывается.
+     */
+    void parallelFor(size_t first, size_t last, size_t grain,
+                     const std::function<void(size_t, size_t)>& body);
+
+    /**
+     * Выполнить body(i) для каждой вершины графа задач; dependencies[i] - вершины,
+     * которые должны завершиться раньше i, все с меньшими номерами (поэтому циклов нет).
+     * Вершина запускается сразу, как только готовы её зависимости. После первого
+     * исключения новые вершины не запускаются, исключение пробрасывается.
+     */
+    void runGraph(const std::vector<std::vector<size_t>>& dependencies,
+                  const std::function<void(size_t)>& body);
+
+    /// Общий пул процесса
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void workerLoop();
+    void enqueue(std::function<void()> task);
+};
+
+} // namespace utils
+} // namespace fontmaster
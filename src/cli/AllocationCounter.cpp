@@ -0,0 +1,64 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<uint64_t> allocatedBytes{0};
+std::atomic<uint64_t> allocationCount{0};
+
+} // namespace
+
+void setAllocationCounting(bool enabled) {
+    counting.store(enabled, std::memory_order_relaxed);
+}
+
+AllocationStats allocationStats() {
+    AllocationStats stats;
+    stats.bytes = allocatedBytes.load(std::memory_order_relaxed);
+    stats.count = allocationCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+uint64_t peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);           // байты
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;    // килобайты
+#endif
+#else
+    return 0;
+#endif
+}
+
+// Остальные формы (new[], nothrow) в libstdc++ и libc++ сводятся к этим
+void* operator new(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* memory = std::malloc(size)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
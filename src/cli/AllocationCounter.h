@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Счётчик выделений памяти через глобальный operator new во всём процессе, включая
+ * библиотеку и потоки пула. Пока счёт выключен, operator new проверяет только флаг.
+ */
+struct AllocationStats {
+    uint64_t bytes = 0;
+    uint64_t count = 0;
+};
+
+void setAllocationCounting(bool enabled);
+AllocationStats allocationStats();
+
+/// Пиковый резидентный размер процесса в байтах; 0, если недоступен
+uint64_t peakResidentBytes();
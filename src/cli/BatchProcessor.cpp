@@ -0,0 +1,534 @@
+#include "BatchProcessor.h"
+#include "CliSupport.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/FontEditSession.h"
+#include "fontmaster/FileIO.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// ============ Разбор строк JSON ============
+
+// Значения манифеста плоские: строки, числа, логические и массивы строк или чисел
+struct JsonValue {
+    enum class Type {
+        STRING,
+        NUMBER,
+        BOOLEAN,
+        NUL,
+        ARRAY
+    };
+
+    Type type = Type::NUL;
+    std::string text;                    // строка или запись числа
+    bool flag = false;
+    std::vector<std::string> items;
+};
+
+class JsonLineParser {
+public:
+    explicit JsonLineParser(const std::string& text) : text(text) {}
+
+    void parseObject(const std::function<void(const std::string&, JsonValue)>& onField) {
+        skipSpace();
+        expect('{');
+        skipSpace();
+        if (peek() == '}') {
+            ++pos;
+        } else {
+            while (true) {
+                skipSpace();
+                std::string key = parseString();
+                skipSpace();
+                expect(':');
+                onField(key, parseValue());
+                skipSpace();
+                if (peek() == ',') {
+                    ++pos;
+                    continue;
+                }
+                expect('}');
+                break;
+            }
+        }
+        skipSpace();
+        if (pos != text.size()) fail("trailing characters");
+    }
+
+private:
+    const std::string& text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string& reason) const {
+        throw std::runtime_error("invalid JSON at column " + std::to_string(pos + 1) + ": " + reason);
+    }
+
+    char peek() const { return pos < text.size() ? text[pos] : '\0'; }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) ++pos;
+    }
+
+    void expect(char c) {
+        if (peek() != c) fail(std::string("expected '") + c + "'");
+        ++pos;
+    }
+
+    uint32_t parseHex4() {
+        if (pos + 4 > text.size()) fail("truncated \\u escape");
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = text[pos++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= static_cast<uint32_t>(c - '0');
+            else if (c >= 'a' && c <= 'f') value |= static_cast<uint32_t>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') value |= static_cast<uint32_t>(c - 'A' + 10);
+            else fail("invalid \\u escape");
+        }
+        return value;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t codepoint) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (true) {
+            if (pos >= text.size()) fail("unterminated string");
+            char c = text[pos++];
+            if (c == '"') break;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            char escape = peek();
+            ++pos;
+            switch (escape) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t codepoint = parseHex4();
+                    // Суррогатная пара
+                    if (codepoint >= 0xD800 && codepoint < 0xDC00 && text.compare(pos, 2, "\\u") == 0) {
+                        pos += 2;
+                        uint32_t low = parseHex4();
+                        if (low < 0xDC00 || low > 0xDFFF) fail("invalid surrogate pair");
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, codepoint);
+                    break;
+                }
+                default: fail("invalid escape");
+            }
+        }
+        return out;
+    }
+
+    std::string parseNumber() {
+        size_t begin = pos;
+        while (pos < text.size() && std::string("+-0123456789.eE").find(text[pos]) != std::string::npos) ++pos;
+        if (begin == pos) fail("unexpected character");
+        return text.substr(begin, pos - begin);
+    }
+
+    bool consumeLiteral(const char* literal) {
+        size_t length = std::char_traits<char>::length(literal);
+        if (text.compare(pos, length, literal) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        JsonValue value;
+        char c = peek();
+        if (c == '"') {
+            value.type = JsonValue::Type::STRING;
+            value.text = parseString();
+        } else if (c == '[') {
+            ++pos;
+            value.type = JsonValue::Type::ARRAY;
+            skipSpace();
+            if (peek() == ']') {
+                ++pos;
+                return value;
+            }
+            while (true) {
+                skipSpace();
+                value.items.push_back(peek() == '"' ? parseString() : parseNumber());
+                skipSpace();
+                if (peek() == ',') {
+                    ++pos;
+                    continue;
+                }
+                expect(']');
+                break;
+            }
+        } else if (c == '{') {
+            fail("nested objects are not supported");
+        } else if (consumeLiteral("true")) {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.flag = true;
+        } else if (consumeLiteral("false")) {
+            value.type = JsonValue::Type::BOOLEAN;
+        } else if (consumeLiteral("null")) {
+            value.type = JsonValue::Type::NUL;
+        } else {
+            value.type = JsonValue::Type::NUMBER;
+            value.text = parseNumber();
+        }
+        return value;
+    }
+};
+
+// ============ Задания ============
+
+struct ManifestItem {
+    size_t line = 0;
+    std::string key;                     // id или "line:N"
+    std::string op;
+    std::string font;
+    std::string image;
+    std::string output;
+    bool inplace = false;
+    std::vector<std::string> selectors;
+    std::string error;                   // строка манифеста не разобрана
+    // Файлы задания после разрешения путей: по ним упорядочиваются задания над одним файлом
+    std::vector<std::string> reads;
+    std::vector<std::string> writes;
+};
+
+struct ItemResult {
+    bool ok = false;
+    size_t glyphs = 0;                   // изменено (или перечислено для list/info)
+    double milliseconds = 0;
+    std::string error;
+};
+
+bool isEditOp(const std::string& op) {
+    return op == "remove" || op == "replace" || op == "add";
+}
+
+// Один файл под разными записями пути должен давать одну строку
+std::string resolvePath(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(path, error);
+    if (error) return std::filesystem::path(path).lexically_normal().string();
+    return resolved.string();
+}
+
+ManifestItem parseManifestLine(const std::string& text, size_t line) {
+    ManifestItem item;
+    item.line = line;
+    item.key = "line:" + std::to_string(line);
+    try {
+        JsonLineParser(text).parseObject([&](const std::string& key, JsonValue value) {
+            bool scalar = value.type == JsonValue::Type::STRING || value.type == JsonValue::Type::NUMBER;
+            if (key == "id") {
+                if (!scalar) throw std::runtime_error("\"id\" must be a string or number");
+                item.key = value.text;
+            } else if (key == "select") {
+                if (value.type == JsonValue::Type::STRING) item.selectors.push_back(value.text);
+                else if (value.type == JsonValue::Type::ARRAY) item.selectors = std::move(value.items);
+                else throw std::runtime_error("\"select\" must be a string or an array");
+            } else if (key == "inplace") {
+                item.inplace = value.type == JsonValue::Type::BOOLEAN && value.flag;
+            } else if (key == "op" || key == "font" || key == "image" || key == "output") {
+                if (value.type != JsonValue::Type::STRING) throw std::runtime_error("\"" + key + "\" must be a string");
+                std::string& field = key == "op" ? item.op : key == "font" ? item.font : key == "image" ? item.image : item.output;
+                field = std::move(value.text);
+            }
+            // Прочие поля - пометки автора манифеста
+        });
+
+        if (item.font.empty()) throw std::runtime_error("missing \"font\"");
+        if (item.op.empty()) throw std::runtime_error("missing \"op\"");
+        if (item.op != "list" && item.op != "info" && !isEditOp(item.op)) {
+            throw std::runtime_error("unknown op \"" + item.op + "\"");
+        }
+        if (isEditOp(item.op) && item.selectors.empty()) throw std::runtime_error("missing \"select\"");
+        if ((item.op == "replace" || item.op == "add") && item.image.empty()) {
+            throw std::runtime_error("missing \"image\"");
+        }
+
+        // Правка пишет в output (по умолчанию <font>.modified.ttf) или, с inplace, в сам шрифт
+        std::string font = resolvePath(item.font);
+        if (!isEditOp(item.op)) {
+            item.reads.push_back(font);
+        } else if (item.inplace) {
+            item.writes.push_back(font);
+        } else {
+            if (item.output.empty()) item.output = item.font + ".modified.ttf";
+            item.reads.push_back(font);
+            item.writes.push_back(resolvePath(item.output));
+        }
+    } catch (const std::exception& e) {
+        item.error = e.what();
+    }
+    return item;
+}
+
+ItemResult runItem(const ManifestItem& item) {
+    auto start = std::chrono::steady_clock::now();
+    ItemResult result;
+    try {
+        if (!item.error.empty()) throw std::runtime_error(item.error);
+
+        std::vector<uint8_t> image;
+        if (!item.image.empty() && !fontmaster::utils::readFile(item.image, image)) {
+            throw std::runtime_error("cannot read image " + item.image);
+        }
+
+        auto font = fontmaster::Font::load(item.font);
+        if (!font) throw std::runtime_error("cannot load font " + item.font);
+
+        if (!isEditOp(item.op)) {
+            result.glyphs = font->listGlyphs().size();
+        } else {
+            fontmaster::FontEditSession session(*font);
+            for (const std::string& text : item.selectors) {
+                fontmaster::GlyphSelector target = fontmaster::GlyphSelector::parse(text);
+                if (item.op == "remove") session.remove(target);
+                else if (item.op == "replace") session.replace(target, image);
+                else session.add(target, image);
+            }
+            result.glyphs = item.inplace ? session.commitInPlace() : session.commit(item.output);
+        }
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::string formatResult(const ManifestItem& item, const ItemResult& result) {
+    char milliseconds[32];
+    std::snprintf(milliseconds, sizeof(milliseconds), "%.3f", result.milliseconds);
+    std::string line = "{\"key\":\"" + escapeJson(item.key) + "\",\"line\":" + std::to_string(item.line) +
+                       ",\"op\":\"" + escapeJson(item.op) + "\",\"font\":\"" + escapeJson(item.font) + "\"";
+    if (result.ok) {
+        line += ",\"status\":\"ok\",\"glyphs\":" + std::to_string(result.glyphs);
+    } else {
+        line += ",\"status\":\"error\",\"error\":\"" + escapeJson(result.error) + "\"";
+    }
+    return line + ",\"ms\":" + milliseconds + "}";
+}
+
+/*
+ * Ключи заданий, чей последний результат в журнале успешный. Строки, которые не
+ * разбираются (запись оборвалась при сбое), пропускаются.
+ */
+std::unordered_map<std::string, bool> readCompletedKeys(const std::string& logPath, bool& endsWithNewline) {
+    std::unordered_map<std::string, bool> completed;
+    endsWithNewline = true;
+    std::ifstream log(logPath, std::ios::binary);
+    std::string text;
+    while (std::getline(log, text)) {
+        endsWithNewline = !log.eof();
+        std::string key;
+        std::string status;
+        try {
+            JsonLineParser(text).parseObject([&](const std::string& field, JsonValue value) {
+                if (field == "key") key = std::move(value.text);
+                else if (field == "status") status = std::move(value.text);
+            });
+        } catch (const std::exception&) {
+            continue;
+        }
+        if (!key.empty()) completed[key] = status == "ok";
+    }
+    return completed;
+}
+
+/*
+ * Очередь с ограниченной ёмкостью: чтение манифеста не убегает вперёд исполнителей.
+ * Задания над одним файлом, если хотя бы одно его пишет, выдаются по порядку манифеста
+ * и только после завершения предыдущего (finish); остальные идут параллельно.
+ */
+class JobQueue {
+public:
+    explicit JobQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(ManifestItem item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(ManifestItem& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto ready = findReady();
+            if (ready != items.end()) {
+                item = std::move(*ready);
+                items.erase(ready);
+                addUse(item, running);
+                notFull.notify_one();
+                return true;
+            }
+            if (items.empty() && closed) return false;
+            notEmpty.wait(lock);
+        }
+    }
+
+    /// Задание выполнено: следующие задания над его файлами можно выдавать
+    void finish(const ManifestItem& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& path : item.reads) --running[path].readers;
+        for (const std::string& path : item.writes) running[path].writer = false;
+        for (const auto* paths : {&item.reads, &item.writes}) {
+            for (const std::string& path : *paths) {
+                auto it = running.find(path);
+                if (it != running.end() && it->second.readers == 0 && !it->second.writer) running.erase(it);
+            }
+        }
+        notEmpty.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    struct FileUse {
+        size_t readers = 0;
+        bool writer = false;
+    };
+    using FileUses = std::unordered_map<std::string, FileUse>;
+
+    size_t capacity;
+    std::deque<ManifestItem> items;
+    FileUses running;                    // файлы выполняемых заданий
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    bool closed = false;
+
+    static void addUse(const ManifestItem& item, FileUses& uses) {
+        for (const std::string& path : item.reads) ++uses[path].readers;
+        for (const std::string& path : item.writes) uses[path].writer = true;
+    }
+
+    static bool conflicts(const ManifestItem& item, const FileUses& uses) {
+        for (const std::string& path : item.writes) {
+            auto it = uses.find(path);
+            if (it != uses.end() && (it->second.readers != 0 || it->second.writer)) return true;
+        }
+        for (const std::string& path : item.reads) {
+            auto it = uses.find(path);
+            if (it != uses.end() && it->second.writer) return true;
+        }
+        return false;
+    }
+
+    // Первое задание, которому не мешают ни выполняемые, ни более ранние в очереди
+    std::deque<ManifestItem>::iterator findReady() {
+        FileUses waiting;
+        for (auto it = items.begin(); it != items.end(); ++it) {
+            if (!conflicts(*it, running) && !conflicts(*it, waiting)) return it;
+            addUse(*it, waiting);
+        }
+        return items.end();
+    }
+};
+
+} // namespace
+
+BatchProcessor::BatchProcessor(BatchOptions batchOptions) : options(std::move(batchOptions)) {
+    if (options.logPath.empty()) options.logPath = options.manifestPath + ".results.jsonl";
+    if (options.jobs == 0) options.jobs = std::max(1u, std::thread::hardware_concurrency());
+}
+
+BatchSummary BatchProcessor::run() {
+    std::ifstream manifest(options.manifestPath);
+    if (!manifest) throw std::runtime_error("Cannot open manifest " + options.manifestPath);
+
+    std::unordered_map<std::string, bool> completed;
+    bool logEndsWithNewline = true;
+    if (options.resume) completed = readCompletedKeys(options.logPath, logEndsWithNewline);
+
+    std::ofstream log(options.logPath, options.resume ? std::ios::app : std::ios::trunc);
+    if (!log) throw std::runtime_error("Cannot open result log " + options.logPath);
+    // Оборванную при сбое строку закрываем, чтобы новая запись не склеилась с ней
+    if (!logEndsWithNewline) log << '\n';
+
+    BatchSummary summary;
+    std::mutex logMutex;
+    JobQueue queue(options.jobs * 2);
+
+    OutputSilencer silencer(!options.verbose);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.jobs; ++i) {
+        workers.emplace_back([&] {
+            ManifestItem item;
+            while (queue.pop(item)) {
+                ItemResult result = runItem(item);
+                std::string line = formatResult(item, result);
+                {
+                    // Строка попадает в файл сразу: после сбоя журнал отражает всё сделанное
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    log << line << '\n';
+                    log.flush();
+                    ++(result.ok ? summary.succeeded : summary.failed);
+                }
+                queue.finish(item);
+            }
+        });
+    }
+
+    std::string text;
+    size_t line = 0;
+    while (std::getline(manifest, text)) {
+        ++line;
+        if (text.find_first_not_of(" \t\r") == std::string::npos) continue;
+        ManifestItem item = parseManifestLine(text, line);
+        auto done = completed.find(item.key);
+        if (done != completed.end() && done->second) {
+            ++summary.skipped;
+            continue;
+        }
+        queue.push(std::move(item));
+    }
+    queue.close();
+    for (std::thread& worker : workers) worker.join();
+    return summary;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/// Параметры команды fontmaster-cli batch
+struct BatchOptions {
+    std::string manifestPath;
+    std::string logPath;             // пусто - <manifest>.results.jsonl
+    size_t jobs = 0;                 // 0 - по числу аппаратных потоков
+    bool resume = false;             // пропустить задания, успешные по журналу
+    bool verbose = false;            // не глушить вывод библиотеки
+};
+
+struct BatchSummary {
+    size_t succeeded = 0;
+    size_t failed = 0;
+    size_t skipped = 0;              // выполнены в прошлый раз (--resume)
+};
+
+/**
+ * Пакетная обработка шрифтов по манифесту JSON Lines, одно задание на строку:
+ *
+ *   {"id": "a1", "font": "in.ttf", "op": "remove", "select": ["U+1F600-1F64F", "gid:42"], "output": "out.ttf"}
+ *
+ * op - list, info, remove, replace или add; для replace/add нужен "image". "select" -
+ * строка или массив селекторов в записи GlyphSelector::parse. Без "output" результат
+ * пишется в <font>.modified.ttf, "inplace": true сохраняет через Font::saveInPlace.
+ * Без "id" ключом задания служит номер строки ("line:N").
+ *
+ * Манифест читается потоком, задания выполняются ограниченным пулом из jobs потоков
+ * (в очереди не больше 2 * jobs заданий). Задания над одним файлом (шрифт, output), если
+ * хотя бы одно из них его пишет, выполняются по очереди в порядке манифеста, так что
+ * цепочка правок одного файла даёт тот же результат, что и при jobs = 1. Результат каждого
+ * задания сразу дописывается в журнал отдельной строкой JSON. После сбоя запуск с resume
+ * пропускает задания, чей последний результат в журнале - "ok"; оборванная последняя
+ * строка журнала игнорируется.
+ */
+class BatchProcessor {
+public:
+    explicit BatchProcessor(BatchOptions options);
+
+    /// Бросает std::runtime_error, если манифест или журнал не открываются
+    BatchSummary run();
+
+    const std::string& logPath() const { return options.logPath; }
+
+private:
+    BatchOptions options;
+};
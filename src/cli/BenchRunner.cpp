@@ -0,0 +1,190 @@
+#include "BenchRunner.h"
+#include "AllocationCounter.h"
+#include "CliSupport.h"
+#include "fontmaster/PhaseTimer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+
+namespace {
+
+const char* formatNameOf(fontmaster::FontFormat format) {
+    switch (format) {
+        case fontmaster::FontFormat::CBDT_CBLC: return "CBDT/CBLC";
+        case fontmaster::FontFormat::SBIX: return "SBIX";
+        case fontmaster::FontFormat::COLR_CPAL: return "COLR/CPAL";
+        case fontmaster::FontFormat::SVG: return "SVG";
+        default: return "Unknown";
+    }
+}
+
+std::string milliseconds(uint64_t nanoseconds) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(nanoseconds) / 1e6);
+    return buffer;
+}
+
+} // namespace
+
+BenchRunner::BenchRunner(BenchOptions benchOptions) : options(std::move(benchOptions)) {
+    total.name = "total";
+    allocatedBytes.name = "allocated bytes";
+    allocationCount.name = "allocations";
+}
+
+void BenchRunner::run() {
+    bool temporaryOutput = options.outputPath.empty() && options.op != "load" && options.op != "list";
+    if (temporaryOutput) options.outputPath = options.fontPath + ".bench.ttf";
+
+    {
+        OutputSilencer silencer(true);
+        // Формат и цель для remove выбираются до замеров
+        auto font = fontmaster::Font::load(options.fontPath);
+        if (!font) throw fontmaster::FontLoadException(options.fontPath, "no suitable handler");
+        formatName = formatNameOf(font->getFormat());
+        if (options.op == "remove" && options.targets.empty()) {
+            std::vector<fontmaster::GlyphInfo> glyphs = font->listGlyphs();
+            if (glyphs.empty()) throw fontmaster::FontException("Font has no glyphs to remove");
+            options.targets.push_back(fontmaster::GlyphSelector::byName(glyphs.front().name));
+        }
+        font.reset();
+
+        for (size_t i = 0; i < options.repeat; ++i) {
+            runOnce(i);
+        }
+    }
+    if (temporaryOutput) std::remove(options.outputPath.c_str());
+    peakRss = peakResidentBytes();
+
+    // Время между этапами верхнего уровня
+    Series other;
+    other.name = "other";
+    other.calls = 1;
+    for (size_t i = 0; i < options.repeat; ++i) {
+        uint64_t accounted = 0;
+        for (const Series& phase : phases) accounted += phase.samples[i];
+        other.samples.push_back(total.samples[i] > accounted ? total.samples[i] - accounted : 0);
+    }
+    phases.push_back(std::move(other));
+}
+
+void BenchRunner::runOnce(size_t iteration) {
+    fontmaster::utils::PhaseProfile profile;
+    fontmaster::utils::PhaseProfile::attach(&profile);
+    setAllocationCounting(true);
+    AllocationStats before = allocationStats();
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        std::unique_ptr<fontmaster::Font> font;
+        {
+            fontmaster::utils::ScopedPhase phase("load");
+            font = fontmaster::Font::load(options.fontPath);
+        }
+        if (options.op == "list") {
+            fontmaster::utils::ScopedPhase phase("list");
+            font->listGlyphs();
+        } else if (options.op == "save") {
+            fontmaster::utils::ScopedPhase phase("save");
+            if (!font->save(options.outputPath)) {
+                throw fontmaster::FontSaveException(options.outputPath, "cannot write output file");
+            }
+        } else if (options.op == "remove") {
+            fontmaster::utils::ScopedPhase phase("save");
+            fontmaster::FontEditSession session(*font);
+            for (const auto& target : options.targets) session.remove(target);
+            session.commit(options.outputPath);
+        }
+    } catch (...) {
+        setAllocationCounting(false);
+        fontmaster::utils::PhaseProfile::attach(nullptr);
+        throw;
+    }
+
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    AllocationStats after = allocationStats();
+    setAllocationCounting(false);
+    fontmaster::utils::PhaseProfile::attach(nullptr);
+
+    total.samples.push_back(elapsed);
+    allocatedBytes.samples.push_back(after.bytes - before.bytes);
+    allocationCount.samples.push_back(after.count - before.count);
+
+    for (const auto& measured : profile.phases()) {
+        auto it = std::find_if(phases.begin(), phases.end(),
+                               [&](const Series& series) { return series.name == measured.name; });
+        if (it == phases.end()) {
+            // Этап впервые встретился не в первом повторе - в прежних его время нулевое
+            phases.push_back({measured.name, measured.calls, std::vector<uint64_t>(iteration, 0)});
+            it = phases.end() - 1;
+        }
+        it->calls = std::max(it->calls, measured.calls);
+        it->samples.push_back(measured.nanoseconds);
+    }
+    for (Series& series : phases) {
+        if (series.samples.size() == iteration) series.samples.push_back(0);
+    }
+}
+
+BenchRunner::Summary BenchRunner::summarize(const Series& series) {
+    Summary summary;
+    if (series.samples.empty()) return summary;
+    std::vector<uint64_t> sorted = series.samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t count = sorted.size();
+    summary.min = sorted.front();
+    summary.median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    // p99 по ближайшему рангу: при небольшом числе повторов совпадает с максимумом
+    summary.p99 = sorted[(count * 99 + 99) / 100 - 1];
+    return summary;
+}
+
+void BenchRunner::printTable(std::ostream& out) const {
+    out << "Font: " << options.fontPath << " (" << formatName << "), op: " << options.op
+        << ", repeats: " << options.repeat << std::endl;
+    out << std::left << std::setw(12) << "phase" << std::right << std::setw(7) << "calls"
+        << std::setw(12) << "min ms" << std::setw(12) << "median ms" << std::setw(12) << "p99 ms" << std::endl;
+
+    auto printRow = [&](const Series& series, bool showCalls) {
+        Summary summary = summarize(series);
+        out << std::left << std::setw(12) << series.name << std::right << std::setw(7)
+            << (showCalls ? std::to_string(series.calls) : "") << std::setw(12) << milliseconds(summary.min)
+            << std::setw(12) << milliseconds(summary.median) << std::setw(12) << milliseconds(summary.p99) << std::endl;
+    };
+    for (const Series& phase : phases) printRow(phase, phase.name != "other");
+    printRow(total, false);
+
+    Summary bytes = summarize(allocatedBytes);
+    Summary count = summarize(allocationCount);
+    out << "Allocated per run: " << bytes.median << " bytes in " << count.median << " allocations (median; min "
+        << bytes.min << ", p99 " << bytes.p99 << " bytes)" << std::endl;
+    out << "Peak RSS: " << peakRss << " bytes" << std::endl;
+}
+
+void BenchRunner::printJson(std::ostream& out) const {
+    auto printSummary = [&](const Summary& summary, bool asMilliseconds) {
+        if (asMilliseconds) {
+            out << "\"min_ms\":" << milliseconds(summary.min) << ",\"median_ms\":" << milliseconds(summary.median)
+                << ",\"p99_ms\":" << milliseconds(summary.p99);
+        } else {
+            out << "\"min\":" << summary.min << ",\"median\":" << summary.median << ",\"p99\":" << summary.p99;
+        }
+    };
+
+    out << "{\"font\":\"" << escapeJson(options.fontPath) << "\",\"format\":\"" << formatName << "\",\"op\":\""
+        << escapeJson(options.op) << "\",\"repeat\":" << options.repeat << ",\"phases\":[";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        out << (i ? "," : "") << "{\"name\":\"" << escapeJson(phases[i].name) << "\",\"calls\":" << phases[i].calls << ",";
+        printSummary(summarize(phases[i]), true);
+        out << "}";
+    }
+    out << "],\"total\":{";
+    printSummary(summarize(total), true);
+    out << "},\"allocated_bytes\":{";
+    printSummary(summarize(allocatedBytes), false);
+    out << "},\"allocations\":{";
+    printSummary(summarize(allocationCount), false);
+    out << "},\"peak_rss_bytes\":" << peakRss << "}" << std::endl;
+}
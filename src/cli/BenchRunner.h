@@ -0,0 +1,57 @@
+#pragma once
+#include "fontmaster/FontEditSession.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// Параметры команды fontmaster-cli bench
+struct BenchOptions {
+    std::string fontPath;
+    std::string op = "list";                           // load, list, save или remove
+    size_t repeat = 10;
+    std::vector<fontmaster::GlyphSelector> targets;    // для remove; пусто - первый глиф шрифта
+    std::string outputPath;                            // для save/remove; пусто - временный файл
+    bool json = false;
+};
+
+/**
+ * Замер операции над шрифтом по этапам (utils::PhaseProfile). Каждый повтор загружает
+ * шрифт заново и выполняет операцию целиком; по повторам считаются min/median/p99
+ * для каждого этапа, общего времени и выделенной памяти, плюс пиковый RSS процесса.
+ * Вывод библиотеки на время замеров подавляется.
+ */
+class BenchRunner {
+public:
+    explicit BenchRunner(BenchOptions options);
+
+    /// Бросает FontException, если шрифт не загружается или операция не удалась
+    void run();
+    void printTable(std::ostream& out) const;
+    void printJson(std::ostream& out) const;
+
+private:
+    // Значения метрики по повторам
+    struct Series {
+        std::string name;
+        uint64_t calls = 0;                            // вызовов этапа за повтор
+        std::vector<uint64_t> samples;
+    };
+
+    struct Summary {
+        uint64_t min = 0;
+        uint64_t median = 0;
+        uint64_t p99 = 0;
+    };
+
+    BenchOptions options;
+    std::string formatName;
+    std::vector<Series> phases;                        // в порядке первого появления, затем other
+    Series total;
+    Series allocatedBytes;
+    Series allocationCount;
+    uint64_t peakRss = 0;
+
+    void runOnce(size_t iteration);
+    static Summary summarize(const Series& series);
+};
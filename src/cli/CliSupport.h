@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdio>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+// Общее для команд batch и bench CLI и для fontmaster_bench
+
+// Поглощает вывод библиотеки
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Подмена буферов cout/cerr на время работы; восстанавливается и при исключении
+class OutputSilencer {
+public:
+    explicit OutputSilencer(bool enabled) : enabled(enabled) {
+        if (!enabled) return;
+        savedOut = std::cout.rdbuf(&sink);
+        savedErr = std::cerr.rdbuf(&sink);
+    }
+    ~OutputSilencer() {
+        if (!enabled) return;
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+    }
+
+private:
+    bool enabled;
+    NullBuffer sink;
+    std::streambuf* savedOut = nullptr;
+    std::streambuf* savedErr = nullptr;
+};
+
+/// Строка для вставки в JSON между кавычками
+inline std::string escapeJson(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
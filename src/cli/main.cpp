@@ -1,8 +1,12 @@
 #include "fontmaster/FontMaster.h"
+#include "fontmaster/FontEditSession.h"
+#include "BatchProcessor.h"
+#include "BenchRunner.h"
 #include <iostream>
 #include <iomanip>
 #include <cstring>
 #include <fstream>
+#include <sstream>
 
 class CommandProcessor {
 public:
@@ -39,6 +43,10 @@ public:
                               << std::setfill('0') << glyph.unicode << std::dec << ")";
                 }
                 std::cout << " - " << glyph.format;
+                if (glyph.width != 0 && glyph.height != 0) {
+                    std::cout << " " << glyph.width << "x" << glyph.height;
+                    if (glyph.ppem != 0) std::cout << " @" << glyph.ppem << "ppem";
+                }
                 std::cout << " - " << glyph.data_size << " bytes";
                 std::cout << std::endl;
             }
@@ -52,25 +60,27 @@ public:
     
     static int processRemove(int argc, char* argv[]) {
         std::string fontFile;
-        std::string glyphName;
-        std::string unicodeStr;
+        std::vector<fontmaster::GlyphSelector> targets;
         std::string outputFile;
         
-        for (int i = 2; i < argc; i++) {
-            std::string arg = argv[i];
-            if (arg == "--font" && i + 1 < argc) {
-                fontFile = argv[++i];
-            } else if (arg == "--name" && i + 1 < argc) {
-                glyphName = argv[++i];
-            } else if (arg == "--unicode" && i + 1 < argc) {
-                unicodeStr = argv[++i];
-            } else if (arg == "--output" && i + 1 < argc) {
-                outputFile = argv[++i];
+        try {
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--font" && i + 1 < argc) {
+                    fontFile = argv[++i];
+                } else if (isSelectorOption(arg) && i + 1 < argc) {
+                    addSelectors(arg, argv[++i], targets);
+                } else if (arg == "--output" && i + 1 < argc) {
+                    outputFile = argv[++i];
+                }
             }
+        } catch (const fontmaster::FontException& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
         
-        if (fontFile.empty() || (glyphName.empty() && unicodeStr.empty())) {
-            std::cerr << "Usage: fontmaster-cli remove --font <file> (--name <name> | --unicode <hex>) [--output <file>]" << std::endl;
+        if (fontFile.empty() || targets.empty()) {
+            std::cerr << "Usage: fontmaster-cli remove --font <file> (--name <names> | --unicode <hex> | --gid <ids>)... [--output <file>]" << std::endl;
             return 1;
         }
         
@@ -85,28 +95,13 @@ public:
                 return 1;
             }
             
-            bool success = false;
-            if (!glyphName.empty()) {
-                std::cout << "Removing glyph by name: " << glyphName << std::endl;
-                success = font->removeGlyph(glyphName);
-            } else {
-                uint32_t unicode = std::stoul(unicodeStr, nullptr, 16);
-                std::cout << "Removing glyph by Unicode: U+" << unicodeStr << std::endl;
-                success = font->removeGlyph(unicode);
+            // Все удаления проверяются вместе и сохраняются одной пересборкой
+            fontmaster::FontEditSession session(*font);
+            for (const auto& target : targets) {
+                session.remove(target);
             }
-            
-            if (success) {
-                if (font->save(outputFile)) {
-                    std::cout << "Success! Modified font saved as: " << outputFile << std::endl;
-                } else {
-                    std::cerr << "Error: Failed to save modified font" << std::endl;
-                    return 1;
-                }
-            } else {
-                std::cerr << "Error: Failed to remove glyph" << std::endl;
-                return 1;
-            }
-            
+            size_t removed = session.commit(outputFile);
+            std::cout << "Success! Removed " << removed << " glyph(s), modified font saved as: " << outputFile << std::endl;
             return 0;
         } catch (const fontmaster::FontException& e) {
             std::cerr << "Error: " << e.what() << std::endl;
@@ -119,25 +114,30 @@ public:
     
     static int processReplace(int argc, char* argv[]) {
         std::string fontFile;
-        std::string glyphName;
+        std::vector<fontmaster::GlyphSelector> targets;
         std::string imageFile;
         std::string outputFile;
         
-        for (int i = 2; i < argc; i++) {
-            std::string arg = argv[i];
-            if (arg == "--font" && i + 1 < argc) {
-                fontFile = argv[++i];
-            } else if (arg == "--name" && i + 1 < argc) {
-                glyphName = argv[++i];
-            } else if (arg == "--image" && i + 1 < argc) {
-                imageFile = argv[++i];
-            } else if (arg == "--output" && i + 1 < argc) {
-                outputFile = argv[++i];
+        try {
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--font" && i + 1 < argc) {
+                    fontFile = argv[++i];
+                } else if (isSelectorOption(arg) && i + 1 < argc) {
+                    addSelectors(arg, argv[++i], targets);
+                } else if (arg == "--image" && i + 1 < argc) {
+                    imageFile = argv[++i];
+                } else if (arg == "--output" && i + 1 < argc) {
+                    outputFile = argv[++i];
+                }
             }
+        } catch (const fontmaster::FontException& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
         
-        if (fontFile.empty() || glyphName.empty() || imageFile.empty()) {
-            std::cerr << "Usage: fontmaster-cli replace --font <file> --name <name> --image <file> [--output <file>]" << std::endl;
+        if (fontFile.empty() || targets.empty() || imageFile.empty()) {
+            std::cerr << "Usage: fontmaster-cli replace --font <file> (--name <names> | --unicode <hex> | --gid <ids>)... --image <file> [--output <file>]" << std::endl;
             return 1;
         }
         
@@ -166,19 +166,13 @@ public:
                 return 1;
             }
             
-            std::cout << "Replacing image for glyph: " << glyphName << std::endl;
-            if (font->replaceGlyphImage(glyphName, imageData)) {
-                if (font->save(outputFile)) {
-                    std::cout << "Success! Modified font saved as: " << outputFile << std::endl;
-                } else {
-                    std::cerr << "Error: Failed to save modified font" << std::endl;
-                    return 1;
-                }
-            } else {
-                std::cerr << "Error: Failed to replace glyph image" << std::endl;
-                return 1;
+            // Одно изображение на все выбранные глифы
+            fontmaster::FontEditSession session(*font);
+            for (const auto& target : targets) {
+                session.replace(target, imageData);
             }
-            
+            size_t replaced = session.commit(outputFile);
+            std::cout << "Success! Replaced " << replaced << " glyph image(s), modified font saved as: " << outputFile << std::endl;
             return 0;
         } catch (const fontmaster::FontException& e) {
             std::cerr << "Error: " << e.what() << std::endl;
@@ -228,6 +222,124 @@ public:
             return 1;
         }
     }
+    
+    static int processBatch(int argc, char* argv[]) {
+        BatchOptions options;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--manifest" && i + 1 < argc) {
+                options.manifestPath = argv[++i];
+            } else if (arg == "--jobs" && i + 1 < argc) {
+                std::string value = argv[++i];
+                if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                    std::cerr << "Error: --jobs expects a number" << std::endl;
+                    return 1;
+                }
+                options.jobs = std::stoul(value);
+            } else if (arg == "--log" && i + 1 < argc) {
+                options.logPath = argv[++i];
+            } else if (arg == "--resume") {
+                options.resume = true;
+            } else if (arg == "--verbose") {
+                options.verbose = true;
+            }
+        }
+        
+        if (options.manifestPath.empty()) {
+            std::cerr << "Usage: fontmaster-cli batch --manifest <ops.jsonl> [--jobs <n>] [--log <file>] [--resume] [--verbose]" << std::endl;
+            return 1;
+        }
+        
+        try {
+            BatchProcessor batch(options);
+            BatchSummary summary = batch.run();
+            std::cout << "Batch finished: " << summary.succeeded << " succeeded, " << summary.failed << " failed";
+            if (summary.skipped != 0) std::cout << ", " << summary.skipped << " skipped (already done)";
+            std::cout << "; results in " << batch.logPath() << std::endl;
+            return summary.failed == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    static int processBench(int argc, char* argv[]) {
+        const char* usage = "Usage: fontmaster-cli bench <fontfile> [--op load|list|save|remove] [--repeat <n>] "
+                            "[--json] [--output <file>] [--name|--unicode|--gid <list>]";
+        if (argc < 3) {
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+        
+        BenchOptions options;
+        options.fontPath = argv[2];
+        try {
+            for (int i = 3; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--op" && i + 1 < argc) {
+                    options.op = argv[++i];
+                } else if (arg == "--repeat" && i + 1 < argc) {
+                    std::string value = argv[++i];
+                    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || std::stoul(value) == 0) {
+                        std::cerr << "Error: --repeat expects a positive number" << std::endl;
+                        return 1;
+                    }
+                    options.repeat = std::stoul(value);
+                } else if (arg == "--json") {
+                    options.json = true;
+                } else if (arg == "--output" && i + 1 < argc) {
+                    options.outputPath = argv[++i];
+                } else if (isSelectorOption(arg) && i + 1 < argc) {
+                    addSelectors(arg, argv[++i], options.targets);
+                }
+            }
+        } catch (const fontmaster::FontException& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        
+        if (options.op != "load" && options.op != "list" && options.op != "save" && options.op != "remove") {
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+        
+        try {
+            BenchRunner bench(options);
+            bench.run();
+            if (options.json) {
+                bench.printJson(std::cout);
+            } else {
+                bench.printTable(std::cout);
+            }
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+private:
+    static bool isSelectorOption(const std::string& arg) {
+        return arg == "--name" || arg == "--unicode" || arg == "--gid";
+    }
+    
+    // Значение опции - список через запятую; --unicode принимает коды и диапазоны "1F600-1F64F"
+    static void addSelectors(const std::string& option, const std::string& value,
+                             std::vector<fontmaster::GlyphSelector>& targets) {
+        std::stringstream items(value);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item.empty()) continue;
+            if (option == "--name") {
+                targets.push_back(fontmaster::GlyphSelector::byName(item));
+            } else if (option == "--gid") {
+                targets.push_back(fontmaster::GlyphSelector::parse("gid:" + item));
+            } else {
+                bool prefixed = item.compare(0, 2, "U+") == 0 || item.compare(0, 2, "u+") == 0;
+                targets.push_back(fontmaster::GlyphSelector::parse(prefixed ? item : "U+" + item));
+            }
+        }
+    }
 };
 
 void printUsage() {
@@ -235,10 +347,16 @@ void printUsage() {
     std::cout << "Usage: fontmaster-cli <command> [options]" << std::endl;
     std::cout << "Commands:" << std::endl;
     std::cout << "  list <fontfile>                                 List all glyphs" << std::endl;
-    std::cout << "  remove --font <font> --name <name>              Remove glyph by name" << std::endl;
-    std::cout << "  remove --font <font> --unicode <hex>            Remove glyph by unicode" << std::endl;
-    std::cout << "  replace --font <font> --name <name> --image <file>  Replace glyph image" << std::endl;
+    std::cout << "  remove --font <font> --name <name>[,<name>...]  Remove glyphs by name" << std::endl;
+    std::cout << "  remove --font <font> --unicode <hex>[-<hex>],...  Remove glyphs by code point or range" << std::endl;
+    std::cout << "  remove --font <font> --gid <id>[,<id>...]       Remove glyphs by glyph ID" << std::endl;
+    std::cout << "  replace --font <font> --name <names> --image <file>  Replace glyph images" << std::endl;
+    std::cout << "                                                  (also --unicode/--gid lists)" << std::endl;
     std::cout << "  info <fontfile>                                 Show font information" << std::endl;
+    std::cout << "  batch --manifest <ops.jsonl> [--jobs <n>]       Run per-font operations from a JSON Lines manifest" << std::endl;
+    std::cout << "        [--log <file>] [--resume] [--verbose]     (results logged per item; --resume skips finished items)" << std::endl;
+    std::cout << "  bench <fontfile> [--op load|list|save|remove]   Time an operation by phase (min/median/p99)" << std::endl;
+    std::cout << "        [--repeat <n>] [--json]                   with allocations and peak RSS" << std::endl;
     std::cout << std::endl;
     std::cout << "Supported formats: CBDT/CBLC (Google), SBIX (Apple), COLR/CPAL (Microsoft), SVG (Adobe)" << std::endl;
 }
@@ -260,6 +378,10 @@ int main(int argc, char* argv[]) {
             return CommandProcessor::processReplace(argc, argv);
         } else if (command == "info") {
             return CommandProcessor::processInfo(argc, argv);
+        } else if (command == "batch") {
+            return CommandProcessor::processBatch(argc, argv);
+        } else if (command == "bench") {
+            return CommandProcessor::processBench(argc, argv);
         } else if (command == "help" || command == "--help" || command == "-h") {
             printUsage();
             return 0;
@@ -0,0 +1,371 @@
+#include "fontmaster/FontEditSession.h"
+#include "fontmaster/PhaseTimer.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fontmaster {
+
+namespace {
+
+const uint32_t MAX_CODEPOINT = 0x10FFFF;
+// Диапазоны не длиннее этого дополнительно проверяются по cmap покодово: в списке глифов
+// только один код на глиф. В длинных (вплоть до всего Unicode) хватает кодов из списка
+const uint32_t MAX_PROBED_RANGE = 0x10000;
+
+const char* const ACTION_NAMES[] = {"remove", "replace", "add"};
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+}
+
+// Код без префикса: 1-6 шестнадцатеричных цифр в пределах Unicode
+bool parseHexCodepoint(std::string text, uint32_t& value) {
+    if (startsWith(text, "U+") || startsWith(text, "u+")) text = text.substr(2);
+    if (text.empty() || text.size() > 6) return false;
+    value = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        value = value * 16 + static_cast<uint32_t>(digit);
+    }
+    return value <= MAX_CODEPOINT;
+}
+
+std::string formatCodepoint(uint32_t codepoint) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%04X", codepoint);
+    return buffer;
+}
+
+std::string joinProblems(const std::vector<std::string>& problems) {
+    std::string message = "edit session rejected (" + std::to_string(problems.size()) + " problem" +
+                          (problems.size() == 1 ? "" : "s") + ")";
+    for (const std::string& problem : problems) {
+        message += "\n  " + problem;
+    }
+    return message;
+}
+
+} // namespace
+
+// ============ GlyphSelector ============
+
+GlyphSelector GlyphSelector::byName(const std::string& glyphName) {
+    GlyphSelector selector;
+    selector.kind = Kind::NAME;
+    selector.name = glyphName;
+    return selector;
+}
+
+GlyphSelector GlyphSelector::byGlyphID(uint16_t glyphID) {
+    GlyphSelector selector;
+    selector.kind = Kind::GLYPH_ID;
+    selector.first = selector.last = glyphID;
+    return selector;
+}
+
+GlyphSelector GlyphSelector::byCodepoint(uint32_t codepoint) {
+    GlyphSelector selector;
+    selector.kind = Kind::CODEPOINT;
+    selector.first = selector.last = codepoint;
+    return selector;
+}
+
+GlyphSelector GlyphSelector::byRange(uint32_t firstCodepoint, uint32_t lastCodepoint) {
+    if (firstCodepoint == lastCodepoint) return byCodepoint(firstCodepoint);
+    GlyphSelector selector;
+    selector.kind = Kind::CODEPOINT_RANGE;
+    selector.first = firstCodepoint;
+    selector.last = lastCodepoint;
+    return selector;
+}
+
+GlyphSelector GlyphSelector::parse(const std::string& text) {
+    std::string value = trim(text);
+    if (value.empty()) {
+        throw FontException("Empty glyph selector");
+    }
+
+    if (startsWith(value, "gid:")) {
+        std::string digits = value.substr(4);
+        if (digits.empty() || digits.size() > 5 || digits.find_first_not_of("0123456789") != std::string::npos ||
+            std::stoul(digits) > 0xFFFF) {
+            throw FontException("Invalid glyph ID in selector '" + value + "'");
+        }
+        return byGlyphID(static_cast<uint16_t>(std::stoul(digits)));
+    }
+
+    if (startsWith(value, "U+") || startsWith(value, "u+")) {
+        size_t separator = value.find("..");
+        size_t separatorLength = 2;
+        if (separator == std::string::npos) {
+            separator = value.find('-');
+            separatorLength = 1;
+        }
+        uint32_t first = 0;
+        uint32_t last = 0;
+        bool valid = separator == std::string::npos
+                         ? parseHexCodepoint(value, first) && parseHexCodepoint(value, last)
+                         : parseHexCodepoint(value.substr(0, separator), first) &&
+                               parseHexCodepoint(value.substr(separator + separatorLength), last);
+        if (!valid || first > last) {
+            throw FontException("Invalid code point or range in selector '" + value + "'");
+        }
+        return byRange(first, last);
+    }
+
+    return byName(value);
+}
+
+std::string GlyphSelector::toString() const {
+    switch (kind) {
+        case Kind::GLYPH_ID: return "gid:" + std::to_string(first);
+        case Kind::CODEPOINT: return "U+" + formatCodepoint(first);
+        case Kind::CODEPOINT_RANGE: return "U+" + formatCodepoint(first) + "-" + formatCodepoint(last);
+        default: return name;
+    }
+}
+
+// ============ FontEditException ============
+
+FontEditException::FontEditException(std::vector<std::string> problems)
+    : FontException(joinProblems(problems)), problemList(std::move(problems)) {}
+
+// ============ FontEditSession ============
+
+FontEditSession::FontEditSession(Font& font) : font(font) {}
+
+void FontEditSession::remove(const GlyphSelector& target) {
+    operations.push_back({Action::REMOVE, target, {}});
+}
+
+void FontEditSession::replace(const GlyphSelector& target, std::vector<uint8_t> image) {
+    operations.push_back({Action::REPLACE, target, std::move(image)});
+}
+
+void FontEditSession::add(const GlyphSelector& target, std::vector<uint8_t> image) {
+    operations.push_back({Action::ADD, target, std::move(image)});
+}
+
+std::vector<std::string> FontEditSession::validate() const {
+    std::vector<std::string> problems;
+    resolve(problems);
+    return problems;
+}
+
+/*
+ * Список глифов запрашивается один раз, селекторы разрешаются по индексам за O(log n)
+ * на глиф. Удаление и замена касаются глифов с изображением, поэтому диапазоны ищутся
+ * по коду из списка; добавление - только по cmap через findGlyphName, ведь у таких
+ * глифов изображения ещё нет и в списке их нет.
+ */
+std::vector<FontEditSession::GlyphEdit> FontEditSession::resolve(std::vector<std::string>& problems) const {
+    std::unordered_set<std::string> withImage;
+    std::unordered_map<uint16_t, std::string> byGlyphID;
+    std::map<uint32_t, std::string> byCodepoint;
+    for (const GlyphInfo& info : font.listGlyphs()) {
+        withImage.insert(info.name);
+        byGlyphID.emplace(info.glyph_id, info.name);
+        if (info.unicode != 0) byCodepoint.emplace(info.unicode, info.name);
+    }
+
+    std::vector<GlyphEdit> edits;
+    std::unordered_map<std::string, size_t> claimed;   // глиф -> индекс правки в edits
+
+    auto claim = [&](size_t index, const std::string& glyphName) {
+        const Operation& operation = operations[index];
+        auto [it, inserted] = claimed.emplace(glyphName, edits.size());
+        if (inserted) {
+            edits.push_back({operation.action, glyphName, index});
+            return;
+        }
+        // Пересекающиеся удаления - обычное дело для диапазонов
+        const GlyphEdit& previous = edits[it->second];
+        if (previous.action == Action::REMOVE && operation.action == Action::REMOVE) return;
+        const Operation& other = operations[previous.operation];
+        problems.push_back("glyph '" + glyphName + "': " + ACTION_NAMES[static_cast<int>(operation.action)] + " " +
+                           operation.target.toString() + " conflicts with " +
+                           ACTION_NAMES[static_cast<int>(previous.action)] + " " + other.target.toString());
+    };
+
+    for (size_t index = 0; index < operations.size(); ++index) {
+        const Operation& operation = operations[index];
+        const GlyphSelector& target = operation.target;
+        std::string label = std::string(ACTION_NAMES[static_cast<int>(operation.action)]) + " " + target.toString();
+
+        if (operation.action != Action::REMOVE && operation.image.empty()) {
+            problems.push_back(label + ": image is empty");
+            continue;
+        }
+
+        if (operation.action == Action::ADD) {
+            auto checkAdd = [&](const std::string& glyphName) {
+                if (withImage.count(glyphName)) {
+                    problems.push_back(label + ": glyph '" + glyphName + "' already has an image");
+                } else if (!font.canAddGlyphImage(glyphName)) {
+                    problems.push_back(label + ": cannot add an image for glyph '" + glyphName + "'");
+                } else {
+                    claim(index, glyphName);
+                }
+            };
+            switch (target.kind) {
+                case GlyphSelector::Kind::NAME:
+                    checkAdd(target.name);
+                    break;
+                case GlyphSelector::Kind::GLYPH_ID:
+                    // Без изображения глифа нет в списке, и имя по ID узнать неоткуда
+                    problems.push_back(byGlyphID.count(static_cast<uint16_t>(target.first))
+                                           ? label + ": glyph already has an image"
+                                           : label + ": address glyphs without an image by name or code point");
+                    break;
+                case GlyphSelector::Kind::CODEPOINT: {
+                    std::string glyphName = font.findGlyphName(target.first);
+                    if (glyphName.empty()) problems.push_back(label + ": code point is not mapped in cmap");
+                    else checkAdd(glyphName);
+                    break;
+                }
+                case GlyphSelector::Kind::CODEPOINT_RANGE: {
+                    // Диапазон заполняет недостающие изображения, глифы с изображением пропускаются
+                    size_t found = 0;
+                    for (uint32_t codepoint = target.first; codepoint <= target.last; ++codepoint) {
+                        std::string glyphName = font.findGlyphName(codepoint);
+                        if (glyphName.empty() || withImage.count(glyphName) || !font.canAddGlyphImage(glyphName)) {
+                            continue;
+                        }
+                        claim(index, glyphName);
+                        ++found;
+                    }
+                    if (found == 0) problems.push_back(label + ": no glyphs without an image in range");
+                    break;
+                }
+            }
+            continue;
+        }
+
+        switch (target.kind) {
+            case GlyphSelector::Kind::NAME:
+                if (withImage.count(target.name)) claim(index, target.name);
+                else problems.push_back(label + ": glyph not found");
+                break;
+            case GlyphSelector::Kind::GLYPH_ID: {
+                auto it = byGlyphID.find(static_cast<uint16_t>(target.first));
+                if (it != byGlyphID.end()) claim(index, it->second);
+                else problems.push_back(label + ": glyph not found");
+                break;
+            }
+            case GlyphSelector::Kind::CODEPOINT: {
+                // Список хранит по одному коду на глиф, остальные коды - через cmap шрифта
+                auto it = byCodepoint.find(target.first);
+                std::string glyphName = it != byCodepoint.end() ? it->second : font.findGlyphName(target.first);
+                if (!glyphName.empty() && withImage.count(glyphName)) claim(index, glyphName);
+                else problems.push_back(label + ": glyph not found");
+                break;
+            }
+            case GlyphSelector::Kind::CODEPOINT_RANGE: {
+                std::vector<std::string> glyphNames;
+                auto begin = byCodepoint.lower_bound(target.first);
+                auto end = byCodepoint.upper_bound(target.last);
+                for (auto it = begin; it != end; ++it) glyphNames.push_back(it->second);
+                if (target.last - target.first < MAX_PROBED_RANGE) {
+                    for (uint32_t codepoint = target.first; codepoint <= target.last; ++codepoint) {
+                        if (byCodepoint.count(codepoint)) continue;
+                        std::string glyphName = font.findGlyphName(codepoint);
+                        if (!glyphName.empty() && withImage.count(glyphName)) glyphNames.push_back(glyphName);
+                    }
+                }
+                if (glyphNames.empty()) problems.push_back(label + ": no glyphs in range");
+                // Глиф с несколькими кодами в диапазоне встречается повторно - claim это пропустит
+                std::unordered_set<std::string> seen;
+                for (const std::string& glyphName : glyphNames) {
+                    if (seen.insert(glyphName).second) claim(index, glyphName);
+                }
+                break;
+            }
+        }
+    }
+    return edits;
+}
+
+FontEditSession::UndoLog FontEditSession::apply() {
+    utils::ScopedPhase phase("edit");
+    std::vector<std::string> problems;
+    std::vector<GlyphEdit> edits = resolve(problems);
+    if (!problems.empty()) {
+        throw FontEditException(std::move(problems));
+    }
+
+    // Перед каждой правкой запоминаем состояние глифа; глифы правок не повторяются,
+    // поэтому откат в обратном порядке возвращает шрифт к состоянию до пакета
+    UndoLog undo;
+    undo.reserve(edits.size());
+    for (const GlyphEdit& edit : edits) {
+        const Operation& operation = operations[edit.operation];
+        undo.push_back(font.saveGlyphEditState(edit.glyphName));
+        bool applied = false;
+        std::string reason;
+        try {
+            switch (edit.action) {
+                case Action::REMOVE: applied = font.removeGlyph(edit.glyphName); break;
+                case Action::REPLACE: applied = font.replaceGlyphImage(edit.glyphName, operation.image); break;
+                case Action::ADD: applied = font.addGlyphImage(edit.glyphName, operation.image); break;
+            }
+        } catch (const std::exception& e) {
+            reason = e.what();
+        }
+        // Проверка пройдена, но формат отверг данные (например, изображение не того типа)
+        if (!applied) {
+            rollback(undo);
+            throw FontException("Edit " + std::to_string(edit.operation + 1) + " (" +
+                                ACTION_NAMES[static_cast<int>(edit.action)] + " " + operation.target.toString() +
+                                ") failed for glyph '" + edit.glyphName + "'" +
+                                (reason.empty() ? "" : ": " + reason) + "; no edits were applied");
+        }
+    }
+    return undo;
+}
+
+void FontEditSession::rollback(const UndoLog& undo) {
+    for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+        font.restoreGlyphEditState(**it);
+    }
+}
+
+// Неудачное сохранение откатывает пакет: повторный commit применит те же операции заново
+size_t FontEditSession::applyAndSave(const std::string& target, const std::function<bool()>& save) {
+    UndoLog undo = apply();
+    std::string reason;
+    try {
+        if (save()) {
+            operations.clear();
+            return undo.size();
+        }
+        reason = "cannot write font file";
+    } catch (const std::exception& e) {
+        reason = e.what();
+    }
+    rollback(undo);
+    throw FontSaveException(target, reason + "; edits were rolled back");
+}
+
+size_t FontEditSession::commit(const std::string& outputPath) {
+    return applyAndSave(outputPath, [&]() { return font.save(outputPath); });
+}
+
+size_t FontEditSession::commitInPlace() {
+    return applyAndSave("<in place>", [&]() { return font.saveInPlace(); });
+}
+
+} // namespace fontmaster
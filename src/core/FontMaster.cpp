@@ -1,5 +1,8 @@
 #include "fontmaster/FontMaster.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/LRUCache.h"
+#include "fontmaster/PhaseTimer.h"
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <memory>
@@ -24,7 +27,6 @@ public:
         FontFormat format = handler->getFormat();
         handlers.push_back(std::move(handler));
         handlerMap[format] = handlers.back().get();
-        std::cout << "Registered handler for format: " << static_cast<int>(format) << std::endl;
     }
     
     std::unique_ptr<Font> loadFont(const std::string& filepath) {
@@ -52,8 +54,12 @@ public:
         // Пробуем все обработчики по порядку
         for (auto& handler : handlers) {
             try {
-                if (handler->canHandle(filepath)) {
-                    std::cout << "Loading font with handler: " << static_cast<int>(handler->getFormat()) << std::endl;
+                bool canHandle;
+                {
+                    utils::ScopedPhase phase("sniff");
+                    canHandle = handler->canHandle(filepath);
+                }
+                if (canHandle) {
                     return handler->loadFont(filepath);
                 }
             } catch (const std::exception& e) {
@@ -83,7 +89,7 @@ public:
     }
 };
 
-// Глобальная регистрация обработчиков
+// Обработчики встроенных форматов
 extern void registerCBDTHandler();
 extern void registerSBIXHandler();
 extern void registerCOLRHandler();
@@ -97,15 +103,104 @@ static void registerAllHandlers() {
     registerSVGHandler();
 }
 
-// Вызываем регистрацию при загрузке библиотеки
-__attribute__((constructor))
-static void initFontMaster() {
-    std::cout << "Initializing FontMaster..." << std::endl;
-    registerAllHandlers();
+// Встроенные обработчики регистрируются при первой загрузке шрифта, а не конструктором
+// библиотеки: тот мог выполниться раньше инициализации iostream и статиков форматов
+static FontMasterImpl& registry() {
+    static bool builtinsRegistered = (registerAllHandlers(), true);
+    (void)builtinsRegistered;
+    return FontMasterImpl::instance();
+}
+
+void registerFontFormatHandler(std::unique_ptr<FontFormatHandler> handler) {
+    FontMasterImpl::instance().registerHandler(std::move(handler));
 }
 
 std::unique_ptr<Font> Font::load(const std::string& filepath) {
-    return FontMasterImpl::instance().loadFont(filepath);
+    return registry().loadFont(filepath);
+}
+
+namespace {
+
+struct DecodedGlyphKey {
+    const Font* font;
+    uint64_t generation;
+    uint16_t strike;
+    uint16_t glyphID;
+    
+    bool operator==(const DecodedGlyphKey& other) const {
+        return font == other.font && generation == other.generation &&
+               strike == other.strike && glyphID == other.glyphID;
+    }
+};
+
+struct DecodedGlyphKeyHash {
+    size_t operator()(const DecodedGlyphKey& key) const {
+        size_t h = std::hash<const Font*>()(key.font) ^ std::hash<uint64_t>()(key.generation);
+        return h ^ ((static_cast<size_t>(key.strike) << 16 | key.glyphID) * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+using DecodedGlyphCache = utils::LRUCache<DecodedGlyphKey, RGBAImage, DecodedGlyphKeyHash>;
+
+// Общий кэш декодированных изображений всех шрифтов, 64 МБ пикселей
+DecodedGlyphCache& decodedGlyphCache() {
+    static DecodedGlyphCache cache(64 * 1024 * 1024);
+    return cache;
+}
+
+} // namespace
+
+Font::~Font() {
+    // Освобождаем память сразу: шрифт больше не будет читать свои записи
+    const Font* self = this;
+    decodedGlyphCache().eraseIf([self](const DecodedGlyphKey& key) { return key.font == self; });
+}
+
+uint64_t Font::nextDecodedGeneration() {
+    // Общий счётчик: новый шрифт по адресу удалённого не совпадёт с его ключами
+    static std::atomic<uint64_t> counter{0};
+    return ++counter;
+}
+
+std::shared_ptr<const RGBAImage> Font::decodeGlyph(uint16_t glyphID, uint16_t strike) const {
+    return decodedGlyphCache().getOrCreate(DecodedGlyphKey{this, decodedGeneration, strike, glyphID}, [&]() {
+        auto image = std::make_shared<RGBAImage>(decodeGlyphImage(glyphID, strike));
+        size_t cost = image->pixels.size() + sizeof(RGBAImage);
+        return std::make_pair(std::shared_ptr<const RGBAImage>(std::move(image)), cost);
+    });
+}
+
+bool Font::saveInPlace() {
+    throw FontFormatException(std::to_string(static_cast<int>(getFormat())),
+                              "in-place saving is not supported");
+}
+
+bool Font::addGlyphImage(const std::string& /*glyphName*/, const std::vector<uint8_t>& /*image*/) {
+    throw FontFormatException(std::to_string(static_cast<int>(getFormat())),
+                              "adding glyph images is not supported");
+}
+
+bool Font::canAddGlyphImage(const std::string& /*glyphName*/) const {
+    return false;
+}
+
+std::unique_ptr<Font::GlyphEditState> Font::saveGlyphEditState(const std::string& /*glyphName*/) const {
+    throw FontFormatException(std::to_string(static_cast<int>(getFormat())),
+                              "edit rollback is not supported");
+}
+
+void Font::restoreGlyphEditState(const GlyphEditState& /*state*/) {
+    throw FontFormatException(std::to_string(static_cast<int>(getFormat())),
+                              "edit rollback is not supported");
+}
+
+RGBAImage Font::decodeGlyphImage(uint16_t /*glyphID*/, uint16_t /*strike*/) const {
+    throw FontFormatException(std::to_string(static_cast<int>(getFormat())),
+                              "glyph image decoding is not supported");
+}
+
+void Font::invalidateDecodedGlyphs() const {
+    decodedGeneration = nextDecodedGeneration();
 }
 
 } // namespace fontmaster
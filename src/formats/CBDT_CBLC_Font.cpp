@@ -1,18 +1,23 @@
 #include "fontmaster/CBDT_CBLC_Font.h"
 #include "fontmaster/CBDT_CBLC_Rebuilder.h"
 #include "fontmaster/TTFUtils.h"
-#include "fontmaster/CMAPParser.h"
-
 #include "fontmaster/CMAPParser.h"
 #include "fontmaster/NAMEParser.h"
 #include "fontmaster/POSTParser.h"
 #include "fontmaster/MAXPParser.h"
+#include "fontmaster/PNGDecoder.h"
+#include "fontmaster/BitmapUnpack.h"
+#include "fontmaster/Rasterizer.h"
+#include "fontmaster/ImageHeader.h"
+#include "fontmaster/ByteWriter.h"
 
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <stdexcept>
 #include <sstream>
 #include <set>
+#include <cstdint>
 
 namespace fontmaster {
 
@@ -20,18 +25,8 @@ CBDT_CBLC_Font::CBDT_CBLC_Font(const std::string& filepath)
     : filepath(filepath), parser(fontData) {}
 
 bool CBDT_CBLC_Font::load() {
-    if (fontData.empty()) {
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            return false;
-        }
-        
-        file.seekg(0, std::ios::end);
-        size_t size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        fontData.resize(size);
-        file.read(reinterpret_cast<char*>(fontData.data()), size);
+    if (fontData.empty() && !utils::readFile(filepath, fontData, &sourceStamp)) {
+        return false;
     }
     
     // Инициализируем парсер с данными шрифта
@@ -41,22 +36,29 @@ bool CBDT_CBLC_Font::load() {
         std::cerr << "Failed to parse CBDT/CBLC font" << std::endl;
         return false;
     }
+    removedGlyphIDs.clear();
+    buildGlyphLookup();
     
     std::cout << "CBDT/CBLC Font loaded successfully: " << filepath << std::endl;
     return true;
 }
 
 bool CBDT_CBLC_Font::save(const std::string& filepath) {
-    CBDT_CBLC_Rebuilder rebuilder(fontData, parser.getStrikes(), parser.getRemovedGlyphs());
-    std::vector<uint8_t> newData = rebuilder.rebuild();
-    
-    std::ofstream file(filepath, std::ios::binary);
-    if (!file) {
-        return false;
-    }
-    
-    file.write(reinterpret_cast<const char*>(newData.data()), newData.size());
-    return file.good();
+    CBDT_CBLC_Rebuilder rebuilder(fontData, parser.getStrikes(), getRemovedGlyphs());
+    // Неизменённые таблицы копируются из исходного файла ядром, запись атомарная
+    utils::SourceFile source{this->filepath, sourceStamp, fontData};
+    return rebuilder.assemble().writeFile(filepath, &source);
+}
+
+bool CBDT_CBLC_Font::saveInPlace() {
+    CBDT_CBLC_Rebuilder rebuilder(fontData, parser.getStrikes(), getRemovedGlyphs());
+    // Замены, которые помещаются в прежние записи, не сдвигают таблицы - patchFile пишет только их
+    utils::FontAssembler assembler = rebuilder.assemble(true);
+    utils::SourceFile source{filepath, sourceStamp, fontData};
+    bool saved = assembler.patchFile(source) || assembler.writeFile(filepath, &source);
+    // Файл больше не совпадает с fontData
+    if (saved) sourceStamp = utils::FileStamp();
+    return saved;
 }
 
 const std::vector<uint8_t>& CBDT_CBLC_Font::getFontData() const {
@@ -65,6 +67,8 @@ const std::vector<uint8_t>& CBDT_CBLC_Font::getFontData() const {
 
 void CBDT_CBLC_Font::setFontData(const std::vector<uint8_t>& data) {
     fontData = data;
+    sourceStamp = utils::FileStamp();
+    invalidateDecodedGlyphs();
 }
 
 
@@ -72,13 +76,17 @@ void CBDT_CBLC_Font::setFontData(const std::vector<uint8_t>& data) {
 bool CBDT_CBLC_Font::removeGlyph(const std::string& glyphName) {
     try {
         uint16_t glyphID = findGlyphID(glyphName);
-        if (glyphID == 0) {
+        if (glyphID == 0 || !hasGlyphImage(glyphID)) {
             std::cerr << "CBDT_CBLC_Font: Glyph not found: " << glyphName << std::endl;
             return false;
         }
         
-        std::cout << "CBDT_CBLC_Font: Glyph removal marked for: " << glyphName 
-                  << " (ID: " << glyphID << ")" << std::endl;
+        // Изображения убираются сразу, чтобы список и декодирование видели правку до сохранения
+        for (auto& strikePair : parser.getStrikes()) {
+            strikePair.second.glyphImages.erase(glyphID);
+        }
+        removedGlyphIDs.insert(glyphID);
+        invalidateDecodedGlyphs();
         return true;
         
     } catch (const std::exception& e) {
@@ -107,14 +115,12 @@ bool CBDT_CBLC_Font::replaceGlyphImage(const std::string& glyphName,
                                       const std::vector<uint8_t>& newImage) {
     try {
         uint16_t glyphID = findGlyphID(glyphName);
-        if (glyphID == 0) {
+        if (glyphID == 0 || !hasGlyphImage(glyphID)) {
             std::cerr << "CBDT_CBLC_Font: Glyph not found: " << glyphName << std::endl;
             return false;
         }
         
-        std::cout << "CBDT_CBLC_Font: Glyph image replacement marked for: " << glyphName 
-                  << " (new image size: " << newImage.size() << " bytes)" << std::endl;
-        return true;
+        return storeGlyphPNG(glyphID, newImage, false);
         
     } catch (const std::exception& e) {
         std::cerr << "CBDT_CBLC_Font: Error processing glyph image replacement: " << e.what() << std::endl;
@@ -122,41 +128,96 @@ bool CBDT_CBLC_Font::replaceGlyphImage(const std::string& glyphName,
     }
 }
 
+bool CBDT_CBLC_Font::canAddGlyphImage(const std::string& glyphName) const {
+    uint16_t glyphID = findGlyphID(glyphName);
+    return glyphID != 0 && !hasGlyphImage(glyphID) && !parser.getStrikes().empty();
+}
+
+bool CBDT_CBLC_Font::addGlyphImage(const std::string& glyphName, const std::vector<uint8_t>& image) {
+    if (!canAddGlyphImage(glyphName)) {
+        std::cerr << "CBDT_CBLC_Font: Cannot add image for glyph: " << glyphName << std::endl;
+        return false;
+    }
+    uint16_t glyphID = findGlyphID(glyphName);
+    if (!storeGlyphPNG(glyphID, image, true)) return false;
+    removedGlyphIDs.erase(glyphID);
+    return true;
+}
+
+namespace {
+
+// Записи глифа во всех страйках и отметка об удалении
+struct CBDTGlyphEditState : Font::GlyphEditState {
+    uint16_t glyphID = 0;
+    bool removed = false;
+    std::map<uint16_t, GlyphImage> images;   // страйк -> запись; страйков без глифа здесь нет
+};
+
+} // namespace
+
+std::unique_ptr<Font::GlyphEditState> CBDT_CBLC_Font::saveGlyphEditState(const std::string& glyphName) const {
+    auto state = std::make_unique<CBDTGlyphEditState>();
+    state->glyphID = findGlyphID(glyphName);
+    if (state->glyphID == 0) return state;
+    state->removed = removedGlyphIDs.count(state->glyphID) != 0;
+    for (const auto& strikePair : parser.getStrikes()) {
+        auto it = strikePair.second.glyphImages.find(state->glyphID);
+        if (it != strikePair.second.glyphImages.end()) {
+            state->images.emplace(strikePair.first, it->second);
+        }
+    }
+    return state;
+}
+
+void CBDT_CBLC_Font::restoreGlyphEditState(const GlyphEditState& editState) {
+    const auto& state = static_cast<const CBDTGlyphEditState&>(editState);
+    if (state.glyphID == 0) return;
+    for (auto& strikePair : parser.getStrikes()) {
+        auto saved = state.images.find(strikePair.first);
+        if (saved != state.images.end()) {
+            strikePair.second.glyphImages[state.glyphID] = saved->second;
+        } else {
+            strikePair.second.glyphImages.erase(state.glyphID);
+        }
+    }
+    if (state.removed) {
+        removedGlyphIDs.insert(state.glyphID);
+    } else {
+        removedGlyphIDs.erase(state.glyphID);
+    }
+    invalidateDecodedGlyphs();
+}
+
 std::vector<GlyphInfo> CBDT_CBLC_Font::listGlyphs() const {
     std::vector<GlyphInfo> glyphs;
     
     try {
         const auto& strikes = parser.getStrikes();
-        auto postGlyphNames = getPostGlyphNames();
-        auto maxpGlyphCount = getMaxpGlyphCount();
         
+        // glyphIDs страйка - как в исходном CBLC, текущий набор - ключи glyphImages
         std::set<uint16_t> uniqueGlyphIDs;
         
         for (const auto& strikePair : strikes) {
-            const StrikeRecord& strike = strikePair.second;
-            
-            for (uint16_t glyphID : strike.glyphIDs) {
-                uniqueGlyphIDs.insert(glyphID);
+            for (const auto& imagePair : strikePair.second.glyphImages) {
+                uniqueGlyphIDs.insert(imagePair.first);
             }
         }
         
         for (uint16_t glyphID : uniqueGlyphIDs) {
-            if (maxpGlyphCount > 0 && glyphID >= maxpGlyphCount) {
+            if (numGlyphs > 0 && glyphID >= numGlyphs) {
                 continue;
             }
             
             GlyphInfo info;
-            info.name = getGlyphName(glyphID, postGlyphNames);
+            info.name = getGlyphName(glyphID);
+            info.glyph_id = glyphID;
             info.unicode = getUnicodeFromGlyphID(glyphID);
             
             for (const auto& strikePair : strikes) {
                 const StrikeRecord& strike = strikePair.second;
                 auto it = strike.glyphImages.find(glyphID);
                 if (it != strike.glyphImages.end()) {
-                    const GlyphImage& glyphImage = it->second;
-                    info.image_data = glyphImage.data;
-                    info.format = getImageFormatString(glyphImage.imageFormat);
-                    info.data_size = glyphImage.data.size();
+                    fillImageInfo(info, strike, it->second);
                     break;
                 }
             }
@@ -180,22 +241,18 @@ GlyphInfo CBDT_CBLC_Font::getGlyphInfo(const std::string& glyphName) const {
             throw GlyphNotFoundException(glyphName);
         }
         
-        auto postGlyphNames = getPostGlyphNames();
-        std::string actualName = getGlyphName(glyphID, postGlyphNames);
+        std::string actualName = getGlyphName(glyphID);
         
         const auto& strikes = parser.getStrikes();
         for (const auto& strikePair : strikes) {
             const StrikeRecord& strike = strikePair.second;
             auto it = strike.glyphImages.find(glyphID);
             if (it != strike.glyphImages.end()) {
-                const GlyphImage& glyphImage = it->second;
-                
                 GlyphInfo info;
                 info.name = actualName;
+                info.glyph_id = glyphID;
                 info.unicode = getUnicodeFromGlyphID(glyphID);
-                info.image_data = glyphImage.data;
-                info.format = getImageFormatString(glyphImage.imageFormat);
-                info.data_size = glyphImage.data.size();
+                fillImageInfo(info, strike, it->second);
                 
                 std::cout << "CBDT_CBLC_Font: Retrieved info for glyph: " << glyphName 
                           << " (ID: " << glyphID << ")" << std::endl;
@@ -217,8 +274,7 @@ std::string CBDT_CBLC_Font::findGlyphName(uint32_t unicode) const {
     try {
         uint16_t glyphID = findGlyphIDByUnicode(unicode);
         if (glyphID != 0) {
-            auto postGlyphNames = getPostGlyphNames();
-            return getGlyphName(glyphID, postGlyphNames);
+            return getGlyphName(glyphID);
         }
         
         return "";
@@ -229,174 +285,323 @@ std::string CBDT_CBLC_Font::findGlyphName(uint32_t unicode) const {
     }
 }
 
-// ============ PRIVATE HELPER METHODS ============
+namespace {
 
-std::string CBDT_CBLC_Font::getGlyphName(uint16_t glyphID, const std::map<uint16_t, std::string>& postGlyphNames) const {
-    auto it = postGlyphNames.find(glyphID);
-    if (it != postGlyphNames.end() && !it->second.empty()) {
-        return it->second;
+const int MAX_COMPONENT_DEPTH = 8;
+
+// Наложение premultiplied RGBA (source-over) со смещением и отсечением
+void compositeOver(RGBAImage& target, const RGBAImage& source, int offsetX, int offsetY) {
+    for (uint32_t y = 0; y < source.height; ++y) {
+        int ty = offsetY + static_cast<int>(y);
+        if (ty < 0 || ty >= static_cast<int>(target.height)) continue;
+        for (uint32_t x = 0; x < source.width; ++x) {
+            int tx = offsetX + static_cast<int>(x);
+            if (tx < 0 || tx >= static_cast<int>(target.width)) continue;
+            const uint8_t* s = &source.pixels[(static_cast<size_t>(y) * source.width + x) * 4];
+            uint8_t* d = &target.pixels[(static_cast<size_t>(ty) * target.width + tx) * 4];
+            uint32_t inverse = 255 - s[3];
+            for (int c = 0; c < 4; ++c) {
+                d[c] = static_cast<uint8_t>(s[c] + (d[c] * inverse + 127) / 255);
+            }
+        }
     }
-    
-    std::ostringstream name;
-    name << "glyph_" << glyphID;
-    return name.str();
 }
 
-std::map<uint16_t, std::string> CBDT_CBLC_Font::getPostGlyphNames() const {
-    std::map<uint16_t, std::string> glyphNames;
+void premultiplyAlpha(RGBAImage& image) {
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        uint32_t a = image.pixels[i + 3];
+        for (int c = 0; c < 3; ++c) {
+            image.pixels[i + c] = static_cast<uint8_t>((image.pixels[i + c] * a + 127) / 255);
+        }
+    }
+}
+
+// PNG форматов 17/18/19: метрики (small 5 байт / big 8 байт / нет), uint32 dataLen, PNG
+utils::ByteSpan embeddedPNG(const GlyphImage& glyphImage) {
+    utils::ByteSpan data(glyphImage.data);
+    size_t metricsSize = glyphImage.imageFormat == 17 ? 5 : glyphImage.imageFormat == 18 ? 8 : 0;
+    uint32_t dataLen = data.readUInt32(metricsSize);
+    return data.subspan(metricsSize + 4, dataLen);
+}
+
+} // namespace
+
+RGBAImage CBDT_CBLC_Font::decodeGlyphImage(uint16_t glyphID, uint16_t strikeIndex) const {
+    const auto& strikes = parser.getStrikes();
+    auto strikeIt = strikes.find(strikeIndex);
+    if (strikeIt == strikes.end()) {
+        throw GlyphNotFoundException("strike " + std::to_string(strikeIndex));
+    }
+    auto imageIt = strikeIt->second.glyphImages.find(glyphID);
+    if (imageIt == strikeIt->second.glyphImages.end() || imageIt->second.data.empty()) {
+        throw GlyphNotFoundException("glyph_" + std::to_string(glyphID));
+    }
     
+    const GlyphImage& glyphImage = imageIt->second;
     try {
-        auto tables = utils::parseTTFTables(fontData);
-        const utils::TableRecord* postRec = utils::findTable(tables, "post");
-        const utils::TableRecord* maxpRec = utils::findTable(tables, "maxp");
-        
-        if (postRec && maxpRec) {
-            utils::MAXPParser maxpParser(fontData, maxpRec->offset);
-            if (maxpParser.parse()) {
-                uint16_t numGlyphs = maxpParser.getNumGlyphs();
-                
-                utils::POSTParser postParser(fontData, postRec->offset, numGlyphs);
-                if (postParser.parse()) {
-                    glyphNames = postParser.getGlyphNames();
-                }
+        switch (glyphImage.imageFormat) {
+            case 17: case 18: case 19:
+                return utils::decodePNG(embeddedPNG(glyphImage));
+            default: {
+                RGBAImage image = decodeBitmapGlyph(strikeIt->second, glyphImage, 0);
+                utils::unpremultiplyAlpha(image.pixels.data(), image.pixels.size() / 4);
+                return image;
             }
         }
+    } catch (const FontException&) {
+        throw;
     } catch (const std::exception& e) {
-        std::cerr << "CBDT_CBLC_Font: Error parsing POST table: " << e.what() << std::endl;
+        throw FontFormatException("CBDT", "glyph " + std::to_string(glyphID) + ": " + e.what());
     }
+}
+
+RGBAImage CBDT_CBLC_Font::decodeBitmapGlyph(const StrikeRecord& strike, const GlyphImage& glyphImage,
+                                            int depth) const {
+    utils::ByteSpan data(glyphImage.data);
+    RGBAImage image;
+    image.width = glyphImage.width;
+    image.height = glyphImage.height;
+    image.pixels.assign(static_cast<size_t>(image.width) * image.height * 4, 0);
     
-    return glyphNames;
+    // Смещение растра за метриками и признак упаковки строк без выравнивания
+    size_t bitmapOffset;
+    bool bitAligned;
+    switch (glyphImage.imageFormat) {
+        case 1: bitmapOffset = 5; bitAligned = false; break;
+        case 2: bitmapOffset = 5; bitAligned = true; break;
+        case 5: bitmapOffset = 0; bitAligned = true; break;
+        case 6: bitmapOffset = 8; bitAligned = false; break;
+        case 7: bitmapOffset = 8; bitAligned = true; break;
+        case 8:
+        case 9: {
+            // Составной глиф: small метрики + pad / big метрики, uint16 numComponents, компоненты
+            if (depth >= MAX_COMPONENT_DEPTH) {
+                throw FontFormatException("CBDT", "component nesting too deep");
+            }
+            size_t pos = glyphImage.imageFormat == 8 ? 6 : 8;
+            uint16_t numComponents = data.readUInt16(pos);
+            pos += 2;
+            for (uint16_t i = 0; i < numComponents; ++i, pos += 4) {
+                uint16_t componentID = data.readUInt16(pos);
+                int8_t xOffset = static_cast<int8_t>(data.readUInt8(pos + 2));
+                int8_t yOffset = static_cast<int8_t>(data.readUInt8(pos + 3));
+                
+                auto it = strike.glyphImages.find(componentID);
+                if (it == strike.glyphImages.end() || it->second.data.empty()) continue;
+                compositeOver(image, decodeBitmapGlyph(strike, it->second, depth + 1), xOffset, yOffset);
+            }
+            return image;
+        }
+        case 17: case 18: case 19: {
+            RGBAImage png = utils::decodePNG(embeddedPNG(glyphImage));
+            premultiplyAlpha(png);
+            return png;
+        }
+        default:
+            throw FontFormatException("CBDT", "image format " + std::to_string(glyphImage.imageFormat) +
+                                              " cannot be decoded");
+    }
+    
+    utils::unpackBitmap(data.subspan(bitmapOffset), image.width, image.height, strike.bitDepth, bitAligned,
+                        image.pixels.data(), static_cast<size_t>(image.width) * 4);
+    return image;
 }
 
-uint16_t CBDT_CBLC_Font::getMaxpGlyphCount() const {
+// ============ PRIVATE HELPER METHODS ============
+
+void CBDT_CBLC_Font::buildGlyphLookup() {
+    numGlyphs = 0;
+    glyphNames.clear();
+    glyphIDsByName.clear();
+    unicodeToGlyph.clear();
+    glyphToUnicode.clear();
+    
     try {
         auto tables = utils::parseTTFTables(fontData);
         const utils::TableRecord* maxpRec = utils::findTable(tables, "maxp");
+        const utils::TableRecord* postRec = utils::findTable(tables, "post");
+        const utils::TableRecord* cmapRec = utils::findTable(tables, "cmap");
         
         if (maxpRec) {
             utils::MAXPParser maxpParser(fontData, maxpRec->offset);
             if (maxpParser.parse()) {
-                return maxpParser.getNumGlyphs();
+                numGlyphs = maxpParser.getNumGlyphs();
             }
         }
-    } catch (const std::exception& e) {
-        std::cerr << "CBDT_CBLC_Font: Error parsing MAXP table: " << e.what() << std::endl;
-    }
-    
-    return 0;
-}
-
-uint16_t CBDT_CBLC_Font::findGlyphID(const std::string& glyphName) const {
-    try {
-        auto postGlyphNames = getPostGlyphNames();
-        for (const auto& pair : postGlyphNames) {
-            if (pair.second == glyphName) {
-                return pair.first;
+        
+        if (postRec && numGlyphs > 0) {
+            utils::POSTParser postParser(fontData, postRec->offset, numGlyphs);
+            if (postParser.parse()) {
+                glyphNames = postParser.getGlyphNames();
             }
         }
+        for (const auto& [glyphID, name] : glyphNames) {
+            if (!name.empty()) glyphIDsByName.emplace(name, glyphID);
+        }
         
-        if (glyphName.find("glyph_") == 0) {
-            try {
-                std::string idStr = glyphName.substr(6);
-                uint16_t glyphID = static_cast<uint16_t>(std::stoi(idStr));
-                
-                auto maxpGlyphCount = getMaxpGlyphCount();
-                if (maxpGlyphCount > 0 && glyphID < maxpGlyphCount) {
-                    return glyphID;
+        if (cmapRec) {
+            utils::CMAPParser cmapParser(utils::ByteSpan(fontData).subspan(cmapRec->offset, cmapRec->length).toVector());
+            if (cmapParser.parse()) {
+                unicodeToGlyph = cmapParser.getCharToGlyphMap();
+                for (const auto& [glyphID, charCodes] : cmapParser.getGlyphToCharMap()) {
+                    if (!charCodes.empty()) glyphToUnicode.emplace(glyphID, *charCodes.begin());
                 }
-            } catch (const std::exception&) {
             }
         }
+    } catch (const std::exception& e) {
+        std::cerr << "CBDT_CBLC_Font: Error reading glyph names: " << e.what() << std::endl;
+    }
+}
+
+std::string CBDT_CBLC_Font::getGlyphName(uint16_t glyphID) const {
+    auto it = glyphNames.find(glyphID);
+    if (it != glyphNames.end() && !it->second.empty()) {
+        return it->second;
+    }
+    
+    std::ostringstream name;
+    name << "glyph_" << glyphID;
+    return name.str();
+}
+
+bool CBDT_CBLC_Font::hasGlyphImage(uint16_t glyphID) const {
+    for (const auto& strikePair : parser.getStrikes()) {
+        auto it = strikePair.second.glyphImages.find(glyphID);
+        if (it != strikePair.second.glyphImages.end() && !it->second.data.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CBDT_CBLC_Font::storeGlyphPNG(uint16_t glyphID, const std::vector<uint8_t>& png, bool addMissing) {
+    // Размеры пишутся в small metrics - по байту на сторону
+    utils::ImageHeader header = utils::probeImageHeader(png);
+    if (header.format != "png" || header.width == 0 || header.height == 0 ||
+        header.width > 255 || header.height > 255) {
+        std::cerr << "CBDT_CBLC_Font: Glyph image must be a PNG up to 255x255" << std::endl;
+        return false;
+    }
+    
+    for (auto& strikePair : parser.getStrikes()) {
+        StrikeRecord& strike = strikePair.second;
+        auto it = strike.glyphImages.find(glyphID);
+        bool present = it != strike.glyphImages.end() && !it->second.data.empty();
+        if (!present && !addMissing) continue;
         
-        if (glyphName.find("u") == 0) {
-            try {
-                std::string hexStr = glyphName.substr(1);
-                uint32_t unicode = std::stoul(hexStr, nullptr, 16);
-                return findGlyphIDByUnicode(unicode);
-            } catch (...) {
+        GlyphImage& image = strike.glyphImages[glyphID];
+        if (!present) {
+            // Точка привязки и ширина - как у первого глифа страйка: в эмодзи-шрифтах они общие
+            auto sample = std::find_if(strike.glyphImages.begin(), strike.glyphImages.end(),
+                                       [glyphID](const std::pair<const uint16_t, GlyphImage>& entry) {
+                                           return entry.first != glyphID && !entry.second.data.empty();
+                                       });
+            image = GlyphImage();
+            image.glyphID = glyphID;
+            if (sample != strike.glyphImages.end()) {
+                image.bearingX = sample->second.bearingX;
+                image.bearingY = sample->second.bearingY;
+                image.advance = sample->second.advance;
+            } else {
+                image.bearingY = static_cast<int16_t>(std::min<uint32_t>(header.height, 127));
+                image.advance = static_cast<uint16_t>(header.width);
             }
         }
         
-        return 0;
+        image.imageFormat = 17;
+        image.width = static_cast<uint16_t>(header.width);
+        image.height = static_cast<uint16_t>(header.height);
+        image.vertBearingX = 0;
+        image.vertBearingY = 0;
+        image.vertAdvance = 0;
         
-    } catch (const std::exception& e) {
-        std::cerr << "CBDT_CBLC_Font: Error finding glyph ID: " << e.what() << std::endl;
-        return 0;
+        // Запись формата 17: small metrics, uint32 dataLen, PNG
+        utils::ByteWriter record(5 + 4 + png.size());
+        record.writeUInt8(static_cast<uint8_t>(image.height));
+        record.writeUInt8(static_cast<uint8_t>(image.width));
+        record.writeInt8(static_cast<int8_t>(image.bearingX));
+        record.writeInt8(static_cast<int8_t>(image.bearingY));
+        record.writeUInt8(static_cast<uint8_t>(image.advance));
+        record.writeUInt32(static_cast<uint32_t>(png.size()));
+        record.writeBytes(png.data(), png.size());
+        image.data = record.take();
     }
+    
+    invalidateDecodedGlyphs();
+    return true;
 }
 
-uint16_t CBDT_CBLC_Font::findGlyphIDByUnicode(uint32_t unicode) const {
-    try {
-        auto tables = utils::parseTTFTables(fontData);
-        const utils::TableRecord* cmapRec = utils::findTable(tables, "cmap");
-        
-        if (cmapRec) {
-            std::vector<uint8_t> cmapData(
-                fontData.begin() + cmapRec->offset,
-                fontData.begin() + cmapRec->offset + cmapRec->length
-            );
-            
-            utils::CMAPParser cmapParser(cmapData);
-            if (cmapParser.parse()) {
-                return cmapParser.getGlyphIndex(unicode);
+uint16_t CBDT_CBLC_Font::findGlyphID(const std::string& glyphName) const {
+    auto it = glyphIDsByName.find(glyphName);
+    if (it != glyphIDsByName.end()) {
+        return it->second;
+    }
+    
+    if (glyphName.find("glyph_") == 0) {
+        try {
+            uint16_t glyphID = static_cast<uint16_t>(std::stoi(glyphName.substr(6)));
+            if (numGlyphs > 0 && glyphID < numGlyphs) {
+                return glyphID;
             }
+        } catch (const std::exception&) {
+        }
+    }
+    
+    if (glyphName.find("u") == 0) {
+        try {
+            uint32_t unicode = std::stoul(glyphName.substr(1), nullptr, 16);
+            return findGlyphIDByUnicode(unicode);
+        } catch (const std::exception&) {
         }
-        
-        return 0;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "CBDT_CBLC_Font: Error finding glyph ID by Unicode: " << e.what() << std::endl;
-        return 0;
     }
+    
+    return 0;
+}
+
+uint16_t CBDT_CBLC_Font::findGlyphIDByUnicode(uint32_t unicode) const {
+    auto it = unicodeToGlyph.find(unicode);
+    return it != unicodeToGlyph.end() ? it->second : 0;
 }
 
 uint32_t CBDT_CBLC_Font::getUnicodeFromGlyphID(uint16_t glyphID) const {
-    try {
-        auto tables = utils::parseTTFTables(fontData);
-        const utils::TableRecord* cmapRec = utils::findTable(tables, "cmap");
-        
-        if (cmapRec) {
-            std::vector<uint8_t> cmapData(
-                fontData.begin() + cmapRec->offset,
-                fontData.begin() + cmapRec->offset + cmapRec->length
-            );
-            
-            utils::CMAPParser cmapParser(cmapData);
-            if (cmapParser.parse()) {
-                auto charCodes = cmapParser.getCharCodes(glyphID);
-                if (!charCodes.empty()) {
-                    return *charCodes.begin();
-                }
-            }
+    auto it = glyphToUnicode.find(glyphID);
+    return it != glyphToUnicode.end() ? it->second : 0;
+}
+
+void CBDT_CBLC_Font::fillImageInfo(GlyphInfo& info, const StrikeRecord& strike,
+                                   const GlyphImage& glyphImage) const {
+    info.format = getImageFormatString(glyphImage.imageFormat);
+    if (info.format == "png") {
+        // Отдаём сам PNG без метрик и dataLen записи CBDT; битая запись не выдаётся за PNG
+        try {
+            info.image_data = embeddedPNG(glyphImage).toVector();
+        } catch (const std::out_of_range&) {
+            info.image_data = glyphImage.data;
+            info.format = "unknown";
         }
-        
-        return 0;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "CBDT_CBLC_Font: Error getting Unicode from glyph ID: " << e.what() << std::endl;
-        return 0;
+    } else {
+        info.image_data = glyphImage.data;
     }
+    info.data_size = info.image_data.size();
+    // Размеры уже прочитаны из метрик при разборе CBDT
+    info.width = glyphImage.width;
+    info.height = glyphImage.height;
+    info.bit_depth = strike.bitDepth;
+    info.ppem = strike.ppem;
 }
 
 std::string CBDT_CBLC_Font::getImageFormatString(uint16_t imageFormat) const {
     switch (imageFormat) {
-        case 1: return "bitmap_mono";
-        case 2: return "bitmap_grayscale";
-        case 3: return "bitmap_rgb";
-        case 4: return "bitmap_rgba";
-        case 5: return "png";
-        case 6: return "jpeg";
-        case 7: return "tiff";
-        case 8: return "bitmap_mono_small";
-        case 9: return "bitmap_grayscale_small";
-        case 17: return "png_small";
-        case 18: return "png_mono";
+        case 1: return "bitmap_small_metrics";
+        case 2: return "bitmap_small_metrics_bit_aligned";
+        case 5: return "bitmap_bit_aligned";
+        case 6: return "bitmap_big_metrics";
+        case 7: return "bitmap_big_metrics_bit_aligned";
+        case 8: return "bitmap_composite_small_metrics";
+        case 9: return "bitmap_composite_big_metrics";
+        case 17: case 18: case 19: return "png";
         default: return "unknown";
     }
 }
 
-
-
-
-
 } // namespace fontmaster
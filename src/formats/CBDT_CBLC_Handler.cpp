@@ -32,31 +32,14 @@ bool CBDT_CBLC_Handler::canHandle(const std::string& filepath) {
 }
 
 std::unique_ptr<Font> CBDT_CBLC_Handler::loadFont(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
-        std::cerr << "CBDT/CBLC: Cannot open file: " << filepath << std::endl;
-        return nullptr;
-    }
-    
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    std::vector<uint8_t> data(size);
-    file.read(reinterpret_cast<char*>(data.data()), size);
-    
-    if (!file) {
-        std::cerr << "CBDT/CBLC: Cannot read file: " << filepath << std::endl;
-        return nullptr;
-    }
-    
     if (!canHandle(filepath)) {
         std::cerr << "CBDT/CBLC: Cannot handle this font format" << std::endl;
         return nullptr;
     }
     
+    // Шрифт читает файл сам и запоминает его отпечаток: при сохранении
+    // неизменённые таблицы копируются прямо из этого файла
     auto font = std::make_unique<CBDT_CBLC_Font>(filepath);
-    font->setFontData(data);
     
     if (!font->load()) {
         std::cerr << "CBDT/CBLC: Failed to load font" << std::endl;
@@ -66,4 +49,8 @@ std::unique_ptr<Font> CBDT_CBLC_Handler::loadFont(const std::string& filepath) {
     return font;
 }
 
+void registerCBDTHandler() {
+    registerFontFormatHandler(std::make_unique<CBDT_CBLC_Handler>());
+}
+
 } // namespace fontmaster
@@ -1,219 +1,457 @@
 #include "fontmaster/CBDT_CBLC_Rebuilder.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/PhaseTimer.h"
 #include <iostream>
 #include <algorithm>
 #include <cstring>
+#include <array>
+#include <deque>
 
 namespace fontmaster {
 
 using namespace fontmaster::utils;
 
-static inline void appendUInt32(std::vector<uint8_t>& data, uint32_t value) {
-    data.push_back((value >> 24) & 0xFF);
-    data.push_back((value >> 16) & 0xFF);
-    data.push_back((value >> 8) & 0xFF);
-    data.push_back(value & 0xFF);
+namespace {
+
+const uint32_t CBLC_CBDT_VERSION = 0x00030000;
+const size_t BITMAP_SIZE_RECORD = 48;
+const size_t INDEX_ARRAY_ENTRY = 8;      // firstGlyphIndex, lastGlyphIndex, additionalOffsetToIndexSubtable
+const size_t INDEX_SUBHEADER = 8;        // indexFormat, imageFormat, imageDataOffset
+const size_t SMALL_METRICS_SIZE = 5;
+const size_t BIG_METRICS_SIZE = 8;
+// Стоимость форматов 2/5 не раскладывается на слагаемые (размер записи - максимум по прогону),
+// поэтому начало такого прогона перебирается в окне плюс начало серии одинаковых записей
+const size_t UNIFORM_RUN_WINDOW = 32;
+
+// Как глиф может лечь в CBDT
+enum class GlyphKind {
+    PNG_SMALL,       // PNG без вертикальных метрик: 17 в форматах 1/3, 19 в 2/5
+    PNG_BIG,         // PNG с вертикальными метриками: 18 в форматах 1/3, 19 в 2/5
+    EMBEDDED,        // растр с метриками в записи (1, 2, 6-9): только форматы 1/3, запись как есть
+    INDEX_METRICS    // растр формата 5 (метрики в индексе): только форматы 2/5
+};
+
+struct GlyphEntry {
+    uint16_t glyphID = 0;
+    GlyphKind kind = GlyphKind::EMBEDDED;
+    uint16_t imageFormat = 0;                 // исходный, для растров
+    ByteSpan payload;                         // PNG - само изображение, растр - исходная запись
+    std::array<uint8_t, BIG_METRICS_SIZE> metrics = {};
+    uint32_t recordSize = 0;                  // запись в формате 1/3
+    uint32_t uniformSize = 0;                 // запись в формате 2/5 до выравнивания по максимуму
+};
+
+struct IndexRun {
+    size_t begin = 0;                         // [begin, end) в списке глифов страйка
+    size_t end = 0;
+    uint16_t indexFormat = 1;
+};
+
+bool sameClass(const GlyphEntry& a, const GlyphEntry& b) {
+    return a.kind == b.kind && (a.kind == GlyphKind::PNG_SMALL || a.kind == GlyphKind::PNG_BIG ||
+                                a.imageFormat == b.imageFormat);
 }
 
-static inline void appendUInt16(std::vector<uint8_t>& data, uint16_t value) {
-    data.push_back((value >> 8) & 0xFF);
-    data.push_back(value & 0xFF);
-}
-
-static inline void setUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
-    if (offset + 4 <= data.size()) {
-        data[offset] = (value >> 24) & 0xFF;
-        data[offset + 1] = (value >> 16) & 0xFF;
-        data[offset + 2] = (value >> 8) & 0xFF;
-        data[offset + 3] = value & 0xFF;
+uint16_t imageFormatFor(const GlyphEntry& glyph, uint16_t indexFormat) {
+    bool uniform = indexFormat == 2 || indexFormat == 5;
+    switch (glyph.kind) {
+        case GlyphKind::PNG_SMALL: return uniform ? 19 : 17;
+        case GlyphKind::PNG_BIG: return uniform ? 19 : 18;
+        default: return glyph.imageFormat;
     }
 }
 
-static inline uint32_t calcTableChecksum(const std::vector<uint8_t>& data) {
-    uint32_t sum = 0;
-    for (size_t i = 0; i < data.size(); i += 4) {
-        uint32_t val = 0;
-        for (int j = 0; j < 4 && i + j < data.size(); ++j)
-            val = (val << 8) | data[i + j];
-        sum += val;
-    }
-    return sum;
+// PNG из записи формата 17/18/19: метрики (если есть), uint32 dataLen, данные
+bool extractPNG(const GlyphImage& image, ByteSpan& png) {
+    size_t metricsSize = image.imageFormat == 17 ? SMALL_METRICS_SIZE : image.imageFormat == 18 ? BIG_METRICS_SIZE : 0;
+    ByteSpan record(image.data);
+    if (record.size() < metricsSize + 4) return false;
+    uint32_t length = record.readUInt32(metricsSize);
+    if (length > record.size() - metricsSize - 4) return false;
+    png = record.subspan(metricsSize + 4, length);
+    return true;
 }
 
-static inline void setTag(std::vector<uint8_t>& buf, size_t offset, const std::string& tag) {
-    for (size_t i = 0; i < 4; ++i)
-        buf[offset + i] = (i < tag.size()) ? tag[i] : ' ';
+std::vector<GlyphEntry> collectGlyphs(const StrikeRecord& strike, const std::vector<bool>& removed) {
+    std::vector<GlyphEntry> glyphs;
+    glyphs.reserve(strike.glyphImages.size());
+    for (const auto& [glyphID, image] : strike.glyphImages) {
+        if ((glyphID < removed.size() && removed[glyphID]) || image.data.empty()) continue;
+
+        GlyphEntry glyph;
+        glyph.glyphID = glyphID;
+        glyph.imageFormat = image.imageFormat;
+        glyph.metrics = {static_cast<uint8_t>(image.height), static_cast<uint8_t>(image.width),
+                         static_cast<uint8_t>(image.bearingX), static_cast<uint8_t>(image.bearingY),
+                         static_cast<uint8_t>(image.advance), static_cast<uint8_t>(image.vertBearingX),
+                         static_cast<uint8_t>(image.vertBearingY), static_cast<uint8_t>(image.vertAdvance)};
+
+        bool isPNG = image.imageFormat >= 17 && image.imageFormat <= 19;
+        if (isPNG && extractPNG(image, glyph.payload)) {
+            // Small metrics в вертикальном страйке означали бы вертикальные метрики
+            bool hasVertical = image.vertBearingX != 0 || image.vertBearingY != 0 || image.vertAdvance != 0;
+            glyph.kind = hasVertical || (strike.flags & 0x02) ? GlyphKind::PNG_BIG : GlyphKind::PNG_SMALL;
+            size_t metricsSize = glyph.kind == GlyphKind::PNG_SMALL ? SMALL_METRICS_SIZE : BIG_METRICS_SIZE;
+            glyph.recordSize = static_cast<uint32_t>(metricsSize + 4 + glyph.payload.size());
+            glyph.uniformSize = static_cast<uint32_t>(4 + glyph.payload.size());
+        } else {
+            glyph.kind = image.imageFormat == 5 ? GlyphKind::INDEX_METRICS : GlyphKind::EMBEDDED;
+            glyph.payload = ByteSpan(image.data);
+            glyph.recordSize = static_cast<uint32_t>(image.data.size());
+            glyph.uniformSize = glyph.recordSize;
+        }
+        glyphs.push_back(glyph);
+    }
+    return glyphs;
 }
 
-/* ────────────────────────────────  MAIN  ─────────────────────────────── */
+/*
+ * Разбиение глифов страйка на прогоны с минимальным суммарным размером CBLC и CBDT.
+ * Динамика по префиксам: форматы 1 и 3 стоят заголовок + смещение на каждый ID диапазона
+ * + записи, что раскладывается в best[i] - k*ID[i] - P[i] и даёт минимум за O(1)
+ * (для формата 3 - скользящий минимум с ограничением 16-битных смещений). Форматы 2 и 5
+ * требуют одинаковых метрик и выравнивают записи по самой длинной.
+ */
+std::vector<IndexRun> planIndexRuns(const std::vector<GlyphEntry>& glyphs) {
+    const int64_t INF = INT64_MAX / 4;
+    size_t n = glyphs.size();
+    std::vector<int64_t> best(n + 1, INF);
+    std::vector<IndexRun> choice(n + 1);
+    std::vector<int64_t> prefix(n + 1, 0);    // сумма recordSize
+    for (size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + glyphs[i].recordSize;
+    best[0] = 0;
+
+    // Минимумы для форматов 1 и 3 внутри текущего сегмента одного класса
+    int64_t min1 = INF;
+    size_t min1At = 0;
+    std::deque<size_t> window3;
+    size_t uniformBegin = 0;
+    size_t equalBegin = 0;
+
+    auto value1 = [&](size_t i) { return best[i] - 4 * int64_t(glyphs[i].glyphID) - prefix[i]; };
+    auto value3 = [&](size_t i) { return best[i] - 2 * int64_t(glyphs[i].glyphID) - prefix[i]; };
+
+    for (size_t j = 0; j < n; ++j) {
+        const GlyphEntry& glyph = glyphs[j];
+        // Прогон не пересекает границу класса глифов
+        if (j == 0 || !sameClass(glyphs[j - 1], glyph)) {
+            min1 = INF;
+            window3.clear();
+            uniformBegin = equalBegin = j;
+        } else {
+            if (glyphs[j - 1].metrics != glyph.metrics) uniformBegin = j;
+            if (glyphs[j - 1].metrics != glyph.metrics || glyphs[j - 1].uniformSize != glyph.uniformSize) {
+                equalBegin = j;
+            }
+        }
+        auto consider = [&](int64_t cost, size_t begin, uint16_t indexFormat) {
+            if (cost < best[j + 1]) {
+                best[j + 1] = cost;
+                choice[j + 1] = {begin, j + 1, indexFormat};
+            }
+        };
+
+        bool offsetFormats = glyph.kind != GlyphKind::INDEX_METRICS;
+        bool uniformFormats = glyph.kind != GlyphKind::EMBEDDED;
+
+        if (offsetFormats) {
+            // Формат 1: 16 + 4 * (ID[j] - ID[i] + 2) + P[j+1] - P[i]
+            if (value1(j) < min1) {
+                min1 = value1(j);
+                min1At = j;
+            }
+            consider(min1 + 16 + 4 * (int64_t(glyph.glyphID) + 2) + prefix[j + 1], min1At, 1);
+
+            // Формат 3: то же с 2 байтами на смещение, пока данные прогона < 64 КБ
+            while (!window3.empty() && value3(window3.back()) >= value3(j)) window3.pop_back();
+            window3.push_back(j);
+            while (!window3.empty() && prefix[j + 1] - prefix[window3.front()] > 0xFFFF) window3.pop_front();
+            if (!window3.empty()) {
+                size_t i = window3.front();
+                int64_t count = int64_t(glyph.glyphID) - glyphs[i].glyphID + 2;
+                consider(value3(i) + 16 + 2 * (int64_t(glyph.glyphID) + 2) + prefix[j + 1] + (count & 1) * 2, i, 3);
+            }
+        }
 
-std::vector<uint8_t> CBDT_CBLC_Rebuilder::rebuild() {
-    std::vector<uint8_t> cblcData;
-    std::vector<uint8_t> cbdtData;
+        if (uniformFormats) {
+            size_t lowest = std::max(uniformBegin, j + 1 > UNIFORM_RUN_WINDOW ? j + 1 - UNIFORM_RUN_WINDOW : 0);
+            int64_t maxSize = 0;
+            auto considerUniform = [&](size_t i, int64_t size) {
+                int64_t count = static_cast<int64_t>(j - i + 1);
+                // Формат 2: 28 байт без списка глифов, но ID подряд
+                if (int64_t(glyph.glyphID) - glyphs[i].glyphID == count - 1) {
+                    consider(best[i] + INDEX_ARRAY_ENTRY + INDEX_SUBHEADER + 12 + count * size, i, 2);
+                }
+                // Формат 5: + numGlyphs и glyphIdArray с выравниванием до 4
+                consider(best[i] + INDEX_ARRAY_ENTRY + INDEX_SUBHEADER + 16 + 2 * count + (count & 1) * 2 +
+                         count * size, i, 5);
+            };
+            for (size_t i = j + 1; i-- > lowest;) {
+                maxSize = std::max<int64_t>(maxSize, glyphs[i].uniformSize);
+                considerUniform(i, maxSize);
+            }
+            if (equalBegin < lowest) considerUniform(equalBegin, glyph.uniformSize);
+        }
+    }
 
-    rebuildCBLCTable(cblcData);
-    rebuildCBDTTable(cbdtData);
+    std::vector<IndexRun> runs;
+    for (size_t end = n; end > 0; end = choice[end].begin) runs.push_back(choice[end]);
+    std::reverse(runs.begin(), runs.end());
+    return runs;
+}
 
-    return createUpdatedFont(cblcData, cbdtData);
+int8_t clampInt8(int value) {
+    return static_cast<int8_t>(std::max(-128, std::min(127, value)));
 }
 
-/* ─────────────────────────────── CBLC ─────────────────────────────── */
+// SbitLineMetrics: экстремумы по глифам, ascender/descender и наклон каретки - из исходного страйка
+std::array<uint8_t, 12> lineMetrics(const StrikeRecord& strike, const std::vector<GlyphEntry>& glyphs) {
+    std::array<uint8_t, 12> metrics = strike.hasLineMetrics ? strike.hori : std::array<uint8_t, 12>{};
+    if (glyphs.empty()) return metrics;
+
+    int widthMax = 0, minOriginSB = 127, minAdvanceSB = 127, maxBeforeBL = -128, minAfterBL = 127;
+    for (const GlyphEntry& glyph : glyphs) {
+        int height = glyph.metrics[0];
+        int width = glyph.metrics[1];
+        int bearingX = static_cast<int8_t>(glyph.metrics[2]);
+        int bearingY = static_cast<int8_t>(glyph.metrics[3]);
+        int advance = glyph.metrics[4];
+        widthMax = std::max(widthMax, width);
+        minOriginSB = std::min(minOriginSB, bearingX);
+        minAdvanceSB = std::min(minAdvanceSB, advance - bearingX - width);
+        maxBeforeBL = std::max(maxBeforeBL, bearingY);
+        minAfterBL = std::min(minAfterBL, bearingY - height);
+    }
+    if (!strike.hasLineMetrics) {
+        metrics[0] = static_cast<uint8_t>(clampInt8(maxBeforeBL));   // ascender
+        metrics[1] = static_cast<uint8_t>(clampInt8(minAfterBL));    // descender
+        metrics[3] = 1;                                              // caretSlopeNumerator
+    }
+    metrics[2] = static_cast<uint8_t>(std::min(widthMax, 255));
+    metrics[6] = static_cast<uint8_t>(clampInt8(minOriginSB));
+    metrics[7] = static_cast<uint8_t>(clampInt8(minAdvanceSB));
+    metrics[8] = static_cast<uint8_t>(clampInt8(maxBeforeBL));
+    metrics[9] = static_cast<uint8_t>(clampInt8(minAfterBL));
+    return metrics;
+}
 
-void CBDT_CBLC_Rebuilder::rebuildCBLCTable(std::vector<uint8_t>& cblc) {
-    appendUInt32(cblc, 0x00020000); // version
-    appendUInt32(cblc, static_cast<uint32_t>(strikes.size())); // numStrikes
+// Подтаблица индекса и записи её глифов; entry - её запись в IndexSubTableArray
+void writeIndexRun(ByteWriter& cblc, ByteWriter& cbdt, const std::vector<GlyphEntry>& glyphs,
+                   const IndexRun& run, size_t arrayOffset, size_t entry) {
+    const GlyphEntry& first = glyphs[run.begin];
+    const GlyphEntry& last = glyphs[run.end - 1];
+    uint16_t imageFormat = imageFormatFor(first, run.indexFormat);
+
+    // IndexSubTableArray: смещение подтаблицы - от начала массива
+    cblc.patchUInt16(entry, first.glyphID);
+    cblc.patchUInt16(entry + 2, last.glyphID);
+    cblc.patchUInt32(entry + 4, static_cast<uint32_t>(cblc.size() - arrayOffset));
+
+    cblc.writeUInt16(run.indexFormat);
+    cblc.writeUInt16(imageFormat);
+    cblc.writeUInt32(static_cast<uint32_t>(cbdt.size())); // imageDataOffset
+    size_t imageDataOffset = cbdt.size();
+
+    auto appendRecord = [&](const GlyphEntry& glyph, size_t paddedSize) {
+        size_t start = cbdt.size();
+        if (imageFormat == 17 || imageFormat == 18) {
+            cbdt.writeBytes(glyph.metrics.data(), imageFormat == 17 ? SMALL_METRICS_SIZE : BIG_METRICS_SIZE);
+        }
+        if (imageFormat >= 17 && imageFormat <= 19) {
+            cbdt.writeUInt32(static_cast<uint32_t>(glyph.payload.size()));
+        }
+        cbdt.writeBytes(glyph.payload);
+        // В форматах 2/5 шаг записей общий; у PNG длина указана явно, хвост не читается
+        if (cbdt.size() - start < paddedSize) cbdt.writeZeros(start + paddedSize - cbdt.size());
+    };
+
+    if (run.indexFormat == 1 || run.indexFormat == 3) {
+        size_t entrySize = run.indexFormat == 1 ? 4 : 2;
+        size_t offsetsPos = cblc.size();
+        cblc.writeZeros((static_cast<size_t>(last.glyphID) - first.glyphID + 2) * entrySize);
+        auto putOffset = [&](size_t index) {
+            uint32_t offset = static_cast<uint32_t>(cbdt.size() - imageDataOffset);
+            if (entrySize == 4) {
+                cblc.patchUInt32(offsetsPos + index * 4, offset);
+            } else {
+                cblc.patchUInt16(offsetsPos + index * 2, static_cast<uint16_t>(offset));
+            }
+        };
+        // Пропущенные ID получают равные соседние смещения - изображения нет
+        size_t index = 0;
+        for (size_t g = run.begin; g < run.end; ++g) {
+            for (; first.glyphID + index <= glyphs[g].glyphID; ++index) putOffset(index);
+            appendRecord(glyphs[g], 0);
+        }
+        putOffset(index);
+    } else {
+        uint32_t imageSize = 0;
+        for (size_t g = run.begin; g < run.end; ++g) imageSize = std::max(imageSize, glyphs[g].uniformSize);
+        cblc.writeUInt32(imageSize);
+        cblc.writeBytes(first.metrics.data(), first.metrics.size());
+        if (run.indexFormat == 5) {
+            cblc.writeUInt32(static_cast<uint32_t>(run.end - run.begin));
+            uint8_t* ids = cblc.extend((run.end - run.begin) * 2);
+            for (size_t g = run.begin; g < run.end; ++g) storeUInt16(ids + (g - run.begin) * 2, glyphs[g].glyphID);
+        }
+        for (size_t g = run.begin; g < run.end; ++g) appendRecord(glyphs[g], imageSize);
+    }
+    cblc.align(4);
+}
 
-    std::vector<uint32_t> strikeOffsets(strikes.size(), 0);
-    size_t offsetStart = cblc.size();
-    cblc.resize(cblc.size() + strikes.size() * 4, 0);
+} // namespace
 
-    size_t idx = 0;
-    for (const auto& [id, strike] : strikes) {
-        strikeOffsets[idx] = cblc.size();
-        rebuildStrike(cblc, strike);
-        ++idx;
-    }
+/* ────────────────────────────────  MAIN  ─────────────────────────────── */
 
-    for (size_t i = 0; i < strikeOffsets.size(); ++i)
-        setUInt32(cblc, offsetStart + i * 4, strikeOffsets[i]);
+std::vector<uint8_t> CBDT_CBLC_Rebuilder::rebuild() {
+    return assemble().assemble();
 }
 
-void CBDT_CBLC_Rebuilder::rebuildStrike(std::vector<uint8_t>& buf, const StrikeRecord& strike) {
-    appendUInt16(buf, strike.ppem);
-    appendUInt16(buf, strike.resolution);
-    appendUInt32(buf, 0); // colorRef
-    appendUInt16(buf, 72);
-    appendUInt16(buf, 72);
-
-    uint16_t firstGlyph = 0xFFFF, lastGlyph = 0;
-    for (uint16_t g : strike.glyphIDs) {
-        if (std::find(removedGlyphs.begin(), removedGlyphs.end(), g) == removedGlyphs.end()) {
-            firstGlyph = std::min(firstGlyph, g);
-            lastGlyph  = std::max(lastGlyph, g);
+FontAssembler CBDT_CBLC_Rebuilder::assemble(bool keepSlots) {
+    if (keepSlots) {
+        std::vector<uint8_t> cbdt;
+        if (rewriteSlots(cbdt)) {
+            std::vector<TableRecord> tables = parseTTFTables(fontData);
+            const TableRecord* cblcRecord = findTable(tables, "CBLC");
+            if (!cblcRecord || static_cast<size_t>(cblcRecord->offset) + cblcRecord->length > fontData.size()) {
+                throw FontFormatException("CBLC", "table is missing or out of bounds");
+            }
+            return createUpdatedFont(ByteSpan(fontData).subspan(cblcRecord->offset, cblcRecord->length).toVector(),
+                                     std::move(cbdt));
         }
     }
-    if (firstGlyph == 0xFFFF) firstGlyph = lastGlyph = 0;
 
-    appendUInt16(buf, firstGlyph);
-    appendUInt16(buf, lastGlyph);
-    appendUInt16(buf, strike.ppem);
-    appendUInt16(buf, strike.ppem);
-    buf.push_back(1); // bitDepth
-    appendUInt16(buf, 0); // flags
+    ByteWriter cblc;
+    ByteWriter cbdt;
 
-    appendUInt32(buf, 0x00000020); // offsetArray (placeholder)
-    appendUInt32(buf, 1);          // numSubtables
-    appendUInt32(buf, 0);          // colorRef
+    rebuildTables(cblc, cbdt);
 
-    rebuildIndexSubtable1(buf, strike, firstGlyph, lastGlyph);
+    return createUpdatedFont(cblc.take(), cbdt.take());
 }
 
-void CBDT_CBLC_Rebuilder::rebuildIndexSubtable1(
-    std::vector<uint8_t>& buf, const StrikeRecord& strike,
-    uint16_t firstGlyph, uint16_t lastGlyph
-) {
-    appendUInt16(buf, firstGlyph);
-    appendUInt16(buf, lastGlyph);
-    appendUInt16(buf, 1);   // indexFormat
-    appendUInt16(buf, 17);  // imageFormat = PNG(small metrics)
-    appendUInt32(buf, 0);   // imageDataOffsetArray offset placeholder
-
-    uint32_t imgDataOffset = 0;
-    size_t offsetArrayPos = buf.size();
-    for (uint16_t g = firstGlyph; g <= lastGlyph; ++g) {
-        if (std::find(removedGlyphs.begin(), removedGlyphs.end(), g) != removedGlyphs.end()) {
-            appendUInt32(buf, 0);
-            continue;
-        }
-        auto it = strike.glyphImages.find(g);
-        if (it != strike.glyphImages.end() && !it->second.data.empty()) {
-            appendUInt32(buf, imgDataOffset);
-            imgDataOffset += it->second.data.size();
-        } else {
-            appendUInt32(buf, 0);
+/* ───────────────────────────── CBLC + CBDT ───────────────────────────── */
+
+void CBDT_CBLC_Rebuilder::rebuildTables(ByteWriter& cblc, ByteWriter& cbdt) {
+    utils::ScopedPhase phase("rebuild");
+    std::vector<bool> removed;
+    for (uint16_t glyphID : removedGlyphs) {
+        if (glyphID >= removed.size()) removed.resize(glyphID + 1u, false);
+        removed[glyphID] = true;
+    }
+
+    // Образы почти всегда переносятся целиком - исходный размер CBDT хорошая оценка
+    std::vector<TableRecord> tables = parseTTFTables(fontData);
+    if (const TableRecord* cbdtRecord = findTable(tables, "CBDT")) cbdt.reserve(cbdtRecord->length);
+
+    cblc.writeUInt32(CBLC_CBDT_VERSION);
+    cblc.writeUInt32(static_cast<uint32_t>(strikes.size())); // numSizes
+    size_t recordOffset = cblc.size();
+    cblc.writeZeros(strikes.size() * BITMAP_SIZE_RECORD);
+    cbdt.writeUInt32(CBLC_CBDT_VERSION);
+
+    for (const auto& [id, strike] : strikes) {
+        std::vector<GlyphEntry> glyphs = collectGlyphs(strike, removed);
+        std::vector<IndexRun> runs = planIndexRuns(glyphs);
+
+        size_t arrayOffset = cblc.size();
+        cblc.writeZeros(runs.size() * INDEX_ARRAY_ENTRY);
+        for (size_t r = 0; r < runs.size(); ++r) {
+            writeIndexRun(cblc, cbdt, glyphs, runs[r], arrayOffset, arrayOffset + r * INDEX_ARRAY_ENTRY);
         }
+
+        // BitmapSize
+        uint8_t* record = cblc.data() + recordOffset;
+        storeUInt32(record, static_cast<uint32_t>(arrayOffset));                // indexSubTableArrayOffset
+        storeUInt32(record + 4, static_cast<uint32_t>(cblc.size() - arrayOffset)); // indexTablesSize
+        storeUInt32(record + 8, static_cast<uint32_t>(runs.size()));           // numberOfIndexSubTables
+        storeUInt32(record + 12, 0);                                           // colorRef
+        std::array<uint8_t, 12> hori = lineMetrics(strike, glyphs);
+        std::memcpy(record + 16, hori.data(), hori.size());
+        const std::array<uint8_t, 12>& vert = strike.hasLineMetrics ? strike.vert : hori;
+        std::memcpy(record + 28, vert.data(), vert.size());
+        storeUInt16(record + 40, glyphs.empty() ? 0 : glyphs.front().glyphID); // startGlyphIndex
+        storeUInt16(record + 42, glyphs.empty() ? 0 : glyphs.back().glyphID);  // endGlyphIndex
+        record[44] = static_cast<uint8_t>(strike.ppemX ? strike.ppemX : strike.ppem);
+        record[45] = static_cast<uint8_t>(strike.ppem);
+        record[46] = strike.bitDepth;
+        record[47] = strike.flags;
+        recordOffset += BITMAP_SIZE_RECORD;
     }
-    setUInt32(buf, offsetArrayPos - 4, static_cast<uint32_t>(offsetArrayPos - offsetArrayPos + 4));
 }
 
-/* ─────────────────────────────── CBDT ─────────────────────────────── */
+/* ───────────────────────────── IN-PLACE SLOTS ──────────────────────────── */
 
-void CBDT_CBLC_Rebuilder::rebuildCBDTTable(std::vector<uint8_t>& cbdt) {
-    appendUInt32(cbdt, 0x00020000); // version
+bool CBDT_CBLC_Rebuilder::rewriteSlots(std::vector<uint8_t>& cbdt) const {
+    if (!removedGlyphs.empty()) return false;
+    std::vector<TableRecord> tables = parseTTFTables(fontData);
+    const TableRecord* cbdtRecord = findTable(tables, "CBDT");
+    if (!cbdtRecord || !findTable(tables, "CBLC") ||
+        static_cast<size_t>(cbdtRecord->offset) + cbdtRecord->length > fontData.size()) {
+        return false;
+    }
+    ByteSpan source = ByteSpan(fontData).subspan(cbdtRecord->offset, cbdtRecord->length);
 
+    utils::ScopedPhase phase("rebuild");
+    cbdt.clear();
     for (const auto& [id, strike] : strikes) {
-        for (uint16_t g : strike.glyphIDs) {
-            if (std::find(removedGlyphs.begin(), removedGlyphs.end(), g) != removedGlyphs.end())
+        for (const auto& [glyphID, image] : strike.glyphImages) {
+            // Добавленный глиф: в CBLC для него нет места
+            if (image.length == 0 || static_cast<size_t>(image.offset) + image.length > source.size()) return false;
+            ByteSpan slot = source.subspan(image.offset, image.length);
+            if (image.data.size() == slot.size() && std::equal(image.data.begin(), image.data.end(), slot.begin())) {
                 continue;
-            auto it = strike.glyphImages.find(g);
-            if (it != strike.glyphImages.end())
-                cbdt.insert(cbdt.end(), it->second.data.begin(), it->second.data.end());
+            }
+
+            // Заменённый глиф - запись формата 17 (см. storeGlyphPNG); прежние метрики в CBLC и
+            // SbitLineMetrics остаются верными, только если метрики глифа те же
+            size_t sourceMetrics = image.sourceImageFormat == 17 ? SMALL_METRICS_SIZE :
+                                   image.sourceImageFormat == 18 ? BIG_METRICS_SIZE : 0;
+            if (image.imageFormat != 17 || sourceMetrics == 0 || image.data.size() < SMALL_METRICS_SIZE ||
+                slot.size() < sourceMetrics || !std::equal(slot.begin(), slot.begin() + SMALL_METRICS_SIZE,
+                                                           image.data.begin())) {
+                return false;
+            }
+            // В формате 18 на месте остаются и вертикальные метрики
+            size_t recordSize = sourceMetrics + image.data.size() - SMALL_METRICS_SIZE;
+            if (recordSize > slot.size()) return false;
+
+            if (cbdt.empty()) cbdt = source.toVector();
+            uint8_t* out = cbdt.data() + image.offset;
+            std::copy(image.data.begin() + SMALL_METRICS_SIZE, image.data.end(), out + sourceMetrics);
+            std::fill(out + recordSize, out + slot.size(), 0);
         }
     }
+    if (cbdt.empty()) cbdt = source.toVector();
+    return true;
 }
 
 /* ─────────────────────────────── FONT UPDATE ─────────────────────────────── */
 
-std::vector<uint8_t> CBDT_CBLC_Rebuilder::createUpdatedFont(
-    const std::vector<uint8_t>& newCBLCTable,
-    const std::vector<uint8_t>& newCBDTTable
+FontAssembler CBDT_CBLC_Rebuilder::createUpdatedFont(
+    std::vector<uint8_t>&& newCBLCTable,
+    std::vector<uint8_t>&& newCBDTTable
 ) {
     auto tables = parseTTFTables(fontData);
-    std::vector<uint8_t> newFont;
+    ByteSpan source(fontData);
 
-    const TTFHeader* header = reinterpret_cast<const TTFHeader*>(fontData.data());
-    uint16_t numTables = header->numTables;
-
-    appendUInt32(newFont, header->sfntVersion);
-    appendUInt16(newFont, numTables);
-    appendUInt16(newFont, header->searchRange);
-    appendUInt16(newFont, header->entrySelector);
-    appendUInt16(newFont, header->rangeShift);
-
-    size_t dirStart = newFont.size();
-    newFont.resize(dirStart + numTables * sizeof(TableRecord));
+    std::cout << "[Rebuilder] Created font with "
+              << newCBLCTable.size() << " bytes (CBLC) and "
+              << newCBDTTable.size() << " bytes (CBDT)\n";
 
-    size_t currentOffset = 12 + numTables * 16;
-    for (size_t i = 0; i < tables.size(); ++i) {
-        const TableRecord& t = tables[i];
+    // Остальные таблицы не копируются - сборщик ссылается на исходный буфер
+    FontAssembler assembler(source.readUInt32(0));
+    for (const TableRecord& t : tables) {
         std::string tag(t.tag, t.tag + 4);
-
-        std::vector<uint8_t> data;
         if (tag == "CBLC")
-            data = newCBLCTable;
+            assembler.addTable(tag, std::move(newCBLCTable));
         else if (tag == "CBDT")
-            data = newCBDTTable;
+            assembler.addTable(tag, std::move(newCBDTTable));
         else
-            data.assign(fontData.begin() + t.offset, fontData.begin() + t.offset + t.length);
-
-        while (data.size() % 4 != 0) data.push_back(0);
-        uint32_t checksum = calcTableChecksum(data);
-
-        // Write table record
-        setTag(newFont, dirStart + i * 16, tag);
-        setUInt32(newFont, dirStart + i * 16 + 4, checksum);
-        setUInt32(newFont, dirStart + i * 16 + 8, currentOffset);
-        setUInt32(newFont, dirStart + i * 16 + 12, data.size());
-
-        newFont.insert(newFont.end(), data.begin(), data.end());
-        currentOffset += data.size();
+            assembler.addTable(tag, source.subspan(t.offset, t.length), t.checksum);
     }
-
-    // Fix head checksum
-    const TableRecord* head = findTable(tables, "head");
-    if (head) {
-        size_t headOffset = head->offset;
-        setUInt32(newFont, headOffset + 8, 0);
-        uint32_t total = calcTableChecksum(newFont);
-        uint32_t adjust = 0xB1B0AFBA - total;
-        setUInt32(newFont, headOffset + 8, adjust);
-    }
-
-    std::cout << "[Rebuilder] Created font with "
-              << newCBLCTable.size() << " bytes (CBLC) and "
-              << newCBDTTable.size() << " bytes (CBDT)\n";
-
-    return newFont;
+    return assembler;
 }
 
 } // namespace fontmaster
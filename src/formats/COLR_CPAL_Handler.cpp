@@ -1,8 +1,10 @@
 #include "fontmaster/FontMaster.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/FileIO.h"
 #include "fontmaster/CMAPParser.h"
 #include "fontmaster/POSTParser.h"
 #include "fontmaster/MAXPParser.h"
+#include "fontmaster/COLRRenderer.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -17,6 +19,7 @@ class COLR_CPAL_Font : public Font {
 private:
     std::string filepath;
     std::vector<uint8_t> fontData;
+    utils::FileStamp sourceStamp;   // fontData совпадает с файлом filepath, пока отпечаток валиден
     std::map<std::string, GlyphInfo> glyphs;
     std::vector<std::string> removedGlyphs;
     
@@ -38,6 +41,17 @@ private:
     std::vector<BaseGlyph> baseGlyphs;
     std::vector<Palette> palettes;
     std::map<uint16_t, std::string> glyphNames;
+    std::unique_ptr<utils::COLRRenderer> renderer;
+    
+    // Базовые записи глифа с их местами в baseGlyphs и отметки об удалении
+    struct COLRGlyphEditState : GlyphEditState {
+        std::string glyphName;
+        uint16_t glyphID = 0;
+        std::vector<std::pair<size_t, BaseGlyph>> baseGlyphs;
+        bool hasInfo = false;
+        GlyphInfo info;
+        size_t removedCount = 0;
+    };
     
 public:
     COLR_CPAL_Font(const std::string& path) : filepath(path) {
@@ -56,6 +70,13 @@ public:
     
     void setFontData(const std::vector<uint8_t>& data) override {
         fontData = data;
+        sourceStamp = utils::FileStamp();
+        // Рендерер и разобранные слои ссылаются на старые данные
+        baseGlyphs.clear();
+        palettes.clear();
+        glyphNames.clear();
+        invalidateDecodedGlyphs();
+        parseFont();
     }
     
     FontFormat getFormat() const override { return FontFormat::COLR_CPAL; }
@@ -63,13 +84,12 @@ public:
     bool save(const std::string& outputPath) override {
         try {
             // TODO: Реализовать пересборку COLR/CPAL таблиц
-            std::ofstream file(outputPath, std::ios::binary);
-            if (!file) {
-                throw FontSaveException(outputPath, "Cannot create output file");
+            // Пока шрифт не менялся, файл копируется ядром; запись атомарная
+            utils::SourceFile source{filepath, sourceStamp, fontData};
+            if (!utils::writeFileAtomic(outputPath, {utils::ByteSpan(fontData)}, &source)) {
+                throw FontSaveException(outputPath, "Cannot write output file");
             }
-            
-            file.write(reinterpret_cast<const char*>(fontData.data()), fontData.size());
-            return file.good();
+            return true;
         } catch (const std::exception& e) {
             throw FontSaveException(outputPath, std::string("Save failed: ") + e.what());
         }
@@ -97,6 +117,7 @@ public:
             }
             
             removedGlyphs.push_back(glyphName);
+            invalidateDecodedGlyphs();
             std::cout << "COLR_CPAL_Font: Removed glyph: " << glyphName << " (ID: " << glyphID << ")" << std::endl;
             return true;
             
@@ -123,7 +144,7 @@ public:
     }
     
     bool replaceGlyphImage(const std::string& glyphName,
-                          const std::vector<uint8_t>& newImage) override {
+                          const std::vector<uint8_t>& /*newImage*/) override {
         try {
             uint16_t glyphID = findGlyphID(glyphName);
             if (glyphID == 0) {
@@ -145,6 +166,47 @@ public:
         }
     }
     
+    std::unique_ptr<GlyphEditState> saveGlyphEditState(const std::string& glyphName) const override {
+        auto state = std::make_unique<COLRGlyphEditState>();
+        state->glyphName = glyphName;
+        state->glyphID = findGlyphID(glyphName);
+        for (size_t i = 0; i < baseGlyphs.size(); ++i) {
+            if (state->glyphID != 0 && baseGlyphs[i].glyphID == state->glyphID) {
+                state->baseGlyphs.emplace_back(i, baseGlyphs[i]);
+            }
+        }
+        auto it = glyphs.find(glyphName);
+        if (it != glyphs.end()) {
+            state->hasInfo = true;
+            state->info = it->second;
+        }
+        state->removedCount = static_cast<size_t>(std::count(removedGlyphs.begin(), removedGlyphs.end(), glyphName));
+        return state;
+    }
+    
+    void restoreGlyphEditState(const GlyphEditState& editState) override {
+        const auto& state = static_cast<const COLRGlyphEditState&>(editState);
+        if (state.glyphID != 0) {
+            uint16_t glyphID = state.glyphID;
+            baseGlyphs.erase(
+                std::remove_if(baseGlyphs.begin(), baseGlyphs.end(),
+                    [glyphID](const BaseGlyph& bg) { return bg.glyphID == glyphID; }),
+                baseGlyphs.end()
+            );
+            // Места возрастают, поэтому каждая запись встаёт туда, где была
+            for (const auto& [index, baseGlyph] : state.baseGlyphs) {
+                baseGlyphs.insert(baseGlyphs.begin() + static_cast<std::ptrdiff_t>(std::min(index, baseGlyphs.size())),
+                                  baseGlyph);
+            }
+        }
+        if (state.hasInfo) glyphs[state.glyphName] = state.info;
+        else glyphs.erase(state.glyphName);
+        removedGlyphs.erase(std::remove(removedGlyphs.begin(), removedGlyphs.end(), state.glyphName),
+                            removedGlyphs.end());
+        removedGlyphs.insert(removedGlyphs.end(), state.removedCount, state.glyphName);
+        invalidateDecodedGlyphs();
+    }
+    
     std::vector<GlyphInfo> listGlyphs() const override {
         std::vector<GlyphInfo> result;
         
@@ -160,6 +222,7 @@ public:
                 
                 GlyphInfo info;
                 info.name = glyphName;
+                info.glyph_id = baseGlyph.glyphID;
                 info.unicode = getUnicodeFromGlyphID(baseGlyph.glyphID);
                 info.format = "colr";
                 info.data_size = calculateGlyphDataSize(baseGlyph);
@@ -198,6 +261,7 @@ public:
             
             GlyphInfo info;
             info.name = glyphName;
+            info.glyph_id = glyphID;
             info.unicode = getUnicodeFromGlyphID(glyphID);
             info.format = "colr";
             info.data_size = calculateGlyphDataSize(*it);
@@ -214,6 +278,22 @@ public:
         }
     }
     
+    /**
+     * Отрисовать цветной глиф в RGBA (straight alpha).
+     * pixelSize - размер em в пикселях, paletteIndex - палитра CPAL.
+     */
+    RGBAImage renderGlyph(const std::string& glyphName, uint16_t pixelSize, uint16_t paletteIndex = 0) const {
+        uint16_t glyphID = findGlyphID(glyphName);
+        if (glyphID == 0 ||
+            std::find(removedGlyphs.begin(), removedGlyphs.end(), glyphName) != removedGlyphs.end()) {
+            throw GlyphNotFoundException(glyphName);
+        }
+        if (!renderer->canRenderOutlines()) {
+            throw FontFormatException("COLR/CPAL", "glyf outlines are required for rendering");
+        }
+        return renderer->render(glyphID, pixelSize, paletteIndex);
+    }
+    
     std::string findGlyphName(uint32_t unicode) const override {
         try {
             uint16_t glyphID = findGlyphIDByUnicode(unicode);
@@ -229,19 +309,19 @@ public:
         }
     }
     
+protected:
+    // strike для COLR - размер em в пикселях, палитра по умолчанию
+    RGBAImage decodeGlyphImage(uint16_t glyphID, uint16_t strike) const override {
+        // Страйков у COLR нет: 0 дал бы пустое изображение, которое осело бы в кэше
+        if (strike == 0) {
+            throw FontFormatException("COLR/CPAL", "pixel size must be positive");
+        }
+        return renderGlyph(getGlyphName(glyphID), strike);
+    }
+    
 private:
     void loadFontData() {
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            throw FontLoadException(filepath, "Cannot open file");
-        }
-        
-        file.seekg(0, std::ios::end);
-        size_t size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        fontData.resize(size);
-        if (!file.read(reinterpret_cast<char*>(fontData.data()), size)) {
+        if (!utils::readFile(filepath, fontData, &sourceStamp)) {
             throw FontLoadException(filepath, "Cannot read file data");
         }
     }
@@ -253,11 +333,17 @@ private:
             throw FontFormatException("COLR/CPAL", "Required tables not found");
         }
         
+        try {
+            renderer.reset(new utils::COLRRenderer(fontData));
+        } catch (const std::exception& e) {
+            throw FontFormatException("COLR/CPAL", e.what());
+        }
+        
         // Парсим COLR таблицу
-        parseCOLRTable(tables);
+        parseCOLRTable();
         
         // Парсим CPAL таблицу
-        parseCPALTable(tables);
+        parseCPALTable();
         
         // Получаем имена глифов
         parseGlyphNames(tables);
@@ -266,55 +352,23 @@ private:
                   << palettes.size() << " palettes, " << glyphNames.size() << " glyph names" << std::endl;
     }
     
-    void parseCOLRTable(const std::vector<utils::TableRecord>& tables) {
-        const utils::TableRecord* colrRec = utils::findTable(tables, "COLR");
-        if (!colrRec) return;
-        
-        const uint8_t* data = fontData.data() + colrRec->offset;
-        
-        // COLR header
-        uint16_t version = readUInt16(data);
-        uint16_t numBaseGlyphRecords = readUInt16(data + 2);
-        
-        // Парсим базовые глифы
-        for (uint16_t i = 0; i < numBaseGlyphRecords; ++i) {
-            const uint8_t* record = data + 4 + i * 6;
+    void parseCOLRTable() {
+        // Смещения заголовка COLR разбирает рендерер; здесь только копия слоёв для редактирования
+        for (const auto& record : renderer->getBaseGlyphs()) {
             BaseGlyph baseGlyph;
-            baseGlyph.glyphID = readUInt16(record);
-            uint16_t firstLayerIndex = readUInt16(record + 2);
-            uint16_t numLayers = readUInt16(record + 4);
-            
-            // Парсим слои
-            for (uint16_t j = 0; j < numLayers; ++j) {
-                const uint8_t* layer = data + 4 + numBaseGlyphRecords * 6 + (firstLayerIndex + j) * 4;
-                ColorLayer colorLayer;
-                colorLayer.glyphID = readUInt16(layer);
-                colorLayer.paletteIndex = readUInt16(layer + 2);
-                baseGlyph.layers.push_back(colorLayer);
+            baseGlyph.glyphID = record.glyphID;
+            for (const auto& layer : renderer->getLayerRecords(record.glyphID)) {
+                baseGlyph.layers.push_back(ColorLayer{layer.glyphID, layer.paletteIndex});
             }
-            
             baseGlyphs.push_back(baseGlyph);
         }
     }
     
-    void parseCPALTable(const std::vector<utils::TableRecord>& tables) {
-        const utils::TableRecord* cpalRec = utils::findTable(tables, "CPAL");
-        if (!cpalRec) return;
-        
-        const uint8_t* data = fontData.data() + cpalRec->offset;
-        
-        // CPAL header
-        uint16_t version = readUInt16(data);
-        uint16_t numPaletteEntries = readUInt16(data + 2);
-        uint16_t numPalettes = readUInt16(data + 4);
-        
-        // Парсим палитры
-        for (uint16_t i = 0; i < numPalettes; ++i) {
+    void parseCPALTable() {
+        for (uint16_t i = 0; i < renderer->getPaletteCount(); ++i) {
             Palette palette;
-            for (uint16_t j = 0; j < numPaletteEntries; ++j) {
-                const uint8_t* color = data + 8 + i * numPaletteEntries * 4 + j * 4;
-                uint32_t colorValue = readUInt32(color);
-                palette.colors.push_back(colorValue);
+            for (uint16_t j = 0; j < renderer->getPaletteSize(); ++j) {
+                palette.colors.push_back(renderer->getPaletteColor(i, j));
             }
             palettes.push_back(palette);
         }
@@ -342,17 +396,6 @@ private:
     }
     
     // Вспомогательные методы
-    uint16_t readUInt16(const uint8_t* data) const {
-        return (static_cast<uint16_t>(data[0]) << 8) | data[1];
-    }
-    
-    uint32_t readUInt32(const uint8_t* data) const {
-        return (static_cast<uint32_t>(data[0]) << 24) | 
-               (static_cast<uint32_t>(data[1]) << 16) | 
-               (static_cast<uint32_t>(data[2]) << 8) | 
-               data[3];
-    }
-    
     std::string getGlyphName(uint16_t glyphID) const {
         auto it = glyphNames.find(glyphID);
         if (it != glyphNames.end() && !it->second.empty()) {
@@ -434,18 +477,8 @@ private:
     }
     
     size_t calculateGlyphDataSize(const BaseGlyph& baseGlyph) const {
-        // Расчет размера данных для цветного глифа
-        size_t size = sizeof(BaseGlyph);
-        size += baseGlyph.layers.size() * sizeof(ColorLayer);
-        
-        // Добавляем размер информации о цветах из палитры
-        for (const auto& layer : baseGlyph.layers) {
-            if (layer.paletteIndex < palettes.size()) {
-                size += palettes[layer.paletteIndex].colors.size() * sizeof(uint32_t);
-            }
-        }
-        
-        return size;
+        // Байты глифа в таблице COLR: BaseGlyphRecord + LayerRecord на каждый слой
+        return 6 + baseGlyph.layers.size() * 4;
     }
 };
 
@@ -479,12 +512,9 @@ public:
     FontFormat getFormat() const override { return FontFormat::COLR_CPAL; }
 };
 
-// Регистрация обработчика
-static bool registerCOLRHandler() {
-    // Автоматическая регистрация через static initialization
-    return true;
+// Вызывается из реестра обработчиков при первой загрузке шрифта
+void registerCOLRHandler() {
+    registerFontFormatHandler(std::make_unique<COLR_CPAL_Handler>());
 }
 
-static bool colrHandlerRegistered = registerCOLRHandler();
-
 } // namespace fontmaster
@@ -1,14 +1,22 @@
 #include "fontmaster/FontMaster.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/FileIO.h"
 #include "fontmaster/CMAPParser.h"
 #include "fontmaster/POSTParser.h"
 #include "fontmaster/MAXPParser.h"
+#include "fontmaster/PNGDecoder.h"
+#include "fontmaster/ImageHeader.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/PhaseTimer.h"
+#include "fontmaster/ThreadPool.h"
 #include <fstream>
 #include <map>
 #include <iostream>
 #include <memory>
 #include <algorithm>
 #include <cstring>
+#include <set>
 
 namespace fontmaster {
 
@@ -42,101 +50,62 @@ public:
     FontFormat getFormat() const override { return FontFormat::SBIX; }
 };
 
-#pragma pack(push, 1)
-struct SBIXHeader {
-    uint16_t version;
-    uint16_t flags;
-    uint32_t numStrikes;
-};
-
-struct StrikeOffset {
-    uint32_t offset;
-    uint32_t length;
-};
-
 struct StrikeHeader {
     uint16_t ppem;
     uint16_t resolution;
-    uint32_t glyphDataOffset;
 };
 
-struct GlyphDataOffset {
-    uint32_t offset;
-};
+namespace {
 
-struct GlyphDataHeader {
-    int16_t originOffsetX;
-    int16_t originOffsetY;
-    char graphicType[4];
-    uint32_t dataLength;
-};
-#pragma pack(pop)
+const size_t SBIX_HEADER_SIZE = 8;          // version, flags, numStrikes
+const size_t STRIKE_HEADER_SIZE = 4;        // ppem, ppi
+const size_t GLYPH_RECORD_HEADER_SIZE = 8;  // originOffsetX, originOffsetY, graphicType
 
-// Вспомогательный класс TTFWriter
-class TTFWriter {
-private:
-    std::vector<uint8_t> data;
-    size_t pos;
+// graphicType по формату из заголовка изображения; нераспознанное пишется как PNG
+const char* graphicTypeOf(const std::string& format) {
+    if (format == "jpg") return "jpg ";
+    if (format == "tiff") return "tiff";
+    return "png ";
+}
 
-public:
-    TTFWriter() : pos(0) {}
-    
-    void writeUInt8(uint8_t value) {
-        if (pos >= data.size()) data.resize(pos + 1);
-        data[pos++] = value;
-    }
-    
-    void writeInt16(int16_t value) {
-        writeUInt16(static_cast<uint16_t>(value));
-    }
-    
-    void writeUInt16(uint16_t value) {
-        if (pos + 2 > data.size()) data.resize(pos + 2);
-        data[pos] = (value >> 8) & 0xFF;
-        data[pos + 1] = value & 0xFF;
-        pos += 2;
-    }
-    
-    void writeUInt32(uint32_t value) {
-        if (pos + 4 > data.size()) data.resize(pos + 4);
-        data[pos] = (value >> 24) & 0xFF;
-        data[pos + 1] = (value >> 16) & 0xFF;
-        data[pos + 2] = (value >> 8) & 0xFF;
-        data[pos + 3] = value & 0xFF;
-        pos += 4;
-    }
-    
-    void writeBytes(const std::vector<uint8_t>& bytes) {
-        if (pos + bytes.size() > data.size()) data.resize(pos + bytes.size());
-        std::copy(bytes.begin(), bytes.end(), data.begin() + pos);
-        pos += bytes.size();
-    }
-    
-    void seek(size_t newPos) {
-        if (newPos > data.size()) data.resize(newPos);
-        pos = newPos;
-    }
-    
-    size_t getPosition() const { return pos; }
-    const std::vector<uint8_t>& getData() const { return data; }
+// Изображение глифа, его заголовки по страйкам и отметки правок
+struct SBIXGlyphEditState : Font::GlyphEditState {
+    std::string glyphName;
+    bool hasImage = false;
+    std::vector<uint8_t> image;
+    std::map<uint16_t, utils::ImageHeader> headers;   // страйк -> заголовок
+    bool removed = false;
+    bool replaced = false;
 };
 
+} // namespace
+
 class SBIX_Font : public Font {
 private:
     std::string filepath;
     std::vector<uint8_t> fontData;
+    utils::FileStamp sourceStamp;   // fontData совпадает с файлом filepath, пока отпечаток валиден
     std::map<std::string, std::vector<uint8_t>> glyphImages;
     std::map<uint32_t, std::string> unicodeToGlyphName;
     std::map<std::string, uint32_t> glyphNameToUnicode;
-    std::vector<std::string> removedGlyphs;
+    std::set<std::string> removedGlyphs;
+    std::set<std::string> replacedGlyphs;    // и добавленные: запись пишется во все страйки
+    
+    // Заголовки изображений по (страйк, глиф): в каждом страйке своё изображение и свой ppem.
+    // Считаются один раз при разборе и замене
+    std::map<std::pair<uint16_t, std::string>, utils::ImageHeader> imageMeta;
     
     // SBIX специфичные данные
     std::vector<StrikeHeader> strikes;
-    const utils::TableRecord* sbixTableRecord;
+    uint32_t sbixOffset = 0;
+    uint32_t sbixLength = 0;
     uint16_t numGlyphs;
+    // Имена глифов из post разбираются один раз; по ним же ищется ID
+    std::vector<std::string> glyphNames;
+    std::map<std::string, uint16_t> glyphIDs;
     
 public:
-    SBIX_Font(const std::string& path) : filepath(path), sbixTableRecord(nullptr), numGlyphs(0) {
+    SBIX_Font(const std::string& path) : filepath(path), numGlyphs(0) {
         loadFontData();
         parseFont();
     }
@@ -153,21 +122,13 @@ public:
     
     void setFontData(const std::vector<uint8_t>& data) override {
         fontData = data;
+        sourceStamp = utils::FileStamp();
+        invalidateDecodedGlyphs();
     }
     
 private:
     void loadFontData() {
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            throw FontLoadException(filepath, "Cannot open file");
-        }
-        
-        file.seekg(0, std::ios::end);
-        size_t size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        fontData.resize(size);
-        if (!file.read(reinterpret_cast<char*>(fontData.data()), size)) {
+        if (!utils::readFile(filepath, fontData, &sourceStamp)) {
             throw FontLoadException(filepath, "Cannot read file data");
         }
     }
@@ -178,10 +139,12 @@ private:
             throw FontFormatException("SBIX", "sbix table not found");
         }
         
-        sbixTableRecord = utils::findTable(tables, "sbix");
-        if (!sbixTableRecord) {
+        const utils::TableRecord* sbixRecord = utils::findTable(tables, "sbix");
+        if (!sbixRecord || static_cast<size_t>(sbixRecord->offset) + sbixRecord->length > fontData.size()) {
             throw FontFormatException("SBIX", "sbix table record not found");
         }
+        sbixOffset = sbixRecord->offset;
+        sbixLength = sbixRecord->length;
         
         // Получаем количество глифов из maxp таблицы
         const utils::TableRecord* maxpTable = utils::findTable(tables, "maxp");
@@ -197,118 +160,125 @@ private:
             throw FontFormatException("SBIX", "Cannot determine number of glyphs");
         }
         
+        loadGlyphNames();
         parseSBIXTable();
         buildGlyphMappings();
     }
     
-    void parseSBIXTable() {
-        uint32_t sbixOffset = sbixTableRecord->offset;
-        utils::TTFReader reader(fontData);
-        reader.seek(sbixOffset);
-        
-        // Чтение заголовка SBIX
-        SBIXHeader header;
-        header.version = reader.readUInt16();
-        header.flags = reader.readUInt16();
-        header.numStrikes = reader.readUInt32();
-        
-        std::cout << "SBIX Table: version=" << header.version 
-                  << ", flags=" << header.flags 
-                  << ", strikes=" << header.numStrikes << std::endl;
-        
-        // Чтение смещений до strikes
-        std::vector<StrikeOffset> strikeOffsets;
-        for (uint32_t i = 0; i < header.numStrikes; ++i) {
-            StrikeOffset so;
-            so.offset = reader.readUInt32();
-            so.length = reader.readUInt32();
-            strikeOffsets.push_back(so);
-        }
-        
-        // Парсинг каждого strike
-        for (uint32_t i = 0; i < header.numStrikes; ++i) {
-            parseStrike(sbixOffset + strikeOffsets[i].offset, i);
+    utils::ByteSpan sbixTable() const {
+        return utils::ByteSpan(fontData).subspan(sbixOffset, sbixLength);
+    }
+    
+    // numStrikes из файла: массив strikeOffsets должен поместиться в таблицу до любых выделений
+    static uint32_t strikeCount(utils::ByteSpan table) {
+        uint32_t numStrikes = table.readUInt32(4);
+        if (numStrikes > (table.size() - SBIX_HEADER_SIZE) / 4) {
+            throw FontFormatException("SBIX", "sbix strike count " + std::to_string(numStrikes) +
+                                              " does not fit the table");
         }
+        return numStrikes;
     }
     
-    void parseStrike(uint32_t strikeOffset, uint32_t strikeIndex) {
-        utils::TTFReader reader(fontData);
-        reader.seek(strikeOffset);
-        
-        StrikeHeader strike;
-        strike.ppem = reader.readUInt16();
-        strike.resolution = reader.readUInt16();
-        strike.glyphDataOffset = reader.readUInt32();
-        
-        strikes.push_back(strike);
-        
-        std::cout << "Strike " << strikeIndex << ": ppem=" << strike.ppem 
-                  << ", resolution=" << strike.resolution << std::endl;
+    // Смещение записи глифа от начала страйка: glyphDataOffsets[numGlyphs + 1] после ppem и ppi
+    static uint32_t glyphDataOffset(utils::ByteSpan strike, uint32_t glyphIndex) {
+        return strike.readUInt32(STRIKE_HEADER_SIZE + glyphIndex * 4);
+    }
+    
+    // Изображение глифа в своём страйке - вид на fontData, заголовок уже прочитан
+    struct ParsedGlyph {
+        uint16_t glyphIndex = 0;
+        char graphicType[4] = {};
+        utils::ByteSpan image;
+        utils::ImageHeader header;
+    };
+    
+    struct ParsedStrike {
+        StrikeHeader header = {};
+        std::vector<ParsedGlyph> glyphs;
+    };
+    
+    void parseSBIXTable() {
+        utils::ByteSpan table = sbixTable();
+        uint16_t version = table.readUInt16(0);
+        uint16_t flags = table.readUInt16(2);
+        uint32_t numStrikes = strikeCount(table);
+        
+        std::cout << "SBIX Table: version=" << version 
+                  << ", flags=" << flags 
+                  << ", strikes=" << numStrikes << std::endl;
+        
+        // Страйки независимы и разбираются параллельно; strikeOffsets[numStrikes] от начала таблицы
+        std::vector<ParsedStrike> parsed(numStrikes);
+        {
+            utils::ScopedPhase phase("strikes");
+            utils::ThreadPool::shared().parallelFor(0, numStrikes, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    parsed[i] = parseStrike(table.subspan(table.readUInt32(SBIX_HEADER_SIZE + i * 4)));
+                }
+            });
+        }
         
-        // Чтение смещений глифов
-        std::vector<GlyphDataOffset> glyphOffsets;
-        for (uint16_t i = 0; i < numGlyphs; ++i) {
-            GlyphDataOffset go;
-            go.offset = reader.readUInt32();
-            glyphOffsets.push_back(go);
+        for (uint32_t i = 0; i < numStrikes; ++i) {
+            strikes.push_back(parsed[i].header);
+            std::cout << "Strike " << i << ": ppem=" << parsed[i].header.ppem 
+                      << ", resolution=" << parsed[i].header.resolution << std::endl;
+        }
+        if (numStrikes > 0) { // Выводим только для первого strike
+            for (const ParsedGlyph& glyph : parsed[0].glyphs) {
+                std::cout << "Glyph " << getGlyphName(glyph.glyphIndex) << " [" << glyph.glyphIndex << "]: " 
+                          << std::string(glyph.graphicType, 4) << " (" << glyph.image.size() << " bytes)" << std::endl;
+            }
         }
         
-        // Парсинг данных глифов
-        for (uint16_t glyphIndex = 0; glyphIndex < numGlyphs; ++glyphIndex) {
-            if (glyphOffsets[glyphIndex].offset == 0) {
-                continue; // Нет данных для этого глифа
+        // Изображение глифа берётся из последнего страйка, где оно есть; копируется только оно.
+        // Заголовки запоминаются для всех страйков
+        utils::ScopedPhase phase("images");
+        for (uint32_t i = numStrikes; i-- > 0;) {
+            for (const ParsedGlyph& glyph : parsed[i].glyphs) {
+                std::string glyphName = getGlyphName(glyph.glyphIndex);
+                glyphImages.emplace(glyphName, glyph.image.toVector());
+                imageMeta[{static_cast<uint16_t>(i), glyphName}] = glyph.header;
             }
-            
-            uint32_t glyphDataOffset = strikeOffset + glyphOffsets[glyphIndex].offset;
-            parseGlyphData(glyphDataOffset, glyphIndex, strikeIndex);
         }
     }
     
-    void parseGlyphData(uint32_t glyphDataOffset, uint16_t glyphIndex, uint32_t strikeIndex) {
-        utils::TTFReader reader(fontData);
-        reader.seek(glyphDataOffset);
-        
-        GlyphDataHeader glyphHeader;
-        glyphHeader.originOffsetX = reader.readInt16();
-        glyphHeader.originOffsetY = reader.readInt16();
-        
-        // Чтение graphicType
-        auto graphicTypeBytes = reader.readBytes(4);
-        std::memcpy(glyphHeader.graphicType, graphicTypeBytes.data(), 4);
-        
-        glyphHeader.dataLength = reader.readUInt32();
-        
-        // Чтение данных изображения
-        auto imageData = reader.readBytes(glyphHeader.dataLength);
+    // Вызывается из потоков пула: только читает fontData
+    ParsedStrike parseStrike(utils::ByteSpan strikeData) const {
+        ParsedStrike strike;
+        strike.header.ppem = strikeData.readUInt16(0);
+        strike.header.resolution = strikeData.readUInt16(2);
         
-        // Получаем имя глифа
-        std::string glyphName = getGlyphName(glyphIndex);
-        if (!glyphName.empty()) {
-            glyphImages[glyphName] = imageData;
-            
-            // Добавляем информацию о формате
-            std::string format(glyphHeader.graphicType, 4);
-            if (strikeIndex == 0) { // Выводим только для первого strike
-                std::cout << "Glyph " << glyphName << " [" << glyphIndex << "]: " 
-                          << format << " (" << imageData.size() << " bytes)" << std::endl;
+        // Длина записи - разность соседних смещений; пустая запись - глифа в страйке нет
+        for (uint16_t glyphIndex = 0; glyphIndex < numGlyphs; ++glyphIndex) {
+            uint32_t start = glyphDataOffset(strikeData, glyphIndex);
+            uint32_t end = glyphDataOffset(strikeData, glyphIndex + 1u);
+            if (end < start + GLYPH_RECORD_HEADER_SIZE) {
+                continue;
             }
+            utils::ByteSpan record = strikeData.subspan(start, end - start);
+            // 'dupe' хранит ID другого глифа, а не изображение
+            if (std::memcmp(record.data() + 4, "dupe", 4) == 0) {
+                continue;
+            }
+            ParsedGlyph glyph;
+            glyph.glyphIndex = glyphIndex;
+            std::memcpy(glyph.graphicType, record.data() + 4, 4);
+            glyph.image = record.subspan(GLYPH_RECORD_HEADER_SIZE);
+            glyph.header = utils::probeImageHeader(glyph.image);
+            strike.glyphs.push_back(glyph);
         }
+        return strike;
     }
     
-    std::string getGlyphName(uint16_t glyphIndex) {
-        // Пытаемся получить имя из post таблицы
+    void loadGlyphNames() {
+        std::map<uint16_t, std::string> postNames;
         auto tables = utils::parseTTFTables(fontData);
         const utils::TableRecord* postTable = utils::findTable(tables, "post");
-        
         if (postTable) {
             try {
                 utils::POSTParser postParser(fontData, postTable->offset, numGlyphs);
                 if (postParser.parse()) {
-                    auto glyphNames = postParser.getGlyphNames();
-                    auto it = glyphNames.find(glyphIndex);
-                    if (it != glyphNames.end()) {
-                        return it->second;
-                    }
+                    postNames = postParser.getGlyphNames();
                 }
             } catch (const std::exception& e) {
                 std::cerr << "Error parsing POST table: " << e.what() << std::endl;
@@ -316,6 +286,18 @@ private:
         }
         
         // Если нет имени в post, генерируем по умолчанию
+        glyphNames.resize(numGlyphs);
+        for (uint16_t glyphIndex = 0; glyphIndex < numGlyphs; ++glyphIndex) {
+            auto it = postNames.find(glyphIndex);
+            glyphNames[glyphIndex] = it != postNames.end() ? it->second : "glyph" + std::to_string(glyphIndex);
+            glyphIDs.emplace(glyphNames[glyphIndex], glyphIndex);
+        }
+    }
+    
+    std::string getGlyphName(uint16_t glyphIndex) const {
+        if (glyphIndex < glyphNames.size()) {
+            return glyphNames[glyphIndex];
+        }
         return "glyph" + std::to_string(glyphIndex);
     }
     
@@ -326,14 +308,14 @@ private:
         
         if (cmapTable) {
             try {
-                utils::CMAPParser cmapParser(fontData);
+                utils::CMAPParser cmapParser(
+                    utils::ByteSpan(fontData).subspan(cmapTable->offset, cmapTable->length).toVector());
                 cmapParser.parse();
                 
                 // Строим маппинг Unicode -> Glyph Name
-                for (uint16_t glyphIndex = 0; glyphIndex < numGlyphs; ++glyphIndex) {
+                for (const auto& [glyphIndex, charCodes] : cmapParser.getGlyphToCharMap()) {
+                    if (glyphIndex >= numGlyphs) continue;
                     std::string glyphName = getGlyphName(glyphIndex);
-                    auto charCodes = cmapParser.getCharCodes(glyphIndex);
-                    
                     for (uint32_t charCode : charCodes) {
                         unicodeToGlyphName[charCode] = glyphName;
                         glyphNameToUnicode[glyphName] = charCode;
@@ -351,341 +333,258 @@ private:
 
     // ==================== МЕТОДЫ ПЕРЕСБОРКИ SBIX ТАБЛИЦЫ ====================
     
-    void rebuildSBIXTable(std::vector<uint8_t>& outputData) {
-        auto tables = utils::parseTTFTables(outputData);
-        const utils::TableRecord* sbixTableRec = utils::findTable(tables, "sbix");
-        if (!sbixTableRec) {
-            throw FontSaveException(filepath, "SBIX table not found during rebuild");
-        }
-
-        uint32_t sbixOffset = sbixTableRec->offset;
-        utils::TTFReader reader(outputData);
-        reader.seek(sbixOffset);
-
-        // Читаем оригинальный заголовок SBIX
-        SBIXHeader header;
-        header.version = reader.readUInt16();
-        header.flags = reader.readUInt16();
-        header.numStrikes = reader.readUInt32();
-
-        // Читаем оригинальные смещения strikes
-        std::vector<StrikeOffset> originalStrikeOffsets;
-        for (uint32_t i = 0; i < header.numStrikes; ++i) {
-            StrikeOffset so;
-            so.offset = reader.readUInt32();
-            so.length = reader.readUInt32();
-            originalStrikeOffsets.push_back(so);
-        }
-
-        // Собираем новые данные для SBIX таблицы
-        TTFWriter writer;
-
-        // Записываем заголовок
-        writer.writeUInt16(header.version);
-        writer.writeUInt16(header.flags);
-        writer.writeUInt32(header.numStrikes);
-
-        // Резервируем место для strike offsets (будем заполнять позже)
-        size_t strikeOffsetsPos = writer.getPosition();
-        for (uint32_t i = 0; i < header.numStrikes; ++i) {
-            writer.writeUInt32(0); // offset - заполним позже
-            writer.writeUInt32(0); // length - заполним позже
-        }
-
-        // Обрабатываем каждый strike
-        std::vector<StrikeOffset> newStrikeOffsets;
-        for (uint32_t strikeIndex = 0; strikeIndex < header.numStrikes; ++strikeIndex) {
-            uint32_t strikeStartPos = writer.getPosition();
-            
-            // Перестраиваем strike
-            uint32_t originalStrikeOffset = sbixOffset + originalStrikeOffsets[strikeIndex].offset;
-            rebuildStrike(outputData, originalStrikeOffset, strikeIndex, writer);
-            
-            uint32_t strikeLength = writer.getPosition() - strikeStartPos;
-            
-            StrikeOffset newSO;
-            newSO.offset = strikeStartPos;
-            newSO.length = strikeLength;
-            newStrikeOffsets.push_back(newSO);
-        }
-
-        // Обновляем смещения strikes в заголовке
-        size_t currentPos = writer.getPosition();
-        writer.seek(strikeOffsetsPos);
-        for (const auto& strikeOffset : newStrikeOffsets) {
-            writer.writeUInt32(strikeOffset.offset);
-            writer.writeUInt32(strikeOffset.length);
-        }
-        writer.seek(currentPos);
-
-        // Заменяем SBIX таблицу в выходных данных
-        replaceTable(outputData, "sbix", writer.getData());
-    }
-
-    void rebuildStrike(std::vector<uint8_t>& outputData, uint32_t strikeOffset, 
-                       uint32_t strikeIndex, TTFWriter& writer) {
-        utils::TTFReader reader(outputData);
-        reader.seek(strikeOffset);
-
-        // Читаем заголовок strike
-        StrikeHeader strikeHeader;
-        strikeHeader.ppem = reader.readUInt16();
-        strikeHeader.resolution = reader.readUInt16();
-        strikeHeader.glyphDataOffset = reader.readUInt32();
-
-        // Записываем заголовок strike
-        writer.writeUInt16(strikeHeader.ppem);
-        writer.writeUInt16(strikeHeader.resolution);
-        
-        // Резервируем место для glyphDataOffset (заполним позже)
-        size_t glyphDataOffsetPos = writer.getPosition();
-        writer.writeUInt32(0);
-
-        // Получаем количество глифов
-        auto tables = utils::parseTTFTables(outputData);
-        const utils::TableRecord* maxpTable = utils::findTable(tables, "maxp");
-        if (!maxpTable) return;
-        
-        uint16_t numGlyphsInStrike = numGlyphs;
-
-        // Резервируем место для смещений глифов
-        size_t glyphOffsetsPos = writer.getPosition();
-        for (uint16_t i = 0; i < numGlyphsInStrike; ++i) {
-            writer.writeUInt32(0);
-        }
-
-        // Обрабатываем данные глифов
-        std::vector<uint32_t> newGlyphOffsets;
-        uint32_t glyphDataStart = writer.getPosition();
-        
-        for (uint16_t glyphIndex = 0; glyphIndex < numGlyphsInStrike; ++glyphIndex) {
-            std::string glyphName = getGlyphName(glyphIndex);
-            
-            // Проверяем, не удален ли глиф
-            if (std::find(removedGlyphs.begin(), removedGlyphs.end(), glyphName) != removedGlyphs.end()) {
-                newGlyphOffsets.push_back(0); // Глиф удален
-                continue;
+    // Новое изображение глифа и его graphicType
+    struct Replacement {
+        const std::vector<uint8_t>* image = nullptr;
+        const char* graphicType = nullptr;
+    };
+    
+    // Исходный страйк и размеры записей глифов в новом
+    struct StrikeLayout {
+        utils::ByteSpan source;
+        std::vector<uint32_t> recordSizes;
+        size_t size = 0;
+    };
+    
+    /**
+     * Новая sbix за линейное время: состояние глифов собирается по ID один раз, размер
+     * каждого страйка известен заранее из массивов смещений, подряд идущие нетронутые
+     * записи копируются одним блоком.
+     * keepSlots - заменённый PNG, который не длиннее прежней записи, пишется на её место
+     * с нулями после IEND (декодеры PNG их не читают): раскладка таблицы не меняется,
+     * и при сохранении на месте переписываются только эти записи.
+     */
+    std::vector<uint8_t> rebuildSBIXTable(bool keepSlots = false) const {
+        utils::ScopedPhase phase("rebuild");
+        utils::ByteSpan table = sbixTable();
+        uint32_t numStrikes = strikeCount(table);
+        
+        std::vector<bool> removed(numGlyphs, false);
+        for (const std::string& name : removedGlyphs) {
+            auto it = glyphIDs.find(name);
+            if (it != glyphIDs.end()) removed[it->second] = true;
+        }
+        std::vector<Replacement> replacements(numGlyphs);
+        for (const std::string& name : replacedGlyphs) {
+            auto id = glyphIDs.find(name);
+            auto image = glyphImages.find(name);
+            const utils::ImageHeader* header = findImageHeader(name);
+            if (id == glyphIDs.end() || image == glyphImages.end() || removed[id->second]) continue;
+            replacements[id->second] = {&image->second, graphicTypeOf(header ? header->format : "")};
+        }
+        
+        // Размеры страйков считаются параллельно, смещения - префиксной суммой, затем каждый
+        // страйк пишется параллельно в свой участок общего буфера - без промежуточных копий
+        utils::ThreadPool& pool = utils::ThreadPool::shared();
+        std::vector<StrikeLayout> layouts(numStrikes);
+        pool.parallelFor(0, numStrikes, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                layouts[i] = layoutStrike(table.subspan(table.readUInt32(SBIX_HEADER_SIZE + i * 4)),
+                                          static_cast<uint32_t>(i), removed, replacements, keepSlots);
             }
-
-            uint32_t glyphStartPos = writer.getPosition();
-            newGlyphOffsets.push_back(glyphStartPos - glyphDataStart);
-
-            auto it = glyphImages.find(glyphName);
-            if (it != glyphImages.end() && !it->second.empty()) {
-                // Используем модифицированное изображение
-                writeGlyphDataWithNewImage(writer, it->second, "png ");
-            } else {
-                // Используем оригинальное изображение
-                uint32_t originalGlyphOffset = strikeOffset + strikeHeader.glyphDataOffset;
-                reader.seek(originalGlyphOffset + glyphIndex * 4);
-                uint32_t originalDataOffset = reader.readUInt32();
-                
-                if (originalDataOffset != 0) {
-                    copyOriginalGlyphData(outputData, strikeOffset + originalDataOffset, writer);
-                } else {
-                    // Нет оригинальных данных - записываем пустые данные
-                    writeEmptyGlyphData(writer);
-                }
+        });
+        
+        std::vector<uint32_t> positions(numStrikes);
+        size_t total = SBIX_HEADER_SIZE + static_cast<size_t>(numStrikes) * 4;
+        for (uint32_t strikeIndex = 0; strikeIndex < numStrikes; ++strikeIndex) {
+            positions[strikeIndex] = static_cast<uint32_t>(total);
+            total += layouts[strikeIndex].size;
+            if (total > UINT32_MAX) {
+                throw FontSaveException(filepath, "sbix table exceeds 4 GB");
             }
         }
-
-        // Обновляем glyphDataOffset
-        size_t currentPos = writer.getPosition();
-        writer.seek(glyphDataOffsetPos);
-        writer.writeUInt32(glyphDataStart);
-        writer.seek(currentPos);
-
-        // Обновляем смещения глифов
-        writer.seek(glyphOffsetsPos);
-        for (uint32_t offset : newGlyphOffsets) {
-            writer.writeUInt32(offset);
-        }
-        writer.seek(currentPos);
-    }
-
-    void writeGlyphDataWithNewImage(TTFWriter& writer, 
-                                   const std::vector<uint8_t>& imageData,
-                                   const std::string& graphicType) {
-        // Записываем заголовок глиф-данных
-        writer.writeInt16(0); // originOffsetX
-        writer.writeInt16(0); // originOffsetY
         
-        // Записываем graphicType
-        for (size_t i = 0; i < 4; ++i) {
-            if (i < graphicType.length()) {
-                writer.writeUInt8(static_cast<uint8_t>(graphicType[i]));
-            } else {
-                writer.writeUInt8(' ');
+        utils::ByteWriter result(total);
+        result.writeBytes(table.data(), SBIX_HEADER_SIZE);  // version, flags, numStrikes
+        result.writeBE32(positions.data(), positions.size());
+        result.extend(total - result.size());
+        uint8_t* out = result.data();
+        pool.parallelFor(0, numStrikes, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                writeStrike(layouts[i], removed, replacements, out + positions[i]);
             }
-        }
-        
-        // Записываем длину данных
-        writer.writeUInt32(static_cast<uint32_t>(imageData.size()));
-        
-        // Записываем данные изображения
-        writer.writeBytes(imageData);
-    }
-
-    void writeEmptyGlyphData(TTFWriter& writer) {
-        // Записываем пустые данные глифа
-        writer.writeInt16(0); // originOffsetX
-        writer.writeInt16(0); // originOffsetY
-        writer.writeUInt8(' '); writer.writeUInt8(' '); 
-        writer.writeUInt8(' '); writer.writeUInt8(' '); // graphicType
-        writer.writeUInt32(0); // dataLength
-        // Нет данных изображения
+        });
+        return result.take();
     }
-
-    void copyOriginalGlyphData(std::vector<uint8_t>& outputData, 
-                              uint32_t glyphDataOffset, 
-                              TTFWriter& writer) {
-        utils::TTFReader reader(outputData);
-        reader.seek(glyphDataOffset);
-        
-        // Копируем заголовок
-        int16_t originOffsetX = reader.readInt16();
-        int16_t originOffsetY = reader.readInt16();
-        auto graphicType = reader.readBytes(4);
-        uint32_t dataLength = reader.readUInt32();
-        
-        // Записываем заголовок
-        writer.writeInt16(originOffsetX);
-        writer.writeInt16(originOffsetY);
-        writer.writeBytes(graphicType);
-        writer.writeUInt32(dataLength);
-        
-        // Копируем данные
-        auto imageData = reader.readBytes(dataLength);
-        writer.writeBytes(imageData);
+    
+    StrikeLayout layoutStrike(utils::ByteSpan source, uint32_t strikeIndex, const std::vector<bool>& removed,
+                              const std::vector<Replacement>& replacements, bool keepSlots) const {
+        size_t offsetsSize = (static_cast<size_t>(numGlyphs) + 1) * 4;
+        StrikeLayout layout;
+        layout.source = source;
+        if (source.size() < STRIKE_HEADER_SIZE + offsetsSize) {
+            throw FontSaveException(filepath, "sbix strike " + std::to_string(strikeIndex) + " is truncated");
+        }
+        layout.recordSizes.resize(numGlyphs);
+        layout.size = STRIKE_HEADER_SIZE + offsetsSize;
+        for (uint16_t glyphIndex = 0; glyphIndex < numGlyphs; ++glyphIndex) {
+            uint32_t start = glyphDataOffset(source, glyphIndex);
+            uint32_t end = glyphDataOffset(source, glyphIndex + 1u);
+            if (end < start || end > source.size()) {
+                throw FontSaveException(filepath, "bad sbix glyph data offsets in strike " +
+                                                  std::to_string(strikeIndex));
+            }
+            uint32_t size = end - start;
+            const Replacement& replacement = replacements[glyphIndex];
+            if (removed[glyphIndex]) {
+                size = 0;
+            } else if (replacement.image) {
+                size_t needed = GLYPH_RECORD_HEADER_SIZE + replacement.image->size();
+                bool fitsSlot = keepSlots && needed <= size && std::strcmp(replacement.graphicType, "png ") == 0;
+                if (!fitsSlot) size = static_cast<uint32_t>(needed);
+            }
+            layout.recordSizes[glyphIndex] = size;
+            layout.size += size;
+        }
+        return layout;
     }
-
-    void replaceTable(std::vector<uint8_t>& outputData, 
-                      const std::string& tableTag, 
-                      const std::vector<uint8_t>& newTableData) {
-        auto tables = utils::parseTTFTables(outputData);
-        const utils::TableRecord* tableRecord = utils::findTable(tables, tableTag);
-        if (!tableRecord) return;
-
-        uint32_t tableOffset = tableRecord->offset;
-        uint32_t originalLength = tableRecord->length;
-        uint32_t newLength = static_cast<uint32_t>(newTableData.size());
-
-        if (newLength <= originalLength) {
-            // Просто перезаписываем на том же месте
-            std::copy(newTableData.begin(), newTableData.end(), 
-                      outputData.begin() + tableOffset);
+    
+    void writeStrike(const StrikeLayout& layout, const std::vector<bool>& removed,
+                     const std::vector<Replacement>& replacements, uint8_t* out) const {
+        utils::ByteSpan source = layout.source;
+        std::memcpy(out, source.data(), STRIKE_HEADER_SIZE);  // ppem, ppi
+        uint8_t* offsets = out + STRIKE_HEADER_SIZE;
+        uint32_t position = static_cast<uint32_t>(STRIKE_HEADER_SIZE + (static_cast<size_t>(numGlyphs) + 1) * 4);
+        
+        uint32_t glyphIndex = 0;
+        while (glyphIndex < numGlyphs) {
+            uint32_t start = glyphDataOffset(source, glyphIndex);
+            if (!removed[glyphIndex] && !replacements[glyphIndex].image) {
+                // Нетронутые записи лежат подряд - смещения сдвигаются на одну величину
+                uint32_t runEnd = glyphIndex;
+                for (; runEnd < numGlyphs && !removed[runEnd] && !replacements[runEnd].image; ++runEnd) {
+                    utils::storeUInt32(offsets + runEnd * 4, position + glyphDataOffset(source, runEnd) - start);
+                }
+                uint32_t length = glyphDataOffset(source, runEnd) - start;
+                std::memcpy(out + position, source.data() + start, length);
+                position += length;
+                glyphIndex = runEnd;
+                continue;
+            }
             
-            // Заполняем остаток нулями если нужно
-            if (newLength < originalLength) {
-                std::fill(outputData.begin() + tableOffset + newLength,
-                         outputData.begin() + tableOffset + originalLength, 0);
+            utils::storeUInt32(offsets + glyphIndex * 4, position);
+            uint32_t size = layout.recordSizes[glyphIndex];
+            const Replacement& replacement = replacements[glyphIndex];
+            if (replacement.image && size > 0) {
+                // Точка привязки сохраняется из прежней записи, если она была
+                uint8_t* record = out + position;
+                uint32_t end = glyphDataOffset(source, glyphIndex + 1);
+                if (end >= start + GLYPH_RECORD_HEADER_SIZE) {
+                    std::memcpy(record, source.data() + start, 4);
+                }
+                std::memcpy(record + 4, replacement.graphicType, 4);
+                std::copy(replacement.image->begin(), replacement.image->end(), record + GLYPH_RECORD_HEADER_SIZE);
             }
-        } else {
-            // Таблица увеличилась - используем простую стратегию: добавляем в конец
-            simpleTableReplacement(outputData, tableTag, newTableData);
+            position += size;
+            ++glyphIndex;
         }
+        utils::storeUInt32(offsets + numGlyphs * 4u, position);
     }
 
-    void simpleTableReplacement(std::vector<uint8_t>& outputData,
-                               const std::string& tableTag,
-                               const std::vector<uint8_t>& newTableData) {
-        // Простая стратегия: добавляем новую таблицу в конец файла
-        // и обновляем offset в directory
-        
-        auto tables = utils::parseTTFTables(outputData);
-        uint32_t newTableOffset = static_cast<uint32_t>(outputData.size());
-        
-        // Добавляем новую таблицу в конец
-        outputData.insert(outputData.end(), newTableData.begin(), newTableData.end());
-        
-        // Выравнивание по 4 байта
-        while (outputData.size() % 4 != 0) {
-            outputData.push_back(0);
+protected:
+    RGBAImage decodeGlyphImage(uint16_t glyphID, uint16_t strikeIndex) const override {
+        std::string glyphName = getGlyphName(glyphID);
+        if (removedGlyphs.count(glyphName)) {
+            throw GlyphNotFoundException(glyphName + " (removed)");
         }
         
-        // Обновляем offset в таблице directory
-        uint32_t directoryStart = sizeof(utils::TTFHeader);
-        for (size_t i = 0; i < tables.size(); ++i) {
-            std::string currentTag(tables[i].tag, 4);
-            if (currentTag == tableTag) {
-                uint32_t directoryEntryOffset = directoryStart + i * sizeof(utils::TableRecord) + 8; // +8 для пропуска tag и checksum
-                
-                // Записываем новое смещение
-                TTFWriter writer;
-                writer.writeUInt32(newTableOffset);
-                std::vector<uint8_t> offsetData = writer.getData();
+        try {
+            // Заменённое изображение одно на все страйки
+            if (replacedGlyphs.count(glyphName)) {
+                return utils::decodePNG(glyphImages.at(glyphName));
+            }
+            
+            auto tables = utils::parseTTFTables(fontData);
+            const utils::TableRecord* sbixRec = utils::findTable(tables, "sbix");
+            if (!sbixRec || static_cast<size_t>(sbixRec->offset) + sbixRec->length > fontData.size()) {
+                throw FontFormatException("SBIX", "sbix table not found");
+            }
+            utils::ByteSpan table(fontData.data() + sbixRec->offset, sbixRec->length);
+            
+            if (strikeIndex >= table.readUInt32(4)) {
+                throw GlyphNotFoundException("strike " + std::to_string(strikeIndex));
+            }
+            // Strike: ppem, ppi, glyphDataOffsets[numGlyphs + 1] от начала страйка
+            utils::ByteSpan strike = table.subspan(table.readUInt32(8 + strikeIndex * 4u));
+            
+            // 'dupe' ссылается на другой глиф того же страйка; цепочки не разворачиваем
+            uint16_t currentID = glyphID;
+            for (int hop = 0; hop < 2; ++hop) {
+                if (currentID >= numGlyphs) break;
+                uint32_t start = strike.readUInt32(4 + currentID * 4u);
+                uint32_t end = strike.readUInt32(8 + currentID * 4u);
+                if (end < start + 8) break;
                 
-                std::copy(offsetData.begin(), offsetData.end(),
-                          outputData.begin() + directoryEntryOffset);
-                break;
+                utils::ByteSpan glyph = strike.subspan(start, end - start);
+                std::string graphicType(reinterpret_cast<const char*>(glyph.data() + 4), 4);
+                if (graphicType == "png ") {
+                    return utils::decodePNG(glyph.subspan(8));
+                }
+                if (graphicType == "dupe" && hop == 0) {
+                    currentID = glyph.readUInt16(8);
+                    continue;
+                }
+                throw FontFormatException("SBIX", "graphic type '" + graphicType + "' cannot be decoded");
             }
+        } catch (const FontException&) {
+            throw;
+        } catch (const std::exception& e) {
+            throw FontFormatException("SBIX", glyphName + ": " + e.what());
         }
+        throw GlyphNotFoundException(glyphName);
     }
-
-    void rebuildFontStructure(std::vector<uint8_t>& outputData) {
-        // Обновляем checksumAdjustment в head таблице
-        updateHeadTableChecksum(outputData);
+    
+    // Заголовок из последнего страйка, где у глифа есть изображение, - того же, что в glyphImages
+    const utils::ImageHeader* findImageHeader(const std::string& glyphName, uint16_t* strikeIndex = nullptr) const {
+        for (size_t i = strikes.size(); i-- > 0;) {
+            auto it = imageMeta.find({static_cast<uint16_t>(i), glyphName});
+            if (it != imageMeta.end()) {
+                if (strikeIndex) *strikeIndex = static_cast<uint16_t>(i);
+                return &it->second;
+            }
+        }
+        return nullptr;
     }
-
-    void updateHeadTableChecksum(std::vector<uint8_t>& outputData) {
-        auto tables = utils::parseTTFTables(outputData);
-        const utils::TableRecord* headTable = utils::findTable(tables, "head");
-        if (!headTable) return;
-
-        // Устанавливаем checksumAdjustment в 0 для расчета
-        uint32_t checksumAdjustmentOffset = headTable->offset + 8;
-        TTFWriter writer;
-        writer.writeUInt32(0);
-        std::vector<uint8_t> zeroChecksum = writer.getData();
-        
-        std::copy(zeroChecksum.begin(), zeroChecksum.end(),
-                  outputData.begin() + checksumAdjustmentOffset);
-
-        // Рассчитываем новую контрольную сумму
-        uint32_t newChecksum = calculateFontChecksum(outputData);
-        
-        // Записываем новую контрольную сумму
-        writer.seek(0);
-        writer.writeUInt32(newChecksum);
-        std::vector<uint8_t> newChecksumData = writer.getData();
-        
-        std::copy(newChecksumData.begin(), newChecksumData.end(),
-                  outputData.begin() + checksumAdjustmentOffset);
+    
+    void fillImageInfo(GlyphInfo& info) const {
+        uint16_t strikeIndex = 0;
+        const utils::ImageHeader* header = findImageHeader(info.name, &strikeIndex);
+        if (!header) {
+            info.format = "unknown";
+            return;
+        }
+        info.format = header->format;
+        info.width = header->width;
+        info.height = header->height;
+        info.bit_depth = header->bitDepth;
+        info.ppem = strikes[strikeIndex].ppem;
     }
-
-    uint32_t calculateFontChecksum(std::vector<uint8_t>& fontData) {
-        auto tables = utils::parseTTFTables(fontData);
-        
-        // Суммируем контрольные суммы всех таблиц
-        uint32_t totalChecksum = 0;
-        for (const auto& table : tables) {
-            uint32_t tableChecksum = calculateTableChecksum(
-                fontData, table.offset, table.length);
-            totalChecksum += tableChecksum;
+    
+    /**
+     * Новое изображение пишется во все страйки. Для каждого страйка сообщаем, если его размер
+     * не совпадает с изображением, которое там было, а где изображения не было - с ppem страйка.
+     * Затем заголовок всех страйков заменяется новым.
+     */
+    void setImageForAllStrikes(const std::string& glyphName, const utils::ImageHeader& header) {
+        for (size_t i = 0; i < strikes.size(); ++i) {
+            auto key = std::make_pair(static_cast<uint16_t>(i), glyphName);
+            auto it = imageMeta.find(key);
+            bool hadImage = it != imageMeta.end() && it->second.width != 0;
+            uint32_t expectedWidth = hadImage ? it->second.width : strikes[i].ppem;
+            uint32_t expectedHeight = hadImage ? it->second.height : strikes[i].ppem;
+            if (header.width != 0 && (header.width != expectedWidth || header.height != expectedHeight)) {
+                std::cerr << "SBIX: " << glyphName << ": " << header.width << "x" << header.height
+                          << " image in strike " << i << " (" << strikes[i].ppem << " ppem) expects "
+                          << expectedWidth << "x" << expectedHeight << std::endl;
+            }
+            imageMeta[key] = header;
         }
-        
-        // Magic number from OpenType spec
-        uint32_t magicNumber = 0xB1B0AFBA;
-        return magicNumber - totalChecksum;
     }
-
-    uint32_t calculateTableChecksum(const std::vector<uint8_t>& data, 
-                                   uint32_t offset, uint32_t length) {
-        uint32_t sum = 0;
-        uint32_t nLongs = (length + 3) / 4;
-        
-        for (uint32_t i = 0; i < nLongs; ++i) {
-            uint32_t value = 0;
-            for (int j = 0; j < 4; ++j) {
-                uint32_t pos = offset + i * 4 + j;
-                if (pos < offset + length) {
-                    value = (value << 8) | data[pos];
-                }
-            }
-            sum += value;
+    
+    void eraseImageMeta(const std::string& glyphName) {
+        for (size_t i = 0; i < strikes.size(); ++i) {
+            imageMeta.erase({static_cast<uint16_t>(i), glyphName});
         }
-        
-        return sum;
     }
     
 public:
@@ -698,7 +597,9 @@ public:
         }
         
         glyphImages.erase(it);
-        removedGlyphs.push_back(glyphName);
+        eraseImageMeta(glyphName);
+        removedGlyphs.insert(glyphName);
+        invalidateDecodedGlyphs();
         return true;
     }
     
@@ -716,32 +617,77 @@ public:
         }
         
         it->second = newImage;
+        setImageForAllStrikes(glyphName, utils::probeImageHeader(newImage));
+        replacedGlyphs.insert(glyphName);
+        invalidateDecodedGlyphs();
         return true;
     }
     
+    bool canAddGlyphImage(const std::string& glyphName) const override {
+        return glyphIDs.count(glyphName) && !glyphImages.count(glyphName);
+    }
+    
+    bool addGlyphImage(const std::string& glyphName, const std::vector<uint8_t>& image) override {
+        if (!canAddGlyphImage(glyphName)) {
+            return false;
+        }
+        
+        // Пустые записи страйков заполняются так же, как при замене
+        glyphImages[glyphName] = image;
+        setImageForAllStrikes(glyphName, utils::probeImageHeader(image));
+        removedGlyphs.erase(glyphName);
+        replacedGlyphs.insert(glyphName);
+        invalidateDecodedGlyphs();
+        return true;
+    }
+    
+    std::unique_ptr<GlyphEditState> saveGlyphEditState(const std::string& glyphName) const override {
+        auto state = std::make_unique<SBIXGlyphEditState>();
+        state->glyphName = glyphName;
+        auto it = glyphImages.find(glyphName);
+        if (it != glyphImages.end()) {
+            state->hasImage = true;
+            state->image = it->second;
+        }
+        for (size_t i = 0; i < strikes.size(); ++i) {
+            auto meta = imageMeta.find({static_cast<uint16_t>(i), glyphName});
+            if (meta != imageMeta.end()) state->headers.emplace(static_cast<uint16_t>(i), meta->second);
+        }
+        state->removed = removedGlyphs.count(glyphName) != 0;
+        state->replaced = replacedGlyphs.count(glyphName) != 0;
+        return state;
+    }
+    
+    void restoreGlyphEditState(const GlyphEditState& editState) override {
+        const auto& state = static_cast<const SBIXGlyphEditState&>(editState);
+        if (state.hasImage) {
+            glyphImages[state.glyphName] = state.image;
+        } else {
+            glyphImages.erase(state.glyphName);
+        }
+        eraseImageMeta(state.glyphName);
+        for (const auto& [strikeIndex, header] : state.headers) {
+            imageMeta[{strikeIndex, state.glyphName}] = header;
+        }
+        if (state.removed) removedGlyphs.insert(state.glyphName);
+        else removedGlyphs.erase(state.glyphName);
+        if (state.replaced) replacedGlyphs.insert(state.glyphName);
+        else replacedGlyphs.erase(state.glyphName);
+        invalidateDecodedGlyphs();
+    }
+    
     std::vector<GlyphInfo> listGlyphs() const override {
         std::vector<GlyphInfo> result;
         for (const auto& [name, imageData] : glyphImages) {
-            if (std::find(removedGlyphs.begin(), removedGlyphs.end(), name) != removedGlyphs.end()) {
+            if (removedGlyphs.count(name)) {
                 continue;
             }
             
             GlyphInfo info;
             info.name = name;
+            info.glyph_id = glyphIDs.at(name);
             
-            // Определяем формат на основе данных
-            if (imageData.size() >= 8) {
-                if (imageData[0] == 0x89 && imageData[1] == 0x50 && imageData[2] == 0x4E && imageData[3] == 0x47) {
-                    info.format = "png";
-                } else if (imageData[0] == 0xFF && imageData[1] == 0xD8 && imageData[2] == 0xFF) {
-                    info.format = "jpg";
-                } else {
-                    info.format = "unknown";
-                }
-            } else {
-                info.format = "unknown";
-            }
-            
+            fillImageInfo(info);
             info.image_data = imageData;
             info.data_size = imageData.size();
             
@@ -761,22 +707,11 @@ public:
         if (it != glyphImages.end()) {
             GlyphInfo info;
             info.name = glyphName;
+            info.glyph_id = glyphIDs.at(glyphName);
             info.image_data = it->second;
             info.data_size = it->second.size();
             
-            // Определяем формат
-            if (it->second.size() >= 8) {
-                if (it->second[0] == 0x89 && it->second[1] == 0x50 && 
-                    it->second[2] == 0x4E && it->second[3] == 0x47) {
-                    info.format = "png";
-                } else if (it->second[0] == 0xFF && it->second[1] == 0xD8 && it->second[2] == 0xFF) {
-                    info.format = "jpg";
-                } else {
-                    info.format = "unknown";
-                }
-            } else {
-                info.format = "unknown";
-            }
+            fillImageInfo(info);
             
             // Находим Unicode код
             auto unicodeIt = glyphNameToUnicode.find(glyphName);
@@ -796,36 +731,58 @@ public:
     
     bool save(const std::string& outputPath) override {
         try {
-            std::ofstream file(outputPath, std::ios::binary);
-            if (!file) {
-                throw FontSaveException(outputPath, "Cannot create output file");
+            // Неизменённые таблицы копируются из исходного файла ядром, запись атомарная
+            utils::FontAssembler assembler = assembleFont();
+            utils::SourceFile sourceFile{filepath, sourceStamp, fontData};
+            if (!assembler.writeFile(outputPath, &sourceFile)) {
+                throw FontSaveException(outputPath, "Cannot write output file");
             }
-
-            // Создаем копию исходных данных для модификации
-            std::vector<uint8_t> outputData = fontData;
-        
-            // Перестраиваем SBIX таблицу с учетом изменений
-            rebuildSBIXTable(outputData);
-        
-            // Обновляем структуру шрифта
-            rebuildFontStructure(outputData);
-        
-            file.write(reinterpret_cast<const char*>(outputData.data()), outputData.size());
-            return file.good();
+            return true;
         } catch (const std::exception& e) {
             throw FontSaveException(outputPath, std::string("Save failed: ") + e.what());
         }
     }
+    
+    bool saveInPlace() override {
+        try {
+            utils::FontAssembler assembler = assembleFont(true);
+            utils::SourceFile sourceFile{filepath, sourceStamp, fontData};
+            if (!assembler.patchFile(sourceFile) && !assembler.writeFile(filepath, &sourceFile)) {
+                throw FontSaveException(filepath, "Cannot write output file");
+            }
+            // Файл больше не совпадает с fontData
+            sourceStamp = utils::FileStamp();
+            return true;
+        } catch (const std::exception& e) {
+            throw FontSaveException(filepath, std::string("Save failed: ") + e.what());
+        }
+    }
+    
+private:
+    // Перестроенная sbix и остальные таблицы видами на fontData, без копии шрифта
+    utils::FontAssembler assembleFont(bool keepSlots = false) const {
+        std::vector<uint8_t> sbixData = rebuildSBIXTable(keepSlots);
+        
+        utils::ByteSpan source(fontData);
+        utils::FontAssembler assembler(source.readUInt32(0));
+        for (const auto& table : utils::parseTTFTables(fontData)) {
+            std::string tag(table.tag, 4);
+            if (tag == "sbix") {
+                assembler.addTable(tag, std::move(sbixData));
+            } else {
+                assembler.addTable(tag, source.subspan(table.offset, table.length), table.checksum);
+            }
+        }
+        return assembler;
+    }
 };
 
 std::unique_ptr<Font> SBIX_Handler::loadFont(const std::string& filepath) {
     return std::make_unique<SBIX_Font>(filepath);
 }
 
-static bool registerSBIXHandler() {
-    return true;
+void registerSBIXHandler() {
+    registerFontFormatHandler(std::make_unique<SBIX_Handler>());
 }
 
-static bool sbixHandlerRegistered = registerSBIXHandler();
-
 } // namespace fontmaster
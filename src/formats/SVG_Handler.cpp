@@ -1,177 +1,443 @@
 #include "fontmaster/FontMaster.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/FileIO.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/SVGDocumentIndex.h"
+#include "fontmaster/CMAPParser.h"
+#include "fontmaster/POSTParser.h"
+#include "fontmaster/MAXPParser.h"
+#include <algorithm>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <set>
+#include <mutex>
+#include <stdexcept>
 #include <iostream>
 
 
 namespace fontmaster {
 
-class SVG_Handler : public FontFormatHandler {
-public:
-    bool canHandle(const std::string& filepath) override {
-        try {
-            std::ifstream file(filepath, std::ios::binary);
-            if (!file) return false;
-            
-            file.seekg(0, std::ios::end);
-            size_t size = file.tellg();
-            file.seekg(0, std::ios::beg);
-            
-            if (size < 1024) return false;
-            
-            std::vector<uint8_t> header(1024);
-            file.read(reinterpret_cast<char*>(header.data()), header.size());
-            
-            auto tables = utils::parseTTFTables(header);
-            return utils::hasTable(tables, "SVG ");
-        } catch (...) {
-            return false;
-        }
-    }
-    
-    std::unique_ptr<SVG_Font> loadFont(const std::string& filepath) override {
-        return std::make_unique<SVG_Font>(filepath);
-    }
-    
-    FontFormat getFormat() const override { return FontFormat::SVG; }
+namespace {
+
+// Отметка об удалении и заменённый документ одного глифа
+struct SVGGlyphEditState : Font::GlyphEditState {
+    bool found = false;
+    uint16_t glyphID = 0;
+    bool removed = false;
+    bool replaced = false;
+    std::shared_ptr<const std::vector<uint8_t>> document;
 };
 
+} // namespace
+
 class SVG_Font : public Font {
 private:
     std::string filepath;
     std::vector<uint8_t> fontData;
-    std::map<std::string, std::string> glyphSVG;
-    std::vector<std::string> removedGlyphs;
-    
+    utils::FileStamp sourceStamp;   // fontData совпадает с файлом filepath, пока отпечаток валиден
+    std::vector<utils::TableRecord> tables;
+    std::unique_ptr<utils::SVGDocumentIndex> svgIndex;
+    uint16_t numGlyphs = 0;
+
+    // Правки хранятся по glyph ID поверх исходного индекса
+    std::set<uint16_t> removedGlyphs;
+    std::map<uint16_t, std::shared_ptr<const std::vector<uint8_t>>> replacedDocuments;
+
+    // Имена глифов и cmap нужны только для поиска по имени/юникоду,
+    // поэтому строятся лениво при первом обращении
+    struct GlyphLookup {
+        std::once_flag namesOnce;
+        std::vector<std::string> glyphNames;
+        std::map<std::string, uint16_t> nameToGlyph;
+        std::once_flag cmapOnce;
+        std::map<uint32_t, uint16_t> unicodeToGlyph;
+        std::map<uint16_t, uint32_t> glyphToUnicode;
+    };
+    std::unique_ptr<GlyphLookup> lookup;
+
 public:
     SVG_Font(const std::string& path) : filepath(path) {
         loadFontData();
         parseFont();
     }
-    
+
+    bool load() override {
+        return !fontData.empty();
+    }
+
+    const std::vector<uint8_t>& getFontData() const override {
+        return fontData;
+    }
+
+    void setFontData(const std::vector<uint8_t>& data) override {
+        // Индекс указывает внутрь fontData, поэтому перестраивается вместе с ней
+        std::vector<uint8_t> copy = data;
+        fontData.swap(copy);
+        sourceStamp = utils::FileStamp();
+        parseFont();
+    }
+
 private:
     void loadFontData() {
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            throw FontLoadException(filepath, "Cannot open file");
-        }
-        
-        file.seekg(0, std::ios::end);
-        size_t size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        fontData.resize(size);
-        if (!file.read(reinterpret_cast<char*>(fontData.data()), size)) {
+        if (!utils::readFile(filepath, fontData, &sourceStamp)) {
             throw FontLoadException(filepath, "Cannot read file data");
         }
     }
-    
+
     void parseFont() {
-        auto tables = utils::parseTTFTables(fontData);
-        if (!utils::hasTable(tables, "SVG ")) {
+        tables = utils::parseTTFTables(fontData);
+        const utils::TableRecord* svgTable = utils::findTable(tables, "SVG ");
+        if (!svgTable) {
             throw FontFormatException("SVG", "SVG table not found");
         }
-        
-        std::cout << "SVG table found" << std::endl;
-        
-        // Заглушка для демонстрации
-        for (int i = 0; i < 10; ++i) {
-            std::string glyphName = "svg_glyph_" + std::to_string(i);
-            glyphSVG[glyphName] = "<svg><circle cx='50' cy='50' r='40'/></svg>";
+        if (static_cast<size_t>(svgTable->offset) + svgTable->length > fontData.size()) {
+            throw FontFormatException("SVG", "SVG table out of bounds");
+        }
+
+        try {
+            utils::ByteSpan table(fontData.data() + svgTable->offset, svgTable->length);
+            svgIndex = std::make_unique<utils::SVGDocumentIndex>(table);
+        } catch (const std::exception& e) {
+            throw FontFormatException("SVG", e.what());
         }
+
+        numGlyphs = 0;
+        if (const utils::TableRecord* maxpTable = utils::findTable(tables, "maxp")) {
+            utils::MAXPParser maxpParser(fontData, maxpTable->offset);
+            if (maxpParser.parse()) {
+                numGlyphs = maxpParser.getNumGlyphs();
+            }
+        }
+
+        removedGlyphs.clear();
+        replacedDocuments.clear();
+        lookup = std::make_unique<GlyphLookup>();
     }
-    
+
+    void buildGlyphNames() const {
+        std::call_once(lookup->namesOnce, [this]() {
+            auto& glyphNames = lookup->glyphNames;
+            size_t count = numGlyphs;
+            if (!svgIndex->getGlyphRanges().empty()) {
+                count = std::max<size_t>(count, svgIndex->getGlyphRanges().back().endGlyphID + 1u);
+            }
+            glyphNames.resize(count);
+
+            std::map<uint16_t, std::string> postNames;
+            if (const utils::TableRecord* postTable = utils::findTable(tables, "post")) {
+                try {
+                    utils::POSTParser postParser(fontData, postTable->offset, numGlyphs);
+                    if (postParser.parse()) {
+                        postNames = postParser.getGlyphNames();
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error parsing POST table: " << e.what() << std::endl;
+                }
+            }
+
+            for (size_t gid = 0; gid < count; ++gid) {
+                auto it = postNames.find(static_cast<uint16_t>(gid));
+                glyphNames[gid] = (it != postNames.end() && !it->second.empty())
+                                      ? it->second
+                                      : "glyph" + std::to_string(gid);
+                lookup->nameToGlyph.emplace(glyphNames[gid], static_cast<uint16_t>(gid));
+            }
+        });
+    }
+
+    void buildCmap() const {
+        std::call_once(lookup->cmapOnce, [this]() {
+            const utils::TableRecord* cmapTable = utils::findTable(tables, "cmap");
+            if (!cmapTable) return;
+            try {
+                utils::CMAPParser cmapParser(
+                    utils::ByteSpan(fontData).subspan(cmapTable->offset, cmapTable->length).toVector());
+                cmapParser.parse();
+                lookup->unicodeToGlyph = cmapParser.getCharToGlyphMap();
+                for (const auto& pair : lookup->unicodeToGlyph) {
+                    lookup->glyphToUnicode.emplace(pair.second, pair.first);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error parsing CMAP table: " << e.what() << std::endl;
+            }
+        });
+    }
+
+    std::string glyphName(uint16_t glyphID) const {
+        buildGlyphNames();
+        if (glyphID >= lookup->glyphNames.size()) {
+            return "glyph" + std::to_string(glyphID);
+        }
+        return lookup->glyphNames[glyphID];
+    }
+
+    bool findGlyphID(const std::string& name, uint16_t& glyphID) const {
+        buildGlyphNames();
+        auto it = lookup->nameToGlyph.find(name);
+        if (it == lookup->nameToGlyph.end()) return false;
+        glyphID = it->second;
+        return true;
+    }
+
+    bool hasDocument(uint16_t glyphID) const {
+        return svgIndex->hasGlyph(glyphID) && removedGlyphs.count(glyphID) == 0;
+    }
+
+    GlyphInfo makeGlyphInfo(uint16_t glyphID) const {
+        buildCmap();
+
+        GlyphInfo info;
+        info.name = glyphName(glyphID);
+        info.glyph_id = glyphID;
+        auto unicodeIt = lookup->glyphToUnicode.find(glyphID);
+        info.unicode = unicodeIt != lookup->glyphToUnicode.end() ? unicodeIt->second : 0;
+        info.format = "svg";
+
+        utils::SVGDocument document = getDocument(glyphID);
+        info.image_data.assign(document.bytes.begin(), document.bytes.end());
+        info.data_size = info.image_data.size();
+        return info;
+    }
+
 public:
     FontFormat getFormat() const override { return FontFormat::SVG; }
-    
+
+    /// Документ глифа с учётом правок, без копирования (gzip распаковывается через кэш индекса)
+    utils::SVGDocument getDocument(uint16_t glyphID) const {
+        if (removedGlyphs.count(glyphID)) {
+            throw std::out_of_range("SVG: glyph " + std::to_string(glyphID) + " was removed");
+        }
+        auto replaced = replacedDocuments.find(glyphID);
+        if (replaced != replacedDocuments.end()) {
+            utils::SVGDocument document;
+            document.owner = replaced->second;
+            document.bytes = utils::ByteSpan(*document.owner);
+            return document;
+        }
+        return svgIndex->getDocument(glyphID);
+    }
+
     bool removeGlyph(const std::string& glyphName) override {
-        auto it = glyphSVG.find(glyphName);
-        if (it == glyphSVG.end()) {
+        uint16_t glyphID;
+        if (!findGlyphID(glyphName, glyphID) || !hasDocument(glyphID)) {
             return false;
         }
-        
-        glyphSVG.erase(it);
-        removedGlyphs.push_back(glyphName);
+
+        removedGlyphs.insert(glyphID);
+        replacedDocuments.erase(glyphID);
         return true;
     }
-    
+
     bool removeGlyph(uint32_t unicode) override {
         std::string name = findGlyphName(unicode);
         if (name.empty()) return false;
         return removeGlyph(name);
     }
-    
+
     bool replaceGlyphImage(const std::string& glyphName,
                           const std::vector<uint8_t>& newImage) override {
-        auto it = glyphSVG.find(glyphName);
-        if (it == glyphSVG.end()) {
+        uint16_t glyphID;
+        if (!findGlyphID(glyphName, glyphID) || !hasDocument(glyphID)) {
             return false;
         }
-        
-        std::string newSVG(newImage.begin(), newImage.end());
-        it->second = newSVG;
+
+        replacedDocuments[glyphID] = std::make_shared<const std::vector<uint8_t>>(newImage);
         return true;
     }
-    
+
+    std::unique_ptr<GlyphEditState> saveGlyphEditState(const std::string& glyphName) const override {
+        auto state = std::make_unique<SVGGlyphEditState>();
+        state->found = findGlyphID(glyphName, state->glyphID);
+        if (!state->found) return state;
+        state->removed = removedGlyphs.count(state->glyphID) != 0;
+        auto replaced = replacedDocuments.find(state->glyphID);
+        if (replaced != replacedDocuments.end()) {
+            state->replaced = true;
+            state->document = replaced->second;
+        }
+        return state;
+    }
+
+    void restoreGlyphEditState(const GlyphEditState& editState) override {
+        const auto& state = static_cast<const SVGGlyphEditState&>(editState);
+        if (!state.found) return;
+        if (state.removed) removedGlyphs.insert(state.glyphID);
+        else removedGlyphs.erase(state.glyphID);
+        if (state.replaced) replacedDocuments[state.glyphID] = state.document;
+        else replacedDocuments.erase(state.glyphID);
+    }
+
     std::vector<GlyphInfo> listGlyphs() const override {
         std::vector<GlyphInfo> result;
-        for (const auto& pair : glyphSVG) {
-            if (std::find(removedGlyphs.begin(), removedGlyphs.end(), pair.first) != removedGlyphs.end()) {
-                continue;
+        for (const auto& range : svgIndex->getGlyphRanges()) {
+            for (uint32_t gid = range.startGlyphID; gid <= range.endGlyphID; ++gid) {
+                if (removedGlyphs.count(static_cast<uint16_t>(gid))) continue;
+                result.push_back(makeGlyphInfo(static_cast<uint16_t>(gid)));
             }
-            
-            GlyphInfo info;
-            info.name = pair.first;
-            info.format = "svg";
-            const std::string& svg = pair.second;
-            info.image_data.assign(svg.begin(), svg.end());
-            info.data_size = svg.size();
-            result.push_back(info);
         }
         return result;
     }
-    
+
     GlyphInfo getGlyphInfo(const std::string& glyphName) const override {
-        auto it = glyphSVG.find(glyphName);
-        if (it != glyphSVG.end()) {
-            GlyphInfo info;
-            info.name = glyphName;
-            info.format = "svg";
-            const std::string& svg = it->second;
-            info.image_data.assign(svg.begin(), svg.end());
-            info.data_size = svg.size();
-            return info;
+        uint16_t glyphID;
+        if (findGlyphID(glyphName, glyphID) && hasDocument(glyphID)) {
+            return makeGlyphInfo(glyphID);
         }
         throw GlyphNotFoundException(glyphName);
     }
-    
+
     std::string findGlyphName(uint32_t unicode) const override {
-        // Для SVG нужно парсить cmap таблицу
-        // Временно возвращаем пустую строку
-        return "";
+        buildCmap();
+        auto it = lookup->unicodeToGlyph.find(unicode);
+        if (it == lookup->unicodeToGlyph.end()) return "";
+        return glyphName(it->second);
     }
-    
+
     bool save(const std::string& outputPath) override {
         try {
-            std::ofstream file(outputPath, std::ios::binary);
-            if (!file) {
-                throw FontSaveException(outputPath, "Cannot create output file");
+            // Пока шрифт не менялся, файл копируется ядром; иначе пересобирается только 'SVG ',
+            // остальные таблицы - виды на fontData. Запись атомарная
+            utils::SourceFile source{filepath, sourceStamp, fontData};
+            bool written = removedGlyphs.empty() && replacedDocuments.empty()
+                               ? utils::writeFileAtomic(outputPath, {utils::ByteSpan(fontData)}, &source)
+                               : assembleFont().writeFile(outputPath, &source);
+            if (!written) {
+                throw FontSaveException(outputPath, "Cannot write output file");
             }
-            
-            file.write(reinterpret_cast<const char*>(fontData.data()), fontData.size());
-            return file.good();
+            return true;
         } catch (const std::exception& e) {
             throw FontSaveException(outputPath, std::string("Save failed: ") + e.what());
         }
     }
+
+private:
+    /**
+     * Таблица 'SVG ' с учётом правок. Нетронутые глифы одной записи остаются общим
+     * диапазоном, удалённые выпадают из индекса, заменённые получают свою запись.
+     * Документ, общий для нескольких записей, пишется один раз; gzip не распаковывается.
+     */
+    std::vector<uint8_t> rebuildSVGTable() const {
+        struct Entry {
+            uint16_t startGlyphID;
+            uint16_t endGlyphID;
+            utils::ByteSpan document;
+            bool replaced;
+        };
+        std::vector<Entry> entries;
+        for (const auto& range : svgIndex->getGlyphRanges()) {
+            utils::ByteSpan original = svgIndex->getRawDocument(*range.record);
+            for (uint32_t gid = range.startGlyphID; gid <= range.endGlyphID; ++gid) {
+                uint16_t glyphID = static_cast<uint16_t>(gid);
+                if (removedGlyphs.count(glyphID)) continue;
+                auto replaced = replacedDocuments.find(glyphID);
+                if (replaced != replacedDocuments.end()) {
+                    entries.push_back({glyphID, glyphID, utils::ByteSpan(*replaced->second), true});
+                } else if (!entries.empty() && !entries.back().replaced && entries.back().endGlyphID + 1u == gid &&
+                           entries.back().document.data() == original.data() &&
+                           entries.back().document.size() == original.size()) {
+                    entries.back().endGlyphID = glyphID;
+                } else {
+                    entries.push_back({glyphID, glyphID, original, false});
+                }
+            }
+        }
+        if (entries.size() > 0xFFFF) {
+            throw FontSaveException(filepath, "too many SVG document records");
+        }
+
+        // Заголовок (10 байт), затем список: numEntries, записи, документы
+        const size_t recordsSize = 2 + entries.size() * 12;
+        std::map<std::pair<const uint8_t*, size_t>, uint32_t> documentOffsets;
+        std::vector<utils::ByteSpan> documents;
+        std::vector<uint32_t> offsets;
+        offsets.reserve(entries.size());
+        size_t documentsSize = 0;
+        for (const Entry& entry : entries) {
+            auto key = std::make_pair(entry.document.data(), entry.document.size());
+            auto placed = entry.replaced ? documentOffsets.end() : documentOffsets.find(key);
+            if (placed != documentOffsets.end()) {
+                offsets.push_back(placed->second);
+                continue;
+            }
+            size_t offset = recordsSize + documentsSize;
+            if (offset + entry.document.size() > 0xFFFFFFFFu) {
+                throw FontSaveException(filepath, "SVG table exceeds 4 GiB");
+            }
+            offsets.push_back(static_cast<uint32_t>(offset));
+            if (!entry.replaced) documentOffsets.emplace(key, static_cast<uint32_t>(offset));
+            documents.push_back(entry.document);
+            documentsSize += entry.document.size();
+        }
+
+        utils::ByteWriter writer(10 + recordsSize + documentsSize);
+        writer.writeUInt16(0);                  // version
+        writer.writeUInt32(10);                 // svgDocumentListOffset
+        writer.writeUInt32(0);                  // reserved
+        writer.writeUInt16(static_cast<uint16_t>(entries.size()));
+        for (size_t i = 0; i < entries.size(); ++i) {
+            writer.writeUInt16(entries[i].startGlyphID);
+            writer.writeUInt16(entries[i].endGlyphID);
+            writer.writeUInt32(offsets[i]);
+            writer.writeUInt32(static_cast<uint32_t>(entries[i].document.size()));
+        }
+        for (const auto& document : documents) {
+            writer.writeBytes(document);
+        }
+        return writer.take();
+    }
+
+    // Новая 'SVG ' и остальные таблицы видами на fontData, без копии шрифта
+    utils::FontAssembler assembleFont() const {
+        std::vector<uint8_t> svgData = rebuildSVGTable();
+
+        utils::ByteSpan source(fontData);
+        utils::FontAssembler assembler(source.readUInt32(0));
+        for (const auto& table : tables) {
+            std::string tag(table.tag, 4);
+            if (tag == "SVG ") {
+                assembler.addTable(tag, std::move(svgData));
+            } else {
+                assembler.addTable(tag, source.subspan(table.offset, table.length), table.checksum);
+            }
+        }
+        return assembler;
+    }
 };
 
-static bool registerSVGHandler() {
-        std::make_unique<SVG_Handler>();
-    return true;
-}
+class SVG_Handler : public FontFormatHandler {
+public:
+    bool canHandle(const std::string& filepath) override {
+        try {
+            std::ifstream file(filepath, std::ios::binary);
+            if (!file) return false;
+
+            file.seekg(0, std::ios::end);
+            size_t size = file.tellg();
+            file.seekg(0, std::ios::beg);
+
+            if (size < 1024) return false;
 
-static bool svgHandlerRegistered = registerSVGHandler();
+            std::vector<uint8_t> header(1024);
+            file.read(reinterpret_cast<char*>(header.data()), header.size());
+
+            auto tables = utils::parseTTFTables(header);
+            return utils::hasTable(tables, "SVG ");
+        } catch (...) {
+            return false;
+        }
+    }
+
+    std::unique_ptr<Font> loadFont(const std::string& filepath) override {
+        return std::make_unique<SVG_Font>(filepath);
+    }
+
+    FontFormat getFormat() const override { return FontFormat::SVG; }
+};
+
+void registerSVGHandler() {
+    registerFontFormatHandler(std::make_unique<SVG_Handler>());
+}
 
 } // namespace fontmaster
@@ -1,6 +1,14 @@
 #include "MainWindow.h"
 #include <QScrollArea>
 #include <QGroupBox>
+#include <QImage>
+#include <QIcon>
+#include <QPixmap>
+
+namespace {
+// Размер em для превью COLR-глифов, которые рисуются из контуров
+const uint16_t PREVIEW_PIXEL_SIZE = 128;
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     setupUI();
@@ -270,8 +278,24 @@ void MainWindow::updateGlyphPreview() {
         
         glyphPreview->addItem(previewText);
         
-        // Здесь можно добавить отображение самого изображения глифа
-        // Для этого нужно конвертировать image_data в QPixmap
+        // Изображение берём из общего кэша Font::decodeGlyph: повторный выбор глифа не декодирует заново.
+        // Для COLR strike - размер em в пикселях, для CBDT/sbix - индекс страйка
+        uint16_t strike = currentFont->getFormat() == fontmaster::FontFormat::COLR_CPAL ? PREVIEW_PIXEL_SIZE : 0;
+        std::shared_ptr<const fontmaster::RGBAImage> image;
+        try {
+            image = currentFont->decodeGlyph(glyphInfo.glyph_id, strike);
+        } catch (const fontmaster::FontException& e) {
+            // Формат без декодирования изображений или у глифа нет картинки - остаётся текстовое описание
+            glyphPreview->addItem("No preview: " + QString(e.what()));
+        }
+        if (image && image->width > 0 && image->height > 0) {
+            QImage qimage(image->pixels.data(), static_cast<int>(image->width), static_cast<int>(image->height),
+                          static_cast<int>(image->width * 4), QImage::Format_RGBA8888);
+            // copy(): QImage не владеет буфером image->pixels
+            QPixmap pixmap = QPixmap::fromImage(qimage.copy());
+            glyphPreview->setIconSize(pixmap.size().boundedTo(QSize(256, 256)));
+            glyphPreview->addItem(new QListWidgetItem(QIcon(pixmap), QString("%1x%2").arg(image->width).arg(image->height)));
+        }
         
     } catch (const std::exception& e) {
         glyphPreview->addItem("Error loading glyph details: " + QString(e.what()));
@@ -0,0 +1,202 @@
+#include "fontmaster/BitmapUnpack.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FONTMASTER_BITMAP_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONTMASTER_BITMAP_NEON 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+// Таблицы разворачивания байта в значения альфы: первый пиксель - старшие биты
+struct ExpandTables {
+    uint8_t mono[256][8];
+    uint8_t gray2[256][4];
+    uint8_t gray4[256][2];
+
+    ExpandTables() {
+        for (int byte = 0; byte < 256; ++byte) {
+            for (int i = 0; i < 8; ++i) mono[byte][i] = (byte >> (7 - i)) & 1 ? 255 : 0;
+            for (int i = 0; i < 4; ++i) gray2[byte][i] = static_cast<uint8_t>(((byte >> (6 - i * 2)) & 3) * 85);
+            for (int i = 0; i < 2; ++i) gray4[byte][i] = static_cast<uint8_t>(((byte >> (4 - i * 4)) & 15) * 17);
+        }
+    }
+};
+
+const ExpandTables& expandTables() {
+    static const ExpandTables instance;
+    return instance;
+}
+
+// Альфа -> чёрный RGBA (0, 0, 0, a)
+void alphaToRGBA(const uint8_t* alpha, uint32_t count, uint8_t* out) {
+    uint32_t i = 0;
+#if defined(FONTMASTER_BITMAP_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha + i));
+        __m128i lo = _mm_unpacklo_epi8(zero, a);
+        __m128i hi = _mm_unpackhi_epi8(zero, a);
+        __m128i* dst = reinterpret_cast<__m128i*>(out + i * 4);
+        _mm_storeu_si128(dst, _mm_unpacklo_epi16(zero, lo));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(zero, lo));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(zero, hi));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(zero, hi));
+    }
+#elif defined(FONTMASTER_BITMAP_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = {{zero, zero, zero, vld1q_u8(alpha + i)}};
+        vst4q_u8(out + i * 4, pixels);
+    }
+#endif
+    for (; i < count; ++i) {
+        uint8_t* p = out + i * 4;
+        p[0] = p[1] = p[2] = 0;
+        p[3] = alpha[i];
+    }
+}
+
+// Premultiplied BGRA -> premultiplied RGBA
+void swapRedBlue(const uint8_t* src, uint32_t count, uint8_t* out) {
+    uint32_t i = 0;
+#if defined(FONTMASTER_BITMAP_SSE2)
+    const __m128i maskRB = _mm_set1_epi32(0x00FF00FF);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i rb = _mm_and_si128(v, maskRB);
+        __m128i ga = _mm_andnot_si128(maskRB, v);
+        // Перестановка 16-битных половин каждого пикселя меняет местами B и R
+        rb = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_or_si128(rb, ga));
+    }
+#elif defined(FONTMASTER_BITMAP_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+        uint8x16_t blue = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = blue;
+        vst4q_u8(out + i * 4, pixels);
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint8_t* s = src + i * 4;
+        uint8_t* p = out + i * 4;
+        p[0] = s[2];
+        p[1] = s[1];
+        p[2] = s[0];
+        p[3] = s[3];
+    }
+}
+
+// 1 бит -> альфа: байт размножается на 8 полос и сравнивается с масками битов
+void expandMono(const uint8_t* src, uint32_t count, uint8_t* alpha) {
+    uint32_t i = 0;
+#if defined(FONTMASTER_BITMAP_SSE2)
+    const __m128i bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    for (; i + 16 <= count; i += 16) {
+        uint16_t pair;
+        std::memcpy(&pair, src + i / 8, 2);
+        __m128i v = _mm_cvtsi32_si128(pair);
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_unpacklo_epi16(v, v);
+        v = _mm_unpacklo_epi32(v, v);
+        v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(alpha + i), v);
+    }
+#endif
+    const ExpandTables& tables = expandTables();
+    for (; i < count; i += 8) {
+        std::memcpy(alpha + i, tables.mono[src[i / 8]], 8);
+    }
+}
+
+void expandGray(const uint8_t* src, uint32_t count, uint8_t bitDepth, uint8_t* alpha) {
+    const ExpandTables& tables = expandTables();
+    switch (bitDepth) {
+        case 1:
+            expandMono(src, count, alpha);
+            break;
+        case 2:
+            for (uint32_t i = 0; i < count; i += 4) std::memcpy(alpha + i, tables.gray2[src[i / 4]], 4);
+            break;
+        case 4:
+            for (uint32_t i = 0; i < count; i += 2) std::memcpy(alpha + i, tables.gray4[src[i / 2]], 2);
+            break;
+    }
+}
+
+} // namespace
+
+size_t bitmapDataSize(uint32_t width, uint32_t height, uint8_t bitDepth, bool bitAligned) {
+    uint64_t rowBits = static_cast<uint64_t>(width) * bitDepth;
+    if (bitAligned) return static_cast<size_t>((rowBits * height + 7) / 8);
+    return static_cast<size_t>((rowBits + 7) / 8 * height);
+}
+
+void unpackBitmap(ByteSpan data, uint32_t width, uint32_t height, uint8_t bitDepth, bool bitAligned,
+                  uint8_t* rgba, size_t dstStride) {
+    if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 32) {
+        throw std::runtime_error("bitmap: unsupported bit depth " + std::to_string(bitDepth));
+    }
+    size_t required = bitmapDataSize(width, height, bitDepth, bitAligned);
+    if (data.size() < required) {
+        throw std::runtime_error("bitmap: " + std::to_string(data.size()) + " bytes, expected " +
+                                 std::to_string(required));
+    }
+    if (width == 0 || height == 0) return;
+
+    const size_t rowBytes = (static_cast<size_t>(width) * bitDepth + 7) / 8;
+    const uint8_t* src = data.data();
+
+    if (bitDepth == 32) {
+        for (uint32_t y = 0; y < height; ++y) {
+            swapRedBlue(src + y * rowBytes, width, rgba + y * dstStride);
+        }
+        return;
+    }
+
+    // Альфа пишется блоками до 16 пикселей, поэтому буфер с запасом; чтение строки не выходит за rowBytes
+    std::vector<uint8_t> alpha(bitDepth == 8 ? 0 : (width + 15) / 16 * 16);
+    std::vector<uint8_t> aligned(rowBytes + 2, 0);
+    const uint8_t* end = src + required;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* row;
+        uint64_t bitOffset = bitAligned ? static_cast<uint64_t>(y) * width * bitDepth
+                                        : static_cast<uint64_t>(y) * rowBytes * 8;
+        const uint8_t* start = src + bitOffset / 8;
+        unsigned shift = static_cast<unsigned>(bitOffset & 7);
+
+        if (shift == 0) {
+            row = start;
+        } else {
+            // Строка начинается с середины байта: сдвигаем в буфер
+            for (size_t k = 0; k < rowBytes; ++k) {
+                uint8_t next = start + k + 1 < end ? start[k + 1] : 0;
+                aligned[k] = static_cast<uint8_t>((start[k] << shift) | (next >> (8 - shift)));
+            }
+            row = aligned.data();
+        }
+
+        uint8_t* out = rgba + y * dstStride;
+        if (bitDepth == 8) {
+            alphaToRGBA(row, width, out);
+        } else {
+            expandGray(row, width, bitDepth, alpha.data());
+            alphaToRGBA(alpha.data(), width, out);
+        }
+    }
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,36 @@
+#include "fontmaster/ByteWriter.h"
+#include <algorithm>
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const size_t MIN_CAPACITY = 256;
+
+} // namespace
+
+void ByteWriter::grow(size_t count) {
+    // Удвоение: суммарно O(n) копирования при любой последовательности записей
+    size_t capacity = std::max({length + count, buffer.size() * 2, MIN_CAPACITY});
+    buffer.resize(capacity);
+}
+
+void ByteWriter::writeBE16(const uint16_t* values, size_t count) {
+    uint8_t* out = extend(count * 2);
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t value = toBigEndian16(values[i]);
+        std::memcpy(out + i * 2, &value, 2);
+    }
+}
+
+void ByteWriter::writeBE32(const uint32_t* values, size_t count) {
+    uint8_t* out = extend(count * 4);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = toBigEndian32(values[i]);
+        std::memcpy(out + i * 4, &value, 4);
+    }
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,772 @@
+#include "fontmaster/CFFCharstringInterpreter.h"
+#include "fontmaster/ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const size_t MAX_STACK = 96;          // Type 2 допускает 48, берём с запасом
+const int MAX_SUBR_DEPTH = 10;
+const size_t TRANSIENT_SIZE = 32;
+
+enum SubrState : uint8_t {
+    SUBR_UNKNOWN = 0,
+    SUBR_COMPUTING = 1,
+    SUBR_CACHED = 2,
+    SUBR_UNSAFE = 3
+};
+
+enum FirstOp : uint8_t {
+    OP_NONE = 0,
+    OP_DRAW = 1,
+    OP_MOVE = 2
+};
+
+int32_t subrBias(uint32_t count) {
+    if (count < 1240) return 107;
+    if (count < 33900) return 1131;
+    return 32768;
+}
+
+struct Bounds {
+    double xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+    bool valid = false;
+
+    void add(double x, double y) {
+        if (!valid) {
+            xMin = xMax = x;
+            yMin = yMax = y;
+            valid = true;
+            return;
+        }
+        xMin = std::min(xMin, x);
+        xMax = std::max(xMax, x);
+        yMin = std::min(yMin, y);
+        yMax = std::max(yMax, y);
+    }
+
+    void add(const Bounds& other, double dx, double dy) {
+        if (!other.valid) return;
+        add(other.xMin + dx, other.yMin + dy);
+        add(other.xMax + dx, other.yMax + dy);
+    }
+};
+
+// Корни производной кубической кривой на (0, 1) по одной оси
+int cubicExtremaT(double p0, double p1, double p2, double p3, double roots[2]) {
+    double lo = std::min(p0, p3);
+    double hi = std::max(p0, p3);
+    if (p1 >= lo && p1 <= hi && p2 >= lo && p2 <= hi) return 0;
+
+    double a = -p0 + 3 * p1 - 3 * p2 + p3;
+    double b = 2 * (p0 - 2 * p1 + p2);
+    double c = p1 - p0;
+    int count = 0;
+
+    if (std::fabs(a) < 1e-12) {
+        if (std::fabs(b) > 1e-12) {
+            double t = -c / b;
+            if (t > 0 && t < 1) roots[count++] = t;
+        }
+        return count;
+    }
+
+    double discriminant = b * b - 4 * a * c;
+    if (discriminant < 0) return 0;
+    double sq = std::sqrt(discriminant);
+    double t1 = (-b + sq) / (2 * a);
+    double t2 = (-b - sq) / (2 * a);
+    if (t1 > 0 && t1 < 1) roots[count++] = t1;
+    if (t2 > 0 && t2 < 1) roots[count++] = t2;
+    return count;
+}
+
+double cubicAt(double p0, double p1, double p2, double p3, double t) {
+    double mt = 1 - t;
+    return mt * mt * mt * p0 + 3 * mt * mt * t * p1 + 3 * mt * t * t * p2 + t * t * t * p3;
+}
+
+} // namespace
+
+/**
+ * Вклад подпрограммы относительно точки входа
+ */
+struct SubrSummary {
+    Bounds bounds;
+    double dx = 0, dy = 0;
+    uint32_t points = 0;
+    uint16_t contours = 0;
+    uint8_t firstOp = OP_NONE;
+    bool endsPending = false;
+};
+
+struct CFFCharstringInterpreter::SubrCache {
+    CFFIndex subrs;
+    int32_t bias;
+    // Заполняются во время анализа, поэтому mutable
+    mutable std::vector<std::atomic<uint8_t>> states;
+    mutable std::vector<SubrSummary> summaries;
+
+    explicit SubrCache(const CFFIndex& index)
+        : subrs(index), bias(subrBias(index.size())), states(index.size()), summaries(index.size()) {}
+};
+
+/**
+ * Состояние выполнения одного глифа
+ */
+struct CFFCharstringInterpreter::Context {
+    // Кадр записи вклада подпрограммы
+    struct Frame {
+        double entryX, entryY;
+        Bounds bounds;
+        uint32_t points = 0;
+        uint16_t contours = 0;
+        uint8_t firstOp = OP_NONE;
+        bool safe = true;
+    };
+
+    const CFFPrivateDict& privateDict;
+    const SubrCache& globalSubrs;
+    const SubrCache* localSubrs;
+
+    double stack[MAX_STACK];
+    size_t sp = 0;
+    double transient[TRANSIENT_SIZE] = {};
+
+    double x = 0, y = 0;
+    bool pendingMove = false;
+    bool widthParsed = false;
+    bool ended = false;
+    uint32_t nStems = 0;
+
+    Bounds bounds;
+    CFFGlyphMetrics metrics;
+
+    Frame frames[MAX_SUBR_DEPTH + 1];
+    int frameCount = 0;
+
+    Context(const CFFPrivateDict& priv, const SubrCache& global, const SubrCache* local)
+        : privateDict(priv), globalSubrs(global), localSubrs(local) {
+        metrics.advanceWidth = priv.defaultWidthX;
+    }
+
+    // ------------------------------------------------------------------ стек
+
+    void push(double value) {
+        if (sp >= MAX_STACK) throw std::runtime_error("CFF charstring: stack overflow");
+        stack[sp++] = value;
+    }
+
+    double pop() {
+        if (sp == 0) throw std::runtime_error("CFF charstring: stack underflow");
+        return stack[--sp];
+    }
+
+    void need(size_t count) const {
+        if (sp < count) throw std::runtime_error("CFF charstring: not enough operands");
+    }
+
+    void markUnsafe() {
+        for (int i = 0; i < frameCount; ++i) frames[i].safe = false;
+    }
+
+    // Первый оператор, очищающий стек, может нести ширину глифа
+    void parseWidth(bool hasExtraArgument) {
+        if (widthParsed) return;
+        widthParsed = true;
+        if (hasExtraArgument) {
+            metrics.advanceWidth = privateDict.nominalWidthX + stack[0];
+            std::copy(stack + 1, stack + sp, stack);
+            --sp;
+        }
+    }
+
+    // --------------------------------------------------------------- контуры
+
+    void addPoint(double px, double py) {
+        bounds.add(px, py);
+        for (int i = 0; i < frameCount; ++i) frames[i].bounds.add(px, py);
+    }
+
+    void countPoints(uint32_t count) {
+        metrics.numPoints += count;
+        for (int i = 0; i < frameCount; ++i) frames[i].points += count;
+    }
+
+    void markStarted(uint8_t op) {
+        for (int i = 0; i < frameCount; ++i) {
+            if (frames[i].firstOp == OP_NONE) frames[i].firstOp = op;
+        }
+    }
+
+    void beginDraw() {
+        if (pendingMove) {
+            // Точка moveto учитывается, только если за ней что-то нарисовано.
+            // Кадр, вошедший с уже отложенным moveto, его не считает.
+            pendingMove = false;
+            addPoint(x, y);
+            metrics.numPoints++;
+            metrics.numContours++;
+            for (int i = 0; i < frameCount; ++i) {
+                if (frames[i].firstOp != OP_NONE) {
+                    frames[i].points++;
+                    frames[i].contours++;
+                }
+            }
+        }
+        for (int i = 0; i < frameCount; ++i) {
+            if (frames[i].firstOp == OP_NONE) {
+                frames[i].firstOp = OP_DRAW;
+                frames[i].bounds.add(x, y);
+            }
+        }
+    }
+
+    void moveTo(double dx, double dy) {
+        markStarted(OP_MOVE);
+        x += dx;
+        y += dy;
+        pendingMove = true;
+    }
+
+    void lineTo(double dx, double dy) {
+        beginDraw();
+        x += dx;
+        y += dy;
+        addPoint(x, y);
+        countPoints(1);
+    }
+
+    void curveTo(double dx1, double dy1, double dx2, double dy2, double dx3, double dy3) {
+        beginDraw();
+        double x0 = x, y0 = y;
+        double x1 = x0 + dx1, y1 = y0 + dy1;
+        double x2 = x1 + dx2, y2 = y1 + dy2;
+        double x3 = x2 + dx3, y3 = y2 + dy3;
+
+        double roots[2];
+        int count = cubicExtremaT(x0, x1, x2, x3, roots);
+        for (int i = 0; i < count; ++i) {
+            addPoint(cubicAt(x0, x1, x2, x3, roots[i]), cubicAt(y0, y1, y2, y3, roots[i]));
+        }
+        count = cubicExtremaT(y0, y1, y2, y3, roots);
+        for (int i = 0; i < count; ++i) {
+            addPoint(cubicAt(x0, x1, x2, x3, roots[i]), cubicAt(y0, y1, y2, y3, roots[i]));
+        }
+
+        x = x3;
+        y = y3;
+        addPoint(x, y);
+        countPoints(3);
+    }
+
+    void applySummary(const SubrSummary& summary) {
+        if (summary.firstOp == OP_DRAW) {
+            beginDraw();
+        } else if (summary.firstOp == OP_MOVE) {
+            markStarted(OP_MOVE);
+        }
+
+        bounds.add(summary.bounds, x, y);
+        for (int i = 0; i < frameCount; ++i) frames[i].bounds.add(summary.bounds, x, y);
+
+        metrics.numPoints += summary.points;
+        metrics.numContours += summary.contours;
+        for (int i = 0; i < frameCount; ++i) {
+            frames[i].points += summary.points;
+            frames[i].contours += summary.contours;
+        }
+
+        x += summary.dx;
+        y += summary.dy;
+        if (summary.firstOp != OP_NONE) pendingMove = summary.endsPending;
+    }
+
+    // ------------------------------------------------------------ выполнение
+
+    void callSubr(const SubrCache& cache, int depth) {
+        int32_t index = static_cast<int32_t>(pop()) + cache.bias;
+        if (index < 0 || static_cast<uint32_t>(index) >= cache.subrs.size()) {
+            throw std::runtime_error("CFF charstring: subroutine index out of range");
+        }
+        if (depth >= MAX_SUBR_DEPTH) {
+            throw std::runtime_error("CFF charstring: subroutine nesting too deep");
+        }
+
+        ByteSpan code = cache.subrs.at(static_cast<uint32_t>(index));
+        std::atomic<uint8_t>& state = cache.states[index];
+
+        // Кэш применим только при "чистом" входе: результат тогда зависит лишь от точки входа
+        bool cleanEntry = (sp == 0 && widthParsed);
+        if (!cleanEntry) {
+            execute(code, depth + 1);
+            return;
+        }
+
+        uint8_t current = state.load(std::memory_order_acquire);
+        if (current == SUBR_CACHED) {
+            applySummary(cache.summaries[index]);
+            return;
+        }
+        if (current != SUBR_UNKNOWN ||
+            !state.compare_exchange_strong(current, SUBR_COMPUTING, std::memory_order_acq_rel)) {
+            execute(code, depth + 1);
+            return;
+        }
+
+        Frame& frame = frames[frameCount++];
+        frame = Frame();
+        frame.entryX = x;
+        frame.entryY = y;
+
+        try {
+            execute(code, depth + 1);
+        } catch (...) {
+            --frameCount;
+            state.store(SUBR_UNSAFE, std::memory_order_release);
+            throw;
+        }
+
+        Frame recorded = frames[--frameCount];
+        if (!recorded.safe || ended || sp != 0) {
+            state.store(SUBR_UNSAFE, std::memory_order_release);
+            return;
+        }
+
+        SubrSummary& summary = cache.summaries[index];
+        summary.bounds = recorded.bounds;
+        if (summary.bounds.valid) {
+            summary.bounds.xMin -= recorded.entryX;
+            summary.bounds.xMax -= recorded.entryX;
+            summary.bounds.yMin -= recorded.entryY;
+            summary.bounds.yMax -= recorded.entryY;
+        }
+        summary.dx = x - recorded.entryX;
+        summary.dy = y - recorded.entryY;
+        summary.points = recorded.points;
+        summary.contours = recorded.contours;
+        summary.firstOp = recorded.firstOp;
+        summary.endsPending = pendingMove;
+        state.store(SUBR_CACHED, std::memory_order_release);
+    }
+
+    void hintStems() {
+        markUnsafe();
+        parseWidth(sp % 2 != 0);
+        nStems += static_cast<uint32_t>(sp / 2);
+        sp = 0;
+    }
+
+    void execute(ByteSpan code, int depth) {
+        const uint8_t* p = code.data();
+        const uint8_t* end = p + code.size();
+
+        while (p < end && !ended) {
+            uint8_t b0 = *p++;
+
+            // Числа
+            if (b0 >= 32 && b0 <= 246) {
+                push(b0 - 139);
+                continue;
+            }
+            if (b0 >= 247 && b0 <= 250) {
+                if (p >= end) throw std::runtime_error("CFF charstring: truncated number");
+                push((b0 - 247) * 256 + *p++ + 108);
+                continue;
+            }
+            if (b0 >= 251 && b0 <= 254) {
+                if (p >= end) throw std::runtime_error("CFF charstring: truncated number");
+                push(-(b0 - 251) * 256 - *p++ - 108);
+                continue;
+            }
+            if (b0 == 28) {
+                if (end - p < 2) throw std::runtime_error("CFF charstring: truncated number");
+                push(static_cast<int16_t>((p[0] << 8) | p[1]));
+                p += 2;
+                continue;
+            }
+            if (b0 == 255) {
+                if (end - p < 4) throw std::runtime_error("CFF charstring: truncated number");
+                int32_t fixed = static_cast<int32_t>((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                                                     (uint32_t(p[2]) << 8) | p[3]);
+                push(fixed / 65536.0);
+                p += 4;
+                continue;
+            }
+
+            switch (b0) {
+            case 1:   // hstem
+            case 3:   // vstem
+            case 18:  // hstemhm
+            case 23:  // vstemhm
+                hintStems();
+                break;
+
+            case 19:  // hintmask
+            case 20: {// cntrmask
+                // Перед маской допускается неявный vstem
+                hintStems();
+                size_t maskBytes = (nStems + 7) / 8;
+                if (static_cast<size_t>(end - p) < maskBytes) {
+                    throw std::runtime_error("CFF charstring: truncated hintmask");
+                }
+                p += maskBytes;
+                break;
+            }
+
+            case 21:  // rmoveto
+                parseWidth(sp > 2);
+                need(2);
+                moveTo(stack[0], stack[1]);
+                sp = 0;
+                break;
+
+            case 22:  // hmoveto
+                parseWidth(sp > 1);
+                need(1);
+                moveTo(stack[0], 0);
+                sp = 0;
+                break;
+
+            case 4:   // vmoveto
+                parseWidth(sp > 1);
+                need(1);
+                moveTo(0, stack[0]);
+                sp = 0;
+                break;
+
+            case 5:   // rlineto
+                for (size_t i = 0; i + 1 < sp; i += 2) lineTo(stack[i], stack[i + 1]);
+                sp = 0;
+                break;
+
+            case 6:   // hlineto
+            case 7: { // vlineto
+                bool horizontal = (b0 == 6);
+                for (size_t i = 0; i < sp; ++i, horizontal = !horizontal) {
+                    if (horizontal) lineTo(stack[i], 0);
+                    else lineTo(0, stack[i]);
+                }
+                sp = 0;
+                break;
+            }
+
+            case 8:   // rrcurveto
+                for (size_t i = 0; i + 5 < sp; i += 6) {
+                    curveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                }
+                sp = 0;
+                break;
+
+            case 24: {// rcurveline
+                size_t i = 0;
+                for (; i + 7 < sp; i += 6) {
+                    curveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                }
+                if (i + 1 < sp) lineTo(stack[i], stack[i + 1]);
+                sp = 0;
+                break;
+            }
+
+            case 25: {// rlinecurve
+                size_t i = 0;
+                for (; i + 7 < sp; i += 2) lineTo(stack[i], stack[i + 1]);
+                if (i + 5 < sp) {
+                    curveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                }
+                sp = 0;
+                break;
+            }
+
+            case 26: {// vvcurveto
+                size_t i = 0;
+                double dx1 = 0;
+                if (sp % 4 == 1) dx1 = stack[i++];
+                for (; i + 3 < sp; i += 4) {
+                    curveTo(dx1, stack[i], stack[i + 1], stack[i + 2], 0, stack[i + 3]);
+                    dx1 = 0;
+                }
+                sp = 0;
+                break;
+            }
+
+            case 27: {// hhcurveto
+                size_t i = 0;
+                double dy1 = 0;
+                if (sp % 4 == 1) dy1 = stack[i++];
+                for (; i + 3 < sp; i += 4) {
+                    curveTo(stack[i], dy1, stack[i + 1], stack[i + 2], stack[i + 3], 0);
+                    dy1 = 0;
+                }
+                sp = 0;
+                break;
+            }
+
+            case 30:  // vhcurveto
+            case 31: {// hvcurveto
+                bool horizontal = (b0 == 31);
+                for (size_t i = 0; i + 3 < sp; i += 4, horizontal = !horizontal) {
+                    // Последняя группа может нести пятый аргумент
+                    double last = (i + 5 == sp) ? stack[i + 4] : 0;
+                    if (horizontal) {
+                        curveTo(stack[i], 0, stack[i + 1], stack[i + 2], last, stack[i + 3]);
+                    } else {
+                        curveTo(0, stack[i], stack[i + 1], stack[i + 2], stack[i + 3], last);
+                    }
+                }
+                sp = 0;
+                break;
+            }
+
+            case 10:  // callsubr
+                if (!localSubrs) throw std::runtime_error("CFF charstring: no local subroutines");
+                callSubr(*localSubrs, depth);
+                break;
+
+            case 29:  // callgsubr
+                callSubr(globalSubrs, depth);
+                break;
+
+            case 11:  // return
+                return;
+
+            case 14:  // endchar
+                // Аргументы seac (accent) устарели для OpenType и игнорируются
+                parseWidth(sp == 1 || sp == 5);
+                markUnsafe();
+                sp = 0;
+                ended = true;
+                return;
+
+            case 12: {
+                if (p >= end) throw std::runtime_error("CFF charstring: truncated escape operator");
+                executeEscape(*p++);
+                break;
+            }
+
+            default:
+                throw std::runtime_error("CFF charstring: reserved operator " + std::to_string(b0));
+            }
+        }
+    }
+
+    void executeEscape(uint8_t op) {
+        switch (op) {
+        case 3: { // and
+            double b = pop(), a = pop();
+            push((a != 0 && b != 0) ? 1 : 0);
+            break;
+        }
+        case 4: { // or
+            double b = pop(), a = pop();
+            push((a != 0 || b != 0) ? 1 : 0);
+            break;
+        }
+        case 5:   // not
+            push(pop() == 0 ? 1 : 0);
+            break;
+        case 9:   // abs
+            push(std::fabs(pop()));
+            break;
+        case 10: {// add
+            double b = pop(), a = pop();
+            push(a + b);
+            break;
+        }
+        case 11: {// sub
+            double b = pop(), a = pop();
+            push(a - b);
+            break;
+        }
+        case 12: {// div
+            double b = pop(), a = pop();
+            push(b != 0 ? a / b : 0);
+            break;
+        }
+        case 14:  // neg
+            push(-pop());
+            break;
+        case 15: {// eq
+            double b = pop(), a = pop();
+            push(a == b ? 1 : 0);
+            break;
+        }
+        case 18:  // drop
+            pop();
+            break;
+        case 20: {// put
+            markUnsafe();
+            double index = pop(), value = pop();
+            if (index >= 0 && index < TRANSIENT_SIZE) transient[static_cast<size_t>(index)] = value;
+            break;
+        }
+        case 21: {// get
+            markUnsafe();
+            double index = pop();
+            push(index >= 0 && index < TRANSIENT_SIZE ? transient[static_cast<size_t>(index)] : 0);
+            break;
+        }
+        case 22: {// ifelse
+            double v2 = pop(), v1 = pop(), s2 = pop(), s1 = pop();
+            push(v1 <= v2 ? s1 : s2);
+            break;
+        }
+        case 23:  // random
+            // Для габаритов берём середину диапазона (0, 1]
+            markUnsafe();
+            push(0.5);
+            break;
+        case 24: {// mul
+            double b = pop(), a = pop();
+            push(a * b);
+            break;
+        }
+        case 26:  // sqrt
+            push(std::sqrt(std::max(0.0, pop())));
+            break;
+        case 27: {// dup
+            double a = pop();
+            push(a);
+            push(a);
+            break;
+        }
+        case 28: {// exch
+            double b = pop(), a = pop();
+            push(b);
+            push(a);
+            break;
+        }
+        case 29: {// index
+            double i = pop();
+            need(1);
+            size_t n = i < 0 ? 0 : static_cast<size_t>(i);
+            push(n < sp ? stack[sp - 1 - n] : stack[sp - 1]);
+            break;
+        }
+        case 30: {// roll
+            int32_t j = static_cast<int32_t>(pop());
+            int32_t n = static_cast<int32_t>(pop());
+            if (n <= 0 || static_cast<size_t>(n) > sp) break;
+            j %= n;
+            if (j < 0) j += n;
+            std::rotate(stack + sp - n, stack + sp - j, stack + sp);
+            break;
+        }
+
+        case 34: {// hflex
+            need(7);
+            double* s = stack;
+            curveTo(s[0], 0, s[1], s[2], s[3], 0);
+            curveTo(s[4], 0, s[5], -s[2], s[6], 0);
+            sp = 0;
+            break;
+        }
+        case 35: {// flex
+            need(13);
+            double* s = stack;
+            curveTo(s[0], s[1], s[2], s[3], s[4], s[5]);
+            curveTo(s[6], s[7], s[8], s[9], s[10], s[11]);
+            sp = 0;
+            break;
+        }
+        case 36: {// hflex1
+            need(9);
+            double* s = stack;
+            double y0 = y;
+            curveTo(s[0], s[1], s[2], s[3], s[4], 0);
+            curveTo(s[5], 0, s[6], s[7], s[8], y0 - (y + s[7]));
+            sp = 0;
+            break;
+        }
+        case 37: {// flex1
+            need(11);
+            double* s = stack;
+            double dx = s[0] + s[2] + s[4] + s[6] + s[8];
+            double dy = s[1] + s[3] + s[5] + s[7] + s[9];
+            curveTo(s[0], s[1], s[2], s[3], s[4], s[5]);
+            if (std::fabs(dx) > std::fabs(dy)) {
+                curveTo(s[6], s[7], s[8], s[9], s[10], -dy);
+            } else {
+                curveTo(s[6], s[7], s[8], s[9], -dx, s[10]);
+            }
+            sp = 0;
+            break;
+        }
+
+        default:
+            throw std::runtime_error("CFF charstring: unsupported escape operator 12 " + std::to_string(op));
+        }
+    }
+};
+
+CFFCharstringInterpreter::CFFCharstringInterpreter(const CFFParser& cffParser)
+    : parser(cffParser),
+      globalCache(std::make_unique<SubrCache>(cffParser.getGlobalSubrs())) {
+    for (size_t fd = 0; fd < parser.getFontDictCount(); ++fd) {
+        localCaches.push_back(std::make_unique<SubrCache>(parser.getFontDictPrivate(fd).localSubrs));
+    }
+}
+
+CFFCharstringInterpreter::~CFFCharstringInterpreter() = default;
+
+const CFFCharstringInterpreter::SubrCache* CFFCharstringInterpreter::localCacheFor(uint16_t glyphID) const {
+    uint8_t fd = parser.getFDIndex(glyphID);
+    return fd < localCaches.size() ? localCaches[fd].get() : nullptr;
+}
+
+CFFGlyphMetrics CFFCharstringInterpreter::analyzeGlyph(uint16_t glyphID) const {
+    Context context(parser.getPrivateDict(glyphID), *globalCache, localCacheFor(glyphID));
+    context.execute(parser.getCharString(glyphID), 0);
+
+    CFFGlyphMetrics metrics = context.metrics;
+    if (context.bounds.valid) {
+        metrics.isEmpty = false;
+        metrics.xMin = context.bounds.xMin;
+        metrics.yMin = context.bounds.yMin;
+        metrics.xMax = context.bounds.xMax;
+        metrics.yMax = context.bounds.yMax;
+    }
+    return metrics;
+}
+
+std::vector<CFFGlyphMetrics> CFFCharstringInterpreter::analyzeAllGlyphs(ThreadPool* pool) const {
+    std::vector<CFFGlyphMetrics> result(parser.getNumGlyphs());
+
+    auto analyzeRange = [&](size_t begin, size_t end) {
+        for (size_t gid = begin; gid < end; ++gid) {
+            try {
+                result[gid] = analyzeGlyph(static_cast<uint16_t>(gid));
+            } catch (const std::exception& e) {
+                std::cerr << "CFF: Glyph " << gid << " charstring error: " << e.what() << std::endl;
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(0, result.size(), 256, analyzeRange);
+    } else {
+        analyzeRange(0, result.size());
+    }
+    return result;
+}
+
+size_t CFFCharstringInterpreter::getCachedSubroutineCount() const {
+    size_t count = 0;
+    auto countCache = [&count](const SubrCache& cache) {
+        for (const auto& state : cache.states) {
+            if (state.load(std::memory_order_relaxed) == SUBR_CACHED) ++count;
+        }
+    };
+    countCache(*globalCache);
+    for (const auto& cache : localCaches) countCache(*cache);
+    return count;
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -1,108 +1,333 @@
 #include "fontmaster/CFFParser.h"
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
 
 namespace fontmaster {
 namespace utils {
 
-CFFParser::CFFParser(const std::vector<uint8_t>& data, uint32_t offset) 
-    : fontData(data), baseOffset(offset) {}
+// ---------------------------------------------------------------------------
+// CFFIndex
 
-bool CFFParser::parse() {
-    if (fontData.size() < baseOffset + 4) {
-        std::cerr << "CFF: Font data too small" << std::endl;
-        return false;
+CFFIndex::CFFIndex(ByteSpan data) : bytes(data) {
+    count = data.readUInt16(0);
+    if (count == 0) {
+        totalLength = 2;
+        return;
     }
 
-    size_t offset = baseOffset;
-    const uint8_t* current = fontData.data() + baseOffset;
+    offSize = data.readUInt8(2);
+    if (offSize < 1 || offSize > 4) {
+        throw std::runtime_error("CFF: invalid INDEX offSize " + std::to_string(offSize));
+    }
 
-    // Parse CFF header
-    uint8_t major = current[0];
-    (void)current[1]; // minor
-    uint8_t hdrSize = current[2];
-    (void)current[3]; // offSize
+    // Смещения отсчитываются от байта перед данными и начинаются с 1
+    dataStart = 3 + static_cast<size_t>(count + 1) * offSize - 1;
+    if (dataStart + 1 > data.size()) {
+        throw std::runtime_error("CFF: INDEX offset array out of bounds");
+    }
 
-    if (major != 1) {
-        std::cerr << "CFF: Unsupported major version: " << static_cast<int>(major) << std::endl;
-        return false;
+    uint32_t lastOffset = readOffset(count);
+    if (lastOffset < 1 || dataStart + lastOffset > data.size()) {
+        throw std::runtime_error("CFF: INDEX data out of bounds");
     }
+    totalLength = dataStart + lastOffset;
+}
 
-    offset = baseOffset + hdrSize;
+uint32_t CFFIndex::readOffset(uint32_t index) const {
+    const uint8_t* p = bytes.data() + 3 + static_cast<size_t>(index) * offSize;
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < offSize; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
 
-    // Parse Name INDEX
-    if (!parseIndex(offset)) {
-        std::cerr << "CFF: Failed to parse Name INDEX" << std::endl;
-        return false;
+ByteSpan CFFIndex::at(uint32_t index) const {
+    if (index >= count) {
+        throw std::out_of_range("CFF: INDEX element " + std::to_string(index) + " out of range");
     }
 
-    // Parse Top DICT INDEX
-    if (!parseIndex(offset)) {
-        std::cerr << "CFF: Failed to parse Top DICT INDEX" << std::endl;
-        return false;
+    uint32_t start = readOffset(index);
+    uint32_t end = readOffset(index + 1);
+    if (start < 1 || end < start || dataStart + end > totalLength) {
+        throw std::runtime_error("CFF: corrupt INDEX offsets");
     }
+    return bytes.subspan(dataStart + start, end - start);
+}
 
-    // Parse String INDEX
-    if (!parseIndex(offset)) {
-        std::cerr << "CFF: Failed to parse String INDEX" << std::endl;
-        return false;
+// ---------------------------------------------------------------------------
+// CFFParser
+
+namespace {
+
+// Операторы DICT (escape-операторы 12 x кодируются как 0x0C00 | x)
+const uint16_t OP_CHARSTRINGS = 17;
+const uint16_t OP_PRIVATE = 18;
+const uint16_t OP_SUBRS = 19;
+const uint16_t OP_DEFAULT_WIDTH_X = 20;
+const uint16_t OP_NOMINAL_WIDTH_X = 21;
+const uint16_t OP_CHARSTRING_TYPE = 0x0C00 | 6;
+const uint16_t OP_ROS = 0x0C00 | 30;
+const uint16_t OP_FDARRAY = 0x0C00 | 36;
+const uint16_t OP_FDSELECT = 0x0C00 | 37;
+
+double parseReal(ByteSpan dict, size_t& pos) {
+    static const char* const nibbleText[] = {
+        "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ".", "E", "E-", "", "-", ""
+    };
+
+    std::string text;
+    while (true) {
+        uint8_t byte = dict.readUInt8(pos++);
+        uint8_t high = byte >> 4;
+        uint8_t low = byte & 0x0F;
+        if (high == 0x0F) break;
+        text += nibbleText[high];
+        if (low == 0x0F) break;
+        text += nibbleText[low];
     }
+    return std::strtod(text.c_str(), nullptr);
+}
 
-    // Parse Global Subr INDEX
-    if (!parseIndex(offset)) {
-        std::cerr << "CFF: Failed to parse Global Subr INDEX" << std::endl;
+// Операнды DICT - double: отрицательное значение, NaN или выход за таблицу
+// нельзя приводить к size_t, иначе получится огромное смещение
+bool toTableOffset(double value, size_t limit, size_t& result) {
+    if (!(value >= 0.0) || value > static_cast<double>(limit)) {
         return false;
     }
-
-    std::cout << "CFF: Successfully parsed CFF data" << std::endl;
+    result = static_cast<size_t>(value);
     return true;
 }
 
-bool CFFParser::parseIndex(size_t& offset) {
-    if (offset + 2 > fontData.size()) {
-        return false;
+} // namespace
+
+CFFParser::CFFParser(const std::vector<uint8_t>& data, uint32_t offset, uint32_t length) {
+    if (offset > data.size()) {
+        throw std::out_of_range("CFF: table offset beyond font data");
     }
+    size_t available = data.size() - offset;
+    cff = ByteSpan(data.data() + offset, length == 0 ? available : std::min<size_t>(length, available));
+}
 
-    const uint8_t* data = fontData.data() + offset;
-    uint16_t count = (data[0] << 8) | data[1];
+CFFParser::CFFParser(ByteSpan cffTable) : cff(cffTable) {}
 
-    if (count == 0) {
-        offset += 2;
+CFFIndex CFFParser::indexAt(size_t offset) const {
+    return CFFIndex(cff.subspan(offset));
+}
+
+std::vector<CFFParser::DictEntry> CFFParser::parseDict(ByteSpan dict) {
+    std::vector<DictEntry> entries;
+    std::vector<double> operands;
+    size_t pos = 0;
+
+    while (pos < dict.size()) {
+        uint8_t b0 = dict.readUInt8(pos++);
+
+        if (b0 <= 21) {
+            uint16_t op = b0;
+            if (b0 == 12) {
+                op = 0x0C00 | dict.readUInt8(pos++);
+            }
+            entries.push_back(DictEntry{op, std::move(operands)});
+            operands.clear();
+        } else if (b0 == 28) {
+            operands.push_back(dict.readInt16(pos));
+            pos += 2;
+        } else if (b0 == 29) {
+            operands.push_back(static_cast<int32_t>(dict.readUInt32(pos)));
+            pos += 4;
+        } else if (b0 == 30) {
+            operands.push_back(parseReal(dict, pos));
+        } else if (b0 >= 32 && b0 <= 246) {
+            operands.push_back(b0 - 139);
+        } else if (b0 >= 247 && b0 <= 250) {
+            operands.push_back((b0 - 247) * 256 + dict.readUInt8(pos++) + 108);
+        } else if (b0 >= 251 && b0 <= 254) {
+            operands.push_back(-(b0 - 251) * 256 - dict.readUInt8(pos++) - 108);
+        } else {
+            throw std::runtime_error("CFF: invalid DICT byte " + std::to_string(b0));
+        }
+    }
+
+    return entries;
+}
+
+const CFFParser::DictEntry* CFFParser::findEntry(const std::vector<DictEntry>& entries,
+                                                 uint16_t op, size_t minOperands) {
+    for (const auto& entry : entries) {
+        if (entry.op == op && entry.operands.size() >= minOperands) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool CFFParser::parsePrivateDict(const std::vector<DictEntry>& fontDict, CFFPrivateDict& result) const {
+    const DictEntry* privateEntry = findEntry(fontDict, OP_PRIVATE, 2);
+    if (!privateEntry) {
+        // Private DICT обязателен, но пустой допустим
         return true;
     }
 
-    if (offset + 2 + 1 > fontData.size()) {
+    size_t privateSize = 0;
+    size_t privateOffset = 0;
+    if (!toTableOffset(privateEntry->operands[1], cff.size(), privateOffset) ||
+        !toTableOffset(privateEntry->operands[0], cff.size() - privateOffset, privateSize)) {
+        std::cerr << "CFF: Private DICT size/offset out of range" << std::endl;
         return false;
     }
+    ByteSpan privateBytes = cff.subspan(privateOffset, privateSize);
+    auto entries = parseDict(privateBytes);
+
+    if (const DictEntry* entry = findEntry(entries, OP_DEFAULT_WIDTH_X, 1)) {
+        result.defaultWidthX = entry->operands[0];
+    }
+    if (const DictEntry* entry = findEntry(entries, OP_NOMINAL_WIDTH_X, 1)) {
+        result.nominalWidthX = entry->operands[0];
+    }
+    if (const DictEntry* entry = findEntry(entries, OP_SUBRS, 1)) {
+        // Смещение Subrs отсчитывается от начала Private DICT
+        size_t subrsOffset = 0;
+        if (!toTableOffset(entry->operands[0], cff.size() - privateOffset, subrsOffset)) {
+            std::cerr << "CFF: Local Subrs offset out of range" << std::endl;
+            return false;
+        }
+        result.localSubrs = indexAt(privateOffset + subrsOffset);
+    }
+    return true;
+}
+
+bool CFFParser::parse() {
+    try {
+        if (cff.size() < 4) {
+            std::cerr << "CFF: Font data too small" << std::endl;
+            return false;
+        }
+
+        uint8_t major = cff.readUInt8(0);
+        uint8_t hdrSize = cff.readUInt8(2);
+        if (major != 1) {
+            std::cerr << "CFF: Unsupported major version: " << static_cast<int>(major) << std::endl;
+            return false;
+        }
+
+        // Четыре INDEX подряд: Name, Top DICT, String, Global Subr
+        size_t offset = hdrSize;
+        names = indexAt(offset);
+        offset += names.byteLength();
+        topDicts = indexAt(offset);
+        offset += topDicts.byteLength();
+        strings = indexAt(offset);
+        offset += strings.byteLength();
+        globalSubrs = indexAt(offset);
 
-    uint8_t offSize = data[2];
-    // Убраны неиспользуемые переменные
-    // size_t objectDataStart = indexStart + (count + 1) * offSize;
+        if (names.empty() || topDicts.empty()) {
+            std::cerr << "CFF: Empty Name or Top DICT INDEX" << std::endl;
+            return false;
+        }
 
-    // Calculate total index size
-    size_t indexSize = 2 + 1 + (count + 1) * offSize;
+        ByteSpan name = names.at(0);
+        fontName.assign(name.begin(), name.end());
 
-    // Read offsets to calculate object data size
-    (void)readOffset(data + 3, offSize); // firstOffset
-    uint32_t lastOffset = readOffset(data + 3 + count * offSize, offSize);
-    size_t objectDataSize = lastOffset - 1;
+        // В OpenType CFF ровно один шрифт, поэтому берём первый Top DICT
+        auto topDict = parseDict(topDicts.at(0));
 
-    indexSize += objectDataSize;
+        if (const DictEntry* entry = findEntry(topDict, OP_CHARSTRING_TYPE, 1)) {
+            charstringType = static_cast<int>(entry->operands[0]);
+        }
 
-    if (offset + indexSize > fontData.size()) {
+        const DictEntry* charStringsEntry = findEntry(topDict, OP_CHARSTRINGS, 1);
+        if (!charStringsEntry) {
+            std::cerr << "CFF: CharStrings offset missing in Top DICT" << std::endl;
+            return false;
+        }
+        size_t charStringsOffset = 0;
+        if (!toTableOffset(charStringsEntry->operands[0], cff.size(), charStringsOffset)) {
+            std::cerr << "CFF: CharStrings offset out of range" << std::endl;
+            return false;
+        }
+        charStrings = indexAt(charStringsOffset);
+
+        cidFont = findEntry(topDict, OP_ROS, 3) != nullptr;
+        fdPrivateDicts.clear();
+        fdSelect = ByteSpan();
+
+        if (cidFont) {
+            const DictEntry* fdArrayEntry = findEntry(topDict, OP_FDARRAY, 1);
+            const DictEntry* fdSelectEntry = findEntry(topDict, OP_FDSELECT, 1);
+            if (!fdArrayEntry || !fdSelectEntry) {
+                std::cerr << "CFF: CID font without FDArray/FDSelect" << std::endl;
+                return false;
+            }
+
+            size_t fdArrayOffset = 0;
+            size_t fdSelectOffset = 0;
+            if (!toTableOffset(fdArrayEntry->operands[0], cff.size(), fdArrayOffset) ||
+                !toTableOffset(fdSelectEntry->operands[0], cff.size(), fdSelectOffset)) {
+                std::cerr << "CFF: FDArray/FDSelect offset out of range" << std::endl;
+                return false;
+            }
+
+            CFFIndex fdArray = indexAt(fdArrayOffset);
+            fdPrivateDicts.resize(fdArray.size());
+            for (uint32_t i = 0; i < fdArray.size(); ++i) {
+                if (!parsePrivateDict(parseDict(fdArray.at(i)), fdPrivateDicts[i])) {
+                    return false;
+                }
+            }
+
+            fdSelect = cff.subspan(fdSelectOffset);
+            fdSelectFormat = fdSelect.readUInt8(0);
+            if (fdSelectFormat != 0 && fdSelectFormat != 3) {
+                std::cerr << "CFF: Unsupported FDSelect format: "
+                          << static_cast<int>(fdSelectFormat) << std::endl;
+                return false;
+            }
+        } else {
+            privateDict = CFFPrivateDict();
+            if (!parsePrivateDict(topDict, privateDict)) {
+                return false;
+            }
+        }
+
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "CFF: " << e.what() << std::endl;
         return false;
     }
+}
 
-    offset += indexSize;
-    return true;
+uint8_t CFFParser::getFDIndex(uint16_t glyphID) const {
+    if (!cidFont) return 0;
+
+    if (fdSelectFormat == 0) {
+        return fdSelect.readUInt8(1 + glyphID);
+    }
+
+    // Формат 3: nRanges, {first, fd}[nRanges], sentinel - двоичный поиск по first
+    uint16_t nRanges = fdSelect.readUInt16(1);
+    uint16_t lo = 0;
+    uint16_t hi = nRanges;
+    while (lo + 1 < hi) {
+        uint16_t mid = static_cast<uint16_t>((lo + hi) / 2);
+        if (fdSelect.readUInt16(3 + mid * 3) <= glyphID) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return nRanges == 0 ? 0 : fdSelect.readUInt8(3 + lo * 3 + 2);
 }
 
-uint32_t CFFParser::readOffset(const uint8_t* data, uint8_t offSize) {
-    uint32_t offset = 0;
-    for (uint8_t i = 0; i < offSize; ++i) {
-        offset = (offset << 8) | data[i];
+const CFFPrivateDict& CFFParser::getPrivateDict(uint16_t glyphID) const {
+    if (!cidFont) return privateDict;
+
+    uint8_t fd = getFDIndex(glyphID);
+    if (fd >= fdPrivateDicts.size()) {
+        throw std::runtime_error("CFF: FDSelect refers to missing Font DICT " + std::to_string(fd));
     }
-    return offset;
+    return fdPrivateDicts[fd];
 }
 
 } // namespace utils
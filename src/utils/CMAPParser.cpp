@@ -1,242 +1,211 @@
-#ifndef CMAPPARSER_H
-#define CMAPPARSER_H
-
-#include <vector>
-#include <map>
-#include <set>
-#include <cstdint>
-#include <string>
+#include "fontmaster/CMAPParser.h"
+#include "fontmaster/PhaseTimer.h"
+#include <algorithm>
 #include <stdexcept>
-#include <iostream>
 
 namespace fontmaster {
 namespace utils {
 
-struct CMAPRange {
-    uint32_t startChar;
-    uint32_t endChar;
-    uint16_t startGlyph;
-};
+namespace {
 
-class CMAPParser {
-public:
-    CMAPParser(const std::vector<uint8_t>& fontData, bool verbose = false)
-        : fontData(fontData), verbose(verbose) {}
+// Группы форматов 12/13 дальше последнего кода Unicode - мусор, а не миллиарды отображений
+const uint32_t MAX_CODEPOINT = 0x10FFFF;
 
-    void parse() {
-        if (fontData.size() < 4)
-            throw std::runtime_error("CMAP: Font data too small");
+bool isUnicodeEncoding(uint16_t platformID, uint16_t encodingID) {
+    return platformID == 0 || (platformID == 3 && (encodingID == 1 || encodingID == 10));
+}
 
-        uint16_t version = readUInt16(fontData.data());
-        uint16_t numTables = readUInt16(fontData.data() + 2);
+} // namespace
 
-        if (version != 0)
-            throw std::runtime_error("CMAP: Unsupported version: " + std::to_string(version));
+CMAPParser::CMAPParser(const std::vector<uint8_t>& fontData) : fontData(fontData) {}
 
-        if (verbose) std::cout << "CMAP: Parsing " << numTables << " subtables\n";
+bool CMAPParser::parse() {
+    ScopedPhase phase("cmap");
+    charToGlyph.clear();
+    glyphToChar.clear();
+    if (fontData.size() < 4) return false;
 
-        for (uint16_t i = 0; i < numTables; ++i) {
-            uint32_t tableOffset = 4 + i * 8;
-            if (tableOffset + 8 > fontData.size())
-                throw std::runtime_error("CMAP: Table record out of bounds");
+    uint16_t version = readUInt16(fontData.data());
+    uint16_t numTables = readUInt16(fontData.data() + 2);
+    if (version != 0 || 4 + static_cast<size_t>(numTables) * 8 > fontData.size()) return false;
 
-            uint16_t platformID = readUInt16(fontData.data() + tableOffset);
-            uint16_t encodingID = readUInt16(fontData.data() + tableOffset + 2);
-            uint32_t subtableOffset = readUInt32(fontData.data() + tableOffset + 4);
-
-            if (subtableOffset >= fontData.size())
-                throw std::runtime_error("CMAP: Subtable offset out of bounds");
-
-            parseSubtable(subtableOffset, platformID, encodingID);
-        }
+    // Подтаблицы Unicode согласованы между собой; Mac Roman и прочие кодировки дали бы
+    // коды не из Unicode, поэтому они читаются, только если Unicode-подтаблиц нет
+    bool hasUnicode = false;
+    for (uint16_t i = 0; i < numTables; ++i) {
+        const uint8_t* record = fontData.data() + 4 + i * 8;
+        hasUnicode = hasUnicode || isUnicodeEncoding(readUInt16(record), readUInt16(record + 2));
     }
 
-    uint16_t getGlyphIndex(uint32_t charCode) const {
-        auto it = charToGlyph.find(charCode);
-        if (it != charToGlyph.end()) return it->second;
+    for (uint16_t i = 0; i < numTables; ++i) {
+        const uint8_t* record = fontData.data() + 4 + i * 8;
+        uint16_t platformID = readUInt16(record);
+        uint16_t encodingID = readUInt16(record + 2);
+        uint32_t offset = readUInt32(record + 4);
+        if (hasUnicode && !isUnicodeEncoding(platformID, encodingID)) continue;
+        if (static_cast<size_t>(offset) + 2 > fontData.size()) continue;
 
-        // Быстрый поиск в диапазонах
-        for (const auto& range : ranges) {
-            if (charCode >= range.startChar && charCode <= range.endChar) {
-                return static_cast<uint16_t>(range.startGlyph + (charCode - range.startChar));
-            }
+        // Повреждённая подтаблица не мешает остальным
+        try {
+            parseSubtable(offset, platformID, encodingID);
+        } catch (const std::exception&) {
         }
-        return 0;
-    }
-
-    std::set<uint32_t> getCharCodes(uint16_t glyphIndex) const {
-        std::set<uint32_t> codes;
-        auto it = glyphToChar.find(glyphIndex);
-        if (it != glyphToChar.end()) codes = it->second;
-
-        for (const auto& range : ranges) {
-            if (glyphIndex >= range.startGlyph && glyphIndex <= range.startGlyph + (range.endChar - range.startChar)) {
-                for (uint32_t c = range.startChar; c <= range.endChar; ++c) {
-                    if (range.startGlyph + (c - range.startChar) == glyphIndex)
-                        codes.insert(c);
-                }
-            }
-        }
-        return codes;
-    }
-
-private:
-    const std::vector<uint8_t>& fontData;
-    std::map<uint32_t, uint16_t> charToGlyph;
-    std::map<uint16_t, std::set<uint32_t>> glyphToChar;
-    std::vector<CMAPRange> ranges;
-    bool verbose;
-
-    void parseSubtable(uint32_t offset, uint16_t platformID, uint16_t encodingID) {
-        if (offset + 2 > fontData.size()) return;
-        uint16_t format = readUInt16(fontData.data() + offset);
-
-        switch (format) {
-            case 0: parseFormat0(offset); break;
-            case 2: parseFormat2(offset); break;
-            case 4: parseFormat4(offset); break;
-            case 6: parseFormat6(offset); break;
-            case 8: parseFormat8(offset); break;
-            case 10: parseFormat10(offset); break;
-            case 12: parseFormat12(offset); break;
-            case 13: parseFormat13(offset); break;
-            case 14: parseFormat14(offset); break;
-            default:
-                if (verbose) std::cout << "CMAP: Unsupported format: " << format << "\n";
-                break;
-        }
-    }
-
-    // ======================= Форматы =========================
-    void parseFormat0(uint32_t offset) {
-        if (offset + 6 + 256 > fontData.size()) throw std::runtime_error("CMAP: Format 0 too small");
-        for (int i = 0; i < 256; ++i) {
-            uint8_t g = fontData[offset + 6 + i];
-            if (g != 0) {
-                charToGlyph[i] = g;
-                glyphToChar[g].insert(i);
-            }
-        }
-        if (verbose) std::cout << "CMAP: Format 0 parsed\n";
-    }
-
-    void parseFormat2(uint32_t offset) {
-        if (verbose) std::cout << "CMAP: Format 2 (high-byte mapping) not fully implemented\n";
     }
-
-    void parseFormat4(uint32_t offset) {
-        if (offset + 14 > fontData.size()) throw std::runtime_error("CMAP: Format 4 too small");
-        uint16_t segCountX2 = readUInt16Safe(offset + 6);
-        uint16_t segCount = segCountX2 / 2;
-
-        uint32_t endCountOffset = offset + 14;
-        uint32_t startCountOffset = endCountOffset + segCountX2 + 2;
-        uint32_t idDeltaOffset = startCountOffset + segCountX2;
-        uint32_t idRangeOffsetOffset = idDeltaOffset + segCountX2;
-
-        for (uint16_t i = 0; i < segCount; ++i) {
-            uint16_t endCount = readUInt16Safe(endCountOffset + i * 2);
-            uint16_t startCount = readUInt16Safe(startCountOffset + i * 2);
-            int16_t idDelta = readInt16Safe(idDeltaOffset + i * 2);
-            uint16_t idRangeOffset = readUInt16Safe(idRangeOffsetOffset + i * 2);
-
-            if (startCount == 0xFFFF && endCount == 0xFFFF) break;
-
-            for (uint32_t c = startCount; c <= endCount; ++c) {
-                uint16_t glyph = 0;
-                if (idRangeOffset == 0) {
-                    glyph = (c + idDelta) & 0xFFFF;
-                } else {
-                    uint32_t glyphOffset = idRangeOffsetOffset + i * 2 + idRangeOffset + (c - startCount) * 2;
-                    if (glyphOffset + 2 <= fontData.size()) {
-                        glyph = readUInt16(fontData.data() + glyphOffset);
-                        if (glyph != 0) glyph = (glyph + idDelta) & 0xFFFF;
-                    }
-                }
-                if (glyph != 0) {
-                    charToGlyph[c] = glyph;
-                    glyphToChar[glyph].insert(c);
-                }
+    return true;
+}
+
+uint16_t CMAPParser::getGlyphIndex(uint32_t charCode) const {
+    auto it = charToGlyph.find(charCode);
+    return it != charToGlyph.end() ? it->second : 0;
+}
+
+std::set<uint32_t> CMAPParser::getCharCodes(uint16_t glyphIndex) const {
+    auto it = glyphToChar.find(glyphIndex);
+    return it != glyphToChar.end() ? it->second : std::set<uint32_t>();
+}
+
+void CMAPParser::parseSubtable(uint32_t offset, uint16_t platformID, uint16_t encodingID) {
+    switch (readUInt16(fontData.data() + offset)) {
+        case 0: parseFormat0(offset, platformID, encodingID); break;
+        case 2: parseFormat2(offset, platformID, encodingID); break;
+        case 4: parseFormat4(offset, platformID, encodingID); break;
+        case 6: parseFormat6(offset, platformID, encodingID); break;
+        case 8: parseFormat8(offset, platformID, encodingID); break;
+        case 10: parseFormat10(offset, platformID, encodingID); break;
+        case 12: parseFormat12(offset, platformID, encodingID); break;
+        case 13: parseFormat13(offset, platformID, encodingID); break;
+        case 14: parseFormat14(offset, platformID, encodingID); break;
+        default: break;
+    }
+}
+
+void CMAPParser::parseFormat0(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 6 + 256 > fontData.size()) throw std::runtime_error("CMAP: Format 0 too small");
+    for (uint32_t c = 0; c < 256; ++c) {
+        uint16_t glyph = fontData[offset + 6 + c];
+        if (glyph != 0 && charToGlyph.emplace(c, glyph).second) glyphToChar[glyph].insert(c);
+    }
+}
+
+void CMAPParser::parseFormat2(uint32_t, uint16_t, uint16_t) {
+    // Многобайтовые кодировки CJK до Unicode: коды не из Unicode, не разбираем
+}
+
+void CMAPParser::parseFormat4(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 14 > fontData.size()) throw std::runtime_error("CMAP: Format 4 too small");
+    uint16_t segCountX2 = readUInt16(fontData.data() + offset + 6);
+    uint16_t segCount = segCountX2 / 2;
+
+    size_t endCountOffset = static_cast<size_t>(offset) + 14;
+    size_t startCountOffset = endCountOffset + segCountX2 + 2;
+    size_t idDeltaOffset = startCountOffset + segCountX2;
+    size_t idRangeOffsetOffset = idDeltaOffset + segCountX2;
+    if (idRangeOffsetOffset + segCountX2 > fontData.size()) throw std::runtime_error("CMAP: Format 4 segments out of bounds");
+
+    for (uint16_t i = 0; i < segCount; ++i) {
+        uint16_t endCount = readUInt16(fontData.data() + endCountOffset + i * 2);
+        uint16_t startCount = readUInt16(fontData.data() + startCountOffset + i * 2);
+        int16_t idDelta = readInt16(fontData.data() + idDeltaOffset + i * 2);
+        uint16_t idRangeOffset = readUInt16(fontData.data() + idRangeOffsetOffset + i * 2);
+        if (startCount == 0xFFFF && endCount == 0xFFFF) break;
+
+        for (uint32_t c = startCount; c <= endCount; ++c) {
+            uint16_t glyph = 0;
+            if (idRangeOffset == 0) {
+                glyph = static_cast<uint16_t>(c + idDelta);
+            } else {
+                size_t glyphOffset = idRangeOffsetOffset + i * 2 + idRangeOffset + (c - startCount) * 2;
+                if (glyphOffset + 2 > fontData.size()) break;
+                glyph = readUInt16(fontData.data() + glyphOffset);
+                if (glyph != 0) glyph = static_cast<uint16_t>(glyph + idDelta);
             }
+            if (glyph != 0 && charToGlyph.emplace(c, glyph).second) glyphToChar[glyph].insert(c);
         }
-        if (verbose) std::cout << "CMAP: Format 4 parsed\n";
     }
-
-    void parseFormat6(uint32_t offset) {
-        uint16_t firstCode = readUInt16Safe(offset + 6);
-        uint16_t entryCount = readUInt16Safe(offset + 8);
-        for (uint16_t i = 0; i < entryCount; ++i) {
-            uint16_t g = readUInt16Safe(offset + 10 + i * 2);
-            if (g != 0) {
-                charToGlyph[firstCode + i] = g;
-                glyphToChar[g].insert(firstCode + i);
+}
+
+void CMAPParser::parseFormat6(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 10 > fontData.size()) throw std::runtime_error("CMAP: Format 6 too small");
+    uint16_t firstCode = readUInt16(fontData.data() + offset + 6);
+    uint16_t entryCount = readUInt16(fontData.data() + offset + 8);
+    if (static_cast<size_t>(offset) + 10 + entryCount * 2 > fontData.size()) {
+        throw std::runtime_error("CMAP: Format 6 entries out of bounds");
+    }
+    for (uint16_t i = 0; i < entryCount; ++i) {
+        uint16_t glyph = readUInt16(fontData.data() + offset + 10 + i * 2);
+        uint32_t c = static_cast<uint32_t>(firstCode) + i;
+        if (glyph != 0 && charToGlyph.emplace(c, glyph).second) glyphToChar[glyph].insert(c);
+    }
+}
+
+void CMAPParser::parseFormat8(uint32_t, uint16_t, uint16_t) {
+    // Смешанные 16/32-битные коды устарели и в шрифтах не встречаются
+}
+
+void CMAPParser::parseFormat10(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 20 > fontData.size()) throw std::runtime_error("CMAP: Format 10 too small");
+    uint32_t startCharCode = readUInt32(fontData.data() + offset + 12);
+    uint32_t numChars = readUInt32(fontData.data() + offset + 16);
+    if (numChars > (fontData.size() - offset - 20) / 2) throw std::runtime_error("CMAP: Format 10 entries out of bounds");
+    for (uint32_t i = 0; i < numChars && startCharCode + i <= MAX_CODEPOINT; ++i) {
+        uint16_t glyph = readUInt16(fontData.data() + offset + 20 + i * 2);
+        if (glyph != 0 && charToGlyph.emplace(startCharCode + i, glyph).second) glyphToChar[glyph].insert(startCharCode + i);
+    }
+}
+
+void CMAPParser::parseFormat12(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 16 > fontData.size()) throw std::runtime_error("CMAP: Format 12 too small");
+    uint32_t numGroups = readUInt32(fontData.data() + offset + 12);
+    if (numGroups > (fontData.size() - offset - 16) / 12) throw std::runtime_error("CMAP: Format 12 groups out of bounds");
+    for (uint32_t i = 0; i < numGroups; ++i) {
+        const uint8_t* group = fontData.data() + offset + 16 + i * 12;
+        uint32_t startChar = readUInt32(group);
+        uint32_t endChar = std::min(readUInt32(group + 4), MAX_CODEPOINT);
+        uint32_t startGlyph = readUInt32(group + 8);
+        for (uint32_t c = startChar; c <= endChar; ++c) {
+            uint32_t glyph = startGlyph + (c - startChar);
+            if (glyph > 0xFFFF) break;
+            if (glyph != 0 && charToGlyph.emplace(c, static_cast<uint16_t>(glyph)).second) {
+                glyphToChar[static_cast<uint16_t>(glyph)].insert(c);
             }
         }
-        if (verbose) std::cout << "CMAP: Format 6 parsed\n";
     }
-
-    void parseFormat8(uint32_t offset) {
-        if (verbose) std::cout << "CMAP: Format 8 (mixed 16/32-bit) not implemented\n";
-    }
-
-    void parseFormat10(uint32_t offset) {
-        if (verbose) std::cout << "CMAP: Format 10 (32-bit) not implemented\n";
-    }
-
-    void parseFormat12(uint32_t offset) {
-        uint32_t numGroups = readUInt32Safe(offset + 12);
-        for (uint32_t i = 0; i < numGroups; ++i) {
-            uint32_t groupOffset = offset + 16 + i * 12;
-            uint32_t startChar = readUInt32Safe(groupOffset);
-            uint32_t endChar = readUInt32Safe(groupOffset + 4);
-            uint16_t startGlyph = static_cast<uint16_t>(readUInt32Safe(groupOffset + 8));
-
-            ranges.push_back({startChar, endChar, startGlyph});
-        }
-        if (verbose) std::cout << "CMAP: Format 12 parsed\n";
-    }
-
-    void parseFormat13(uint32_t offset) {
-        uint32_t numGroups = readUInt32Safe(offset + 12);
-        for (uint32_t i = 0; i < numGroups; ++i) {
-            uint32_t groupOffset = offset + 16 + i * 12;
-            uint32_t startChar = readUInt32Safe(groupOffset);
-            uint32_t endChar = readUInt32Safe(groupOffset + 4);
-            uint16_t glyph = static_cast<uint16_t>(readUInt32Safe(groupOffset + 8));
-            for (uint32_t c = startChar; c <= endChar; ++c) {
-                charToGlyph[c] = glyph;
-                glyphToChar[glyph].insert(c);
+}
+
+void CMAPParser::parseFormat13(uint32_t offset, uint16_t, uint16_t) {
+    if (static_cast<size_t>(offset) + 16 > fontData.size()) throw std::runtime_error("CMAP: Format 13 too small");
+    uint32_t numGroups = readUInt32(fontData.data() + offset + 12);
+    if (numGroups > (fontData.size() - offset - 16) / 12) throw std::runtime_error("CMAP: Format 13 groups out of bounds");
+    for (uint32_t i = 0; i < numGroups; ++i) {
+        const uint8_t* group = fontData.data() + offset + 16 + i * 12;
+        uint32_t startChar = readUInt32(group);
+        uint32_t endChar = std::min(readUInt32(group + 4), MAX_CODEPOINT);
+        uint32_t glyph = readUInt32(group + 8);
+        if (glyph == 0 || glyph > 0xFFFF) continue;
+        for (uint32_t c = startChar; c <= endChar; ++c) {
+            if (charToGlyph.emplace(c, static_cast<uint16_t>(glyph)).second) {
+                glyphToChar[static_cast<uint16_t>(glyph)].insert(c);
             }
         }
-        if (verbose) std::cout << "CMAP: Format 13 parsed\n";
-    }
-
-    void parseFormat14(uint32_t offset) {
-        if (verbose) std::cout << "CMAP: Format 14 (variation selectors) not implemented\n";
     }
+}
 
-    // ======================= Чтение данных =========================
-    uint16_t readUInt16(const uint8_t* data) { return (data[0] << 8) | data[1]; }
-    uint32_t readUInt32(const uint8_t* data) { return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]; }
-    int16_t readInt16(const uint8_t* data) { return (int16_t)((data[0] << 8) | data[1]); }
+void CMAPParser::parseFormat14(uint32_t, uint16_t, uint16_t) {
+    // Варианты по селекторам не дают собственных кодов
+}
 
-    uint16_t readUInt16Safe(uint32_t offset) {
-        if (offset + 2 > fontData.size()) throw std::runtime_error("CMAP: readUInt16Safe out of bounds");
-        return readUInt16(fontData.data() + offset);
-    }
+uint16_t CMAPParser::readUInt16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
 
-    uint32_t readUInt32Safe(uint32_t offset) {
-        if (offset + 4 > fontData.size()) throw std::runtime_error("CMAP: readUInt32Safe out of bounds");
-        return readUInt32(fontData.data() + offset);
-    }
+uint32_t CMAPParser::readUInt32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
 
-    int16_t readInt16Safe(uint32_t offset) {
-        if (offset + 2 > fontData.size()) throw std::runtime_error("CMAP: readInt16Safe out of bounds");
-        return readInt16(fontData.data() + offset);
-    }
-};
+int16_t CMAPParser::readInt16(const uint8_t* data) {
+    return static_cast<int16_t>(readUInt16(data));
+}
 
 } // namespace utils
 } // namespace fontmaster
-
-#endif // CMAPPARSER_H
@@ -0,0 +1,214 @@
+#include "fontmaster/COLRRenderer.h"
+#include "fontmaster/Rasterizer.h"
+#include "fontmaster/TTFUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const uint32_t MAX_IMAGE_DIMENSION = 8192;
+
+ByteSpan tableSpan(const std::vector<uint8_t>& fontData, const TableRecord* record) {
+    if (!record) return ByteSpan();
+    if (static_cast<size_t>(record->offset) + record->length > fontData.size()) {
+        throw std::runtime_error("COLR: table '" + std::string(record->tag, 4) + "' out of bounds");
+    }
+    return ByteSpan(fontData.data() + record->offset, record->length);
+}
+
+// Буферы одного потока: переиспользуются между вызовами render()
+struct RenderScratch {
+    Rasterizer rasterizer;
+    std::vector<uint8_t> coverage;
+    std::vector<GlyphOutline> outlines;
+};
+
+RenderScratch& scratch() {
+    static thread_local RenderScratch instance;
+    return instance;
+}
+
+} // namespace
+
+COLRRenderer::COLRRenderer(const std::vector<uint8_t>& fontData) {
+    auto tables = parseTTFTables(fontData);
+    ByteSpan colr = tableSpan(fontData, findTable(tables, "COLR"));
+    ByteSpan cpal = tableSpan(fontData, findTable(tables, "CPAL"));
+    if (colr.empty() || cpal.empty()) {
+        throw std::runtime_error("COLR: COLR/CPAL tables not found");
+    }
+    parseCOLR(colr);
+    parseCPAL(cpal);
+
+    // Без glyf доступны только метаданные слоёв
+    if (hasTable(tables, "glyf") && hasTable(tables, "loca")) {
+        outlines.reset(new GlyfOutlineDecoder(fontData));
+    }
+}
+
+void COLRRenderer::parseCOLR(ByteSpan colr) {
+    uint16_t numBaseGlyphRecords = colr.readUInt16(2);
+    uint32_t baseGlyphRecordsOffset = colr.readUInt32(4);
+    uint32_t layerRecordsOffset = colr.readUInt32(8);
+    uint16_t numLayerRecords = colr.readUInt16(12);
+
+    ByteSpan baseRecords = colr.subspan(baseGlyphRecordsOffset, numBaseGlyphRecords * 6u);
+    layerRecords = colr.subspan(layerRecordsOffset, numLayerRecords * 4u);
+
+    baseGlyphs.reserve(numBaseGlyphRecords);
+    for (uint16_t i = 0; i < numBaseGlyphRecords; ++i) {
+        COLRBaseGlyph base;
+        base.glyphID = baseRecords.readUInt16(i * 6u);
+        base.firstLayerIndex = baseRecords.readUInt16(i * 6u + 2);
+        base.numLayers = baseRecords.readUInt16(i * 6u + 4);
+        if (static_cast<uint32_t>(base.firstLayerIndex) + base.numLayers > numLayerRecords) {
+            throw std::runtime_error("COLR: layer range of glyph " + std::to_string(base.glyphID) +
+                                     " out of bounds");
+        }
+        baseGlyphs.push_back(base);
+    }
+
+    // Спецификация требует сортировки, но полагаться на это не будем
+    std::sort(baseGlyphs.begin(), baseGlyphs.end(),
+              [](const COLRBaseGlyph& a, const COLRBaseGlyph& b) { return a.glyphID < b.glyphID; });
+}
+
+void COLRRenderer::parseCPAL(ByteSpan cpal) {
+    numPaletteEntries = cpal.readUInt16(2);
+    numPalettes = cpal.readUInt16(4);
+    uint16_t numColorRecords = cpal.readUInt16(6);
+    uint32_t colorRecordsArrayOffset = cpal.readUInt32(8);
+
+    colorRecords = cpal.subspan(colorRecordsArrayOffset, numColorRecords * 4u);
+
+    paletteStarts.reserve(numPalettes);
+    for (uint16_t i = 0; i < numPalettes; ++i) {
+        uint16_t start = cpal.readUInt16(12 + i * 2u);
+        if (static_cast<uint32_t>(start) + numPaletteEntries > numColorRecords) {
+            throw std::runtime_error("CPAL: palette " + std::to_string(i) + " out of bounds");
+        }
+        paletteStarts.push_back(start);
+    }
+}
+
+const COLRBaseGlyph* COLRRenderer::findBaseGlyph(uint16_t glyphID) const {
+    auto it = std::lower_bound(baseGlyphs.begin(), baseGlyphs.end(), glyphID,
+                               [](const COLRBaseGlyph& base, uint16_t id) { return base.glyphID < id; });
+    if (it == baseGlyphs.end() || it->glyphID != glyphID) return nullptr;
+    return &*it;
+}
+
+std::vector<COLRLayerRecord> COLRRenderer::getLayerRecords(uint16_t glyphID) const {
+    std::vector<COLRLayerRecord> result;
+    const COLRBaseGlyph* base = findBaseGlyph(glyphID);
+    if (!base) return result;
+
+    result.reserve(base->numLayers);
+    for (uint16_t i = 0; i < base->numLayers; ++i) {
+        size_t offset = (static_cast<size_t>(base->firstLayerIndex) + i) * 4;
+        result.push_back(COLRLayerRecord{layerRecords.readUInt16(offset), layerRecords.readUInt16(offset + 2)});
+    }
+    return result;
+}
+
+uint32_t COLRRenderer::getPaletteColor(uint16_t palette, uint16_t entry) const {
+    if (palette >= numPalettes || entry >= numPaletteEntries) {
+        throw std::out_of_range("CPAL: color " + std::to_string(palette) + ":" + std::to_string(entry) +
+                                " out of range");
+    }
+    // ColorRecord хранится как BGRA
+    size_t offset = (static_cast<size_t>(paletteStarts[palette]) + entry) * 4;
+    uint32_t b = colorRecords.readUInt8(offset);
+    uint32_t g = colorRecords.readUInt8(offset + 1);
+    uint32_t r = colorRecords.readUInt8(offset + 2);
+    uint32_t a = colorRecords.readUInt8(offset + 3);
+    return (r << 24) | (g << 16) | (b << 8) | a;
+}
+
+std::vector<ColorLayerPaint> COLRRenderer::getLayers(uint16_t glyphID, uint16_t palette,
+                                                     uint32_t foreground) const {
+    std::vector<ColorLayerPaint> result;
+    const COLRBaseGlyph* base = findBaseGlyph(glyphID);
+    if (!base) {
+        result.push_back(ColorLayerPaint{glyphID, foreground});
+        return result;
+    }
+
+    if (palette >= numPalettes) palette = 0;
+    for (const auto& layer : getLayerRecords(glyphID)) {
+        uint32_t color = foreground;
+        if (layer.paletteIndex != FOREGROUND_PALETTE_INDEX && numPalettes > 0) {
+            color = getPaletteColor(palette, layer.paletteIndex);
+        }
+        result.push_back(ColorLayerPaint{layer.glyphID, color});
+    }
+    return result;
+}
+
+RGBAImage COLRRenderer::render(uint16_t glyphID, uint16_t pixelSize, uint16_t palette,
+                               uint32_t foreground) const {
+    return renderLayers(getLayers(glyphID, palette, foreground), pixelSize);
+}
+
+RGBAImage COLRRenderer::renderLayers(const std::vector<ColorLayerPaint>& layers, uint16_t pixelSize) const {
+    RGBAImage image;
+    if (!outlines || layers.empty() || pixelSize == 0) return image;
+
+    RenderScratch& buffers = scratch();
+    if (buffers.outlines.size() < layers.size()) buffers.outlines.resize(layers.size());
+
+    // Общая рамка всех слоёв по точкам контуров (контрольные точки ограничивают кривые)
+    float xMin = std::numeric_limits<float>::max();
+    float yMin = std::numeric_limits<float>::max();
+    float xMax = std::numeric_limits<float>::lowest();
+    float yMax = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < layers.size(); ++i) {
+        GlyphOutline& outline = buffers.outlines[i];
+        if (!outlines->decode(layers[i].glyphID, outline)) continue;
+        for (const auto& point : outline.points) {
+            xMin = std::min(xMin, point.x);
+            yMin = std::min(yMin, point.y);
+            xMax = std::max(xMax, point.x);
+            yMax = std::max(yMax, point.y);
+        }
+    }
+    if (xMin > xMax) return image;
+
+    float scale = static_cast<float>(pixelSize) / outlines->getUnitsPerEm();
+    // Пиксель поля с каждой стороны под сглаживание
+    float left = std::floor(xMin * scale) - 1;
+    float right = std::ceil(xMax * scale) + 1;
+    float top = std::ceil(yMax * scale) + 1;
+    float bottom = std::floor(yMin * scale) - 1;
+    if (right - left > MAX_IMAGE_DIMENSION || top - bottom > MAX_IMAGE_DIMENSION) {
+        throw std::runtime_error("COLR: rendered glyph exceeds " + std::to_string(MAX_IMAGE_DIMENSION) + " pixels");
+    }
+
+    image.width = static_cast<uint32_t>(right - left);
+    image.height = static_cast<uint32_t>(top - bottom);
+    size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+    image.pixels.assign(pixelCount * 4, 0);
+
+    buffers.rasterizer.reset(image.width, image.height);
+    buffers.coverage.resize(pixelCount);
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const GlyphOutline& outline = buffers.outlines[i];
+        if (outline.points.empty() || (layers[i].rgba & 0xFF) == 0) continue;
+        buffers.rasterizer.addOutline(outline, scale, -left, top);
+        buffers.rasterizer.resolve(buffers.coverage.data());
+        blendSolidColor(image.pixels.data(), buffers.coverage.data(), pixelCount, layers[i].rgba);
+    }
+
+    unpremultiplyAlpha(image.pixels.data(), pixelCount);
+    return image;
+}
+
+} // namespace utils
+} // namespace fontmaster
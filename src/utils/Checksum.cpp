@@ -0,0 +1,123 @@
+#include "fontmaster/Checksum.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FONTMASTER_CHECKSUM_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FONTMASTER_CHECKSUM_AVX2 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONTMASTER_CHECKSUM_NEON 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+uint32_t checksumScalar(const uint8_t* p, size_t size) {
+    uint32_t sum = 0;
+    size_t whole = size & ~static_cast<size_t>(3);
+    for (size_t i = 0; i < whole; i += 4) {
+        sum += (static_cast<uint32_t>(p[i]) << 24) | (static_cast<uint32_t>(p[i + 1]) << 16) |
+               (static_cast<uint32_t>(p[i + 2]) << 8) | p[i + 3];
+    }
+    uint32_t tail = 0;
+    for (size_t i = whole; i < size; ++i) {
+        tail |= static_cast<uint32_t>(p[i]) << (24 - 8 * (i - whole));
+    }
+    return sum + tail;
+}
+
+#if defined(FONTMASTER_CHECKSUM_SSE2)
+// Переворот байт в 32-битных полосах без pshufb: обмен байт в 16-битных половинах, затем обмен половин
+inline __m128i byteSwap32(__m128i v) {
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+inline uint32_t horizontalSum(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+
+uint32_t checksumSSE2(const uint8_t* p, size_t size, size_t& done) {
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        acc0 = _mm_add_epi32(acc0, byteSwap32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))));
+        acc1 = _mm_add_epi32(acc1, byteSwap32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 16))));
+    }
+    done = i;
+    return horizontalSum(_mm_add_epi32(acc0, acc1));
+}
+#endif
+
+#if defined(FONTMASTER_CHECKSUM_AVX2)
+__attribute__((target("avx2")))
+uint32_t checksumAVX2(const uint8_t* p, size_t size, size_t& done) {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32));
+        acc0 = _mm256_add_epi32(acc0, _mm256_shuffle_epi8(a, swap));
+        acc1 = _mm256_add_epi32(acc1, _mm256_shuffle_epi8(b, swap));
+    }
+    done = i;
+    __m256i acc = _mm256_add_epi32(acc0, acc1);
+    return horizontalSum(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+}
+
+bool hasAVX2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+#if defined(FONTMASTER_CHECKSUM_NEON)
+uint32_t checksumNEON(const uint8_t* p, size_t size, size_t& done) {
+    uint32x4_t acc0 = vdupq_n_u32(0);
+    uint32x4_t acc1 = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        acc0 = vaddq_u32(acc0, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + i))));
+        acc1 = vaddq_u32(acc1, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + i + 16))));
+    }
+    done = i;
+    uint32x4_t acc = vaddq_u32(acc0, acc1);
+    return vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+}
+#endif
+
+} // namespace
+
+uint32_t tableChecksum(ByteSpan data) {
+    const uint8_t* p = data.data();
+    size_t size = data.size();
+    size_t done = 0;
+    uint32_t sum = 0;
+    // Блоки кратны 4 байтам, поэтому остаток начинается с границы слова
+#if defined(FONTMASTER_CHECKSUM_AVX2)
+    if (hasAVX2()) {
+        sum = checksumAVX2(p, size, done);
+    } else {
+        sum = checksumSSE2(p, size, done);
+    }
+#elif defined(FONTMASTER_CHECKSUM_SSE2)
+    sum = checksumSSE2(p, size, done);
+#elif defined(FONTMASTER_CHECKSUM_NEON)
+    sum = checksumNEON(p, size, done);
+#endif
+    return sum + checksumScalar(p + done, size - done);
+}
+
+} // namespace utils
+} // namespace fontmaster
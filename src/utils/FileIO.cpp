@@ -0,0 +1,314 @@
+#include "fontmaster/FileIO.h"
+#include "fontmaster/PhaseTimer.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define FONTMASTER_HAVE_POSIX_IO 1
+#else
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define FONTMASTER_HAVE_COPY_FILE_RANGE 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+#if defined(FONTMASTER_HAVE_POSIX_IO)
+
+// Мелкие фрагменты дешевле дописать из памяти, чем отдельным системным вызовом копировать
+const size_t MIN_KERNEL_COPY = 4096;
+
+FileStamp stampOf(const struct stat& info) {
+    FileStamp stamp;
+    stamp.device = static_cast<uint64_t>(info.st_dev);
+    stamp.inode = static_cast<uint64_t>(info.st_ino);
+    stamp.size = static_cast<uint64_t>(info.st_size);
+#if defined(__APPLE__)
+    stamp.mtimeNs = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stamp.mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    stamp.valid = true;
+    return stamp;
+}
+
+std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+// Дописать фрагменты через writev; частичная запись продолжается с места остановки
+bool writeAll(int fd, std::vector<ByteSpan> parts) {
+    const size_t batchLimit = 1024;  // IOV_MAX на Linux и macOS
+    std::vector<struct iovec> iov;
+    size_t index = 0;
+    while (index < parts.size()) {
+        iov.clear();
+        for (size_t i = index; i < parts.size() && iov.size() < batchLimit; ++i) {
+            iov.push_back({const_cast<uint8_t*>(parts[i].data()), parts[i].size()});
+        }
+        ssize_t written = ::writev(fd, iov.data(), static_cast<int>(iov.size()));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // Пропускаем целые фрагменты, остаток первого недописанного укорачиваем
+        size_t remaining = static_cast<size_t>(written);
+        while (index < parts.size() && remaining >= parts[index].size()) {
+            remaining -= parts[index].size();
+            ++index;
+        }
+        if (remaining > 0) parts[index] = parts[index].subspan(remaining);
+    }
+    return true;
+}
+
+// Скопировать count байт исходного файла с offset в текущую позицию fd; возвращает, сколько скопировано
+size_t copyRange(int sourceFd, int fd, uint64_t offset, size_t count) {
+    size_t copied = 0;
+#if defined(FONTMASTER_HAVE_COPY_FILE_RANGE)
+    loff_t position = static_cast<loff_t>(offset);
+    while (copied < count) {
+        ssize_t result = ::copy_file_range(sourceFd, &position, fd, nullptr, count - copied, 0);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) break;
+        copied += static_cast<size_t>(result);
+    }
+#else
+    (void)sourceFd;
+    (void)fd;
+    (void)offset;
+#endif
+    return copied;
+}
+
+struct TempFile {
+    int fd = -1;
+    std::string path;        // пусто, пока у безымянного O_TMPFILE нет имени
+};
+
+TempFile createTempFile(const std::string& target) {
+    TempFile temp;
+#if defined(O_TMPFILE)
+    // Безымянный файл не остаётся мусором в каталоге, если процесс упадёт до rename
+    temp.fd = ::open(directoryOf(target).c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    if (temp.fd >= 0) return temp;
+#endif
+    std::string pattern = target + ".XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    temp.fd = ::mkstemp(name.data());
+    if (temp.fd >= 0) {
+        temp.path = name.data();
+        ::fchmod(temp.fd, 0644);
+    }
+    return temp;
+}
+
+// Имя для O_TMPFILE появляется только перед rename, уже после fsync
+bool nameTempFile(TempFile& temp, const std::string& target) {
+    if (!temp.path.empty()) return true;
+#if defined(O_TMPFILE)
+    std::string procPath = "/proc/self/fd/" + std::to_string(temp.fd);
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        std::string name = target + ".tmp" + std::to_string(::getpid()) + "." + std::to_string(attempt);
+        if (::linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, name.c_str(), AT_SYMLINK_FOLLOW) == 0) {
+            temp.path = name;
+            return true;
+        }
+        if (errno != EEXIST) return false;
+    }
+#endif
+    return false;
+}
+
+// Сам rename переживает сбой только после fsync каталога
+void syncDirectory(const std::string& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ::fsync(fd);
+    ::close(fd);
+}
+
+// Открыть исходный файл, только если он всё ещё тот, из которого прочитаны contents
+int openSource(const SourceFile* source, int flags = O_RDONLY) {
+    if (!source || !source->stamp.valid) return -1;
+    int fd = ::open(source->path.c_str(), flags | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || stampOf(info) != source->stamp ||
+        static_cast<uint64_t>(info.st_size) != source->contents.size()) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif
+
+} // namespace
+
+FileStamp FileStamp::of(const std::string& path) {
+#if defined(FONTMASTER_HAVE_POSIX_IO)
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) return FileStamp();
+    return stampOf(info);
+#else
+    std::error_code error;
+    FileStamp stamp;
+    stamp.size = std::filesystem::file_size(path, error);
+    if (error) return FileStamp();
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) return FileStamp();
+    stamp.mtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    stamp.valid = true;
+    return stamp;
+#endif
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data, FileStamp* stamp) {
+    ScopedPhase phase("read");
+    FileStamp before = FileStamp::of(path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size < 0) return false;
+    file.seekg(0, std::ios::beg);
+
+    data.resize(static_cast<size_t>(size));
+    if (size > 0 && !file.read(reinterpret_cast<char*>(data.data()), size)) return false;
+
+    if (stamp) {
+        // Файл переписали во время чтения - содержимому в памяти нельзя сопоставить файл
+        bool unchanged = before.size == data.size() && FileStamp::of(path) == before;
+        *stamp = unchanged ? before : FileStamp();
+    }
+    return true;
+}
+
+bool writeFileAtomic(const std::string& path, const std::vector<ByteSpan>& parts,
+                     const SourceFile* source) {
+    ScopedPhase phase("write");
+#if defined(FONTMASTER_HAVE_POSIX_IO)
+    TempFile temp = createTempFile(path);
+    if (temp.fd < 0) return false;
+
+    // Заменяемый файл сохраняет свои права доступа
+    struct stat existing;
+    if (::stat(path.c_str(), &existing) == 0) {
+        ::fchmod(temp.fd, existing.st_mode & 07777);
+    }
+
+    int sourceFd = openSource(source);
+    bool ok = true;
+    std::vector<ByteSpan> pending;  // фрагменты из памяти копятся для одного writev
+    for (const ByteSpan& part : parts) {
+        size_t copied = 0;
+        if (sourceFd >= 0 && part.size() >= MIN_KERNEL_COPY &&
+            part.data() >= source->contents.data() && part.end() <= source->contents.end()) {
+            ok = writeAll(temp.fd, pending);
+            pending.clear();
+            if (!ok) break;
+            copied = copyRange(sourceFd, temp.fd, static_cast<uint64_t>(part.data() - source->contents.data()),
+                               part.size());
+            if (copied < part.size()) {
+                // Ядро не умеет копировать между этими файлами - дальше всё из памяти
+                ::close(sourceFd);
+                sourceFd = -1;
+            }
+        }
+        if (copied < part.size()) pending.push_back(part.subspan(copied));
+    }
+    ok = ok && writeAll(temp.fd, pending);
+    if (sourceFd >= 0) ::close(sourceFd);
+
+    ok = ok && ::fsync(temp.fd) == 0;
+    ok = ok && nameTempFile(temp, path);
+    if (::close(temp.fd) != 0) ok = false;
+    ok = ok && ::rename(temp.path.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        if (!temp.path.empty()) ::unlink(temp.path.c_str());
+        return false;
+    }
+    syncDirectory(directoryOf(path));
+    return true;
+#else
+    (void)source;
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        for (const ByteSpan& part : parts) {
+            file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+        }
+        file.flush();
+        if (!file.good()) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    // filesystem::rename заменяет существующий файл и на Windows
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool patchFile(const SourceFile& source, const std::vector<FilePatch>& patches) {
+    ScopedPhase phase("write");
+#if defined(FONTMASTER_HAVE_POSIX_IO)
+    int fd = openSource(&source, O_WRONLY);
+    if (fd < 0) return false;
+
+    bool ok = true;
+    for (const FilePatch& patch : patches) {
+        size_t written = 0;
+        while (ok && written < patch.data.size()) {
+            ssize_t result = ::pwrite(fd, patch.data.data() + written, patch.data.size() - written,
+                                      static_cast<off_t>(patch.offset + written));
+            if (result < 0 && errno == EINTR) continue;
+            if (result <= 0) ok = false;
+            else written += static_cast<size_t>(result);
+        }
+        if (!ok) break;
+    }
+    ok = ok && ::fsync(fd) == 0;
+    if (::close(fd) != 0) ok = false;
+    return ok;
+#else
+    if (!source.stamp.valid || FileStamp::of(source.path) != source.stamp) return false;
+    std::fstream file(source.path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file) return false;
+    for (const FilePatch& patch : patches) {
+        file.seekp(static_cast<std::streamoff>(patch.offset));
+        file.write(reinterpret_cast<const char*>(patch.data.data()), static_cast<std::streamsize>(patch.data.size()));
+    }
+    file.flush();
+    return file.good();
+#endif
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,296 @@
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/Checksum.h"
+#include "fontmaster/PhaseTimer.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const uint32_t CHECKSUM_MAGIC = 0xB1B0AFBA;
+const size_t HEAD_ADJUSTMENT_OFFSET = 8;
+const uint8_t ZERO_PADDING[4] = {0, 0, 0, 0};
+
+size_t padding(size_t size) {
+    return (4 - (size & 3)) & 3;
+}
+
+// Сравнение блоками: совпадающие куски короче PATCH_MERGE_GAP дешевле переписать, чем дробить запись
+const size_t PATCH_BLOCK = 64;
+const size_t PATCH_MERGE_GAP = 512;
+// Запись на месте не атомарна: если переписывается больше этой доли файла,
+// выигрыш невелик, и лучше атомарная перезапись целиком
+const size_t PATCH_LIMIT_DIVISOR = 4;
+
+struct DirectoryRecord {
+    std::string tag;
+    size_t position = 0;     // смещение записи в директории
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// after - новые данные таблицы без выравнивания, before - прежние байты с выравниванием
+bool blockDiffers(ByteSpan after, ByteSpan before, size_t begin, size_t end) {
+    size_t dataEnd = std::min(end, after.size());
+    if (dataEnd > begin && std::memcmp(after.data() + begin, before.data() + begin, dataEnd - begin) != 0) {
+        return true;
+    }
+    for (size_t i = std::max(begin, dataEnd); i < end; ++i) {
+        if (before[i] != 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+FontAssembler::Table& FontAssembler::addEntry(const std::string& tag) {
+    if (tag.size() != 4) {
+        throw std::runtime_error("FontAssembler: bad table tag '" + tag + "'");
+    }
+    for (const auto& table : tables) {
+        if (table.tag == tag) throw std::runtime_error("FontAssembler: duplicate table '" + tag + "'");
+    }
+    laidOut = false;
+    tables.emplace_back();
+    tables.back().tag = tag;
+    return tables.back();
+}
+
+void FontAssembler::addTable(const std::string& tag, ByteSpan data) {
+    addEntry(tag).source = data;
+}
+
+void FontAssembler::addTable(const std::string& tag, ByteSpan data, uint32_t checksum) {
+    Table& table = addEntry(tag);
+    table.source = data;
+    table.checksum = checksum;
+    table.checksumKnown = true;
+}
+
+void FontAssembler::addTable(const std::string& tag, std::vector<uint8_t>&& data) {
+    Table& table = addEntry(tag);
+    table.owned = std::move(data);
+    table.isOwned = true;
+}
+
+void FontAssembler::layout() {
+    if (laidOut) return;
+    ScopedPhase phase("checksums");
+
+    // head меняется (checkSumAdjustment), поэтому нужна своя копия; сумма head считается с нулём в поле
+    Table* head = nullptr;
+    for (auto& table : tables) {
+        if (table.tag == "head" && table.bytes().size() >= HEAD_ADJUSTMENT_OFFSET + 4) {
+            if (!table.isOwned) {
+                table.owned = table.source.toVector();
+                table.isOwned = true;
+            }
+            storeUInt32(table.owned.data() + HEAD_ADJUSTMENT_OFFSET, 0);
+            table.checksumKnown = false;
+            head = &table;
+        }
+    }
+
+    uint16_t numTables = static_cast<uint16_t>(tables.size());
+    uint16_t entrySelector = 0;
+    while ((2u << entrySelector) <= numTables) ++entrySelector;
+    uint16_t searchRange = static_cast<uint16_t>((1u << entrySelector) * 16);
+
+    size_t offset = 12 + tables.size() * 16;
+    for (auto& table : tables) {
+        ByteSpan bytes = table.bytes();
+        table.offset = static_cast<uint32_t>(offset);
+        if (!table.checksumKnown) table.checksum = tableChecksum(bytes);
+        offset += bytes.size() + padding(bytes.size());
+    }
+    totalSize = offset;
+
+    // Записи директории упорядочены по тегу, данные - в порядке добавления
+    std::vector<const Table*> sorted;
+    sorted.reserve(tables.size());
+    for (const auto& table : tables) sorted.push_back(&table);
+    std::sort(sorted.begin(), sorted.end(), [](const Table* a, const Table* b) { return a->tag < b->tag; });
+
+    ByteWriter writer(12 + tables.size() * 16);
+    writer.writeUInt32(sfntVersion);
+    writer.writeUInt16(numTables);
+    writer.writeUInt16(numTables ? searchRange : 0);
+    writer.writeUInt16(numTables ? entrySelector : 0);
+    writer.writeUInt16(numTables ? static_cast<uint16_t>(numTables * 16 - searchRange) : 0);
+
+    uint32_t fontChecksum = 0;
+    for (const Table* table : sorted) {
+        writer.writeBytes(table->tag.data(), 4);
+        writer.writeUInt32(table->checksum);
+        writer.writeUInt32(table->offset);
+        writer.writeUInt32(static_cast<uint32_t>(table->bytes().size()));
+        fontChecksum += table->checksum;
+    }
+    directory = writer.take();
+    fontChecksum += tableChecksum(directory);
+
+    if (head) {
+        storeUInt32(head->owned.data() + HEAD_ADJUSTMENT_OFFSET, CHECKSUM_MAGIC - fontChecksum);
+    }
+    laidOut = true;
+}
+
+size_t FontAssembler::size() {
+    layout();
+    return totalSize;
+}
+
+std::vector<ByteSpan> FontAssembler::slices() {
+    layout();
+    std::vector<ByteSpan> result;
+    result.reserve(1 + tables.size() * 2);
+    result.emplace_back(directory);
+    for (const auto& table : tables) {
+        ByteSpan bytes = table.bytes();
+        if (!bytes.empty()) result.push_back(bytes);
+        size_t pad = padding(bytes.size());
+        if (pad) result.emplace_back(ZERO_PADDING, pad);
+    }
+    return result;
+}
+
+std::vector<uint8_t> FontAssembler::assemble() {
+    std::vector<uint8_t> result(size());
+    uint8_t* out = result.data();
+    for (const ByteSpan& slice : slices()) {
+        std::memcpy(out, slice.data(), slice.size());
+        out += slice.size();
+    }
+    return result;
+}
+
+bool FontAssembler::writeFile(const std::string& path, const SourceFile* source) {
+    return writeFileAtomic(path, slices(), source);
+}
+
+bool FontAssembler::patchFile(const SourceFile& source) {
+    ByteSpan original = source.contents;
+    if (original.size() < 12 || original.readUInt32(0) != sfntVersion) return false;
+    size_t numTables = original.readUInt16(4);
+    if (numTables != tables.size() || original.size() < 12 + numTables * 16) return false;
+
+    std::vector<DirectoryRecord> records(numTables);
+    for (size_t i = 0; i < numTables; ++i) {
+        DirectoryRecord& record = records[i];
+        record.position = 12 + i * 16;
+        record.tag.assign(reinterpret_cast<const char*>(original.data() + record.position), 4);
+        record.offset = original.readUInt32(record.position + 8);
+        record.length = original.readUInt32(record.position + 12);
+        if (record.offset > original.size() || record.length > original.size() - record.offset) return false;
+    }
+
+    std::vector<FilePatch> patches;
+    std::vector<FilePatch> recordPatches;
+    std::vector<std::array<uint8_t, 16>> newRecords;
+    newRecords.reserve(numTables);
+    // head сравнивается и суммируется с нулём в checkSumAdjustment; само поле пишется последним
+    std::vector<uint8_t> headBefore;
+    std::vector<uint8_t> headAfter;
+    const DirectoryRecord* headRecord = nullptr;
+    uint32_t delta = 0;      // разница суммы файла без checkSumAdjustment
+    const size_t patchLimit = original.size() / PATCH_LIMIT_DIVISOR;
+    size_t patchedBytes = 0;
+
+    for (const Table& table : tables) {
+        auto found = std::find_if(records.begin(), records.end(),
+                                  [&](const DirectoryRecord& record) { return record.tag == table.tag; });
+        if (found == records.end()) return false;
+        const DirectoryRecord& record = *found;
+        ByteSpan after = table.bytes();
+        bool isHead = table.tag == "head" && after.size() >= HEAD_ADJUSTMENT_OFFSET + 4 &&
+                      record.length >= HEAD_ADJUSTMENT_OFFSET + 4;
+        if (!isHead && after.data() == original.data() + record.offset && after.size() == record.length) {
+            continue;
+        }
+
+        // Таблица остаётся на месте: новое выравнивание не выходит за старое и не задевает соседей
+        size_t padded = after.size() + padding(after.size());
+        if (record.offset % 4 != 0 || padded > record.length + padding(record.length) ||
+            record.offset + padded > original.size()) {
+            return false;
+        }
+        for (const DirectoryRecord& other : records) {
+            if (&other != &record && other.offset < record.offset + padded &&
+                other.offset + other.length > record.offset) {
+                return false;
+            }
+        }
+
+        ByteSpan before = original.subspan(record.offset, padded);
+        uint32_t checksum = 0;
+        if (isHead) {
+            headBefore = before.toVector();
+            headAfter = after.toVector();
+            storeUInt32(headBefore.data() + HEAD_ADJUSTMENT_OFFSET, 0);
+            storeUInt32(headAfter.data() + HEAD_ADJUSTMENT_OFFSET, 0);
+            before = ByteSpan(headBefore);
+            after = ByteSpan(headAfter);
+            checksum = tableChecksum(after);
+            headRecord = &record;
+        } else {
+            checksum = table.checksumKnown ? table.checksum : tableChecksum(after);
+        }
+
+        // Блоки начинаются на границе слова, поэтому разница сумм считается по самим участкам
+        auto emit = [&](size_t begin, size_t end) {
+            patchedBytes += end - begin;
+            size_t dataEnd = std::max(begin, std::min(end, after.size()));
+            if (dataEnd > begin) patches.push_back({record.offset + begin, after.subspan(begin, dataEnd - begin)});
+            if (end > dataEnd) patches.push_back({record.offset + dataEnd, ByteSpan(ZERO_PADDING, end - dataEnd)});
+            delta += tableChecksum(after.subspan(begin, dataEnd - begin)) -
+                     tableChecksum(before.subspan(begin, end - begin));
+        };
+        bool inRun = false;
+        size_t runBegin = 0;
+        size_t runEnd = 0;
+        for (size_t begin = 0; begin < padded; begin += PATCH_BLOCK) {
+            size_t end = std::min(begin + PATCH_BLOCK, padded);
+            if (!blockDiffers(after, before, begin, end)) continue;
+            if (inRun && begin - runEnd > PATCH_MERGE_GAP) {
+                emit(runBegin, runEnd);
+                inRun = false;
+            }
+            if (!inRun) runBegin = begin;
+            inRun = true;
+            runEnd = end;
+        }
+        if (inRun) emit(runBegin, runEnd);
+        if (patchedBytes > patchLimit) return false;
+
+        newRecords.emplace_back();
+        std::array<uint8_t, 16>& bytes = newRecords.back();
+        std::memcpy(bytes.data(), original.data() + record.position, 16);
+        storeUInt32(bytes.data() + 4, checksum);
+        storeUInt32(bytes.data() + 12, static_cast<uint32_t>(after.size()));
+        if (std::memcmp(bytes.data(), original.data() + record.position, 16) != 0) {
+            delta += tableChecksum(ByteSpan(bytes.data(), 16)) -
+                     tableChecksum(original.subspan(record.position, 16));
+            recordPatches.push_back({record.position, ByteSpan(bytes.data(), 16)});
+        }
+    }
+    patches.insert(patches.end(), recordPatches.begin(), recordPatches.end());
+
+    std::array<uint8_t, 4> adjustment;
+    if (headRecord) {
+        size_t position = headRecord->offset + HEAD_ADJUSTMENT_OFFSET;
+        // Исходная сумма файла известна из самого поля: adjustment = magic - сумма без него
+        uint32_t oldAdjustment = original.readUInt32(position);
+        uint32_t oldSum = CHECKSUM_MAGIC - oldAdjustment;
+        storeUInt32(adjustment.data(), CHECKSUM_MAGIC - (oldSum + delta));
+        patches.push_back({position, ByteSpan(adjustment.data(), 4)});
+    }
+    return utils::patchFile(source, patches);
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,456 @@
+#include "fontmaster/GlyfOutline.h"
+#include "fontmaster/TTFUtils.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FONTMASTER_GLYF_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONTMASTER_GLYF_NEON 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const int MAX_COMPONENT_DEPTH = 16;
+
+// Флаги точек простого глифа
+const uint8_t ON_CURVE_POINT = 0x01;
+const uint8_t X_SHORT_VECTOR = 0x02;
+const uint8_t Y_SHORT_VECTOR = 0x04;
+const uint8_t REPEAT_FLAG = 0x08;
+const uint8_t X_IS_SAME_OR_POSITIVE = 0x10;
+const uint8_t Y_IS_SAME_OR_POSITIVE = 0x20;
+
+// Флаги компонентов составного глифа
+const uint16_t ARG_1_AND_2_ARE_WORDS = 0x0001;
+const uint16_t ARGS_ARE_XY_VALUES = 0x0002;
+const uint16_t WE_HAVE_A_SCALE = 0x0008;
+const uint16_t MORE_COMPONENTS = 0x0020;
+const uint16_t WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+const uint16_t WE_HAVE_A_TWO_BY_TWO = 0x0080;
+const uint16_t SCALED_COMPONENT_OFFSET = 0x0800;
+const uint16_t UNSCALED_COMPONENT_OFFSET = 0x1000;
+
+float readF2Dot14(ByteSpan data, size_t offset) {
+    return data.readInt16(offset) / 16384.0f;
+}
+
+// Флаги и абсолютные координаты точек простого глифа; буферы переиспользуются в потоке
+struct SimplePoints {
+    std::vector<uint8_t> flags;
+    std::vector<int32_t> x;
+    std::vector<int32_t> y;
+    int32_t xMin, xMax, yMin, yMax;
+};
+
+SimplePoints& threadPoints() {
+    thread_local SimplePoints points;
+    return points;
+}
+
+// Байт на дельту координаты: короткая - 1, повтор предыдущей - 0, иначе int16
+inline uint32_t deltaSize(uint8_t flag, uint8_t shortBit, uint8_t sameBit) {
+    return (flag & shortBit) ? 1u : ((flag & sameBit) ? 0u : 2u);
+}
+
+// Дельты одной оси; длина данных проверена заранее
+const uint8_t* readDeltas(const uint8_t* p, const uint8_t* flags, uint32_t count,
+                          uint8_t shortBit, uint8_t sameBit, int32_t* out) {
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t flag = flags[i];
+        if (flag & shortBit) {
+            int32_t delta = *p++;
+            out[i] = (flag & sameBit) ? delta : -delta;
+        } else if (flag & sameBit) {
+            out[i] = 0;
+        } else {
+            out[i] = static_cast<int16_t>((p[0] << 8) | p[1]);
+            p += 2;
+        }
+    }
+    return p;
+}
+
+// Префиксная сумма на месте (дельты -> координаты) с минимумом и максимумом результата
+void prefixSumRange(int32_t* values, uint32_t count, int32_t& lo, int32_t& hi) {
+    uint32_t i = 0;
+    int32_t sum = 0;
+    lo = INT32_MAX;
+    hi = INT32_MIN;
+#if defined(FONTMASTER_GLYF_SSE2)
+    if (count >= 4) {
+        // Сумма внутри четвёрки - два сдвига со сложением, перенос - последний элемент предыдущей
+        __m128i carry = _mm_setzero_si128();
+        __m128i vlo = _mm_set1_epi32(INT32_MAX);
+        __m128i vhi = _mm_set1_epi32(INT32_MIN);
+        for (; i + 4 <= count; i += 4) {
+            __m128i* p = reinterpret_cast<__m128i*>(values + i);
+            __m128i v = _mm_loadu_si128(p);
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            _mm_storeu_si128(p, v);
+            carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+            // В SSE2 нет min/max для int32 - выбор по маске сравнения
+            __m128i less = _mm_cmplt_epi32(v, vlo);
+            vlo = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, vlo));
+            __m128i greater = _mm_cmpgt_epi32(v, vhi);
+            vhi = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, vhi));
+        }
+        int32_t lanes[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), vlo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 4), vhi);
+        for (int lane = 0; lane < 4; ++lane) {
+            lo = std::min(lo, lanes[lane]);
+            hi = std::max(hi, lanes[lane + 4]);
+        }
+        sum = _mm_cvtsi128_si32(carry);
+    }
+#elif defined(FONTMASTER_GLYF_NEON)
+    if (count >= 4) {
+        const int32x4_t zero = vdupq_n_s32(0);
+        int32x4_t carry = zero;
+        int32x4_t vlo = vdupq_n_s32(INT32_MAX);
+        int32x4_t vhi = vdupq_n_s32(INT32_MIN);
+        for (; i + 4 <= count; i += 4) {
+            int32x4_t v = vld1q_s32(values + i);
+            v = vaddq_s32(v, vextq_s32(zero, v, 3));
+            v = vaddq_s32(v, vextq_s32(zero, v, 2));
+            v = vaddq_s32(v, carry);
+            vst1q_s32(values + i, v);
+            carry = vdupq_n_s32(vgetq_lane_s32(v, 3));
+            vlo = vminq_s32(vlo, v);
+            vhi = vmaxq_s32(vhi, v);
+        }
+        int32_t lanes[8];
+        vst1q_s32(lanes, vlo);
+        vst1q_s32(lanes + 4, vhi);
+        for (int lane = 0; lane < 4; ++lane) {
+            lo = std::min(lo, lanes[lane]);
+            hi = std::max(hi, lanes[lane + 4]);
+        }
+        sum = vgetq_lane_s32(carry, 0);
+    }
+#endif
+    for (; i < count; ++i) {
+        sum += values[i];
+        values[i] = sum;
+        lo = std::min(lo, sum);
+        hi = std::max(hi, sum);
+    }
+}
+
+/**
+ * Разворачивает флаги, начиная с pos, и восстанавливает координаты numPoints точек.
+ * Длина дельт считается по флагам заранее, так что сами дельты читаются без проверок.
+ * false - данные обрываются или повтор флага выходит за число точек.
+ */
+bool decodePoints(ByteSpan data, size_t pos, uint32_t numPoints, SimplePoints& points) {
+    const uint8_t* p = data.data() + std::min(pos, data.size());
+    const uint8_t* end = data.data() + data.size();
+
+    points.flags.resize(numPoints);
+    uint8_t* flags = points.flags.data();
+    uint32_t xBytes = 0, yBytes = 0;
+    for (uint32_t i = 0; i < numPoints;) {
+        if (p >= end) return false;
+        uint8_t flag = *p++;
+        uint32_t repeat = 1;
+        if (flag & REPEAT_FLAG) {
+            if (p >= end) return false;
+            repeat += *p++;
+        }
+        if (repeat > numPoints - i) return false;
+        std::memset(flags + i, flag, repeat);
+        xBytes += repeat * deltaSize(flag, X_SHORT_VECTOR, X_IS_SAME_OR_POSITIVE);
+        yBytes += repeat * deltaSize(flag, Y_SHORT_VECTOR, Y_IS_SAME_OR_POSITIVE);
+        i += repeat;
+    }
+    if (static_cast<size_t>(end - p) < static_cast<size_t>(xBytes) + yBytes) return false;
+
+    points.x.resize(numPoints);
+    points.y.resize(numPoints);
+    p = readDeltas(p, flags, numPoints, X_SHORT_VECTOR, X_IS_SAME_OR_POSITIVE, points.x.data());
+    readDeltas(p, flags, numPoints, Y_SHORT_VECTOR, Y_IS_SAME_OR_POSITIVE, points.y.data());
+    prefixSumRange(points.x.data(), numPoints, points.xMin, points.xMax);
+    prefixSumRange(points.y.data(), numPoints, points.yMin, points.yMax);
+    return true;
+}
+
+int16_t clampToInt16(int32_t value) {
+    return static_cast<int16_t>(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, value)));
+}
+
+int16_t roundToInt16(float value) {
+    return clampToInt16(static_cast<int32_t>(std::floor(value + 0.5f)));
+}
+
+ByteSpan tableSpan(const std::vector<uint8_t>& fontData, const std::vector<TableRecord>& tables,
+                   const char* tag) {
+    const TableRecord* record = findTable(tables, tag);
+    if (!record) {
+        throw std::runtime_error(std::string("glyf: missing table '") + tag + "'");
+    }
+    if (static_cast<size_t>(record->offset) + record->length > fontData.size()) {
+        throw std::runtime_error(std::string("glyf: table '") + tag + "' out of bounds");
+    }
+    return ByteSpan(fontData.data() + record->offset, record->length);
+}
+
+} // namespace
+
+bool simpleGlyphBounds(ByteSpan data, GlyphBounds& bounds) {
+    if (data.size() < 12) return false;
+    int16_t numberOfContours = data.readInt16(0);
+    if (numberOfContours <= 0) return false;
+
+    size_t endPts = 10 + static_cast<size_t>(numberOfContours) * 2;
+    if (endPts + 2 > data.size()) return false;
+    uint32_t numPoints = data.readUInt16(endPts - 2) + 1u;
+    size_t pos = endPts + 2 + data.readUInt16(endPts);
+
+    SimplePoints& points = threadPoints();
+    if (!decodePoints(data, pos, numPoints, points)) return false;
+    bounds.xMin = clampToInt16(points.xMin);
+    bounds.yMin = clampToInt16(points.yMin);
+    bounds.xMax = clampToInt16(points.xMax);
+    bounds.yMax = clampToInt16(points.yMax);
+    return true;
+}
+
+GlyfOutlineDecoder::GlyfOutlineDecoder(const std::vector<uint8_t>& fontData) {
+    auto tables = parseTTFTables(fontData);
+    ByteSpan head = tableSpan(fontData, tables, "head");
+    ByteSpan maxp = tableSpan(fontData, tables, "maxp");
+    loca = tableSpan(fontData, tables, "loca");
+    glyf = tableSpan(fontData, tables, "glyf");
+
+    unitsPerEm = head.readUInt16(18);
+    longLoca = head.readInt16(50) != 0;
+    numGlyphs = maxp.readUInt16(4);
+    if (unitsPerEm == 0) unitsPerEm = 1000;
+}
+
+GlyfOutlineDecoder::GlyfOutlineDecoder(ByteSpan glyfTable, ByteSpan locaTable, bool longLocaFormat,
+                                       uint16_t glyphCount, uint16_t emUnits)
+    : glyf(glyfTable), loca(locaTable), longLoca(longLocaFormat),
+      numGlyphs(glyphCount), unitsPerEm(emUnits ? emUnits : 1000) {}
+
+GlyfOutlineDecoder::GlyfOutlineDecoder(ByteSpan glyfTable, std::vector<uint32_t> glyphOffsets, uint16_t emUnits)
+    : glyf(glyfTable), offsets(std::move(glyphOffsets)), unitsPerEm(emUnits ? emUnits : 1000) {
+    if (offsets.empty()) offsets.push_back(0);
+    numGlyphs = static_cast<uint16_t>(std::min<size_t>(offsets.size() - 1, UINT16_MAX));
+}
+
+ByteSpan GlyfOutlineDecoder::getGlyphData(uint16_t glyphID) const {
+    if (glyphID >= numGlyphs) {
+        throw std::out_of_range("glyf: glyph " + std::to_string(glyphID) + " out of range");
+    }
+
+    uint32_t start, end;
+    if (!offsets.empty()) {
+        start = offsets[glyphID];
+        end = offsets[glyphID + 1];
+    } else if (longLoca) {
+        start = loca.readUInt32(glyphID * 4u);
+        end = loca.readUInt32(glyphID * 4u + 4);
+    } else {
+        start = loca.readUInt16(glyphID * 2u) * 2u;
+        end = loca.readUInt16(glyphID * 2u + 2) * 2u;
+    }
+
+    if (end <= start) return ByteSpan();
+    return glyf.subspan(start, end - start);
+}
+
+bool GlyfOutlineDecoder::decode(uint16_t glyphID, GlyphOutline& outline) const {
+    outline.clear();
+    try {
+        return decodeInto(glyphID, outline, 0);
+    } catch (const std::exception&) {
+        outline.clear();
+        return false;
+    }
+}
+
+bool GlyfOutlineDecoder::computeBounds(uint16_t glyphID, GlyphBounds& bounds) const {
+    try {
+        ByteSpan data = getGlyphData(glyphID);
+        if (data.size() < 10) return false;
+        if (data.readInt16(0) >= 0) return simpleGlyphBounds(data, bounds);
+
+        GlyphOutline outline;
+        if (!decodeInto(glyphID, outline, 0)) return false;
+        float xMin = outline.points[0].x, xMax = xMin;
+        float yMin = outline.points[0].y, yMax = yMin;
+        for (const GlyphPoint& point : outline.points) {
+            xMin = std::min(xMin, point.x);
+            xMax = std::max(xMax, point.x);
+            yMin = std::min(yMin, point.y);
+            yMax = std::max(yMax, point.y);
+        }
+        bounds.xMin = roundToInt16(xMin);
+        bounds.yMin = roundToInt16(yMin);
+        bounds.xMax = roundToInt16(xMax);
+        bounds.yMax = roundToInt16(yMax);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool GlyfOutlineDecoder::decodeInto(uint16_t glyphID, GlyphOutline& outline, int depth) const {
+    ByteSpan data = getGlyphData(glyphID);
+    if (data.size() < 10) return false;
+
+    int16_t numberOfContours = data.readInt16(0);
+    if (depth == 0) {
+        outline.xMin = data.readInt16(2);
+        outline.yMin = data.readInt16(4);
+        outline.xMax = data.readInt16(6);
+        outline.yMax = data.readInt16(8);
+    }
+
+    if (numberOfContours >= 0) {
+        return decodeSimple(data, numberOfContours, outline);
+    }
+    if (depth >= MAX_COMPONENT_DEPTH) {
+        throw std::runtime_error("glyf: composite glyph nesting too deep");
+    }
+    return decodeComposite(data, outline, depth);
+}
+
+bool GlyfOutlineDecoder::decodeSimple(ByteSpan data, int16_t numberOfContours, GlyphOutline& outline) const {
+    if (numberOfContours == 0) return false;
+
+    size_t base = outline.points.size();
+    size_t pos = 10;
+    uint32_t numPoints = 0;
+    for (int16_t i = 0; i < numberOfContours; ++i, pos += 2) {
+        uint32_t end = data.readUInt16(pos);
+        if (i > 0 && end + 1 < numPoints) {
+            throw std::runtime_error("glyf: contour end points are not increasing");
+        }
+        numPoints = end + 1;
+        outline.contourEnds.push_back(static_cast<uint16_t>(base + end));
+    }
+
+    uint16_t instructionLength = data.readUInt16(pos);
+    pos += 2 + instructionLength;
+
+    SimplePoints& decoded = threadPoints();
+    if (!decodePoints(data, pos, numPoints, decoded)) {
+        throw std::runtime_error("glyf: truncated or inconsistent point data");
+    }
+
+    outline.points.resize(base + numPoints);
+    GlyphPoint* points = outline.points.data() + base;
+    for (uint32_t i = 0; i < numPoints; ++i) {
+        points[i].x = static_cast<float>(decoded.x[i]);
+        points[i].y = static_cast<float>(decoded.y[i]);
+        points[i].onCurve = (decoded.flags[i] & ON_CURVE_POINT) != 0;
+    }
+
+    return true;
+}
+
+bool GlyfOutlineDecoder::decodeComposite(ByteSpan data, GlyphOutline& outline, int depth) const {
+    size_t pos = 10;
+    uint16_t flags;
+    GlyphOutline component;
+
+    do {
+        flags = data.readUInt16(pos);
+        uint16_t componentID = data.readUInt16(pos + 2);
+        pos += 4;
+
+        int32_t arg1, arg2;
+        if (flags & ARG_1_AND_2_ARE_WORDS) {
+            if (flags & ARGS_ARE_XY_VALUES) {
+                arg1 = data.readInt16(pos);
+                arg2 = data.readInt16(pos + 2);
+            } else {
+                arg1 = data.readUInt16(pos);
+                arg2 = data.readUInt16(pos + 2);
+            }
+            pos += 4;
+        } else {
+            if (flags & ARGS_ARE_XY_VALUES) {
+                arg1 = static_cast<int8_t>(data.readUInt8(pos));
+                arg2 = static_cast<int8_t>(data.readUInt8(pos + 1));
+            } else {
+                arg1 = data.readUInt8(pos);
+                arg2 = data.readUInt8(pos + 1);
+            }
+            pos += 2;
+        }
+
+        // x' = a*x + c*y, y' = b*x + d*y
+        float a = 1, b = 0, c = 0, d = 1;
+        if (flags & WE_HAVE_A_SCALE) {
+            a = d = readF2Dot14(data, pos);
+            pos += 2;
+        } else if (flags & WE_HAVE_AN_X_AND_Y_SCALE) {
+            a = readF2Dot14(data, pos);
+            d = readF2Dot14(data, pos + 2);
+            pos += 4;
+        } else if (flags & WE_HAVE_A_TWO_BY_TWO) {
+            a = readF2Dot14(data, pos);
+            b = readF2Dot14(data, pos + 2);
+            c = readF2Dot14(data, pos + 4);
+            d = readF2Dot14(data, pos + 6);
+            pos += 8;
+        }
+
+        component.clear();
+        if (!decodeInto(componentID, component, depth + 1)) continue;
+
+        for (auto& point : component.points) {
+            float px = point.x;
+            float py = point.y;
+            point.x = a * px + c * py;
+            point.y = b * px + d * py;
+        }
+
+        float dx, dy;
+        if (flags & ARGS_ARE_XY_VALUES) {
+            dx = static_cast<float>(arg1);
+            dy = static_cast<float>(arg2);
+            if ((flags & SCALED_COMPONENT_OFFSET) && !(flags & UNSCALED_COMPONENT_OFFSET)) {
+                float sx = a * dx + c * dy;
+                float sy = b * dx + d * dy;
+                dx = sx;
+                dy = sy;
+            }
+        } else {
+            // Совмещение точки родителя arg1 с точкой компонента arg2
+            if (static_cast<size_t>(arg1) >= outline.points.size() ||
+                static_cast<size_t>(arg2) >= component.points.size()) {
+                throw std::runtime_error("glyf: component anchor point out of range");
+            }
+            dx = outline.points[arg1].x - component.points[arg2].x;
+            dy = outline.points[arg1].y - component.points[arg2].y;
+        }
+
+        size_t base = outline.points.size();
+        for (const auto& point : component.points) {
+            outline.points.push_back(GlyphPoint{point.x + dx, point.y + dy, point.onCurve});
+        }
+        for (uint16_t end : component.contourEnds) {
+            outline.contourEnds.push_back(static_cast<uint16_t>(base + end));
+        }
+    } while (flags & MORE_COMPONENTS);
+
+    return !outline.points.empty();
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,120 @@
+#include "fontmaster/ImageHeader.h"
+#include "fontmaster/PNGDecoder.h"
+#include <stdexcept>
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+uint8_t pngChannels(uint8_t colorType) {
+    switch (colorType) {
+        case 0: return 1;
+        case 2: return 3;
+        case 3: return 1;
+        case 4: return 2;
+        case 6: return 4;
+        default: return 0;
+    }
+}
+
+void probePNG(ByteSpan data, ImageHeader& header) {
+    PNGInfo info = readPNGInfo(data);
+    header.width = info.width;
+    header.height = info.height;
+    header.bitDepth = info.bitDepth;
+    header.channels = pngChannels(info.colorType);
+}
+
+// Маркеры идут подряд от SOI; размеры - в первом SOFn (C0-CF, кроме DHT C4, JPG C8, DAC CC)
+void probeJPEG(ByteSpan data, ImageHeader& header) {
+    size_t pos = 2;
+    while (pos + 4 <= data.size()) {
+        if (data[pos] != 0xFF) throw std::runtime_error("jpeg: marker expected");
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {  // байт-заполнитель
+            ++pos;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {  // маркеры без длины
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) break;  // EOI/SOS: дальше энтропийные данные
+
+        uint16_t segmentLength = data.readUInt16(pos + 2);
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            // SOF: P, Y, X, Nf
+            header.bitDepth = data.readUInt8(pos + 4);
+            header.height = data.readUInt16(pos + 5);
+            header.width = data.readUInt16(pos + 7);
+            header.channels = data.readUInt8(pos + 9);
+            return;
+        }
+        if (segmentLength < 2) throw std::runtime_error("jpeg: bad segment length");
+        pos += 2 + segmentLength;
+    }
+}
+
+// TIFF: порядок байт из заголовка, нужные теги берём из первого IFD
+void probeTIFF(ByteSpan data, ImageHeader& header) {
+    bool littleEndian = data[0] == 'I';
+    auto read16 = [&](size_t offset) -> uint32_t {
+        return littleEndian ? data.readUInt16LE(offset) : data.readUInt16(offset);
+    };
+    auto read32 = [&](size_t offset) -> uint32_t {
+        return littleEndian ? data.readUInt32LE(offset) : data.readUInt32(offset);
+    };
+
+    uint32_t ifdOffset = read32(4);
+    uint32_t entryCount = read16(ifdOffset);
+    header.bitDepth = 1;  // значения по умолчанию по спецификации
+    header.channels = 1;
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        size_t entry = ifdOffset + 2 + static_cast<size_t>(i) * 12;
+        uint32_t tag = read16(entry);
+        uint32_t type = read16(entry + 2);
+        uint32_t count = read32(entry + 4);
+        // SHORT (3) или LONG (4); значение лежит в самой записи, если помещается в 4 байта
+        auto value = [&]() -> uint32_t {
+            if (type == 3) {
+                return count <= 2 ? read16(entry + 8) : read16(read32(entry + 8));
+            }
+            return count <= 1 ? read32(entry + 8) : read32(read32(entry + 8));
+        };
+        switch (tag) {
+            case 256: header.width = value(); break;
+            case 257: header.height = value(); break;
+            case 258: header.bitDepth = static_cast<uint8_t>(value()); break;  // BitsPerSample
+            case 277: header.channels = static_cast<uint8_t>(value()); break;  // SamplesPerPixel
+            default: break;
+        }
+    }
+}
+
+} // namespace
+
+ImageHeader probeImageHeader(ByteSpan data) {
+    ImageHeader header;
+    try {
+        if (isPNGData(data)) {
+            header.format = "png";
+            probePNG(data, header);
+        } else if (data.size() >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+            header.format = "jpg";
+            probeJPEG(data, header);
+        } else if (data.size() >= 8 && ((data[0] == 'I' && data[1] == 'I' && data[2] == 42 && data[3] == 0) ||
+                                        (data[0] == 'M' && data[1] == 'M' && data[2] == 0 && data[3] == 42))) {
+            header.format = "tiff";
+            probeTIFF(data, header);
+        }
+    } catch (const std::exception&) {
+        ImageHeader broken;
+        broken.format = header.format;
+        return broken;
+    }
+    return header;
+}
+
+} // namespace utils
+} // namespace fontmaster
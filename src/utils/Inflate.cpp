@@ -0,0 +1,69 @@
+#include "fontmaster/Inflate.h"
+#include <zlib.h>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+namespace fontmaster {
+namespace utils {
+
+bool isGzipData(ByteSpan data) {
+    return data.size() >= 2 && data[0] == 0x1F && data[1] == 0x8B;
+}
+
+size_t gzipUncompressedSize(ByteSpan data) {
+    if (data.size() < 18) return 0;
+    const uint8_t* p = data.end() - 4;
+    return static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8) |
+           (static_cast<size_t>(p[2]) << 16) | (static_cast<size_t>(p[3]) << 24);
+}
+
+std::vector<uint8_t> inflateData(ByteSpan input, CompressionFormat format,
+                                 size_t sizeHint, size_t maxSize) {
+    z_stream stream{};
+    int windowBits = (format == CompressionFormat::GZIP) ? (16 + MAX_WBITS) : MAX_WBITS;
+    if (inflateInit2(&stream, windowBits) != Z_OK) {
+        throw std::runtime_error("inflate: initialization failed");
+    }
+
+    std::vector<uint8_t> output;
+    size_t capacity = sizeHint ? sizeHint : std::max<size_t>(input.size() * 4, 4096);
+    output.resize(std::min(capacity, maxSize));
+
+    stream.next_in = const_cast<Bytef*>(input.data());
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    size_t produced = 0;
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        if (produced == output.size()) {
+            if (output.size() >= maxSize) {
+                inflateEnd(&stream);
+                throw std::runtime_error("inflate: output exceeds size limit");
+            }
+            output.resize(std::min(output.size() * 2, maxSize));
+        }
+
+        stream.next_out = output.data() + produced;
+        stream.avail_out = static_cast<uInt>(output.size() - produced);
+        status = inflate(&stream, Z_NO_FLUSH);
+        produced = output.size() - stream.avail_out;
+
+        if (status == Z_BUF_ERROR && stream.avail_in == 0) {
+            inflateEnd(&stream);
+            throw std::runtime_error("inflate: truncated input");
+        }
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            std::string message = stream.msg ? stream.msg : "corrupted data";
+            inflateEnd(&stream);
+            throw std::runtime_error("inflate: " + message);
+        }
+    }
+
+    inflateEnd(&stream);
+    output.resize(produced);
+    return output;
+}
+
+} // namespace utils
+} // namespace fontmaster
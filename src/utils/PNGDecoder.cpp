@@ -0,0 +1,593 @@
+#include "fontmaster/PNGDecoder.h"
+#include "fontmaster/Inflate.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FONTMASTER_PNG_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FONTMASTER_PNG_AVX2 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONTMASTER_PNG_NEON 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+enum ColorType : uint8_t {
+    GRAY = 0,
+    RGB = 2,
+    PALETTE = 3,
+    GRAY_ALPHA = 4,
+    RGB_ALPHA = 6
+};
+
+enum FilterType : uint8_t {
+    FILTER_NONE = 0,
+    FILTER_SUB = 1,
+    FILTER_UP = 2,
+    FILTER_AVERAGE = 3,
+    FILTER_PAETH = 4
+};
+
+uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint32_t channelCount(uint8_t colorType) {
+    switch (colorType) {
+        case GRAY: return 1;
+        case RGB: return 3;
+        case PALETTE: return 1;
+        case GRAY_ALPHA: return 2;
+        case RGB_ALPHA: return 4;
+        default: return 0;
+    }
+}
+
+bool isValidDepth(uint8_t colorType, uint8_t depth) {
+    switch (colorType) {
+        case GRAY: return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+        case PALETTE: return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+        case RGB: case GRAY_ALPHA: case RGB_ALPHA: return depth == 8 || depth == 16;
+        default: return false;
+    }
+}
+
+inline uint8_t paethPredictor(int a, int b, int c) {
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    if (pb <= pc) return static_cast<uint8_t>(b);
+    return static_cast<uint8_t>(c);
+}
+
+// ---------- Скалярные фильтры (любой bpp) ----------
+
+void unfilterSubScalar(uint8_t* row, size_t length, size_t bpp) {
+    for (size_t i = bpp; i < length; ++i) row[i] = static_cast<uint8_t>(row[i] + row[i - bpp]);
+}
+
+void unfilterUpScalar(uint8_t* row, const uint8_t* prev, size_t length) {
+    for (size_t i = 0; i < length; ++i) row[i] = static_cast<uint8_t>(row[i] + prev[i]);
+}
+
+void unfilterAverageScalar(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    for (size_t i = 0; i < bpp && i < length; ++i) row[i] = static_cast<uint8_t>(row[i] + (prev[i] >> 1));
+    for (size_t i = bpp; i < length; ++i) {
+        row[i] = static_cast<uint8_t>(row[i] + ((row[i - bpp] + prev[i]) >> 1));
+    }
+}
+
+void unfilterPaethScalar(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    for (size_t i = 0; i < bpp && i < length; ++i) row[i] = static_cast<uint8_t>(row[i] + prev[i]);
+    for (size_t i = bpp; i < length; ++i) {
+        row[i] = static_cast<uint8_t>(row[i] + paethPredictor(row[i - bpp], prev[i], prev[i - bpp]));
+    }
+}
+
+// ---------- SIMD-фильтры ----------
+// Sub/Average/Paeth последовательны по пикселям, поэтому векторизуются по каналам
+// одного пикселя (bpp 3 и 4); Up и Sub для bpp 4 - по 16/32 байта за шаг.
+
+#if defined(FONTMASTER_PNG_SSE2)
+
+inline __m128i loadPixel(const uint8_t* p, size_t bpp) {
+    uint32_t value = 0;
+    std::memcpy(&value, p, bpp);
+    return _mm_cvtsi32_si128(static_cast<int>(value));
+}
+
+inline void storePixel(uint8_t* p, __m128i v, size_t bpp) {
+    uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+    std::memcpy(p, &value, bpp);
+}
+
+#if defined(FONTMASTER_PNG_AVX2)
+__attribute__((target("avx2")))
+void unfilterUpAVX2(uint8_t* row, const uint8_t* prev, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_add_epi8(a, b));
+    }
+    unfilterUpScalar(row + i, prev + i, length - i);
+}
+
+bool hasAVX2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void unfilterUp(uint8_t* row, const uint8_t* prev, size_t length) {
+#if defined(FONTMASTER_PNG_AVX2)
+    if (hasAVX2()) {
+        unfilterUpAVX2(row, prev, length);
+        return;
+    }
+#endif
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(a, b));
+    }
+    unfilterUpScalar(row + i, prev + i, length - i);
+}
+
+void unfilterSub(uint8_t* row, size_t length, size_t bpp) {
+    if (bpp == 4) {
+        // Префиксная сумма по 4 пикселям: два сдвига со сложением и перенос последнего пикселя
+        __m128i carry = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi8(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), v);
+            carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        for (i = std::max<size_t>(i, 4); i < length; ++i) row[i] = static_cast<uint8_t>(row[i] + row[i - 4]);
+        return;
+    }
+    if (bpp == 3) {
+        __m128i a = _mm_setzero_si128();
+        size_t i = 0;
+        // Читается и пишется ровно bpp байт - без выхода за конец строки
+        for (; i + 3 <= length; i += 3) {
+            a = _mm_add_epi8(a, loadPixel(row + i, 3));
+            storePixel(row + i, a, 3);
+        }
+        return;
+    }
+    unfilterSubScalar(row, length, bpp);
+}
+
+void unfilterAverage(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    if (bpp != 3 && bpp != 4) {
+        unfilterAverageScalar(row, prev, length, bpp);
+        return;
+    }
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + bpp <= length; i += bpp) {
+        __m128i b = loadPixel(prev + i, bpp);
+        // _mm_avg_epu8 округляет вверх; PNG требует floor((a + b) / 2)
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(avg, loadPixel(row + i, bpp));
+        storePixel(row + i, a, bpp);
+    }
+}
+
+void unfilterPaeth(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    if (bpp != 3 && bpp != 4) {
+        unfilterPaethScalar(row, prev, length, bpp);
+        return;
+    }
+    // Вычисления в 16-битных полосах, как в libpng
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero;
+    __m128i c = zero;
+    for (size_t i = 0; i + bpp <= length; i += bpp) {
+        __m128i b = _mm_unpacklo_epi8(loadPixel(prev + i, bpp), zero);
+        __m128i x = _mm_unpacklo_epi8(loadPixel(row + i, bpp), zero);
+
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = _mm_add_epi16(pa, pb);
+        pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+        pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+        pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        __m128i useA = _mm_cmpeq_epi16(smallest, pa);
+        __m128i useB = _mm_andnot_si128(useA, _mm_cmpeq_epi16(smallest, pb));
+        __m128i useC = _mm_andnot_si128(_mm_or_si128(useA, useB), _mm_set1_epi16(-1));
+        __m128i predictor = _mm_or_si128(_mm_and_si128(useA, a),
+                                         _mm_or_si128(_mm_and_si128(useB, b), _mm_and_si128(useC, c)));
+
+        x = _mm_and_si128(_mm_add_epi16(x, predictor), _mm_set1_epi16(0xFF));
+        storePixel(row + i, _mm_packus_epi16(x, x), bpp);
+        a = x;
+        c = b;
+    }
+}
+
+#elif defined(FONTMASTER_PNG_NEON)
+
+inline uint8x8_t loadPixel(const uint8_t* p, size_t bpp) {
+    uint32_t value = 0;
+    std::memcpy(&value, p, bpp);
+    return vreinterpret_u8_u32(vdup_n_u32(value));
+}
+
+inline void storePixel(uint8_t* p, uint8x8_t v, size_t bpp) {
+    uint32_t value = vget_lane_u32(vreinterpret_u32_u8(v), 0);
+    std::memcpy(p, &value, bpp);
+}
+
+void unfilterUp(uint8_t* row, const uint8_t* prev, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(row + i, vaddq_u8(vld1q_u8(row + i), vld1q_u8(prev + i)));
+    }
+    unfilterUpScalar(row + i, prev + i, length - i);
+}
+
+void unfilterSub(uint8_t* row, size_t length, size_t bpp) {
+    if (bpp != 3 && bpp != 4) {
+        unfilterSubScalar(row, length, bpp);
+        return;
+    }
+    uint8x8_t a = vdup_n_u8(0);
+    for (size_t i = 0; i + bpp <= length; i += bpp) {
+        a = vadd_u8(a, loadPixel(row + i, bpp));
+        storePixel(row + i, a, bpp);
+    }
+}
+
+void unfilterAverage(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    if (bpp != 3 && bpp != 4) {
+        unfilterAverageScalar(row, prev, length, bpp);
+        return;
+    }
+    uint8x8_t a = vdup_n_u8(0);
+    for (size_t i = 0; i + bpp <= length; i += bpp) {
+        a = vadd_u8(vhadd_u8(a, loadPixel(prev + i, bpp)), loadPixel(row + i, bpp));
+        storePixel(row + i, a, bpp);
+    }
+}
+
+void unfilterPaeth(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    if (bpp != 3 && bpp != 4) {
+        unfilterPaethScalar(row, prev, length, bpp);
+        return;
+    }
+    uint8x8_t a = vdup_n_u8(0);
+    uint8x8_t c = vdup_n_u8(0);
+    for (size_t i = 0; i + bpp <= length; i += bpp) {
+        uint8x8_t b = loadPixel(prev + i, bpp);
+        uint16x8_t pa = vabdl_u8(b, c);
+        uint16x8_t pb = vabdl_u8(a, c);
+        uint16x8_t pc = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+
+        uint8x8_t useA = vmovn_u16(vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc)));
+        uint8x8_t useB = vmovn_u16(vcleq_u16(pb, pc));
+        uint8x8_t predictor = vbsl_u8(useA, a, vbsl_u8(useB, b, c));
+
+        a = vadd_u8(predictor, loadPixel(row + i, bpp));
+        storePixel(row + i, a, bpp);
+        c = b;
+    }
+}
+
+#else
+
+void unfilterUp(uint8_t* row, const uint8_t* prev, size_t length) {
+    unfilterUpScalar(row, prev, length);
+}
+
+void unfilterSub(uint8_t* row, size_t length, size_t bpp) {
+    unfilterSubScalar(row, length, bpp);
+}
+
+void unfilterAverage(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    unfilterAverageScalar(row, prev, length, bpp);
+}
+
+void unfilterPaeth(uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    unfilterPaethScalar(row, prev, length, bpp);
+}
+
+#endif
+
+void unfilterRow(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+    switch (filter) {
+        case FILTER_NONE: break;
+        case FILTER_SUB: unfilterSub(row, length, bpp); break;
+        case FILTER_UP: unfilterUp(row, prev, length); break;
+        case FILTER_AVERAGE: unfilterAverage(row, prev, length, bpp); break;
+        case FILTER_PAETH: unfilterPaeth(row, prev, length, bpp); break;
+        default: throw std::runtime_error("PNG: invalid filter type " + std::to_string(filter));
+    }
+}
+
+// ---------- Преобразование строки в RGBA8 ----------
+
+struct ColorState {
+    PNGInfo info;
+    uint8_t palette[256][4];
+    uint32_t paletteSize = 0;
+    bool hasColorKey = false;
+    uint16_t keyGray = 0;
+    uint16_t keyRed = 0, keyGreen = 0, keyBlue = 0;
+};
+
+inline uint32_t readSample(const uint8_t* row, uint32_t index, uint8_t depth) {
+    switch (depth) {
+        case 8: return row[index];
+        case 16: return (static_cast<uint32_t>(row[index * 2]) << 8) | row[index * 2 + 1];
+        default: {
+            uint32_t bit = index * depth;
+            uint32_t shift = 8 - depth - (bit & 7);
+            return (row[bit >> 3] >> shift) & ((1u << depth) - 1);
+        }
+    }
+}
+
+void convertRow(const ColorState& state, const uint8_t* row, uint32_t count, uint8_t* out) {
+    const PNGInfo& info = state.info;
+    const uint8_t depth = info.bitDepth;
+
+    switch (info.colorType) {
+        case RGB_ALPHA:
+            if (depth == 8) {
+                std::memcpy(out, row, static_cast<size_t>(count) * 4);
+            } else {
+                for (uint32_t x = 0; x < count; ++x) {
+                    for (int c = 0; c < 4; ++c) out[x * 4 + c] = row[x * 8 + c * 2];
+                }
+            }
+            break;
+
+        case RGB:
+            for (uint32_t x = 0; x < count; ++x) {
+                uint8_t* p = out + x * 4;
+                if (depth == 8) {
+                    p[0] = row[x * 3];
+                    p[1] = row[x * 3 + 1];
+                    p[2] = row[x * 3 + 2];
+                    p[3] = (state.hasColorKey && p[0] == state.keyRed && p[1] == state.keyGreen &&
+                            p[2] == state.keyBlue) ? 0 : 255;
+                } else {
+                    uint32_t r = readSample(row, x * 3, 16);
+                    uint32_t g = readSample(row, x * 3 + 1, 16);
+                    uint32_t b = readSample(row, x * 3 + 2, 16);
+                    p[0] = static_cast<uint8_t>(r >> 8);
+                    p[1] = static_cast<uint8_t>(g >> 8);
+                    p[2] = static_cast<uint8_t>(b >> 8);
+                    p[3] = (state.hasColorKey && r == state.keyRed && g == state.keyGreen &&
+                            b == state.keyBlue) ? 0 : 255;
+                }
+            }
+            break;
+
+        case GRAY_ALPHA:
+            for (uint32_t x = 0; x < count; ++x) {
+                uint8_t* p = out + x * 4;
+                uint8_t gray = depth == 8 ? row[x * 2] : row[x * 4];
+                uint8_t alpha = depth == 8 ? row[x * 2 + 1] : row[x * 4 + 2];
+                p[0] = p[1] = p[2] = gray;
+                p[3] = alpha;
+            }
+            break;
+
+        case GRAY: {
+            // Множитель приведения 1/2/4-битного значения к 8 битам
+            uint32_t scale = depth == 1 ? 255 : depth == 2 ? 85 : depth == 4 ? 17 : 1;
+            for (uint32_t x = 0; x < count; ++x) {
+                uint8_t* p = out + x * 4;
+                uint32_t sample = readSample(row, x, depth);
+                uint8_t gray = depth == 16 ? static_cast<uint8_t>(sample >> 8)
+                                           : static_cast<uint8_t>(sample * scale);
+                p[0] = p[1] = p[2] = gray;
+                p[3] = (state.hasColorKey && sample == state.keyGray) ? 0 : 255;
+            }
+            break;
+        }
+
+        case PALETTE:
+            for (uint32_t x = 0; x < count; ++x) {
+                uint32_t index = readSample(row, x, depth);
+                std::memcpy(out + x * 4, state.palette[index], 4);
+            }
+            break;
+    }
+}
+
+} // namespace
+
+bool isPNGData(ByteSpan data) {
+    return data.size() >= 8 && std::memcmp(data.data(), PNG_SIGNATURE, 8) == 0;
+}
+
+PNGInfo readPNGInfo(ByteSpan data) {
+    if (!isPNGData(data)) throw std::runtime_error("PNG: bad signature");
+    if (data.size() < 8 + 8 + 13) throw std::runtime_error("PNG: truncated IHDR");
+
+    const uint8_t* chunk = data.data() + 8;
+    if (readBE32(chunk) != 13 || std::memcmp(chunk + 4, "IHDR", 4) != 0) {
+        throw std::runtime_error("PNG: first chunk is not IHDR");
+    }
+
+    const uint8_t* ihdr = chunk + 8;
+    PNGInfo info;
+    info.width = readBE32(ihdr);
+    info.height = readBE32(ihdr + 4);
+    info.bitDepth = ihdr[8];
+    info.colorType = ihdr[9];
+    info.interlace = ihdr[12];
+
+    if (info.width == 0 || info.height == 0) throw std::runtime_error("PNG: empty image");
+    if (!isValidDepth(info.colorType, info.bitDepth)) {
+        throw std::runtime_error("PNG: invalid color type/bit depth " + std::to_string(info.colorType) +
+                                 "/" + std::to_string(info.bitDepth));
+    }
+    if (ihdr[10] != 0 || ihdr[11] != 0 || info.interlace > 1) {
+        throw std::runtime_error("PNG: unsupported compression, filter or interlace method");
+    }
+    return info;
+}
+
+RGBAImage decodePNG(ByteSpan data, size_t maxPixels) {
+    ColorState state;
+    state.info = readPNGInfo(data);
+    const PNGInfo& info = state.info;
+
+    if (static_cast<uint64_t>(info.width) * info.height > maxPixels) {
+        throw std::runtime_error("PNG: image " + std::to_string(info.width) + "x" +
+                                 std::to_string(info.height) + " exceeds size limit");
+    }
+
+    // Разбор чанков; единственный IDAT (типичный случай для глифов) не копируется
+    ByteSpan idat;
+    std::vector<uint8_t> joinedIdat;
+    bool havePalette = false;
+    size_t pos = 8;
+    while (pos + 8 <= data.size()) {
+        uint32_t length = readBE32(data.data() + pos);
+        const uint8_t* type = data.data() + pos + 4;
+        if (length > data.size() - pos - 8) throw std::runtime_error("PNG: chunk exceeds data");
+        ByteSpan body(data.data() + pos + 8, length);
+
+        if (std::memcmp(type, "IDAT", 4) == 0) {
+            if (idat.empty() && joinedIdat.empty()) {
+                idat = body;
+            } else {
+                if (joinedIdat.empty()) joinedIdat.assign(idat.begin(), idat.end());
+                joinedIdat.insert(joinedIdat.end(), body.begin(), body.end());
+                idat = ByteSpan(joinedIdat);
+            }
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            if (length % 3 != 0 || length / 3 > 256) throw std::runtime_error("PNG: invalid PLTE");
+            state.paletteSize = length / 3;
+            for (uint32_t i = 0; i < state.paletteSize; ++i) {
+                state.palette[i][0] = body[i * 3];
+                state.palette[i][1] = body[i * 3 + 1];
+                state.palette[i][2] = body[i * 3 + 2];
+                state.palette[i][3] = 255;
+            }
+            havePalette = true;
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+            if (info.colorType == PALETTE) {
+                for (uint32_t i = 0; i < length && i < 256; ++i) state.palette[i][3] = body[i];
+            } else if (info.colorType == GRAY && length >= 2) {
+                state.hasColorKey = true;
+                state.keyGray = body.readUInt16(0);
+            } else if (info.colorType == RGB && length >= 6) {
+                state.hasColorKey = true;
+                state.keyRed = body.readUInt16(0);
+                state.keyGreen = body.readUInt16(2);
+                state.keyBlue = body.readUInt16(4);
+            }
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + static_cast<size_t>(length);
+    }
+
+    if (idat.empty()) throw std::runtime_error("PNG: no IDAT chunk");
+    if (info.colorType == PALETTE) {
+        if (!havePalette) throw std::runtime_error("PNG: missing PLTE");
+        // Индексы за пределами палитры - непрозрачный чёрный
+        for (uint32_t i = state.paletteSize; i < 256; ++i) {
+            state.palette[i][0] = state.palette[i][1] = state.palette[i][2] = 0;
+            state.palette[i][3] = 255;
+        }
+    }
+
+    const size_t bitsPerPixel = static_cast<size_t>(channelCount(info.colorType)) * info.bitDepth;
+    const size_t bpp = std::max<size_t>(1, bitsPerPixel / 8);
+    auto rowBytes = [&](uint32_t width) { return (width * bitsPerPixel + 7) / 8; };
+
+    // Размер распакованных данных известен заранее
+    struct Pass { uint32_t x0, y0, dx, dy; };
+    static const Pass ADAM7[7] = {
+        {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}
+    };
+    static const Pass SINGLE[1] = {{0, 0, 1, 1}};
+    const Pass* passes = info.interlace ? ADAM7 : SINGLE;
+    const int passCount = info.interlace ? 7 : 1;
+
+    size_t rawSize = 0;
+    for (int p = 0; p < passCount; ++p) {
+        uint32_t pw = info.width > passes[p].x0 ? (info.width - passes[p].x0 + passes[p].dx - 1) / passes[p].dx : 0;
+        uint32_t ph = info.height > passes[p].y0 ? (info.height - passes[p].y0 + passes[p].dy - 1) / passes[p].dy : 0;
+        if (pw && ph) rawSize += static_cast<size_t>(ph) * (rowBytes(pw) + 1);
+    }
+
+    // +1 байт лимита: zlib может потребовать ещё один вызов для чтения adler32
+    std::vector<uint8_t> raw = inflateData(idat, CompressionFormat::ZLIB, rawSize, rawSize + 1);
+    if (raw.size() < rawSize) throw std::runtime_error("PNG: image data truncated");
+
+    RGBAImage image;
+    image.width = info.width;
+    image.height = info.height;
+    image.pixels.resize(static_cast<size_t>(info.width) * info.height * 4);
+
+    std::vector<uint8_t> zeroRow(rowBytes(info.width), 0);
+    std::vector<uint8_t> passRow;
+    uint8_t* cursor = raw.data();
+
+    for (int p = 0; p < passCount; ++p) {
+        const Pass& pass = passes[p];
+        uint32_t pw = info.width > pass.x0 ? (info.width - pass.x0 + pass.dx - 1) / pass.dx : 0;
+        uint32_t ph = info.height > pass.y0 ? (info.height - pass.y0 + pass.dy - 1) / pass.dy : 0;
+        if (pw == 0 || ph == 0) continue;
+
+        size_t length = rowBytes(pw);
+        const uint8_t* prev = zeroRow.data();
+        if (info.interlace) passRow.resize(static_cast<size_t>(pw) * 4);
+
+        for (uint32_t y = 0; y < ph; ++y) {
+            uint8_t filter = cursor[0];
+            uint8_t* row = cursor + 1;
+            unfilterRow(filter, row, prev, length, bpp);
+
+            uint32_t targetY = pass.y0 + y * pass.dy;
+            if (!info.interlace) {
+                convertRow(state, row, pw, image.pixels.data() + static_cast<size_t>(targetY) * info.width * 4);
+            } else {
+                convertRow(state, row, pw, passRow.data());
+                for (uint32_t x = 0; x < pw; ++x) {
+                    size_t target = (static_cast<size_t>(targetY) * info.width + pass.x0 + x * pass.dx) * 4;
+                    std::memcpy(image.pixels.data() + target, passRow.data() + x * 4, 4);
+                }
+            }
+
+            prev = row;
+            cursor += length + 1;
+        }
+    }
+
+    return image;
+}
+
+} // namespace utils
+} // namespace fontmaster
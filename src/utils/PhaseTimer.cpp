@@ -0,0 +1,49 @@
+#include "fontmaster/PhaseTimer.h"
+
+namespace fontmaster {
+namespace utils {
+
+namespace {
+
+thread_local PhaseProfile* currentProfile = nullptr;
+
+} // namespace
+
+void PhaseProfile::attach(PhaseProfile* profile) {
+    currentProfile = profile;
+}
+
+PhaseProfile* PhaseProfile::current() {
+    return currentProfile;
+}
+
+void PhaseProfile::record(const char* name, uint64_t nanoseconds) {
+    // Этапов десяток, линейный поиск дешевле хэширования
+    for (Phase& phase : entries) {
+        if (phase.name == name) {
+            phase.nanoseconds += nanoseconds;
+            ++phase.calls;
+            return;
+        }
+    }
+    entries.push_back({name, nanoseconds, 1});
+}
+
+ScopedPhase::ScopedPhase(const char* name) : profile(currentProfile), name(name) {
+    if (!profile) return;
+    parent = profile->active;
+    profile->active = this;
+    start = std::chrono::steady_clock::now();
+}
+
+ScopedPhase::~ScopedPhase() {
+    if (!profile) return;
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    profile->active = parent;
+    if (parent) parent->nested += elapsed;
+    profile->record(name, elapsed > nested ? elapsed - nested : 0);
+}
+
+} // namespace utils
+} // namespace fontmaster
@@ -0,0 +1,353 @@
+#include "fontmaster/Rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FONTMASTER_RASTER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONTMASTER_RASTER_NEON 1
+#endif
+
+namespace fontmaster {
+namespace utils {
+
+void Rasterizer::reset(uint32_t newWidth, uint32_t newHeight) {
+    width = newWidth;
+    height = newHeight;
+    // Запас в несколько ячеек справа: отрезок у правого края пишет в x1i + 1
+    stride = static_cast<size_t>(width) + 4;
+    accumulation.assign(stride * height, 0.0f);
+}
+
+void Rasterizer::drawLine(float x0, float y0, float x1, float y1) {
+    if (y0 == y1 || height == 0) return;
+
+    float dir = 1.0f;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.0f;
+    }
+    if (y1 <= 0 || y0 >= static_cast<float>(height)) return;
+
+    // Выход за левый/правый край сворачивается на границу: площадь при этом сохраняется
+    const float maxX = static_cast<float>(width);
+    x0 = std::min(std::max(x0, 0.0f), maxX);
+    x1 = std::min(std::max(x1, 0.0f), maxX);
+
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0;
+    if (y0 < 0) x -= y0 * dxdy;
+
+    int yStart = std::max(0, static_cast<int>(y0));
+    int yEnd = std::min(static_cast<int>(height), static_cast<int>(std::ceil(y1)));
+
+    for (int y = yStart; y < yEnd; ++y) {
+        float* row = accumulation.data() + static_cast<size_t>(y) * stride;
+        float dy = std::min(static_cast<float>(y + 1), y1) - std::max(static_cast<float>(y), y0);
+        float xNext = x + dxdy * dy;
+        float d = dy * dir;
+
+        float xa = std::min(x, xNext);
+        float xb = std::max(x, xNext);
+        float xaFloor = std::floor(xa);
+        int xai = static_cast<int>(xaFloor);
+        float xbCeil = std::ceil(xb);
+        int xbi = static_cast<int>(xbCeil);
+
+        if (xbi <= xai + 1) {
+            // Отрезок в пределах одного пикселя
+            float xmf = 0.5f * (x + xNext) - xaFloor;
+            row[xai] += d - d * xmf;
+            row[xai + 1] += d * xmf;
+        } else {
+            float s = 1.0f / (xb - xa);
+            float xaf = xa - xaFloor;
+            float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+            float xbf = xb - xbCeil + 1.0f;
+            float am = 0.5f * s * xbf * xbf;
+
+            row[xai] += d * a0;
+            if (xbi == xai + 2) {
+                row[xai + 1] += d * (1.0f - a0 - am);
+            } else {
+                float a1 = s * (1.5f - xaf);
+                row[xai + 1] += d * (a1 - a0);
+                for (int xi = xai + 2; xi < xbi - 1; ++xi) {
+                    row[xi] += d * s;
+                }
+                float a2 = a1 + static_cast<float>(xbi - xai - 3) * s;
+                row[xbi - 1] += d * (1.0f - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        x = xNext;
+    }
+}
+
+void Rasterizer::drawQuad(float x0, float y0, float x1, float y1, float x2, float y2) {
+    // Число отрезков по отклонению кривой от хорды
+    float devX = x0 - 2 * x1 + x2;
+    float devY = y0 - 2 * y1 + y2;
+    float devSq = devX * devX + devY * devY;
+    if (devSq < 0.333f) {
+        drawLine(x0, y0, x2, y2);
+        return;
+    }
+
+    const float tolerance = 3.0f;
+    int segments = 1 + static_cast<int>(std::floor(std::sqrt(std::sqrt(tolerance * devSq))));
+    float step = 1.0f / static_cast<float>(segments);
+    float px = x0, py = y0;
+    float t = 0;
+    for (int i = 0; i < segments - 1; ++i) {
+        t += step;
+        float mt = 1 - t;
+        float nx = mt * mt * x0 + 2 * mt * t * x1 + t * t * x2;
+        float ny = mt * mt * y0 + 2 * mt * t * y1 + t * t * y2;
+        drawLine(px, py, nx, ny);
+        px = nx;
+        py = ny;
+    }
+    drawLine(px, py, x2, y2);
+}
+
+void Rasterizer::addOutline(const GlyphOutline& outline, float scale, float dx, float dy) {
+    size_t start = 0;
+    for (uint16_t endIndex : outline.contourEnds) {
+        size_t end = endIndex;
+        if (end < start || end >= outline.points.size()) break;
+        size_t count = end - start + 1;
+
+        auto px = [&](size_t i) { return outline.points[start + i % count].x * scale + dx; };
+        auto py = [&](size_t i) { return dy - outline.points[start + i % count].y * scale; };
+        auto on = [&](size_t i) { return outline.points[start + i % count].onCurve; };
+
+        // Стартовая on-curve точка: первая, последняя или середина между ними
+        size_t first = 0;
+        float startX, startY;
+        if (on(0)) {
+            startX = px(0);
+            startY = py(0);
+            first = 1;
+        } else if (on(count - 1)) {
+            startX = px(count - 1);
+            startY = py(count - 1);
+        } else {
+            startX = 0.5f * (px(0) + px(count - 1));
+            startY = 0.5f * (py(0) + py(count - 1));
+        }
+
+        float curX = startX, curY = startY;
+        bool haveControl = false;
+        float ctrlX = 0, ctrlY = 0;
+
+        size_t last = on(count - 1) && !on(0) ? count - 1 : count;
+        for (size_t i = first; i < last; ++i) {
+            float x = px(i), y = py(i);
+            if (on(i)) {
+                if (haveControl) {
+                    drawQuad(curX, curY, ctrlX, ctrlY, x, y);
+                    haveControl = false;
+                } else {
+                    drawLine(curX, curY, x, y);
+                }
+                curX = x;
+                curY = y;
+            } else {
+                if (haveControl) {
+                    float midX = 0.5f * (ctrlX + x);
+                    float midY = 0.5f * (ctrlY + y);
+                    drawQuad(curX, curY, ctrlX, ctrlY, midX, midY);
+                    curX = midX;
+                    curY = midY;
+                }
+                ctrlX = x;
+                ctrlY = y;
+                haveControl = true;
+            }
+        }
+
+        // Замыкание контура
+        if (haveControl) {
+            drawQuad(curX, curY, ctrlX, ctrlY, startX, startY);
+        } else {
+            drawLine(curX, curY, startX, startY);
+        }
+
+        start = end + 1;
+    }
+}
+
+void Rasterizer::resolve(uint8_t* coverage) {
+    for (uint32_t y = 0; y < height; ++y) {
+        float* row = accumulation.data() + static_cast<size_t>(y) * stride;
+        uint8_t* out = coverage + static_cast<size_t>(y) * width;
+        uint32_t x = 0;
+
+#if defined(FONTMASTER_RASTER_SSE2)
+        __m128 carry = _mm_setzero_ps();
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; x + 4 <= width; x += 4) {
+            // Префиксная сумма внутри 4 элементов: два сдвига со сложением
+            __m128 v = _mm_loadu_ps(row + x);
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+            v = _mm_add_ps(v, carry);
+            carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+            __m128 a = _mm_min_ps(_mm_andnot_ps(signMask, v), one);
+            __m128i i32 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), half));
+            __m128i i16 = _mm_packs_epi32(i32, i32);
+            __m128i u8 = _mm_packus_epi16(i16, i16);
+            int packed = _mm_cvtsi128_si32(u8);
+            std::memcpy(out + x, &packed, 4);
+        }
+        float acc = _mm_cvtss_f32(carry);
+#elif defined(FONTMASTER_RASTER_NEON)
+        float32x4_t carry = vdupq_n_f32(0.0f);
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        for (; x + 4 <= width; x += 4) {
+            float32x4_t v = vld1q_f32(row + x);
+            v = vaddq_f32(v, vextq_f32(zero, v, 3));
+            v = vaddq_f32(v, vextq_f32(zero, v, 2));
+            v = vaddq_f32(v, carry);
+            carry = vdupq_n_f32(vgetq_lane_f32(v, 3));
+
+            float32x4_t a = vminq_f32(vabsq_f32(v), vdupq_n_f32(1.0f));
+            uint32x4_t i32 = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), a, 255.0f));
+            uint16x4_t i16 = vmovn_u32(i32);
+            uint8x8_t u8 = vmovn_u16(vcombine_u16(i16, i16));
+            uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(u8), 0);
+            std::memcpy(out + x, &packed, 4);
+        }
+        float acc = vgetq_lane_f32(carry, 0);
+#else
+        float acc = 0.0f;
+#endif
+
+        for (; x < width; ++x) {
+            acc += row[x];
+            float a = std::min(std::fabs(acc), 1.0f);
+            out[x] = static_cast<uint8_t>(a * 255.0f + 0.5f);
+        }
+
+        std::fill(row, row + stride, 0.0f);
+    }
+}
+
+namespace {
+
+inline uint32_t div255(uint32_t value) {
+    value += 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+} // namespace
+
+void blendSolidColor(uint8_t* dst, const uint8_t* coverage, size_t pixelCount, uint32_t color) {
+    uint32_t alpha = color & 0xFF;
+    if (alpha == 0) return;
+
+    // Premultiplied цвет
+    uint32_t r = div255(((color >> 24) & 0xFF) * alpha);
+    uint32_t g = div255(((color >> 16) & 0xFF) * alpha);
+    uint32_t b = div255(((color >> 8) & 0xFF) * alpha);
+
+    size_t i = 0;
+
+#if defined(FONTMASTER_RASTER_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i src = _mm_setr_epi16(static_cast<short>(r), static_cast<short>(g), static_cast<short>(b),
+                                       static_cast<short>(alpha), static_cast<short>(r), static_cast<short>(g),
+                                       static_cast<short>(b), static_cast<short>(alpha));
+
+    auto mulDiv255 = [&](__m128i a, __m128i b16) {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b16), bias);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    };
+
+    for (; i + 4 <= pixelCount; i += 4) {
+        int covPacked;
+        std::memcpy(&covPacked, coverage + i, 4);
+        if (covPacked == 0) continue;
+
+        // Покрытие каждого пикселя размножается на 4 канала
+        __m128i cov = _mm_cvtsi32_si128(covPacked);
+        cov = _mm_unpacklo_epi8(cov, cov);
+        cov = _mm_unpacklo_epi8(cov, cov);
+        __m128i covLo = _mm_unpacklo_epi8(cov, zero);
+        __m128i covHi = _mm_unpackhi_epi8(cov, zero);
+
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+        __m128i dstLo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i dstHi = _mm_unpackhi_epi8(pixels, zero);
+
+        __m128i srcLo = mulDiv255(src, covLo);
+        __m128i srcHi = mulDiv255(src, covHi);
+
+        __m128i invLo = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLo, 0xFF), 0xFF));
+        __m128i invHi = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHi, 0xFF), 0xFF));
+
+        dstLo = _mm_add_epi16(srcLo, mulDiv255(dstLo, invLo));
+        dstHi = _mm_add_epi16(srcHi, mulDiv255(dstHi, invHi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(dstLo, dstHi));
+    }
+#elif defined(FONTMASTER_RASTER_NEON)
+    const uint8x8_t srcColor = vcreate_u8(static_cast<uint64_t>(r) | (static_cast<uint64_t>(g) << 8) |
+                                          (static_cast<uint64_t>(b) << 16) | (static_cast<uint64_t>(alpha) << 24) |
+                                          (static_cast<uint64_t>(r) << 32) | (static_cast<uint64_t>(g) << 40) |
+                                          (static_cast<uint64_t>(b) << 48) | (static_cast<uint64_t>(alpha) << 56));
+    for (; i + 2 <= pixelCount; i += 2) {
+        if ((coverage[i] | coverage[i + 1]) == 0) continue;
+
+        uint8x8_t cov = vcreate_u8(0x0101010101010101ULL * coverage[i] & 0x00000000FFFFFFFFULL |
+                                   (0x0101010101010101ULL * coverage[i + 1] & 0xFFFFFFFF00000000ULL));
+        uint16x8_t s16 = vmull_u8(srcColor, cov);
+        uint8x8_t s = vrshrn_n_u16(vrsraq_n_u16(s16, s16, 8), 8);
+
+        uint8x8_t d = vld1_u8(dst + i * 4);
+        uint8x8_t sa = vtbl1_u8(s, vcreate_u8(0x0707070703030303ULL));
+        uint16x8_t d16 = vmull_u8(d, vsub_u8(vdup_n_u8(255), sa));
+        uint8x8_t dScaled = vrshrn_n_u16(vrsraq_n_u16(d16, d16, 8), 8);
+        vst1_u8(dst + i * 4, vadd_u8(s, dScaled));
+    }
+#endif
+
+    for (; i < pixelCount; ++i) {
+        uint32_t c = coverage[i];
+        if (c == 0) continue;
+        uint8_t* p = dst + i * 4;
+        uint32_t sr = div255(r * c);
+        uint32_t sg = div255(g * c);
+        uint32_t sb = div255(b * c);
+        uint32_t sa = div255(alpha * c);
+        uint32_t inv = 255 - sa;
+        p[0] = static_cast<uint8_t>(sr + div255(p[0] * inv));
+        p[1] = static_cast<uint8_t>(sg + div255(p[1] * inv));
+        p[2] = static_cast<uint8_t>(sb + div255(p[2] * inv));
+        p[3] = static_cast<uint8_t>(sa + div255(p[3] * inv));
+    }
+}
+
+void unpremultiplyAlpha(uint8_t* rgba, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; ++i) {
+        uint8_t* p = rgba + i * 4;
+        uint32_t a = p[3];
+        if (a == 0 || a == 255) continue;
+        for (int c = 0; c < 3; ++c) {
+            p[c] = static_cast<uint8_t>(std::min<uint32_t>(255, (p[c] * 255u + a / 2) / a));
+        }
+    }
+}
+
+} // namespace utils
+} // namespace fontmaster
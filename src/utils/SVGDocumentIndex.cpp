@@ -0,0 +1,123 @@
+#include "fontmaster/SVGDocumentIndex.h"
+#include "fontmaster/Inflate.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace fontmaster {
+namespace utils {
+
+SVGDocumentIndex::SVGDocumentIndex(ByteSpan svgTable, size_t cacheBytes)
+    : table(svgTable), cache(cacheBytes) {
+    parse();
+}
+
+void SVGDocumentIndex::parse() {
+    // Заголовок: version(2) + svgDocumentListOffset(4) + reserved(4)
+    if (table.size() < 10) {
+        throw std::runtime_error("SVG: table too small");
+    }
+
+    uint16_t version = table.readUInt16(0);
+    if (version != 0) {
+        throw std::runtime_error("SVG: unsupported table version " + std::to_string(version));
+    }
+
+    uint32_t listOffset = table.readUInt32(2);
+    if (static_cast<size_t>(listOffset) + 2 > table.size()) {
+        throw std::runtime_error("SVG: document list out of bounds");
+    }
+
+    documentList = table.subspan(listOffset);
+    uint16_t numEntries = documentList.readUInt16(0);
+    if (2 + static_cast<size_t>(numEntries) * 12 > documentList.size()) {
+        throw std::runtime_error("SVG: document records out of bounds");
+    }
+
+    records.resize(numEntries);
+    const uint8_t* p = documentList.data() + 2;
+    bool sorted = true;
+    for (uint16_t i = 0; i < numEntries; ++i, p += 12) {
+        SVGDocumentRecord& record = records[i];
+        record.startGlyphID = static_cast<uint16_t>((p[0] << 8) | p[1]);
+        record.endGlyphID = static_cast<uint16_t>((p[2] << 8) | p[3]);
+        record.offset = (uint32_t(p[4]) << 24) | (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+        record.length = (uint32_t(p[8]) << 24) | (uint32_t(p[9]) << 16) | (uint32_t(p[10]) << 8) | p[11];
+
+        if (record.endGlyphID < record.startGlyphID) {
+            throw std::runtime_error("SVG: invalid glyph range in document record");
+        }
+        if (static_cast<size_t>(record.offset) + record.length > documentList.size()) {
+            throw std::runtime_error("SVG: document data out of bounds");
+        }
+        if (i > 0 && records[i - 1].endGlyphID >= record.startGlyphID) {
+            sorted = false;
+        }
+    }
+
+    // Спецификация требует сортировки по startGlyphID без пересечений,
+    // но встречаются шрифты, где это нарушено
+    if (!sorted) {
+        std::stable_sort(records.begin(), records.end(),
+                         [](const SVGDocumentRecord& a, const SVGDocumentRecord& b) {
+                             return a.startGlyphID < b.startGlyphID;
+                         });
+    }
+
+    // Пересекающиеся хвосты отрезаются, записи без своих глифов выпадают
+    glyphRanges.reserve(records.size());
+    uint32_t nextGlyph = 0;
+    for (const SVGDocumentRecord& record : records) {
+        if (record.endGlyphID >= nextGlyph) {
+            uint16_t start = static_cast<uint16_t>(std::max<uint32_t>(record.startGlyphID, nextGlyph));
+            glyphRanges.push_back({start, record.endGlyphID, &record});
+            nextGlyph = record.endGlyphID + 1u;
+        }
+    }
+}
+
+const SVGDocumentRecord* SVGDocumentIndex::findRecord(uint16_t glyphID) const {
+    // Первый диапазон, у которого startGlyphID > glyphID; кандидат - предыдущий
+    auto it = std::upper_bound(glyphRanges.begin(), glyphRanges.end(), glyphID,
+                               [](uint16_t gid, const SVGGlyphRange& range) {
+                                   return gid < range.startGlyphID;
+                               });
+    if (it == glyphRanges.begin()) return nullptr;
+    --it;
+    return glyphID <= it->endGlyphID ? it->record : nullptr;
+}
+
+ByteSpan SVGDocumentIndex::getRawDocument(const SVGDocumentRecord& record) const {
+    return documentList.subspan(record.offset, record.length);
+}
+
+SVGDocument SVGDocumentIndex::getDocument(const SVGDocumentRecord& record) const {
+    SVGDocument document;
+    ByteSpan raw = getRawDocument(record);
+
+    if (!isGzipData(raw)) {
+        document.bytes = raw;
+        return document;
+    }
+
+    document.compressed = true;
+    document.owner = cache.getOrCreate(record.offset, [&]() {
+        auto inflated = std::make_shared<std::vector<uint8_t>>(
+            inflateData(raw, CompressionFormat::GZIP, gzipUncompressedSize(raw)));
+        size_t cost = inflated->size();
+        return std::make_pair(std::shared_ptr<const std::vector<uint8_t>>(std::move(inflated)), cost);
+    });
+    document.bytes = ByteSpan(*document.owner);
+    return document;
+}
+
+SVGDocument SVGDocumentIndex::getDocument(uint16_t glyphID) const {
+    const SVGDocumentRecord* record = findRecord(glyphID);
+    if (!record) {
+        throw std::out_of_range("SVG: no document for glyph " + std::to_string(glyphID));
+    }
+    return getDocument(*record);
+}
+
+} // namespace utils
+} // namespace fontmaster
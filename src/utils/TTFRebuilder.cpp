@@ -1,5 +1,12 @@
 #include "fontmaster/TTFRebuilder.h"
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/CFFParser.h"
+#include "fontmaster/CFFCharstringInterpreter.h"
+#include "fontmaster/ThreadPool.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/GlyfOutline.h"
+#include "fontmaster/PhaseTimer.h"
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
@@ -15,29 +22,81 @@
 namespace fontmaster {
 
 // Константы для таблиц
-const uint32_t TTF_MAGIC = 0x00010000;
 const uint32_t HEAD_MAGIC = 0x5F0F3CF5;
 const size_t HEAD_TABLE_SIZE = 54;
+const size_t HEAD_MODIFIED_OFFSET = 28;
+const uint64_t MAC_EPOCH_OFFSET = 2082844800;   // секунд между 1904 и 1970 годами
 const size_t MAXP_TABLE_SIZE = 32;
 const size_t HHEA_TABLE_SIZE = 36;
 const size_t OS2_TABLE_SIZE = 96;
 
+// Глифов на одну задачу пула при параллельном разборе glyf
+const size_t GLYPH_GRAIN = 512;
+
 // Максимальный индекс для стандартных имен глифов
 const uint16_t MAX_STANDARD_NAME_INDEX = 32767;
+// Первые индексы имён для новых глифов с кодом, составных и остальных
+const uint32_t FIRST_UNICODE_NAME_INDEX = 532;
+const uint32_t FIRST_COMPOSITE_NAME_INDEX = 1000;
+const uint32_t FIRST_DEFAULT_NAME_INDEX = 2000;
+
+// Промежуточные данные, которые этапы пересборки передают друг другу помимо таблиц
+const char* const GLYPHS_RESOURCE = "#glyphs";
+const char* const HMETRICS_RESOURCE = "#hmetrics";
+const char* const LOCA_FORMAT_RESOURCE = "#locaFormat";
+
+// Признаки изменений без собственных данных: какая часть сведений о глифах устарела
+const char* const OUTLINES_RESOURCE = "#outlines";          // данные и смещения глифов в glyf
+const char* const GLYPH_METRICS_RESOURCE = "#glyphMetrics"; // ширины, боковые отступы и габариты
+const char* const NUM_GLYPHS_RESOURCE = "#numGlyphs";
+
+// Порядок встроенных этапов задаёт результат: граф эквивалентен их последовательному запуску
+const char* const BUILTIN_STAGE_ORDER[] = {
+    "glyf", "CFF ", "head", "loca", "hmtx", "hhea", "maxp", "name", "post", "OS/2"
+};
 
 TTFRebuilder::TTFRebuilder(const std::vector<uint8_t>& fontData) 
     : originalData(fontData), numGlyphs(0), numHMetrics(0), locaShortFormat(false) {
     
-    // Регистрируем обработчики для таблиц, требующих специальной логики
-    rebuildHandlers["glyf"] = [this](const std::string& tag) { rebuildGlyfTable(tag); };
-    rebuildHandlers["loca"] = [this](const std::string& tag) { rebuildLocaTable(tag); };
-    rebuildHandlers["hmtx"] = [this](const std::string& tag) { rebuildHmtxTable(tag); };
-    rebuildHandlers["hhea"] = [this](const std::string& tag) { rebuildHheaTable(tag); };
-    rebuildHandlers["maxp"] = [this](const std::string& tag) { rebuildMaxpTable(tag); };
-    rebuildHandlers["name"] = [this](const std::string& tag) { rebuildNameTable(tag); };
-    rebuildHandlers["OS/2"] = [this](const std::string& tag) { rebuildOS2Table(tag); };
-    rebuildHandlers["head"] = [this](const std::string& tag) { rebuildHeadTable(tag); };
-    rebuildHandlers["post"] = [this](const std::string& tag) { rebuildPostTable(tag); };
+    // Регистрируем обработчики для таблиц, требующих специальной логики, вместе с тем,
+    // что они читают и пишут: по этим объявлениям строится граф этапов пересборки
+    auto registerHandler = [this](const std::string& tag, void (TTFRebuilder::*method)(const std::string&),
+                                  std::vector<std::string> inputs, std::vector<std::string> outputs,
+                                  std::vector<std::string> triggers) {
+        rebuildHandlers[tag] = {[this, method](const std::string& t) { (this->*method)(t); },
+                                std::move(inputs), std::move(outputs), std::move(triggers)};
+    };
+    registerHandler("glyf", &TTFRebuilder::rebuildGlyfTable,
+                    {"glyf", "hmtx", HMETRICS_RESOURCE},
+                    {"glyf", GLYPHS_RESOURCE, OUTLINES_RESOURCE, GLYPH_METRICS_RESOURCE},
+                    {"glyf"});
+    registerHandler("CFF ", &TTFRebuilder::rebuildCFFTable,
+                    {"CFF ", "hmtx", HMETRICS_RESOURCE},
+                    {"CFF ", GLYPHS_RESOURCE, GLYPH_METRICS_RESOURCE},
+                    {"CFF "});
+    registerHandler("head", &TTFRebuilder::rebuildHeadTable,
+                    {LOCA_FORMAT_RESOURCE, GLYPHS_RESOURCE}, {"head"}, {"head", GLYPH_METRICS_RESOURCE});
+    registerHandler("loca", &TTFRebuilder::rebuildLocaTable,
+                    {"head", "glyf", "hmtx", HMETRICS_RESOURCE, GLYPHS_RESOURCE},
+                    {"loca", "head", LOCA_FORMAT_RESOURCE, GLYPHS_RESOURCE},
+                    {"loca", OUTLINES_RESOURCE, NUM_GLYPHS_RESOURCE});
+    registerHandler("hmtx", &TTFRebuilder::rebuildHmtxTable,
+                    {GLYPHS_RESOURCE}, {"hmtx", HMETRICS_RESOURCE},
+                    {"hmtx", GLYPH_METRICS_RESOURCE, NUM_GLYPHS_RESOURCE});
+    registerHandler("hhea", &TTFRebuilder::rebuildHheaTable,
+                    {HMETRICS_RESOURCE, GLYPHS_RESOURCE}, {"hhea"},
+                    {"hhea", HMETRICS_RESOURCE, GLYPH_METRICS_RESOURCE});
+    registerHandler("maxp", &TTFRebuilder::rebuildMaxpTable,
+                    {"glyf", GLYPHS_RESOURCE}, {"maxp"},
+                    {"maxp", OUTLINES_RESOURCE, NUM_GLYPHS_RESOURCE});
+    registerHandler("name", &TTFRebuilder::rebuildNameTable, {"name"}, {"name"}, {"name"});
+    // Данные глифов нужны post только для новых индексов, то есть при смене их числа
+    registerHandler("post", &TTFRebuilder::rebuildPostTable,
+                    {"post", "cmap", "glyf", GLYPHS_RESOURCE}, {"post"},
+                    {"post", NUM_GLYPHS_RESOURCE});
+    registerHandler("OS/2", &TTFRebuilder::rebuildOS2Table,
+                    {GLYPHS_RESOURCE}, {"OS/2"},
+                    {"OS/2", GLYPH_METRICS_RESOURCE});
     
     try {
         parseOriginalStructure();
@@ -55,8 +114,8 @@ TTFRebuilder::TTFRebuilder(const std::vector<uint8_t>& fontData)
         if (!parseLocaTable()) {
             throw std::runtime_error("Failed to parse loca table");
         }
-        
-        parseGlyfTable();
+        // Смещения и габариты глифов считаются по требованию этапов (ensureGlyphMetrics):
+        // правка name или post не разбирает ни контуры, ни charstring'и
         
     } catch (const std::exception& e) {
         std::cerr << "TTFRebuilder initialization error: " << e.what() << std::endl;
@@ -80,20 +139,19 @@ void TTFRebuilder::parseOriginalStructure() {
         info.tag = std::string(record.tag, 4);
         info.originalOffset = record.offset;
         info.originalLength = record.length;
-        info.newOffset = 0;
+        info.originalChecksum = record.checksum;
         info.newLength = record.length;
         info.modified = false;
         
-        // Копируем оригинальные данные таблицы
-        if (record.offset + record.length <= originalData.size()) {
-            info.data.assign(originalData.begin() + record.offset, 
-                           originalData.begin() + record.offset + record.length);
+        // Таблица остаётся видом на исходный буфер до первого изменения
+        if (static_cast<size_t>(record.offset) + record.length <= originalData.size()) {
+            info.source = utils::ByteSpan(originalData.data() + record.offset, record.length);
         } else {
             throw std::runtime_error("Table " + info.tag + " extends beyond font data");
         }
         
-        tables[info.tag] = info;
         tableOrder.push_back(info.tag);
+        tables[info.tag] = std::move(info);
     }
     
     std::cout << "TTFRebuilder: Parsed " << tableOrder.size() << " tables" << std::endl;
@@ -103,6 +161,7 @@ void TTFRebuilder::markTableModified(const std::string& tag) {
     auto it = tables.find(tag);
     if (it != tables.end()) {
         it->second.modified = true;
+        dirty.insert(tag);
         std::cout << "TTFRebuilder: Marked table '" << tag << "' as modified" << std::endl;
     } else {
         throw std::runtime_error("Table '" + tag + "' not found");
@@ -112,9 +171,11 @@ void TTFRebuilder::markTableModified(const std::string& tag) {
 void TTFRebuilder::setTableData(const std::string& tag, const std::vector<uint8_t>& data) {
     auto it = tables.find(tag);
     if (it != tables.end()) {
-        it->second.data = data;
+        it->second.assign(data);
         it->second.newLength = data.size();
         it->second.modified = true;
+        dirty.insert(tag);
+        noteOutlinesReplaced(tag);
         std::cout << "TTFRebuilder: Set table '" << tag << "' data, size: " 
                   << data.size() << " bytes" << std::endl;
     } else {
@@ -122,12 +183,58 @@ void TTFRebuilder::setTableData(const std::string& tag, const std::vector<uint8_
     }
 }
 
-const std::vector<uint8_t>* TTFRebuilder::getTableData(const std::string& tag) const {
+void TTFRebuilder::setTableData(const std::string& tag, std::vector<uint8_t>&& data) {
+    auto it = tables.find(tag);
+    if (it == tables.end()) {
+        throw std::runtime_error("Table '" + tag + "' not found");
+    }
+    it->second.newLength = data.size();
+    it->second.assign(std::move(data));
+    it->second.modified = true;
+    dirty.insert(tag);
+    noteOutlinesReplaced(tag);
+    std::cout << "TTFRebuilder: Set table '" << tag << "' data, size: " 
+              << it->second.newLength << " bytes" << std::endl;
+}
+
+utils::ThreadPool& TTFRebuilder::pool() const {
+    return threadPool ? *threadPool : utils::ThreadPool::shared();
+}
+
+void TTFRebuilder::noteOutlinesReplaced(const std::string& tag) {
+    // Новая loca описывает текущий glyf; новый glyf без loca придётся разбирать подряд
+    if (tag == "glyf" || tag == "loca") {
+        locaMatchesGlyf = tag == "loca";
+        glyphOffsetsStale = true;
+    }
+    // Ширины берутся из hmtx, габариты CFF - из charstring'ов
+    if (tag == "hmtx" || tag == "CFF ") glyphMetricsKnown = false;
+}
+
+void TTFRebuilder::ensureGlyphOffsets() {
+    if (tables.find("glyf") == tables.end()) return;
+    if (glyphOffsetsStale || glyphOffsets.size() != static_cast<size_t>(numGlyphs) + 1) {
+        calculateGlyphOffsets();
+    }
+}
+
+void TTFRebuilder::ensureGlyphMetrics() {
+    if (tables.find("glyf") == tables.end()) {
+        if (!glyphMetricsKnown || glyphOffsets.size() != static_cast<size_t>(numGlyphs) + 1) {
+            calculateCFFGlyphMetrics();
+        }
+        return;
+    }
+    ensureGlyphOffsets();
+    if (!glyphMetricsKnown) calculateGlyphMetrics();
+}
+
+utils::ByteSpan TTFRebuilder::getTableData(const std::string& tag) const {
     auto it = tables.find(tag);
     if (it != tables.end()) {
-        return &it->second.data;
+        return it->second.bytes();
     }
-    return nullptr;
+    return utils::ByteSpan();
 }
 
 bool TTFRebuilder::hasTable(const std::string& tag) const {
@@ -136,58 +243,143 @@ bool TTFRebuilder::hasTable(const std::string& tag) const {
 
 void TTFRebuilder::setTableRebuildHandler(const std::string& tag, 
                                          std::function<void(const std::string&)> handler) {
-    rebuildHandlers[tag] = handler;
+    // Прежние inputs/triggers встроенного этапа только решают, когда его запускать;
+    // что трогает новый обработчик, неизвестно, поэтому этап выполняется один
+    auto it = rebuildHandlers.find(tag);
+    if (it != rebuildHandlers.end()) {
+        it->second.run = std::move(handler);
+        it->second.exclusive = true;
+    } else {
+        rebuildHandlers[tag] = {std::move(handler), {tag}, {tag}, {}, true};
+    }
     std::cout << "TTFRebuilder: Set custom rebuild handler for table '" << tag << "'" << std::endl;
 }
 
-std::vector<uint8_t> TTFRebuilder::rebuild() {
-    newData.clear();
+void TTFRebuilder::setTableRebuildHandler(const std::string& tag,
+                                         std::function<void(const std::string&)> handler,
+                                         std::vector<std::string> inputs,
+                                         std::vector<std::string> outputs) {
+    rebuildHandlers[tag] = {std::move(handler), std::move(inputs), std::move(outputs), {}, false};
+    std::cout << "TTFRebuilder: Set custom rebuild handler for table '" << tag << "'" << std::endl;
+}
+
+utils::FontAssembler TTFRebuilder::assembleTables() {
+    utils::ScopedPhase phase("rebuild");
+    // 1. Пересобираем модифицированные таблицы и синхронизируем зависящие от них
+    //    (loca, maxp, hmtx, hhea, OS/2) - граф этапов на пуле потоков
+    runRebuildStages(planRebuild());
+    
+    // Всё учтено: повторная сборка без новых правок ничего не пересчитывает
+    dirty.clear();
+    for (auto& pair : tables) {
+        pair.second.modified = false;
+    }
+    
+    // 2. Директория, выравнивание и checkSumAdjustment - в FontAssembler;
+    //    таблицы передаются видами, без копирования
+    uint32_t sfntVersion = (static_cast<uint32_t>(originalData[0]) << 24) |
+                           (static_cast<uint32_t>(originalData[1]) << 16) |
+                           (static_cast<uint32_t>(originalData[2]) << 8) | originalData[3];
+    utils::FontAssembler assembler(sfntVersion);
+    for (const auto& tag : tableOrder) {
+        const TableInfo& info = tables.at(tag);
+        if (info.materialized) {
+            assembler.addTable(tag, info.bytes());
+        } else {
+            assembler.addTable(tag, info.bytes(), info.originalChecksum);
+        }
+    }
+    return assembler;
+}
+
+bool TTFRebuilder::isStageTriggered(const std::string& tag) const {
+    auto handlerIt = rebuildHandlers.find(tag);
+    if (handlerIt == rebuildHandlers.end() || !hasTable(tag)) return false;
     
-    try {
-        // 1. Пересобираем модифицированные таблицы
-        for (auto& pair : tables) {
-            if (pair.second.modified) {
-                rebuildTable(pair.first);
-            }
+    const RebuildHandler& handler = handlerIt->second;
+    if (handler.triggers.empty()) {
+        if (dirty.count(tag)) return true;
+        for (const auto& input : handler.inputs) {
+            if (dirty.count(input)) return true;
         }
-        
-        // 2. Синхронизируем связанные таблицы
-        updateGlyfTable();
-        updateLocaTable();
-        updateHmtxTable();
-        updateHheaTable();
-        updateMaxpTable();
-        
-        // 3. Пересчитываем глобальные метрики шрифта
-        recalculateFontMetrics();
-        
-        // 4. Рассчитываем новые смещения
-        updateTableOffsets();
-        
-        // 5. Собираем новый заголовок и директорию таблиц
-        rebuildTableDirectory();
-        
-        // 6. Копируем данные всех таблиц
-        for (const auto& tag : tableOrder) {
-            const auto& tableInfo = tables[tag];
-            size_t requiredSize = tableInfo.newOffset + tableInfo.newLength;
-            if (newData.size() < requiredSize) {
-                newData.resize(requiredSize);
-            }
-            
-            std::copy(tableInfo.data.begin(), tableInfo.data.end(), 
-                     newData.begin() + tableInfo.newOffset);
-            
-            // Выравнивание до 4 байт
-            size_t alignedSize = (tableInfo.newLength + 3) & ~3;
-            if (alignedSize > tableInfo.newLength) {
-                std::fill(newData.begin() + tableInfo.newOffset + tableInfo.newLength,
-                         newData.begin() + tableInfo.newOffset + alignedSize, 0);
+        return false;
+    }
+    for (const auto& trigger : handler.triggers) {
+        if (dirty.count(trigger)) return true;
+    }
+    return false;
+}
+
+bool TTFRebuilder::runStageIfDirty(const std::string& tag) {
+    if (!isStageTriggered(tag)) return false;
+    
+    rebuildTable(tag);
+    const auto& outputs = rebuildHandlers.at(tag).outputs;
+    dirty.insert(outputs.begin(), outputs.end());
+    return true;
+}
+
+std::vector<std::string> TTFRebuilder::planRebuild() {
+    // Изменения распространяются заранее, в порядке этапов: этап запускается, если
+    // устарело то, от чего он зависит, и тогда устаревают его результаты.
+    // Во время параллельного выполнения dirty и флаги modified только читаются
+    std::vector<std::string> stages;
+    auto consider = [&](const std::string& tag) {
+        if (!isStageTriggered(tag)) return;
+        stages.push_back(tag);
+        const auto& outputs = rebuildHandlers.at(tag).outputs;
+        dirty.insert(outputs.begin(), outputs.end());
+    };
+    
+    std::set<std::string> builtin;
+    for (const char* tag : BUILTIN_STAGE_ORDER) {
+        builtin.insert(tag);
+        consider(tag);
+    }
+    
+    for (auto& pair : tables) {
+        if (builtin.count(pair.first)) continue;
+        if (rebuildHandlers.count(pair.first)) {
+            consider(pair.first);
+        } else if (dirty.count(pair.first)) {
+            // Без обработчика таблица остаётся как есть
+            rebuildTable(pair.first);
+        }
+    }
+    return stages;
+}
+
+void TTFRebuilder::runRebuildStages(const std::vector<std::string>& stages) {
+    auto intersects = [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+        for (const auto& item : a) {
+            if (std::find(b.begin(), b.end(), item) != b.end()) return true;
+        }
+        return false;
+    };
+    
+    // Этап ждёт все более ранние, с которыми конфликтует по данным (запись-чтение, чтение-запись,
+    // запись-запись), поэтому результат совпадает с последовательным запуском в порядке stages.
+    // Этап без объявленных зависимостей конфликтует со всеми
+    std::vector<std::vector<size_t>> dependencies(stages.size());
+    for (size_t later = 0; later < stages.size(); ++later) {
+        const RebuildHandler& current = rebuildHandlers.at(stages[later]);
+        for (size_t earlier = 0; earlier < later; ++earlier) {
+            const RebuildHandler& previous = rebuildHandlers.at(stages[earlier]);
+            if (current.exclusive || previous.exclusive ||
+                intersects(previous.outputs, current.inputs) ||
+                intersects(previous.outputs, current.outputs) ||
+                intersects(previous.inputs, current.outputs)) {
+                dependencies[later].push_back(earlier);
             }
         }
-        
-        // 7. Обновляем checksum adjustment в head таблице
-        updateHeadTableChecksumAdjustment();
+    }
+    
+    pool().runGraph(dependencies, [&](size_t stage) { rebuildTable(stages[stage]); });
+}
+
+std::vector<uint8_t> TTFRebuilder::rebuild() {
+    try {
+        std::vector<uint8_t> newData = assembleTables().assemble();
         
         std::cout << "TTFRebuilder: Successfully rebuilt font, original size: " 
                   << originalData.size() << " bytes, new size: " << newData.size() 
@@ -212,17 +404,10 @@ void TTFRebuilder::rebuildTable(const std::string& tag) {
     // Проверяем есть ли специальный обработчик для этой таблицы
     auto handlerIt = rebuildHandlers.find(tag);
     if (handlerIt != rebuildHandlers.end()) {
-        handlerIt->second(tag);
+        handlerIt->second.run(tag);
     } else {
-        // Базовая обработка для таблиц без специальной логики
-        if (!tableInfo.modified) {
-            // Если таблица не модифицирована, используем оригинальные данные
-            if (tableInfo.originalOffset + tableInfo.originalLength <= originalData.size()) {
-                tableInfo.data.assign(originalData.begin() + tableInfo.originalOffset,
-                                    originalData.begin() + tableInfo.originalOffset + tableInfo.originalLength);
-            }
-        }
-        tableInfo.newLength = tableInfo.data.size();
+        // Базовая обработка: немодифицированная таблица так и остаётся видом на исходные данные
+        tableInfo.newLength = tableInfo.bytes().size();
     }
     
     std::cout << "TTFRebuilder: Rebuilt table '" << tag << "', size: " 
@@ -230,18 +415,37 @@ void TTFRebuilder::rebuildTable(const std::string& tag) {
 }
 
 void TTFRebuilder::rebuildGlyfTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     
+    // После replaceGlyph смещения и габариты уже актуальны; заново - если glyf или loca заменены целиком
+    ensureGlyphOffsets();
     validateGlyphData();
-    calculateGlyphMetrics();
+    ensureGlyphMetrics();
+    
+    // Заголовки глифов получают габариты, посчитанные по точкам; совпадающие не трогаются
+    std::vector<size_t> outdated;
+    utils::ByteSpan glyfData = tableInfo.bytes();
+    for (size_t i = 0; i < numGlyphs && i < glyphOffsets.size(); ++i) {
+        const GlyphInfo& glyph = glyphOffsets[i];
+        if (!glyph.hasBounds || glyph.offset + 10 > glyfData.size()) continue;
+        if (getInt16(glyfData, glyph.offset + 2) != glyph.xMin || getInt16(glyfData, glyph.offset + 4) != glyph.yMin ||
+            getInt16(glyfData, glyph.offset + 6) != glyph.xMax || getInt16(glyfData, glyph.offset + 8) != glyph.yMax) {
+            outdated.push_back(i);
+        }
+    }
+    if (!outdated.empty()) {
+        std::vector<uint8_t>& glyf = tableInfo.mutableData();
+        for (size_t i : outdated) writeGlyphBounds(glyf, glyphOffsets[i]);
+        std::cout << "TTFRebuilder: Updated bounding boxes of " << outdated.size() << " glyphs" << std::endl;
+    }
     
     std::cout << "TTFRebuilder: Processed glyf table with " 
               << glyphOffsets.size() << " glyphs, size: " 
-              << tableInfo.data.size() << " bytes" << std::endl;
+              << tableInfo.bytes().size() << " bytes" << std::endl;
 }
 
 void TTFRebuilder::rebuildLocaTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     
     auto headIt = tables.find("head");
     if (headIt == tables.end()) {
@@ -249,38 +453,40 @@ void TTFRebuilder::rebuildLocaTable(const std::string& tag) {
     }
     
     validateTableData("head", HEAD_TABLE_SIZE);
-    const auto& headData = headIt->second.data;
+    utils::ByteSpan headData = headIt->second.bytes();
     
     int16_t indexToLocFormat = getInt16(headData, 50);
     locaShortFormat = (indexToLocFormat == 0);
     
-    calculateGlyphOffsets();
+    // Смещения обычно уже посчитаны этапом glyf; габариты loca не нужны
+    ensureGlyphOffsets();
     
-    std::vector<uint8_t> newLocaData;
+    size_t count = static_cast<size_t>(numGlyphs) + 1;
+    std::vector<uint32_t> offsets(count, 0);
+    uint32_t maxOffset = 0;
+    for (size_t i = 0; i < count && i < glyphOffsets.size(); ++i) {
+        offsets[i] = glyphOffsets[i].offset;
+        maxOffset = std::max(maxOffset, offsets[i]);
+    }
+    // Короткий формат хранит смещение/2 в 16 битах
+    if (locaShortFormat && maxOffset / 2 > 0xFFFF) {
+        locaShortFormat = false;
+        setInt16(headIt->second.mutableData(), 50, 1);
+        std::cout << "TTFRebuilder: Switching loca to long format due to offset overflow" << std::endl;
+    }
     
+    utils::ByteWriter writer(count * (locaShortFormat ? 2 : 4));
     if (locaShortFormat) {
-        newLocaData.resize((numGlyphs + 1) * 2);
-        for (size_t i = 0; i <= numGlyphs; ++i) {
-            uint32_t offset = (i < glyphOffsets.size()) ? glyphOffsets[i].offset / 2 : 0;
-            if (offset > 0xFFFF) {
-                locaShortFormat = false;
-                setInt16(headIt->second.data, 50, 1);
-                std::cout << "TTFRebuilder: Switching loca to long format due to offset overflow" << std::endl;
-                rebuildLocaTable(tag);
-                return;
-            }
-            setUInt16(newLocaData, i * 2, static_cast<uint16_t>(offset));
-        }
+        std::vector<uint16_t> halves(count);
+        for (size_t i = 0; i < count; ++i) halves[i] = static_cast<uint16_t>(offsets[i] / 2);
+        writer.writeBE16(halves.data(), count);
     } else {
-        newLocaData.resize((numGlyphs + 1) * 4);
-        for (size_t i = 0; i <= numGlyphs; ++i) {
-            uint32_t offset = (i < glyphOffsets.size()) ? glyphOffsets[i].offset : 0;
-            setUInt32(newLocaData, i * 4, offset);
-        }
+        writer.writeBE32(offsets.data(), count);
     }
+    locaMatchesGlyf = true;
     
-    tableInfo.data = newLocaData;
-    tableInfo.newLength = newLocaData.size();
+    tableInfo.newLength = static_cast<uint32_t>(writer.size());
+    tableInfo.assign(writer.take());
     
     std::cout << "TTFRebuilder: Rebuilt loca table with " << numGlyphs 
               << " glyphs, format: " << (locaShortFormat ? "short" : "long") 
@@ -288,32 +494,31 @@ void TTFRebuilder::rebuildLocaTable(const std::string& tag) {
 }
 
 void TTFRebuilder::rebuildHmtxTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     
+    ensureGlyphMetrics();
     calculateHMetrics();
     
-    std::vector<uint8_t> newHmtxData;
-    newHmtxData.resize(numHMetrics * 4 + (numGlyphs - numHMetrics) * 2);
+    utils::ByteWriter writer(numHMetrics * 4 + (numGlyphs - numHMetrics) * 2);
     
     for (uint16_t i = 0; i < numHMetrics; ++i) {
         if (i < glyphOffsets.size()) {
-            setUInt16(newHmtxData, i * 4, glyphOffsets[i].advanceWidth);
-            setInt16(newHmtxData, i * 4 + 2, glyphOffsets[i].leftSideBearing);
+            writer.writeUInt16(glyphOffsets[i].advanceWidth);
+            writer.writeInt16(glyphOffsets[i].leftSideBearing);
         } else {
-            setUInt16(newHmtxData, i * 4, 500);
-            setInt16(newHmtxData, i * 4 + 2, 0);
+            writer.writeUInt16(500);
+            writer.writeInt16(0);
         }
     }
     
     // УДАЛЕНО: uint16_t lastAdvanceWidth = (numHMetrics > 0 && numHMetrics - 1 < glyphOffsets.size()) ...
     
     for (uint16_t i = numHMetrics; i < numGlyphs; ++i) {
-        int16_t lsb = (i < glyphOffsets.size()) ? glyphOffsets[i].leftSideBearing : 0;
-        setInt16(newHmtxData, numHMetrics * 4 + (i - numHMetrics) * 2, lsb);
+        writer.writeInt16(i < glyphOffsets.size() ? glyphOffsets[i].leftSideBearing : 0);
     }
     
-    tableInfo.data = newHmtxData;
-    tableInfo.newLength = newHmtxData.size();
+    tableInfo.newLength = static_cast<uint32_t>(writer.size());
+    tableInfo.assign(writer.take());
     
     std::cout << "TTFRebuilder: Rebuilt hmtx table with " << numGlyphs 
               << " glyphs, " << numHMetrics << " h-metrics, size: " 
@@ -321,10 +526,11 @@ void TTFRebuilder::rebuildHmtxTable(const std::string& tag) {
 }
 
 void TTFRebuilder::rebuildHheaTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     validateTableData(tag, HHEA_TABLE_SIZE);
     
-    setUInt16(tableInfo.data, 34, numHMetrics);
+    setUInt16(tableInfo.mutableData(), 34, numHMetrics);
+    ensureGlyphMetrics();
     updateHheaMetrics();
     
     std::cout << "TTFRebuilder: Updated hhea table, numberOfHMetrics: " 
@@ -332,54 +538,77 @@ void TTFRebuilder::rebuildHheaTable(const std::string& tag) {
 }
 
 void TTFRebuilder::rebuildMaxpTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     validateTableData(tag, 6);
     
-    setUInt16(tableInfo.data, 4, numGlyphs);
+    setUInt16(tableInfo.mutableData(), 4, numGlyphs);
+    ensureGlyphOffsets();
     updateMaxpTableValues();
     
     std::cout << "TTFRebuilder: Updated maxp table, numGlyphs: " 
               << numGlyphs << std::endl;
 }
 
-void TTFRebuilder::rebuildNameTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
-    
-    if (tableInfo.modified) {
-        updateNameTableChecksum();
-    }
+void TTFRebuilder::rebuildNameTable(const std::string&) {
+    updateNameTableChecksum();
 }
 
 void TTFRebuilder::rebuildOS2Table(const std::string& tag) {
-    auto& tableInfo = tables[tag];
-    
-    if (tableInfo.modified || tables["glyf"].modified || tables["hmtx"].modified) {
-        validateTableData(tag, OS2_TABLE_SIZE);
-        updateOS2Metrics();
-        std::cout << "TTFRebuilder: Updated OS/2 table metrics" << std::endl;
-    }
+    validateTableData(tag, OS2_TABLE_SIZE);
+    ensureGlyphMetrics();
+    updateOS2Metrics();
+    std::cout << "TTFRebuilder: Updated OS/2 table metrics" << std::endl;
 }
 
 void TTFRebuilder::rebuildHeadTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+    auto& tableInfo = tables.at(tag);
     validateTableData(tag, HEAD_TABLE_SIZE);
     
-    uint64_t currentTimestamp = (uint64_t)time(nullptr) + 2082844800;
-    setUInt32(tableInfo.data, 4, (currentTimestamp >> 32) & 0xFFFFFFFF);
-    setUInt32(tableInfo.data, 8, currentTimestamp & 0xFFFFFFFF);
-    
-    setUInt32(tableInfo.data, 12, HEAD_MAGIC);
-    setInt16(tableInfo.data, 50, locaShortFormat ? 0 : 1);
+    // modified - LONGDATETIME от 1904 года; fontRevision и created остаются как в исходнике
+    uint64_t currentTimestamp = (uint64_t)time(nullptr) + MAC_EPOCH_OFFSET;
+    setUInt32(tableInfo.mutableData(), HEAD_MODIFIED_OFFSET, (currentTimestamp >> 32) & 0xFFFFFFFF);
+    setUInt32(tableInfo.mutableData(), HEAD_MODIFIED_OFFSET + 4, currentTimestamp & 0xFFFFFFFF);
+    
+    setUInt32(tableInfo.mutableData(), 12, HEAD_MAGIC);
+    setInt16(tableInfo.mutableData(), 50, locaShortFormat ? 0 : 1);
+    
+    // Габариты шрифта - объединение габаритов глифов с контуром
+    ensureGlyphMetrics();
+    bool anyBounds = false;
+    int16_t xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+    for (size_t i = 0; i < numGlyphs && i < glyphOffsets.size(); ++i) {
+        const GlyphInfo& glyph = glyphOffsets[i];
+        if (!glyph.hasBounds) continue;
+        if (!anyBounds) {
+            xMin = glyph.xMin; yMin = glyph.yMin; xMax = glyph.xMax; yMax = glyph.yMax;
+            anyBounds = true;
+            continue;
+        }
+        xMin = std::min(xMin, glyph.xMin);
+        yMin = std::min(yMin, glyph.yMin);
+        xMax = std::max(xMax, glyph.xMax);
+        yMax = std::max(yMax, glyph.yMax);
+    }
+    if (anyBounds) {
+        setInt16(tableInfo.mutableData(), 36, xMin);
+        setInt16(tableInfo.mutableData(), 38, yMin);
+        setInt16(tableInfo.mutableData(), 40, xMax);
+        setInt16(tableInfo.mutableData(), 42, yMax);
+    }
     
     std::cout << "TTFRebuilder: Updated head table" << std::endl;
 }
 
-void TTFRebuilder::rebuildPostTable(const std::string& tag) {
-    auto& tableInfo = tables[tag];
+void TTFRebuilder::rebuildCFFTable(const std::string& tag) {
+    auto& tableInfo = tables.at(tag);
+    tableInfo.newLength = tableInfo.bytes().size();
     
-    if (tableInfo.modified) {
-        updatePostTableFormat2();
-    }
+    // Новые контуры меняют габариты, а значит lsb в hmtx и метрики OS/2/hhea (см. planRebuild)
+    calculateCFFGlyphMetrics();
+}
+
+void TTFRebuilder::rebuildPostTable(const std::string&) {
+    updatePostTableFormat2();
 }
 
 // УДАЛЕНО: Реализации без параметров - используем версии с параметрами по умолчанию
@@ -390,58 +619,98 @@ void TTFRebuilder::rebuildPostTable(const std::string& tag) {
 // void TTFRebuilder::updateMaxpTable() {
 
 void TTFRebuilder::updateGlyfTable(const std::string& glyfTag) {
-    if (tables.find(glyfTag) == tables.end() || !tables[glyfTag].modified) return;
-    
-    markTableModified("loca");
-    markTableModified("maxp");
-    markTableModified("hmtx");
-    markTableModified("OS/2");
-    
-    calculateGlyphOffsets();
-    calculateGlyphMetrics();
+    runStageIfDirty(glyfTag);
 }
 
 void TTFRebuilder::updateLocaTable(const std::string& locaTag) {
-    if (tables.find(locaTag) == tables.end()) return;
-    
-    if (tables[locaTag].modified) {
-        rebuildLocaTable(locaTag);
-    }
+    runStageIfDirty(locaTag);
 }
 
 void TTFRebuilder::updateHmtxTable(const std::string& hmtxTag) {
-    if (tables.find(hmtxTag) == tables.end()) return;
-    
-    if (tables[hmtxTag].modified) {
-        rebuildHmtxTable(hmtxTag);
-        markTableModified("hhea");
-    }
+    runStageIfDirty(hmtxTag);
 }
 
 void TTFRebuilder::updateHheaTable(const std::string& hheaTag) {
-    if (tables.find(hheaTag) == tables.end()) return;
-    
-    if (tables[hheaTag].modified) {
-        rebuildHheaTable(hheaTag);
-    }
+    runStageIfDirty(hheaTag);
 }
 
 void TTFRebuilder::updateMaxpTable(const std::string& maxpTag) {
-    if (tables.find(maxpTag) == tables.end()) return;
+    runStageIfDirty(maxpTag);
+}
+
+void TTFRebuilder::replaceGlyph(uint16_t glyphId, utils::ByteSpan glyphData) {
+    auto glyfIt = tables.find("glyf");
+    if (glyfIt == tables.end() || !hasTable("loca")) {
+        throw std::runtime_error("Font has no glyf/loca tables");
+    }
+    if (glyphId >= numGlyphs) {
+        throw std::runtime_error("Glyph " + std::to_string(glyphId) + " out of range");
+    }
+    ensureGlyphOffsets();
+    
+    std::vector<uint8_t>& glyf = glyfIt->second.mutableData();
+    GlyphInfo& glyph = glyphOffsets[glyphId];
     
-    if (tables[maxpTag].modified) {
-        rebuildMaxpTable(maxpTag);
+    // Габариты одного глифа; декодер контуров (компоненты ищутся по всем смещениям) - только составному
+    auto updateBounds = [this, glyphId, &glyf](GlyphInfo& info) {
+        bool composite = !info.isEmpty && static_cast<size_t>(info.offset) + 10 <= glyf.size() &&
+                         static_cast<int16_t>((glyf[info.offset] << 8) | glyf[info.offset + 1]) < 0;
+        if (composite) {
+            utils::GlyfOutlineDecoder outlines = makeOutlineDecoder(glyf);
+            calculateGlyphMetrics(info, glyphId, glyf, &outlines);
+        } else {
+            calculateGlyphMetrics(info, glyphId, glyf, nullptr);
+        }
+    };
+    // Габариты остальных глифов ещё не нужны были ни одному этапу: прежние считаются только у этого
+    if (!glyphMetricsKnown) updateBounds(glyph);
+    
+    // Старое место глифа - до начала следующего, вместе с выравниванием
+    size_t begin = std::min<size_t>(glyph.offset, glyf.size());
+    size_t end = std::max(begin, std::min<size_t>(glyphOffsets[glyphId + 1].offset, glyf.size()));
+    size_t newSize = glyphData.size() + (glyphData.size() & 1);
+    
+    // Глиф, поместившийся на старое место, остаётся там с нулями в хвосте: смещения и loca
+    // не меняются, и сохранение на месте (FontAssembler::patchFile) пишет только этот участок
+    if (newSize > end - begin) {
+        glyf.insert(glyf.begin() + end, newSize - (end - begin), 0);
+        int64_t delta = static_cast<int64_t>(newSize) - static_cast<int64_t>(end - begin);
+        for (size_t i = static_cast<size_t>(glyphId) + 1; i < glyphOffsets.size(); ++i) {
+            glyphOffsets[i].offset = static_cast<uint32_t>(glyphOffsets[i].offset + delta);
+        }
+        locaMatchesGlyf = false;
+    }
+    std::fill(glyf.begin() + begin + glyphData.size(), glyf.begin() + std::max(end, begin + newSize), 0);
+    std::copy(glyphData.begin(), glyphData.end(), glyf.begin() + begin);
+    glyfIt->second.newLength = glyf.size();
+    
+    const GlyphInfo old = glyph;
+    glyph.offset = static_cast<uint32_t>(begin);
+    glyph.length = static_cast<uint32_t>(glyphOffsets[glyphId + 1].offset - begin);
+    glyph.isEmpty = glyphData.empty();
+    updateBounds(glyph);
+    if (glyph.hasBounds) writeGlyphBounds(glyf, glyph);
+    if (glyphId < outlineStats.size()) outlineStats[glyphId].known = false;
+    
+    // Сама таблица glyf заново не разбирается: устарели только смещения и, возможно, метрики
+    dirty.insert(OUTLINES_RESOURCE);
+    if (glyph.leftSideBearing != old.leftSideBearing || glyph.hasBounds != old.hasBounds ||
+        glyph.xMin != old.xMin || glyph.yMin != old.yMin || glyph.xMax != old.xMax || glyph.yMax != old.yMax) {
+        dirty.insert(GLYPH_METRICS_RESOURCE);
     }
+    
+    std::cout << "TTFRebuilder: Replaced glyph " << glyphId << ", " << glyphData.size()
+              << " bytes" << std::endl;
 }
 
-uint16_t TTFRebuilder::getUInt16(const std::vector<uint8_t>& data, size_t offset) const {
+uint16_t TTFRebuilder::getUInt16(utils::ByteSpan data, size_t offset) const {
     if (offset + 2 > data.size()) {
         throw std::runtime_error("Read UInt16 beyond data boundary");
     }
     return (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
 }
 
-uint32_t TTFRebuilder::getUInt32(const std::vector<uint8_t>& data, size_t offset) const {
+uint32_t TTFRebuilder::getUInt32(utils::ByteSpan data, size_t offset) const {
     if (offset + 4 > data.size()) {
         throw std::runtime_error("Read UInt32 beyond data boundary");
     }
@@ -451,7 +720,7 @@ uint32_t TTFRebuilder::getUInt32(const std::vector<uint8_t>& data, size_t offset
            data[offset + 3];
 }
 
-int16_t TTFRebuilder::getInt16(const std::vector<uint8_t>& data, size_t offset) const {
+int16_t TTFRebuilder::getInt16(utils::ByteSpan data, size_t offset) const {
     if (offset + 2 > data.size()) {
         throw std::runtime_error("Read Int16 beyond data boundary");
     }
@@ -462,44 +731,81 @@ void TTFRebuilder::setUInt16(std::vector<uint8_t>& data, size_t offset, uint16_t
     if (offset + 2 > data.size()) {
         throw std::runtime_error("Write UInt16 beyond data boundary");
     }
-    data[offset] = (value >> 8) & 0xFF;
-    data[offset + 1] = value & 0xFF;
+    utils::storeUInt16(data.data() + offset, value);
 }
 
 void TTFRebuilder::setUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
     if (offset + 4 > data.size()) {
         throw std::runtime_error("Write UInt32 beyond data boundary");
     }
-    data[offset] = (value >> 24) & 0xFF;
-    data[offset + 1] = (value >> 16) & 0xFF;
-    data[offset + 2] = (value >> 8) & 0xFF;
-    data[offset + 3] = value & 0xFF;
+    utils::storeUInt32(data.data() + offset, value);
 }
 
 void TTFRebuilder::setInt16(std::vector<uint8_t>& data, size_t offset, int16_t value) {
     if (offset + 2 > data.size()) {
         throw std::runtime_error("Write Int16 beyond data boundary");
     }
-    data[offset] = (value >> 8) & 0xFF;
-    data[offset + 1] = value & 0xFF;
+    utils::storeUInt16(data.data() + offset, static_cast<uint16_t>(value));
 }
 
 void TTFRebuilder::calculateGlyphOffsets() {
-    glyphOffsets.clear();
+    glyphOffsetsStale = false;
+    glyphMetricsKnown = false;
+    outlineStats.clear();
+    glyphOffsets.assign(static_cast<size_t>(numGlyphs) + 1, GlyphInfo{0, 0, 0, 0, true});
     
     auto glyfIt = tables.find("glyf");
-    if (glyfIt == tables.end() || glyfIt->second.data.empty()) {
-        for (uint16_t i = 0; i <= numGlyphs; ++i) {
-            glyphOffsets.push_back({0, 0, 0, 0, true});
-        }
+    if (glyfIt == tables.end() || glyfIt->second.bytes().empty()) return;
+    
+    auto locaIt = tables.find("loca");
+    if (!locaMatchesGlyf || locaIt == tables.end()) {
+        calculateGlyphOffsetsFromOutlines();
         return;
     }
     
-    const auto& glyfData = glyfIt->second.data;
+    // Смещения целиком из loca: glyf разбирать не нужно, длина глифа - до начала следующего
+    utils::ByteSpan loca = locaIt->second.bytes();
+    size_t count = static_cast<size_t>(numGlyphs) + 1;
+    size_t entrySize = locaShortFormat ? 2 : 4;
+    size_t available = std::min(count, loca.size() / entrySize);
+    std::vector<uint32_t> offsets(count, 0);
+    const uint8_t* p = loca.data();
+    if (locaShortFormat) {
+        for (size_t i = 0; i < available; ++i) offsets[i] = static_cast<uint32_t>((p[i * 2] << 8) | p[i * 2 + 1]) * 2;
+    } else {
+        for (size_t i = 0; i < available; ++i) {
+            offsets[i] = (static_cast<uint32_t>(p[i * 4]) << 24) | (static_cast<uint32_t>(p[i * 4 + 1]) << 16) |
+                         (static_cast<uint32_t>(p[i * 4 + 2]) << 8) | p[i * 4 + 3];
+        }
+    }
+    // Глифы без записей в loca (numGlyphs вырос) пусты и стоят в конце
+    for (size_t i = available; i < count; ++i) offsets[i] = available ? offsets[available - 1] : 0;
+    
+    uint32_t limit = static_cast<uint32_t>(glyfIt->second.bytes().size());
+    size_t broken = 0;
+    for (size_t i = 0; i < numGlyphs; ++i) {
+        GlyphInfo& glyph = glyphOffsets[i];
+        uint32_t begin = std::min(offsets[i], limit);
+        uint32_t end = std::min(offsets[i + 1], limit);
+        if (offsets[i + 1] < offsets[i] || offsets[i + 1] > limit) ++broken;
+        glyph.offset = begin;
+        glyph.length = end > begin ? end - begin : 0;
+        glyph.isEmpty = glyph.length == 0;
+    }
+    glyphOffsets[numGlyphs].offset = std::min(offsets[numGlyphs], limit);
+    
+    if (broken) {
+        std::cerr << "TTFRebuilder: " << broken << " loca entries are out of order or beyond glyf" << std::endl;
+    }
+    std::cout << "TTFRebuilder: Read " << glyphOffsets.size() << " glyph offsets from loca" << std::endl;
+}
+
+void TTFRebuilder::calculateGlyphOffsetsFromOutlines() {
+    utils::ByteSpan glyfData = tables.at("glyf").bytes();
     uint32_t currentOffset = 0;
     
     for (uint16_t i = 0; i < numGlyphs; ++i) {
-        GlyphInfo glyph;
+        GlyphInfo& glyph = glyphOffsets[i];
         glyph.offset = currentOffset;
         glyph.isEmpty = false;
         
@@ -521,7 +827,6 @@ void TTFRebuilder::calculateGlyphOffsets() {
             }
         }
         
-        glyphOffsets.push_back(glyph);
         currentOffset += glyph.length;
         
         if (currentOffset % 2 != 0 && currentOffset < glyfData.size()) {
@@ -529,51 +834,45 @@ void TTFRebuilder::calculateGlyphOffsets() {
         }
     }
     
-    glyphOffsets.push_back({currentOffset, 0, 0, 0, true});
+    glyphOffsets[numGlyphs].offset = currentOffset;
     
     std::cout << "TTFRebuilder: Calculated " << glyphOffsets.size() 
               << " glyph offsets, total glyf size: " << currentOffset << " bytes" << std::endl;
 }
 
-uint32_t TTFRebuilder::parseSimpleGlyphLength(const std::vector<uint8_t>& data, uint32_t offset) const {
+uint32_t TTFRebuilder::parseSimpleGlyphLength(utils::ByteSpan data, uint32_t offset) const {
     if (offset + 12 > data.size()) return 0;
     
     int16_t numberOfContours = getInt16(data, offset);
     if (numberOfContours < 0) return 0;
     
     uint32_t length = 10 + 2 * numberOfContours;
+    uint32_t numPoints = numberOfContours > 0 ? getUInt16(data, offset + length - 2) + 1u : 0;
     
     uint16_t instructionLength = getUInt16(data, offset + length);
     length += 2 + instructionLength;
     
+    // Флаги с повторами, затем все X и все Y: размер координат определяется флагами
     uint32_t currentPos = length;
-    for (int16_t contour = 0; contour < numberOfContours; ++contour) {
-        uint16_t pointsInContour = getUInt16(data, offset + 10 + contour * 2);
-        
-        for (uint16_t point = 0; point < pointsInContour; ++point) {
-            if (currentPos >= data.size()) break;
-            
-            uint8_t flag = data[offset + currentPos];
-            currentPos++;
-            
-            if (flag & 0x02) {
-                currentPos += 1;
-            } else if (!(flag & 0x10)) {
-                currentPos += 2;
-            }
-            
-            if (flag & 0x04) {
-                currentPos += 1;
-            } else if (!(flag & 0x20)) {
-                currentPos += 2;
-            }
+    uint32_t coordinateBytes = 0;
+    for (uint32_t point = 0; point < numPoints;) {
+        if (offset + currentPos >= data.size()) return currentPos;
+        uint8_t flag = data[offset + currentPos++];
+        uint32_t repeat = 1;
+        if (flag & 0x08) {
+            if (offset + currentPos >= data.size()) return currentPos;
+            repeat += data[offset + currentPos++];
         }
+        uint32_t xSize = (flag & 0x02) ? 1 : ((flag & 0x10) ? 0 : 2);
+        uint32_t ySize = (flag & 0x04) ? 1 : ((flag & 0x20) ? 0 : 2);
+        coordinateBytes += (xSize + ySize) * repeat;
+        point += repeat;
     }
     
-    return currentPos;
+    return currentPos + coordinateBytes;
 }
 
-uint32_t TTFRebuilder::parseCompositeGlyphLength(const std::vector<uint8_t>& data, uint32_t offset) const {
+uint32_t TTFRebuilder::parseCompositeGlyphLength(utils::ByteSpan data, uint32_t offset) const {
     if (offset + 10 > data.size()) return 0;
     
     uint32_t currentPos = 10;
@@ -602,6 +901,9 @@ uint32_t TTFRebuilder::parseCompositeGlyphLength(const std::vector<uint8_t>& dat
         }
         
         moreComponents = (flags & 0x0020);
+        if (!moreComponents && (flags & 0x0100)) {
+            currentPos += 2 + getUInt16(data, offset + currentPos);
+        }
     }
     
     return currentPos;
@@ -611,93 +913,142 @@ void TTFRebuilder::calculateGlyphMetrics() {
     auto glyfIt = tables.find("glyf");
     if (glyfIt == tables.end()) return;
     
-    const auto& glyfData = glyfIt->second.data;
-    
-    for (size_t i = 0; i < glyphOffsets.size() && i < numGlyphs; ++i) {
-        auto& glyph = glyphOffsets[i];
-        
-        if (glyph.isEmpty || glyph.offset >= glyfData.size()) {
-            auto hmtxIt = tables.find("hmtx");
-            if (hmtxIt != tables.end() && i < numHMetrics) {
-                const auto& hmtxData = hmtxIt->second.data;
-                if (hmtxData.size() >= (i * 4 + 4)) {
-                    glyph.advanceWidth = getUInt16(hmtxData, i * 4);
-                    glyph.leftSideBearing = getInt16(hmtxData, i * 4 + 2);
-                } else {
-                    glyph.advanceWidth = 500;
-                    glyph.leftSideBearing = 0;
-                }
+    utils::ByteSpan glyfData = glyfIt->second.bytes();
+    utils::GlyfOutlineDecoder outlines = makeOutlineDecoder(glyfData);
+    
+    // Ширины - из hmtx как есть; глифы после numberOfHMetrics повторяют последнюю ширину
+    utils::ByteSpan hmtxData;
+    auto hmtxIt = tables.find("hmtx");
+    if (hmtxIt != tables.end()) hmtxData = hmtxIt->second.bytes();
+    size_t longMetrics = std::min<size_t>(numHMetrics, hmtxData.size() / 4);
+    uint16_t lastAdvance = longMetrics ? getUInt16(hmtxData, (longMetrics - 1) * 4) : 0;
+    
+    // Глифы независимы: составные читают чужие точки, но пишут только свою запись
+    size_t count = std::min(glyphOffsets.size(), static_cast<size_t>(numGlyphs));
+    pool().parallelFor(0, count, GLYPH_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GlyphInfo& glyph = glyphOffsets[i];
+            if (i < longMetrics) {
+                glyph.advanceWidth = getUInt16(hmtxData, i * 4);
+                glyph.leftSideBearing = getInt16(hmtxData, i * 4 + 2);
             } else {
-                glyph.advanceWidth = 500;
-                glyph.leftSideBearing = 0;
+                size_t lsbOffset = longMetrics * 4 + (i - longMetrics) * 2;
+                glyph.advanceWidth = lastAdvance;
+                glyph.leftSideBearing = lsbOffset + 2 <= hmtxData.size() ? getInt16(hmtxData, lsbOffset) : 0;
             }
-            continue;
+            calculateGlyphMetrics(glyph, i, glyfData, &outlines);
         }
-        
-        int16_t numberOfContours = getInt16(glyfData, glyph.offset);
-        
-        if (numberOfContours == 0) {
-            glyph.advanceWidth = 500;
-            glyph.leftSideBearing = 0;
-        } else {
-            int16_t xMin = getInt16(glyfData, glyph.offset + 2);
-            // УДАЛЕНО: int16_t yMin = getInt16(glyfData, glyph.offset + 4);
-            getInt16(glyfData, glyph.offset + 4); // Просто читаем yMin
-            int16_t xMax = getInt16(glyfData, glyph.offset + 6);
-            // УДАЛЕНО: int16_t yMax = getInt16(glyfData, glyph.offset + 8);
-            getInt16(glyfData, glyph.offset + 8); // Просто читаем yMax
-            
-            int16_t glyphWidth = xMax - xMin;
-            glyph.advanceWidth = std::max(static_cast<uint16_t>(glyphWidth + 50), static_cast<uint16_t>(500));
-            glyph.leftSideBearing = xMin;
-        }
-    }
+    });
+    glyphMetricsKnown = true;
     
     std::cout << "TTFRebuilder: Calculated metrics for " << glyphOffsets.size() << " glyphs" << std::endl;
 }
 
-void TTFRebuilder::calculateHMetrics() {
-    std::map<uint16_t, uint32_t> advanceWidthCounts;
-    std::set<uint16_t> uniqueAdvanceWidths;
+void TTFRebuilder::calculateGlyphMetrics(GlyphInfo& glyph, size_t index, utils::ByteSpan glyfData,
+                                         const utils::GlyfOutlineDecoder* outlines) const {
+    glyph.xMin = glyph.yMin = glyph.xMax = glyph.yMax = 0;
+    glyph.hasBounds = false;
+    if (glyph.isEmpty || glyph.offset >= glyfData.size()) return;
     
-    for (const auto& glyph : glyphOffsets) {
-        if (!glyph.isEmpty) {
-            advanceWidthCounts[glyph.advanceWidth]++;
-            uniqueAdvanceWidths.insert(glyph.advanceWidth);
-        }
+    utils::ByteSpan data = glyfData.subspan(glyph.offset, std::min<size_t>(glyph.length, glyfData.size() - glyph.offset));
+    if (data.size() < 10) return;
+    
+    utils::GlyphBounds bounds;
+    if (getInt16(data, 0) >= 0) {
+        glyph.hasBounds = utils::simpleGlyphBounds(data, bounds);
+    } else if (outlines) {
+        glyph.hasBounds = outlines->computeBounds(static_cast<uint16_t>(index), bounds);
     }
+    if (!glyph.hasBounds) return;
     
-    uint16_t optimalHMetrics = numGlyphs;
-    uint32_t threshold = numGlyphs / 10;
+    glyph.xMin = bounds.xMin;
+    glyph.yMin = bounds.yMin;
+    glyph.xMax = bounds.xMax;
+    glyph.yMax = bounds.yMax;
+    glyph.leftSideBearing = bounds.xMin;
+}
+
+utils::GlyfOutlineDecoder TTFRebuilder::makeOutlineDecoder(utils::ByteSpan glyfData) const {
+    // loca после replaceGlyph может отставать, поэтому смещения берутся из glyphOffsets
+    std::vector<uint32_t> offsets(glyphOffsets.size());
+    for (size_t i = 0; i < glyphOffsets.size(); ++i) offsets[i] = glyphOffsets[i].offset;
+    return utils::GlyfOutlineDecoder(glyfData, std::move(offsets), 0);
+}
+
+void TTFRebuilder::writeGlyphBounds(std::vector<uint8_t>& glyfData, const GlyphInfo& glyph) const {
+    if (static_cast<size_t>(glyph.offset) + 10 > glyfData.size()) return;
+    uint8_t* header = glyfData.data() + glyph.offset;
+    utils::storeUInt16(header + 2, static_cast<uint16_t>(glyph.xMin));
+    utils::storeUInt16(header + 4, static_cast<uint16_t>(glyph.yMin));
+    utils::storeUInt16(header + 6, static_cast<uint16_t>(glyph.xMax));
+    utils::storeUInt16(header + 8, static_cast<uint16_t>(glyph.yMax));
+}
+
+void TTFRebuilder::calculateCFFGlyphMetrics() {
+    auto cffIt = tables.find("CFF ");
+    if (cffIt == tables.end()) return;
+    
+    utils::CFFParser parser(cffIt->second.bytes());
+    if (!parser.parse()) {
+        throw std::runtime_error("Failed to parse CFF table");
+    }
+    
+    // Глифы интерпретируются параллельно, вклад подпрограмм кэшируется
+    utils::CFFCharstringInterpreter interpreter(parser);
+    std::vector<utils::CFFGlyphMetrics> metrics = interpreter.analyzeAllGlyphs(&pool());
+    
+    glyphOffsets.assign(static_cast<size_t>(numGlyphs) + 1, GlyphInfo{0, 0, 0, 0, true});
+    
+    auto clampToInt16 = [](double value) {
+        return static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, value)));
+    };
+    
+    // Ширина берётся из hmtx: для OpenType она авторитетнее ширины в charstring
+    auto hmtxIt = tables.find("hmtx");
+    uint16_t advanceWidth = 0;
     
     for (uint16_t i = 0; i < numGlyphs; ++i) {
-        if (i >= glyphOffsets.size()) break;
-        
-        uint16_t currentWidth = glyphOffsets[i].advanceWidth;
-        uint32_t count = advanceWidthCounts[currentWidth];
+        auto& glyph = glyphOffsets[i];
         
-        if (count < threshold && i > numGlyphs / 3) {
-            optimalHMetrics = i + 1;
-            break;
+        if (hmtxIt != tables.end() && i < numHMetrics && hmtxIt->second.bytes().size() >= i * 4u + 4) {
+            advanceWidth = getUInt16(hmtxIt->second.bytes(), i * 4);
         }
+        glyph.advanceWidth = advanceWidth;
+        
+        if (i >= metrics.size() || metrics[i].isEmpty) continue;
+        
+        glyph.isEmpty = false;
+        glyph.xMin = clampToInt16(std::floor(metrics[i].xMin));
+        glyph.yMin = clampToInt16(std::floor(metrics[i].yMin));
+        glyph.xMax = clampToInt16(std::ceil(metrics[i].xMax));
+        glyph.yMax = clampToInt16(std::ceil(metrics[i].yMax));
+        glyph.leftSideBearing = glyph.xMin;
+        glyph.hasBounds = true;
     }
+    glyphMetricsKnown = true;
     
-    numHMetrics = std::min(optimalHMetrics, numGlyphs);
-    // ИСПРАВЛЕНО: убрана лишняя проверка, так как numHMetrics всегда <= numGlyphs <= 0xFFFF
-    // if (numHMetrics > 0xFFFF) {
-    //     numHMetrics = 0xFFFF;
-    // }
+    std::cout << "TTFRebuilder: Calculated CFF metrics for " << metrics.size() << " glyphs ("
+              << interpreter.getCachedSubroutineCount() << " cached subroutines)" << std::endl;
+}
+
+void TTFRebuilder::calculateHMetrics() {
+    // Хвост из одинаковых ширин хранится одной записью: за numberOfHMetrics ширина повторяется
+    size_t count = std::min(glyphOffsets.size(), static_cast<size_t>(numGlyphs));
+    size_t longMetrics = count;
+    if (count > 0) {
+        uint16_t lastAdvance = glyphOffsets[count - 1].advanceWidth;
+        while (longMetrics > 1 && glyphOffsets[longMetrics - 2].advanceWidth == lastAdvance) --longMetrics;
+    }
+    numHMetrics = static_cast<uint16_t>(std::max<size_t>(longMetrics, numGlyphs ? 1 : 0));
     
-    std::cout << "TTFRebuilder: Optimized h-metrics: " << numHMetrics 
-              << " (unique advance widths: " << uniqueAdvanceWidths.size() << ")" << std::endl;
+    std::cout << "TTFRebuilder: Optimized h-metrics: " << numHMetrics << std::endl;
 }
 
 void TTFRebuilder::setNumGlyphs(uint16_t newNumGlyphs) {
     if (newNumGlyphs != numGlyphs) {
         numGlyphs = newNumGlyphs;
-        markTableModified("maxp");
-        markTableModified("loca");
-        markTableModified("hmtx");
+        // maxp, loca, hmtx и post обновятся по зависимостям
+        dirty.insert(NUM_GLYPHS_RESOURCE);
         std::cout << "TTFRebuilder: Set numGlyphs to " << numGlyphs << std::endl;
     }
 }
@@ -713,7 +1064,10 @@ void TTFRebuilder::setNumberOfHMetrics(uint16_t newNumHMetrics) {
 
 bool TTFRebuilder::parseLocaTable() {
     auto locaIt = tables.find("loca");
-    if (locaIt == tables.end()) return false;
+    if (locaIt == tables.end()) {
+        // У CFF-шрифтов нет glyf/loca
+        return tables.find("glyf") == tables.end() && tables.find("CFF ") != tables.end();
+    }
     return true;
 }
 
@@ -721,7 +1075,7 @@ bool TTFRebuilder::parseMaxpTable() {
     auto maxpIt = tables.find("maxp");
     if (maxpIt == tables.end()) return false;
     
-    const auto& maxpData = maxpIt->second.data;
+    utils::ByteSpan maxpData = maxpIt->second.bytes();
     if (maxpData.size() < 6) return false;
     
     numGlyphs = getUInt16(maxpData, 4);
@@ -732,7 +1086,7 @@ bool TTFRebuilder::parseHheaTable() {
     auto hheaIt = tables.find("hhea");
     if (hheaIt == tables.end()) return false;
     
-    const auto& hheaData = hheaIt->second.data;
+    utils::ByteSpan hheaData = hheaIt->second.bytes();
     if (hheaData.size() < 36) return false;
     
     numHMetrics = getUInt16(hheaData, 34);
@@ -743,7 +1097,7 @@ bool TTFRebuilder::parseHeadTable() {
     auto headIt = tables.find("head");
     if (headIt == tables.end()) return false;
     
-    const auto& headData = headIt->second.data;
+    utils::ByteSpan headData = headIt->second.bytes();
     if (headData.size() < HEAD_TABLE_SIZE) return false;
     
     uint32_t magic = getUInt32(headData, 12);
@@ -757,76 +1111,57 @@ bool TTFRebuilder::parseHeadTable() {
     return true;
 }
 
-void TTFRebuilder::parseGlyfTable() {
-    auto glyfIt = tables.find("glyf");
-    if (glyfIt == tables.end()) return;
-    calculateGlyphOffsets();
-}
-
-void TTFRebuilder::recalculateFontMetrics() {
-    updateHheaMetrics();
-    updateOS2Metrics();
-}
-
 void TTFRebuilder::updateHheaMetrics() {
     auto hheaIt = tables.find("hhea");
     if (hheaIt == tables.end()) return;
     
-    int16_t ascender = -10000;
-    int16_t descender = 10000;
-    int16_t lineGap = 200;
-    uint16_t maxAdvance = 0;
-    int16_t minLeftSideBearing = 0;
-    int16_t maxRightSideBearing = 0;
-    
-    for (const auto& glyph : glyphOffsets) {
-        if (glyph.isEmpty) continue;
-        
-        auto os2It = tables.find("OS/2");
-        if (os2It != tables.end() && os2It->second.data.size() >= 10) {
-            ascender = std::max(ascender, getInt16(os2It->second.data, 68));
-            descender = std::min(descender, getInt16(os2It->second.data, 70));
-        }
+    // ascender/descender/lineGap - решение дизайнера, из контуров выводятся только крайние значения
+    uint16_t advanceWidthMax = 0;
+    int32_t minLeftSideBearing = INT16_MAX;
+    int32_t minRightSideBearing = INT16_MAX;
+    int32_t xMaxExtent = INT16_MIN;
+    bool anyBounds = false;
+    
+    for (size_t i = 0; i < numGlyphs && i < glyphOffsets.size(); ++i) {
+        const GlyphInfo& glyph = glyphOffsets[i];
+        advanceWidthMax = std::max(advanceWidthMax, glyph.advanceWidth);
+        if (!glyph.hasBounds) continue;
         
-        maxAdvance = std::max(maxAdvance, glyph.advanceWidth);
-        
-        int16_t rightSideBearing = glyph.advanceWidth - glyph.leftSideBearing;
-        minLeftSideBearing = std::min(minLeftSideBearing, glyph.leftSideBearing);
-        maxRightSideBearing = std::max(maxRightSideBearing, rightSideBearing);
+        int32_t extent = glyph.leftSideBearing + (glyph.xMax - glyph.xMin);
+        minLeftSideBearing = std::min<int32_t>(minLeftSideBearing, glyph.leftSideBearing);
+        minRightSideBearing = std::min<int32_t>(minRightSideBearing, glyph.advanceWidth - extent);
+        xMaxExtent = std::max(xMaxExtent, extent);
+        anyBounds = true;
     }
+    if (!anyBounds) minLeftSideBearing = minRightSideBearing = xMaxExtent = 0;
     
-    setInt16(hheaIt->second.data, 4, ascender);
-    setInt16(hheaIt->second.data, 6, descender);
-    setInt16(hheaIt->second.data, 8, lineGap);
-    setUInt16(hheaIt->second.data, 10, maxAdvance);
-    setInt16(hheaIt->second.data, 12, minLeftSideBearing);
-    setInt16(hheaIt->second.data, 14, maxRightSideBearing);
+    auto clampToInt16 = [](int32_t value) {
+        return static_cast<int16_t>(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, value)));
+    };
+    std::vector<uint8_t>& hhea = hheaIt->second.mutableData();
+    setUInt16(hhea, 10, advanceWidthMax);
+    setInt16(hhea, 12, clampToInt16(minLeftSideBearing));
+    setInt16(hhea, 14, clampToInt16(minRightSideBearing));
+    setInt16(hhea, 16, clampToInt16(xMaxExtent));
 }
 
 void TTFRebuilder::updateOS2Metrics() {
     auto os2It = tables.find("OS/2");
     if (os2It == tables.end()) return;
     
-    uint32_t totalWidth = 0;
+    // xAvgCharWidth по правилу OS/2 версии 3+: среднее ненулевых ширин всех глифов.
+    // Типографские метрики задаёт дизайнер - они не пересчитываются
+    uint64_t totalWidth = 0;
     uint32_t count = 0;
-    for (const auto& glyph : glyphOffsets) {
-        if (!glyph.isEmpty) {
-            totalWidth += glyph.advanceWidth;
+    for (size_t i = 0; i < numGlyphs && i < glyphOffsets.size(); ++i) {
+        if (glyphOffsets[i].advanceWidth) {
+            totalWidth += glyphOffsets[i].advanceWidth;
             count++;
         }
     }
-    uint16_t avgWidth = count > 0 ? totalWidth / count : 500;
-    setInt16(os2It->second.data, 2, static_cast<int16_t>(avgWidth));
-    
-    auto hheaIt = tables.find("hhea");
-    if (hheaIt != tables.end() && hheaIt->second.data.size() >= 16) {
-        int16_t ascender = getInt16(hheaIt->second.data, 4);
-        int16_t descender = getInt16(hheaIt->second.data, 6);
-        
-        setInt16(os2It->second.data, 68, ascender);
-        setInt16(os2It->second.data, 70, descender);
-        setInt16(os2It->second.data, 72, getInt16(hheaIt->second.data, 8));
-    }
+    if (count == 0) return;
+    int16_t avgWidth = static_cast<int16_t>(std::min<uint64_t>((totalWidth + count / 2) / count, INT16_MAX));
+    setInt16(os2It->second.mutableData(), 2, avgWidth);
 }
 
 void TTFRebuilder::updateMaxpTableValues() {
@@ -843,91 +1178,83 @@ void TTFRebuilder::updateMaxpTableValues() {
     
     auto glyfIt = tables.find("glyf");
     if (glyfIt != tables.end()) {
-        const auto& glyfData = glyfIt->second.data;
+        utils::ByteSpan glyfData = glyfIt->second.bytes();
+        size_t count = std::min(glyphOffsets.size(), static_cast<size_t>(numGlyphs));
+        if (outlineStats.size() != count) outlineStats.assign(count, GlyphOutlineStats{});
         
-        for (const auto& glyph : glyphOffsets) {
-            if (glyph.isEmpty || glyph.offset >= glyfData.size()) continue;
-            
-            int16_t numberOfContours = getInt16(glyfData, glyph.offset);
-            
-            if (numberOfContours >= 0) {
-                maxContours = std::max(maxContours, static_cast<uint16_t>(numberOfContours));
-                
-                uint16_t points = calculateSimpleGlyphPoints(glyfData, glyph.offset);
-                maxPoints = std::max(maxPoints, points);
-                
-                uint16_t instructionLength = getUInt16(glyfData, glyph.offset + 10 + 2 * numberOfContours);
-                maxSizeOfInstructions = std::max(maxSizeOfInstructions, instructionLength);
-                
-            } else {
-                auto compositeStats = calculateCompositeGlyphStats(glyfData, glyph.offset);
-                maxCompositePoints = std::max(maxCompositePoints, compositeStats.maxPoints);
-                maxCompositeContours = std::max(maxCompositeContours, compositeStats.maxContours);
-                maxComponentElements = std::max(maxComponentElements, compositeStats.maxComponents);
-                maxComponentDepth = std::max(maxComponentDepth, compositeStats.maxDepth);
+        // Заголовки и списки компонентов разбираются параллельно и только у глифов без кэша
+        pool().parallelFor(0, count, GLYPH_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!outlineStats[i].known) decodeOutlineStats(glyfData, i, outlineStats[i]);
             }
+        });
+        std::vector<CompositeGlyphStats> composites = resolveCompositeStats();
+        
+        for (size_t i = 0; i < count; ++i) {
+            const GlyphOutlineStats& glyph = outlineStats[i];
+            maxSizeOfInstructions = std::max(maxSizeOfInstructions, glyph.instructions);
+            if (!glyph.composite) {
+                maxPoints = std::max(maxPoints, glyph.points);
+                maxContours = std::max(maxContours, glyph.contours);
+                continue;
+            }
+            maxCompositePoints = std::max(maxCompositePoints, composites[i].maxPoints);
+            maxCompositeContours = std::max(maxCompositeContours, composites[i].maxContours);
+            maxComponentElements = std::max(maxComponentElements, composites[i].maxComponents);
+            maxComponentDepth = std::max(maxComponentDepth, composites[i].maxDepth);
         }
     }
     
-    if (maxpIt->second.data.size() >= 32) {
-        setUInt16(maxpIt->second.data, 6, maxPoints);
-        setUInt16(maxpIt->second.data, 8, maxContours);
-        setUInt16(maxpIt->second.data, 10, maxCompositePoints);
-        setUInt16(maxpIt->second.data, 12, maxCompositeContours);
-        setUInt16(maxpIt->second.data, 14, maxSizeOfInstructions);
-        setUInt16(maxpIt->second.data, 16, maxComponentElements);
-        setUInt16(maxpIt->second.data, 18, maxComponentDepth);
+    // maxp 1.0: maxZones, maxTwilightPoints, maxStorage и т.п. (14-24) относятся к хинтингу и не трогаются.
+    // maxSizeOfInstructions часто учитывает и fpgm/prep, поэтому только растёт
+    if (maxpIt->second.bytes().size() >= MAXP_TABLE_SIZE) {
+        maxSizeOfInstructions = std::max(maxSizeOfInstructions, getUInt16(maxpIt->second.bytes(), 26));
+        setUInt16(maxpIt->second.mutableData(), 6, maxPoints);
+        setUInt16(maxpIt->second.mutableData(), 8, maxContours);
+        setUInt16(maxpIt->second.mutableData(), 10, maxCompositePoints);
+        setUInt16(maxpIt->second.mutableData(), 12, maxCompositeContours);
+        setUInt16(maxpIt->second.mutableData(), 26, maxSizeOfInstructions);
+        setUInt16(maxpIt->second.mutableData(), 28, maxComponentElements);
+        setUInt16(maxpIt->second.mutableData(), 30, maxComponentDepth);
     }
 }
 
-uint16_t TTFRebuilder::calculateSimpleGlyphPoints(const std::vector<uint8_t>& data, uint32_t offset) const {
+uint16_t TTFRebuilder::calculateSimpleGlyphPoints(utils::ByteSpan data, uint32_t offset) const {
     if (offset + 12 > data.size()) return 0;
     
     int16_t numberOfContours = getInt16(data, offset);
     if (numberOfContours <= 0) return 0;
     
-    uint16_t totalPoints = 0;
-    for (int16_t i = 0; i < numberOfContours; ++i) {
-        if (offset + 10 + (i + 1) * 2 > data.size()) break;
-        uint16_t pointsInContour = getUInt16(data, offset + 10 + i * 2);
-        totalPoints += pointsInContour;
-    }
-    
-    return totalPoints;
+    // endPtsOfContours - индексы последних точек, число точек - последний из них плюс один
+    size_t lastEndPoint = offset + 10 + (static_cast<size_t>(numberOfContours) - 1) * 2;
+    if (lastEndPoint + 2 > data.size()) return 0;
+    return static_cast<uint16_t>(getUInt16(data, lastEndPoint) + 1);
 }
 
-TTFRebuilder::CompositeGlyphStats TTFRebuilder::calculateCompositeGlyphStats(const std::vector<uint8_t>& data, uint32_t offset) const {
-    CompositeGlyphStats stats = {0, 0, 0, 0};
+void TTFRebuilder::decodeOutlineStats(utils::ByteSpan data, size_t index, GlyphOutlineStats& stats) const {
+    stats = GlyphOutlineStats{};
+    stats.known = true;
+    const GlyphInfo& glyph = glyphOffsets[index];
+    if (glyph.isEmpty || glyph.offset + 10 > data.size()) return;
     
-    if (offset + 10 > data.size()) return stats;
+    uint32_t offset = glyph.offset;
+    int16_t numberOfContours = getInt16(data, offset);
+    if (numberOfContours >= 0) {
+        stats.contours = static_cast<uint16_t>(numberOfContours);
+        stats.points = calculateSimpleGlyphPoints(data, offset);
+        size_t instructionsAt = offset + 10 + 2 * static_cast<size_t>(numberOfContours);
+        if (instructionsAt + 2 <= data.size()) stats.instructions = getUInt16(data, instructionsAt);
+        return;
+    }
     
+    stats.composite = true;
     uint32_t currentPos = 10;
-    uint16_t componentCount = 0;
-    
-    bool moreComponents = true;
-    while (moreComponents && currentPos < data.size()) {
-        componentCount++;
-        stats.maxComponents = componentCount;
-        
-        uint16_t flags = getUInt16(data, offset + currentPos);
-        currentPos += 2;
-        
-        uint16_t glyphIndex = getUInt16(data, offset + currentPos);
-        currentPos += 2;
-        
-        if (glyphIndex < glyphOffsets.size() && !glyphOffsets[glyphIndex].isEmpty) {
-            auto componentStats = analyzeGlyphForComposite(data, glyphOffsets[glyphIndex].offset);
-            stats.maxPoints = std::max(stats.maxPoints, componentStats.maxPoints);
-            stats.maxContours = std::max(stats.maxContours, componentStats.maxContours);
-            stats.maxDepth = std::max(stats.maxDepth, static_cast<uint16_t>(componentStats.maxDepth + 1));
-        }
-        
-        if (flags & 0x0001) {
-            currentPos += 4;
-        } else {
-            currentPos += 2;
-        }
-        
+    uint16_t flags = 0;
+    do {
+        flags = getUInt16(data, offset + currentPos);
+        stats.components.push_back(getUInt16(data, offset + currentPos + 2));
+        currentPos += 4;
+        currentPos += (flags & 0x0001) ? 4 : 2;
         if (flags & 0x0008) {
             currentPos += 2;
         } else if (flags & 0x0040) {
@@ -935,36 +1262,83 @@ TTFRebuilder::CompositeGlyphStats TTFRebuilder::calculateCompositeGlyphStats(con
         } else if (flags & 0x0080) {
             currentPos += 8;
         }
-        
-        moreComponents = (flags & 0x0020);
+    } while ((flags & 0x0020) && offset + currentPos + 4 <= data.size());
+    if ((flags & 0x0100) && offset + currentPos + 2 <= data.size()) {
+        stats.instructions = getUInt16(data, offset + currentPos);
+    }
+}
+
+std::vector<TTFRebuilder::CompositeGlyphStats> TTFRebuilder::resolveCompositeStats() const {
+    // Обход графа компонентов в глубину без рекурсии: каждый глиф считается один раз,
+    // составной - после всех своих компонентов; ребро назад (цикл) пропускается
+    enum : uint8_t { PENDING, ACTIVE, DONE };
+    size_t count = outlineStats.size();
+    std::vector<uint8_t> state(count, DONE);
+    std::vector<uint32_t> points(count), contours(count);
+    std::vector<uint16_t> depth(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        points[i] = outlineStats[i].points;
+        contours[i] = outlineStats[i].contours;
+        if (outlineStats[i].composite) state[i] = PENDING;
+    }
+    
+    size_t cycles = 0;
+    std::vector<std::pair<size_t, size_t>> stack;   // глиф и следующий компонент
+    for (size_t root = 0; root < count; ++root) {
+        if (state[root] != PENDING) continue;
+        state[root] = ACTIVE;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            size_t glyph = stack.back().first;
+            const std::vector<uint16_t>& components = outlineStats[glyph].components;
+            size_t& next = stack.back().second;
+            if (next < components.size()) {
+                uint16_t component = components[next++];
+                if (component >= count) continue;
+                if (state[component] == ACTIVE) {
+                    ++cycles;
+                } else if (state[component] == PENDING) {
+                    state[component] = ACTIVE;
+                    stack.emplace_back(component, 0);
+                }
+                continue;
+            }
+            
+            uint32_t totalPoints = 0, totalContours = 0;
+            uint16_t maxDepth = 0;
+            for (uint16_t component : components) {
+                if (component >= count || state[component] != DONE) continue;
+                totalPoints += points[component];
+                totalContours += contours[component];
+                maxDepth = std::max(maxDepth, depth[component]);
+            }
+            points[glyph] = totalPoints;
+            contours[glyph] = totalContours;
+            depth[glyph] = static_cast<uint16_t>(std::min(maxDepth + 1, 0xFFFF));
+            state[glyph] = DONE;
+            stack.pop_back();
+        }
     }
-    
-    return stats;
-}
-
-TTFRebuilder::CompositeGlyphStats TTFRebuilder::analyzeGlyphForComposite(const std::vector<uint8_t>& data, uint32_t offset) const {
-    CompositeGlyphStats stats = {0, 0, 0, 0};
-    
-    if (offset >= data.size()) return stats;
-    
-    int16_t numberOfContours = getInt16(data, offset);
-    
-    if (numberOfContours >= 0) {
-        stats.maxContours = std::max(stats.maxContours, static_cast<uint16_t>(numberOfContours));
-        stats.maxPoints = calculateSimpleGlyphPoints(data, offset);
-    } else {
-        stats = calculateCompositeGlyphStats(data, offset);
-        stats.maxDepth++;
+    if (cycles) {
+        std::cerr << "TTFRebuilder: Ignored " << cycles << " cyclic component references" << std::endl;
     }
     
-    return stats;
+    std::vector<CompositeGlyphStats> result(count, CompositeGlyphStats{0, 0, 0, 0});
+    for (size_t i = 0; i < count; ++i) {
+        if (!outlineStats[i].composite) continue;
+        result[i].maxPoints = static_cast<uint16_t>(std::min<uint32_t>(points[i], 0xFFFF));
+        result[i].maxContours = static_cast<uint16_t>(std::min<uint32_t>(contours[i], 0xFFFF));
+        result[i].maxComponents = static_cast<uint16_t>(std::min<size_t>(outlineStats[i].components.size(), 0xFFFF));
+        result[i].maxDepth = depth[i];
+    }
+    return result;
 }
 
 void TTFRebuilder::updateNameTableChecksum() {
     auto nameIt = tables.find("name");
     if (nameIt == tables.end()) return;
     
-    auto& nameData = nameIt->second.data;
+    utils::ByteSpan nameData = nameIt->second.bytes();
     if (nameData.size() < 6) {
         throw std::runtime_error("name table too small");
     }
@@ -978,7 +1352,6 @@ void TTFRebuilder::updateNameTableChecksum() {
         throw std::runtime_error("name table structure corrupted");
     }
     
-    std::vector<uint8_t> newNameData;
     std::vector<uint8_t> stringStorage;
     std::vector<NameRecord> nameRecords;
     
@@ -1027,29 +1400,23 @@ void TTFRebuilder::updateNameTableChecksum() {
         stringStorage.push_back(0);
     }
     
-    newNameData.resize(6 + nameRecords.size() * 12 + stringStorage.size());
-    
-    setUInt16(newNameData, 0, format);
-    setUInt16(newNameData, 2, static_cast<uint16_t>(nameRecords.size()));
-    setUInt16(newNameData, 4, 6 + static_cast<uint16_t>(nameRecords.size() * 12));
+    utils::ByteWriter writer(6 + nameRecords.size() * 12 + stringStorage.size());
+    writer.writeUInt16(format);
+    writer.writeUInt16(static_cast<uint16_t>(nameRecords.size()));
+    writer.writeUInt16(6 + static_cast<uint16_t>(nameRecords.size() * 12));
     
-    for (size_t i = 0; i < nameRecords.size(); ++i) {
-        size_t recordOffset = 6 + i * 12;
-        const auto& record = nameRecords[i];
-        
-        setUInt16(newNameData, recordOffset, record.platformID);
-        setUInt16(newNameData, recordOffset + 2, record.encodingID);
-        setUInt16(newNameData, recordOffset + 4, record.languageID);
-        setUInt16(newNameData, recordOffset + 6, record.nameID);
-        setUInt16(newNameData, recordOffset + 8, record.length);
-        setUInt16(newNameData, recordOffset + 10, record.offset);
+    for (const auto& record : nameRecords) {
+        writer.writeUInt16(record.platformID);
+        writer.writeUInt16(record.encodingID);
+        writer.writeUInt16(record.languageID);
+        writer.writeUInt16(record.nameID);
+        writer.writeUInt16(record.length);
+        writer.writeUInt16(record.offset);
     }
+    writer.writeBytes(stringStorage.data(), stringStorage.size());
     
-    std::copy(stringStorage.begin(), stringStorage.end(), 
-              newNameData.begin() + 6 + nameRecords.size() * 12);
-    
-    nameIt->second.data = newNameData;
-    nameIt->second.newLength = newNameData.size();
+    nameIt->second.newLength = static_cast<uint32_t>(writer.size());
+    nameIt->second.assign(writer.take());
     
     std::cout << "TTFRebuilder: Rebuilt name table with " << nameRecords.size() 
               << " records, string storage: " << stringStorage.size() << " bytes" << std::endl;
@@ -1059,7 +1426,7 @@ void TTFRebuilder::updatePostTableFormat2() {
     auto postIt = tables.find("post");
     if (postIt == tables.end()) return;
     
-    auto& postData = postIt->second.data;
+    utils::ByteSpan postData = postIt->second.bytes();
     if (postData.size() < 32) {
         throw std::runtime_error("post table too small");
     }
@@ -1069,15 +1436,6 @@ void TTFRebuilder::updatePostTableFormat2() {
         return;
     }
     
-    uint32_t italicAngle = getUInt32(postData, 4);
-    int16_t underlinePosition = getInt16(postData, 8);
-    int16_t underlineThickness = getInt16(postData, 10);
-    uint32_t isFixedPitch = getUInt32(postData, 12);
-    uint32_t minMemType42 = getUInt32(postData, 16);
-    uint32_t maxMemType42 = getUInt32(postData, 20);
-    uint32_t minMemType1 = getUInt32(postData, 24);
-    uint32_t maxMemType1 = getUInt32(postData, 28);
-    
     uint16_t numberOfGlyphs = getUInt16(postData, 32);
     
     if (numberOfGlyphs != numGlyphs) {
@@ -1085,40 +1443,28 @@ void TTFRebuilder::updatePostTableFormat2() {
                   << numberOfGlyphs << " to " << numGlyphs << std::endl;
     }
     
-    std::vector<uint8_t> newPostData;
-    // ИСПРАВЛЕНО: приведение типов для сравнения
-    size_t newSize = 34 + numGlyphs * 2;
-    newPostData.resize(newSize);
-    
-    setUInt32(newPostData, 0, format);
-    setUInt32(newPostData, 4, italicAngle);
-    setInt16(newPostData, 8, underlinePosition);
-    setInt16(newPostData, 10, underlineThickness);
-    setUInt32(newPostData, 12, isFixedPitch);
-    setUInt32(newPostData, 16, minMemType42);
-    setUInt32(newPostData, 20, maxMemType42);
-    setUInt32(newPostData, 24, minMemType1);
-    setUInt32(newPostData, 28, maxMemType1);
-    setUInt16(newPostData, 32, numGlyphs);
-    
-    // ИСПРАВЛЕНО: приведение типов для сравнения
-    if (postData.size() >= static_cast<size_t>(34 + numberOfGlyphs * 2)) {
-        for (uint16_t i = 0; i < numGlyphs; ++i) {
-            if (i < numberOfGlyphs) {
-                uint16_t nameIndex = getUInt16(postData, 34 + i * 2);
-                setUInt16(newPostData, 34 + i * 2, nameIndex);
-            } else {
-                setUInt16(newPostData, 34 + i * 2, calculateStandardGlyphNameIndex(i));
-            }
-        }
-    } else {
-        for (uint16_t i = 0; i < numGlyphs; ++i) {
-            setUInt16(newPostData, 34 + i * 2, calculateStandardGlyphNameIndex(i));
-        }
+    size_t indexesEnd = 34 + static_cast<size_t>(numberOfGlyphs) * 2;
+    bool indexesPresent = postData.size() >= indexesEnd;
+    utils::ByteSpan names = indexesPresent ? postData.subspan(indexesEnd) : utils::ByteSpan();
+    utils::ByteWriter writer(34 + static_cast<size_t>(numGlyphs) * 2 + names.size());
+    
+    // Поля заголовка переносятся как есть, меняется только numGlyphs
+    writer.writeBytes(postData.subspan(0, 32));
+    writer.writeUInt16(numGlyphs);
+    
+    nextUnicodeNameIndex = FIRST_UNICODE_NAME_INDEX;
+    nextCompositeNameIndex = FIRST_COMPOSITE_NAME_INDEX;
+    nextDefaultNameIndex = FIRST_DEFAULT_NAME_INDEX;
+    uint16_t kept = indexesPresent ? std::min(numGlyphs, numberOfGlyphs) : 0;
+    writer.writeBytes(postData.subspan(34, static_cast<size_t>(kept) * 2));
+    for (uint16_t i = kept; i < numGlyphs; ++i) {
+        writer.writeUInt16(calculateStandardGlyphNameIndex(i));
     }
+    // Строки имён: на них ссылаются сохранённые индексы, новые глифы получают стандартные имена
+    writer.writeBytes(names);
     
-    postIt->second.data = newPostData;
-    postIt->second.newLength = newPostData.size();
+    postIt->second.newLength = static_cast<uint32_t>(writer.size());
+    postIt->second.assign(writer.take());
     
     std::cout << "TTFRebuilder: Rebuilt post table format 2.0 with " 
               << numGlyphs << " glyph name indexes" << std::endl;
@@ -1183,7 +1529,7 @@ uint16_t TTFRebuilder::getUnicodeFromCmap(uint16_t glyphIndex) {
     auto cmapIt = tables.find("cmap");
     if (cmapIt == tables.end()) return 0xFFFF;
     
-    const auto& cmapData = cmapIt->second.data;
+    utils::ByteSpan cmapData = cmapIt->second.bytes();
     if (cmapData.size() < 4) return 0xFFFF;
     
     // УДАЛЕНО: uint16_t version = getUInt16(cmapData, 0);
@@ -1217,7 +1563,7 @@ uint16_t TTFRebuilder::getUnicodeFromCmap(uint16_t glyphIndex) {
     return 0xFFFF;
 }
 
-uint16_t TTFRebuilder::findGlyphInFormat4Subtable(const std::vector<uint8_t>& cmapData, uint32_t offset, uint16_t glyphIndex) {
+uint16_t TTFRebuilder::findGlyphInFormat4Subtable(utils::ByteSpan cmapData, uint32_t offset, uint16_t glyphIndex) {
     if (offset + 14 > cmapData.size()) return 0xFFFF;
     
     // УДАЛЕНО: uint16_t length = getUInt16(cmapData, offset + 2);
@@ -1258,7 +1604,7 @@ uint16_t TTFRebuilder::findGlyphInFormat4Subtable(const std::vector<uint8_t>& cm
     return 0xFFFF;
 }
 
-uint16_t TTFRebuilder::findGlyphInFormat12Subtable(const std::vector<uint8_t>& cmapData, uint32_t offset, uint16_t glyphIndex) {
+uint16_t TTFRebuilder::findGlyphInFormat12Subtable(utils::ByteSpan cmapData, uint32_t offset, uint16_t glyphIndex) {
     if (offset + 16 > cmapData.size()) return 0xFFFF;
     
     uint16_t format = getUInt16(cmapData, offset);
@@ -1293,12 +1639,14 @@ bool TTFRebuilder::isCompositeGlyph(uint16_t glyphIndex) {
     auto glyfIt = tables.find("glyf");
     if (glyfIt == tables.end()) return false;
     
+    // Нужен только для имён новых глифов: смещения считаются при первом обращении
+    ensureGlyphOffsets();
     if (glyphIndex >= glyphOffsets.size()) return false;
     
     const auto& glyph = glyphOffsets[glyphIndex];
-    if (glyph.isEmpty || glyph.offset >= glyfIt->second.data.size()) return false;
+    if (glyph.isEmpty || glyph.offset >= glyfIt->second.bytes().size()) return false;
     
-    int16_t numberOfContours = getInt16(glyfIt->second.data, glyph.offset);
+    int16_t numberOfContours = getInt16(glyfIt->second.bytes(), glyph.offset);
     return numberOfContours < 0;
 }
 
@@ -1372,41 +1720,41 @@ uint16_t TTFRebuilder::generateUnicodeGlyphNameIndex(uint16_t unicodeValue) {
     
     // Для остальных Unicode символов генерируем имя по шаблону uniXXXX
     // Начинаем с 532 чтобы избежать конфликтов со стандартными именами
-    static uint16_t nextUnicodeNameIndex = 532;
+    uint32_t nameIndex = nextUnicodeNameIndex++;
     
     // Проверяем не превысили ли максимальный индекс
-    if (nextUnicodeNameIndex > MAX_STANDARD_NAME_INDEX) {
+    if (nameIndex > MAX_STANDARD_NAME_INDEX) {
         std::cerr << "TTFRebuilder: Warning - exceeded maximum standard name index for Unicode glyph" << std::endl;
         return 0; // Возвращаем .notdef
     }
     
-    return nextUnicodeNameIndex++;
+    return static_cast<uint16_t>(nameIndex);
 }
 
 uint16_t TTFRebuilder::generateCompositeGlyphName(uint16_t /*glyphIndex*/) {
     // Для составных глифов используем имена по шаблону compXXXX
-    static uint16_t nextCompositeNameIndex = 1000;
+    uint32_t nameIndex = nextCompositeNameIndex++;
     
     // Проверяем не превысили ли максимальный индекс
-    if (nextCompositeNameIndex > MAX_STANDARD_NAME_INDEX) {
+    if (nameIndex > MAX_STANDARD_NAME_INDEX) {
         std::cerr << "TTFRebuilder: Warning - exceeded maximum standard name index for composite glyph" << std::endl;
         return 0; // Возвращаем .notdef
     }
     
-    return nextCompositeNameIndex++;
+    return static_cast<uint16_t>(nameIndex);
 }
 
 uint16_t TTFRebuilder::generateDefaultGlyphName(uint16_t /*glyphIndex*/) {
     // Для остальных глифов используем имена по шаблону gXXXX
-    static uint16_t nextDefaultNameIndex = 2000;
+    uint32_t nameIndex = nextDefaultNameIndex++;
     
     // Проверяем не превысили ли максимальный индекс
-    if (nextDefaultNameIndex > MAX_STANDARD_NAME_INDEX) {
+    if (nameIndex > MAX_STANDARD_NAME_INDEX) {
         std::cerr << "TTFRebuilder: Warning - exceeded maximum standard name index for default glyph" << std::endl;
         return 0; // Возвращаем .notdef
     }
     
-    return nextDefaultNameIndex++;
+    return static_cast<uint16_t>(nameIndex);
 }
 
 void TTFRebuilder::validateTableData(const std::string& tag, size_t minSize) const {
@@ -1414,10 +1762,10 @@ void TTFRebuilder::validateTableData(const std::string& tag, size_t minSize) con
     if (it == tables.end()) {
         throw std::runtime_error("Table '" + tag + "' not found");
     }
-    if (it->second.data.size() < minSize) {
+    if (it->second.bytes().size() < minSize) {
         throw std::runtime_error("Table '" + tag + "' too small, expected at least " + 
                                std::to_string(minSize) + " bytes, got " + 
-                               std::to_string(it->second.data.size()));
+                               std::to_string(it->second.bytes().size()));
     }
 }
 
@@ -1425,109 +1773,30 @@ void TTFRebuilder::validateGlyphData() const {
     auto glyfIt = tables.find("glyf");
     if (glyfIt == tables.end()) return;
     
-    const auto& glyfData = glyfIt->second.data;
+    utils::ByteSpan glyfData = glyfIt->second.bytes();
     
-    for (const auto& glyph : glyphOffsets) {
-        if (glyph.isEmpty) continue;
-        
-        if (glyph.offset >= glyfData.size()) {
-            throw std::runtime_error("Glyph offset beyond glyf table bounds");
-        }
-        
-        if (glyph.offset + glyph.length > glyfData.size()) {
-            throw std::runtime_error("Glyph extends beyond glyf table bounds");
+    // Разобранная длина контуров и флагов не должна выходить за отведённый loca участок
+    pool().parallelFor(0, glyphOffsets.size(), GLYPH_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const GlyphInfo& glyph = glyphOffsets[i];
+            if (glyph.isEmpty) continue;
+            
+            if (glyph.offset >= glyfData.size()) {
+                throw std::runtime_error("Glyph offset beyond glyf table bounds");
+            }
+            
+            if (glyph.offset + glyph.length > glyfData.size()) {
+                throw std::runtime_error("Glyph extends beyond glyf table bounds");
+            }
+            
+            uint32_t parsed = getInt16(glyfData, glyph.offset) >= 0
+                                  ? parseSimpleGlyphLength(glyfData, glyph.offset)
+                                  : parseCompositeGlyphLength(glyfData, glyph.offset);
+            if (parsed > glyph.length) {
+                throw std::runtime_error("Glyph " + std::to_string(i) + " data exceeds its loca extent");
+            }
         }
-    }
-}
-
-uint32_t TTFRebuilder::calculateChecksum(const std::vector<uint8_t>& data) const {
-    return calculateTableChecksum(data);
-}
-
-void TTFRebuilder::updateTableOffsets() {
-    uint32_t currentOffset = sizeof(utils::TTFHeader) + 
-                           tableOrder.size() * sizeof(utils::TableRecord);
-    
-    currentOffset = (currentOffset + 3) & ~3;
-    
-    for (auto& tableName : tableOrder) {
-        auto& table = tables[tableName];
-        table.newOffset = currentOffset;
-        currentOffset += table.newLength;
-        
-        currentOffset = (currentOffset + 3) & ~3;
-    }
-}
-
-void TTFRebuilder::rebuildTableDirectory() {
-    utils::TTFHeader header;
-    header.sfntVersion = TTF_MAGIC;
-    header.numTables = static_cast<uint16_t>(tableOrder.size());
-    
-    uint16_t maxPower2 = 1;
-    uint16_t entrySelector = 0;
-    while (maxPower2 * 2 <= header.numTables) {
-        maxPower2 *= 2;
-        entrySelector++;
-    }
-    header.searchRange = maxPower2 * 16;
-    header.entrySelector = entrySelector;
-    header.rangeShift = (header.numTables - maxPower2) * 16;
-    
-    newData.resize(sizeof(utils::TTFHeader));
-    std::memcpy(newData.data(), &header, sizeof(header));
-    
-    size_t tableRecordsOffset = newData.size();
-    newData.resize(tableRecordsOffset + header.numTables * sizeof(utils::TableRecord));
-    
-    for (size_t i = 0; i < tableOrder.size(); ++i) {
-        const auto& table = tables[tableOrder[i]];
-        utils::TableRecord record;
-        std::memcpy(record.tag, table.tag.c_str(), 4);
-        record.checksum = calculateTableChecksum(table.data);
-        record.offset = table.newOffset;
-        record.length = table.newLength;
-        
-        std::memcpy(newData.data() + tableRecordsOffset + i * sizeof(record), 
-                   &record, sizeof(record));
-    }
-}
-
-void TTFRebuilder::updateHeadTableChecksumAdjustment() {
-    auto headTable = tables.find("head");
-    if (headTable == tables.end()) return;
-    
-    uint32_t fontChecksum = 0;
-    
-    uint32_t headerChecksum = calculateTableChecksum(
-        std::vector<uint8_t>(newData.begin(), newData.begin() + sizeof(utils::TTFHeader) + 
-                            tableOrder.size() * sizeof(utils::TableRecord))
-    );
-    fontChecksum += headerChecksum;
-    
-    for (const auto& table : tableOrder) {
-        fontChecksum += calculateTableChecksum(tables[table].data);
-    }
-    
-    uint32_t checksumAdjustment = 0xB1B0AFBA - fontChecksum;
-    
-    if (headTable->second.data.size() >= 12) {
-        setUInt32(headTable->second.data, 8, checksumAdjustment);
-    }
-}
-
-uint32_t TTFRebuilder::calculateTableChecksum(const std::vector<uint8_t>& data) const {
-    uint32_t sum = 0;
-    size_t nLongs = (data.size() + 3) / 4;
-    
-    for (size_t i = 0; i < nLongs; ++i) {
-        uint32_t value = 0;
-        size_t bytesToCopy = std::min(size_t(4), data.size() - i * 4);
-        std::memcpy(&value, data.data() + i * 4, bytesToCopy);
-        sum += value;
-    }
-    
-    return sum;
+    });
 }
 
 } // namespace fontmaster
@@ -1,4 +1,5 @@
 #include "fontmaster/TTFUtils.h"
+#include "fontmaster/PhaseTimer.h"
 #include <algorithm>
 #include <fstream>
 
@@ -6,24 +7,34 @@ namespace fontmaster {
 namespace utils {
 
 std::vector<TableRecord> parseTTFTables(const std::vector<uint8_t>& fontData) {
+    ScopedPhase phase("tables");
     std::vector<TableRecord> tables;
     
     if (fontData.size() < sizeof(TTFHeader)) {
         throw std::runtime_error("Font data too small for TTF header");
     }
     
-    const TTFHeader* header = reinterpret_cast<const TTFHeader*>(fontData.data());
-    size_t expectedSize = sizeof(TTFHeader) + header->numTables * sizeof(TableRecord);
+    // Поля в файле хранятся в big-endian; переводим в порядок байт хоста,
+    // чтобы offset/length можно было использовать напрямую
+    TTFReader reader(fontData);
+    reader.readUInt32(); // sfntVersion
+    uint16_t numTables = reader.readUInt16();
+    size_t expectedSize = sizeof(TTFHeader) + numTables * sizeof(TableRecord);
     
     if (fontData.size() < expectedSize) {
         throw std::runtime_error("Font data too small for table records");
     }
     
-    const TableRecord* tableRecords = reinterpret_cast<const TableRecord*>(
-        fontData.data() + sizeof(TTFHeader));
-    
-    for (uint16_t i = 0; i < header->numTables; ++i) {
-        tables.push_back(tableRecords[i]);
+    reader.seek(sizeof(TTFHeader));
+    tables.reserve(numTables);
+    for (uint16_t i = 0; i < numTables; ++i) {
+        TableRecord record;
+        std::memcpy(record.tag, fontData.data() + reader.tell(), 4);
+        reader.readUInt32();
+        record.checksum = reader.readUInt32();
+        record.offset = reader.readUInt32();
+        record.length = reader.readUInt32();
+        tables.push_back(record);
     }
     
     return tables;
@@ -0,0 +1,202 @@
+#include "fontmaster/ThreadPool.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+namespace fontmaster {
+namespace utils {
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Вызывающий поток считается одним из исполнителей
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t first, size_t last, size_t grain,
+                             const std::function<void(size_t, size_t)>& body) {
+    if (first >= last) return;
+    grain = std::max<size_t>(grain, 1);
+
+    size_t chunkCount = (last - first + grain - 1) / grain;
+    if (chunkCount == 1 || workers.empty()) {
+        body(first, last);
+        return;
+    }
+
+    // Поддиапазоны раздаются через общий счётчик: кто свободен, тот и берёт
+    struct Job {
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> doneChunks{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto job = std::make_shared<Job>();
+
+    auto runChunks = [job, first, last, grain, chunkCount, &body]() {
+        size_t chunk;
+        while ((chunk = job->nextChunk.fetch_add(1)) < chunkCount) {
+            size_t begin = first + chunk * grain;
+            size_t end = std::min(last, begin + grain);
+            try {
+                body(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (!job->error) job->error = std::current_exception();
+            }
+            if (job->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(workers.size(), chunkCount - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        enqueue(runChunks);
+    }
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&]() { return job->doneChunks.load() == chunkCount; });
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void ThreadPool::runGraph(const std::vector<std::vector<size_t>>& dependencies,
+                          const std::function<void(size_t)>& body) {
+    const size_t nodeCount = dependencies.size();
+    for (size_t node = 0; node < nodeCount; ++node) {
+        for (size_t dependency : dependencies[node]) {
+            if (dependency >= node) {
+                throw std::invalid_argument("ThreadPool::runGraph: dependency must precede its node");
+            }
+        }
+    }
+    if (nodeCount == 0) return;
+
+    // Номера вершин упорядочены топологически, так что без помощников хватает прямого обхода
+    if (workers.empty() || nodeCount == 1) {
+        for (size_t node = 0; node < nodeCount; ++node) body(node);
+        return;
+    }
+
+    struct Job {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<size_t> ready;
+        std::vector<size_t> pending;                 // число незавершённых зависимостей
+        std::vector<std::vector<size_t>> dependents;
+        size_t remaining = 0;
+        size_t running = 0;
+        std::exception_ptr error;
+    };
+    auto job = std::make_shared<Job>();
+    job->pending.resize(nodeCount);
+    job->dependents.resize(nodeCount);
+    job->remaining = nodeCount;
+    for (size_t node = 0; node < nodeCount; ++node) {
+        job->pending[node] = dependencies[node].size();
+        for (size_t dependency : dependencies[node]) {
+            job->dependents[dependency].push_back(node);
+        }
+        if (job->pending[node] == 0) job->ready.push_back(node);
+    }
+
+    // Помощник, попавший в очередь пула после завершения графа, сразу выходит и body не трогает
+    auto runNodes = [job, &body]() {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        while (true) {
+            job->changed.wait(lock, [&]() {
+                return !job->ready.empty() || job->remaining == 0 || job->error;
+            });
+            if (job->remaining == 0 || job->error) return;
+
+            size_t node = job->ready.front();
+            job->ready.pop_front();
+            ++job->running;
+            lock.unlock();
+
+            std::exception_ptr error;
+            try {
+                body(node);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            --job->running;
+            --job->remaining;
+            if (error) {
+                if (!job->error) job->error = error;
+            } else {
+                for (size_t dependent : job->dependents[node]) {
+                    if (--job->pending[dependent] == 0) job->ready.push_back(dependent);
+                }
+            }
+            job->changed.notify_all();
+        }
+    };
+
+    size_t helpers = std::min(workers.size(), nodeCount - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        enqueue(runNodes);
+    }
+    runNodes();
+
+    // После ошибки дожидаемся уже запущенных вершин: body не должен пережить вызов
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->changed.wait(lock, [&]() { return job->running == 0; });
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+} // namespace utils
+} // namespace fontmaster
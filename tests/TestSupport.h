@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/// assert, который проверяется и в сборках с NDEBUG
+#define CHECK(condition) \
+    ((condition) ? static_cast<void>(0) : ::fontmaster::test::checkFailed(#condition, __FILE__, __LINE__))
+
+namespace fontmaster {
+namespace test {
+
+[[noreturn]] inline void checkFailed(const char* expression, const char* file, int line) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    std::abort();
+}
+
+/// Файл во временном каталоге; удаляется вместе с объектом
+struct TempFile {
+    std::string path;
+
+    explicit TempFile(const std::string& name)
+        : path((std::filesystem::temp_directory_path() / ("fontmaster_test_" + name)).string()) {
+        std::remove(path.c_str());
+    }
+    ~TempFile() { std::remove(path.c_str()); }
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+};
+
+inline std::vector<uint8_t> readBytes(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+inline void writeBytes(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+inline std::vector<uint8_t> bytesOf(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+/// Сигнатура PNG и IHDR (RGBA, 8 бит) без данных: хватает для разбора заголовка
+inline std::vector<uint8_t> pngHeader(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R'};
+    for (uint32_t value : {width, height}) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            png.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+    const uint8_t tail[] = {8, 6, 0, 0, 0, 0, 0, 0, 0};   // глубина, цвет, сжатие, фильтр, interlace, CRC
+    png.insert(png.end(), tail, tail + sizeof(tail));
+    return png;
+}
+
+} // namespace test
+} // namespace fontmaster
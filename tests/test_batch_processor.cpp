@@ -0,0 +1,138 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "BatchProcessor.h"
+#include "fontmaster/FontMaster.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace fontmaster;
+
+namespace {
+
+std::vector<std::string> readLines(const std::string& path) {
+    std::vector<uint8_t> bytes = test::readBytes(path);
+    std::istringstream stream(std::string(bytes.begin(), bytes.end()));
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(stream, line)) lines.push_back(line);
+    return lines;
+}
+
+void writeManifest(const std::string& path, const std::vector<std::string>& lines) {
+    std::string text;
+    for (const std::string& line : lines) text += line + "\n";
+    test::writeBytes(path, test::bytesOf(text));
+}
+
+size_t countContaining(const std::vector<std::string>& lines, const std::string& text) {
+    return static_cast<size_t>(std::count_if(lines.begin(), lines.end(), [&](const std::string& line) {
+        return line.find(text) != std::string::npos;
+    }));
+}
+
+void testEditsOfOneFileRunInOrder() {
+    std::cout << "Testing batch ordering of edits to one file..." << std::endl;
+
+    test::TempFile source("batch_source.ttf");
+    test::TempFile output("batch_output.ttf");
+    test::TempFile manifest("batch_order.jsonl");
+    test::TempFile log("batch_order.log");
+    test::writeBytes(source.path, bench::makeSyntheticFont(64, bench::ColorTables::SBIX));
+    std::vector<GlyphInfo> glyphs = Font::load(source.path)->listGlyphs();
+    const size_t steps = 12;
+    CHECK(glyphs.size() > steps);
+
+    // Первое задание создаёт файл, следующие правят его на месте; между ними - чтения
+    std::vector<std::string> lines;
+    lines.push_back("{\"id\": \"create\", \"font\": \"" + source.path + "\", \"op\": \"remove\", \"select\": \"gid:" +
+                    std::to_string(glyphs[0].glyph_id) + "\", \"output\": \"" + output.path + "\"}");
+    for (size_t i = 1; i < steps; ++i) {
+        lines.push_back("{\"id\": \"step" + std::to_string(i) + "\", \"font\": \"" + output.path +
+                        "\", \"op\": \"remove\", \"select\": \"gid:" + std::to_string(glyphs[i].glyph_id) +
+                        "\", \"inplace\": true}");
+        lines.push_back("{\"font\": \"" + output.path + "\", \"op\": \"list\"}");
+    }
+    writeManifest(manifest.path, lines);
+
+    BatchOptions options;
+    options.manifestPath = manifest.path;
+    options.logPath = log.path;
+    options.jobs = 4;
+    BatchSummary summary = BatchProcessor(options).run();
+    CHECK(summary.failed == 0);
+    CHECK(summary.succeeded == lines.size());
+
+    std::vector<GlyphInfo> remaining = Font::load(output.path)->listGlyphs();
+    CHECK(remaining.size() == glyphs.size() - steps);
+    for (size_t i = 0; i < steps; ++i) {
+        CHECK(std::none_of(remaining.begin(), remaining.end(),
+                            [&](const GlyphInfo& glyph) { return glyph.name == glyphs[i].name; }));
+    }
+
+    std::cout << "✓ Batch ordering test passed" << std::endl;
+}
+
+void testResumeSkipsCompletedItems() {
+    std::cout << "Testing batch manifest parsing and resume..." << std::endl;
+
+    test::TempFile source("batch_resume.ttf");
+    test::TempFile manifest("batch_resume.jsonl");
+    test::TempFile log("batch_resume.log");
+    test::writeBytes(source.path, bench::makeSyntheticFont(16, bench::ColorTables::SBIX));
+
+    writeManifest(manifest.path, {
+        "{\"id\": \"plain\", \"font\": \"" + source.path + "\", \"op\": \"list\"}",
+        // Экранирование и суррогатная пара в ключе: журнал должен вернуть тот же ключ
+        "{\"id\": \"caf\\u00e9 \\\"\\ud83d\\ude00\\\"\", \"font\": \"" + source.path + "\", \"op\": \"info\", \"note\": [1, 2]}",
+        "{\"op\": \"list\", \"font\": ",
+        "  ",
+        "{\"id\": \"missing\", \"font\": \"" + source.path + ".absent\", \"op\": \"list\"}",
+        "{\"font\": \"" + source.path + "\", \"op\": \"rotate\"}",
+    });
+
+    BatchOptions options;
+    options.manifestPath = manifest.path;
+    options.logPath = log.path;
+    options.jobs = 2;
+    BatchSummary first = BatchProcessor(options).run();
+    CHECK(first.succeeded == 2 && first.failed == 3 && first.skipped == 0);
+
+    std::vector<std::string> lines = readLines(log.path);
+    CHECK(lines.size() == 5);
+    CHECK(countContaining(lines, "\"key\":\"caf\xc3\xa9 \\\"\xf0\x9f\x98\x80\\\"\",\"line\":2") == 1);
+    CHECK(countContaining(lines, "\"key\":\"line:3\"") == 1);
+    CHECK(countContaining(lines, "unknown op") == 1);
+
+    // Запись, оборванная сбоем, не мешает продолжению
+    std::vector<uint8_t> truncated = test::readBytes(log.path);
+    std::vector<uint8_t> tail = test::bytesOf("{\"key\":\"plain\",\"status\":\"er");
+    truncated.insert(truncated.end(), tail.begin(), tail.end());
+    test::writeBytes(log.path, truncated);
+
+    options.resume = true;
+    BatchSummary second = BatchProcessor(options).run();
+    CHECK(second.skipped == 2);
+    CHECK(second.succeeded == 0 && second.failed == 3);
+
+    lines = readLines(log.path);
+    CHECK(lines.size() == 5 + 1 + 3);
+    CHECK(countContaining(lines, "\"key\":\"plain\"") == 2);   // первая запись и оборванная
+    CHECK(countContaining(lines, "\"key\":\"missing\"") == 2);
+
+    std::cout << "✓ Batch manifest parsing and resume test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testEditsOfOneFileRunInOrder();
+        testResumeSkipsCompletedItems();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,77 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/FileIO.h"
+#include "fontmaster/FontMaster.h"
+#include <iostream>
+
+using namespace fontmaster;
+
+namespace {
+
+// Синтетический CBDT: один страйк, индекс формата 1, записи формата 17 с PNG 16x16
+const uint16_t NUM_GLYPHS = 64;
+
+void testSameSizeReplacementKeepsLayout() {
+    std::cout << "Testing CBDT in-place save into the old slot..." << std::endl;
+
+    test::TempFile file("cbdt_in_place.ttf");
+    std::vector<uint8_t> original = bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC);
+    test::writeBytes(file.path, original);
+    uint64_t inode = utils::FileStamp::of(file.path).inode;
+
+    auto font = Font::load(file.path);
+    std::string name = font->listGlyphs().front().name;
+    std::vector<uint8_t> image = test::pngHeader(16, 16);
+    image.back() = 0x5A;   // отличается от исходной заглушки только CRC
+    bool replaced = font->replaceGlyphImage(name, image);
+    CHECK(replaced);
+    bool saved = font->saveInPlace();
+    CHECK(saved);
+
+    // Раскладка прежняя: файл переписан на месте, размер тот же
+    std::vector<uint8_t> result = test::readBytes(file.path);
+    CHECK(result.size() == original.size());
+    CHECK(result != original);
+    CHECK(utils::FileStamp::of(file.path).inode == inode);
+
+    auto reloaded = Font::load(file.path);
+    GlyphInfo info = reloaded->getGlyphInfo(name);
+    CHECK(info.width == 16 && info.height == 16);
+    CHECK(info.format == "png" && info.image_data == image);
+    CHECK(reloaded->listGlyphs().size() == font->listGlyphs().size());
+
+    std::cout << "✓ CBDT in-place slot test passed" << std::endl;
+}
+
+void testLargerReplacementFallsBack() {
+    std::cout << "Testing CBDT in-place save with a larger image..." << std::endl;
+
+    test::TempFile file("cbdt_in_place_grow.ttf");
+    test::writeBytes(file.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC));
+
+    auto font = Font::load(file.path);
+    std::string name = font->listGlyphs().front().name;
+    bool replaced = font->replaceGlyphImage(name, test::pngHeader(24, 24));
+    CHECK(replaced);
+    bool saved = font->saveInPlace();
+    CHECK(saved);
+
+    GlyphInfo info = Font::load(file.path)->getGlyphInfo(name);
+    CHECK(info.width == 24 && info.height == 24);
+
+    std::cout << "✓ CBDT in-place fallback test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testSameSizeReplacementKeepsLayout();
+        testLargerReplacementFallsBack();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
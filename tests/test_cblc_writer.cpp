@@ -0,0 +1,146 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/ByteSpan.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/TTFUtils.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+
+using namespace fontmaster;
+
+namespace {
+
+const uint16_t NUM_GLYPHS = 96;
+
+std::map<std::string, std::vector<uint8_t>> imagesOf(const Font& font) {
+    std::map<std::string, std::vector<uint8_t>> images;
+    for (const GlyphInfo& info : font.listGlyphs()) {
+        GlyphInfo full = font.getGlyphInfo(info.name);
+        CHECK(full.format == "png");
+        images[info.name] = full.image_data;
+    }
+    return images;
+}
+
+struct IndexSubtable {
+    uint16_t firstGlyph;
+    uint16_t lastGlyph;
+    uint16_t indexFormat;
+    uint16_t imageFormat;
+};
+
+// Подтаблицы индекса первого страйка CBLC
+std::vector<IndexSubtable> indexSubtables(const std::vector<uint8_t>& font) {
+    auto tables = utils::parseTTFTables(font);
+    const utils::TableRecord* cblcRecord = utils::findTable(tables, "CBLC");
+    CHECK(cblcRecord);
+    utils::ByteSpan cblc = utils::ByteSpan(font).subspan(cblcRecord->offset, cblcRecord->length);
+    CHECK(cblc.readUInt32(4) >= 1);
+    uint32_t arrayOffset = cblc.readUInt32(8);
+    uint32_t count = cblc.readUInt32(8 + 8);
+
+    std::vector<IndexSubtable> subtables;
+    for (uint32_t i = 0; i < count; ++i) {
+        size_t entry = arrayOffset + i * 8;
+        size_t header = arrayOffset + cblc.readUInt32(entry + 4);
+        subtables.push_back({cblc.readUInt16(entry), cblc.readUInt16(entry + 2), cblc.readUInt16(header),
+                             cblc.readUInt16(header + 2)});
+    }
+    return subtables;
+}
+
+void testUnchangedStrikeRoundTrip() {
+    std::cout << "Testing CBLC writer round trip without edits..." << std::endl;
+
+    test::TempFile source("cblc_source.ttf");
+    test::TempFile output("cblc_output.ttf");
+    test::writeBytes(source.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC));
+
+    auto font = Font::load(source.path);
+    auto before = imagesOf(*font);
+    bool saved = font->save(output.path);
+    CHECK(saved);
+
+    // Записи одного размера с общими метриками: один прогон формата 2 с картинками формата 19
+    std::vector<IndexSubtable> subtables = indexSubtables(test::readBytes(output.path));
+    CHECK(subtables.size() == 1);
+    CHECK(subtables[0].indexFormat == 2 && subtables[0].imageFormat == 19);
+
+    auto reloaded = Font::load(output.path);
+    CHECK(imagesOf(*reloaded) == before);
+
+    std::cout << "✓ CBLC writer unchanged round trip test passed" << std::endl;
+}
+
+void testEditedStrikeRoundTrip() {
+    std::cout << "Testing CBLC writer round trip with gaps and mixed sizes..." << std::endl;
+
+    test::TempFile source("cblc_edit_source.ttf");
+    test::TempFile output("cblc_edit_output.ttf");
+    test::TempFile again("cblc_edit_again.ttf");
+    test::writeBytes(source.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC));
+
+    auto font = Font::load(source.path);
+    std::vector<GlyphInfo> glyphs = font->listGlyphs();
+    auto expected = imagesOf(*font);
+
+    // Каждый третий глиф удалён, часть первой половины заменена картинками другого размера
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        const std::string& name = glyphs[i].name;
+        if (i % 3 == 2) {
+            bool removed = font->removeGlyph(name);
+            CHECK(removed);
+            expected.erase(name);
+        } else if (i < glyphs.size() / 2 && i % 4 == 0) {
+            std::vector<uint8_t> image = test::pngHeader(20 + static_cast<uint32_t>(i % 8), 20);
+            bool replaced = font->replaceGlyphImage(name, image);
+            CHECK(replaced);
+            expected[name] = image;
+        }
+    }
+    bool saved = font->save(output.path);
+    CHECK(saved);
+
+    std::vector<uint8_t> written = test::readBytes(output.path);
+    std::vector<IndexSubtable> subtables = indexSubtables(written);
+    CHECK(subtables.size() > 1);
+    std::set<uint16_t> indexFormats;
+    for (size_t i = 0; i < subtables.size(); ++i) {
+        CHECK(subtables[i].firstGlyph <= subtables[i].lastGlyph);
+        if (i > 0) CHECK(subtables[i - 1].lastGlyph < subtables[i].firstGlyph);
+        indexFormats.insert(subtables[i].indexFormat);
+    }
+    CHECK(std::all_of(indexFormats.begin(), indexFormats.end(),
+                       [](uint16_t format) { return format == 1 || format == 2 || format == 3 || format == 5; }));
+    // Вторая половина - одинаковые записи с пропусками ID: выгоднее всего формат 5
+    CHECK(indexFormats.count(5) == 1);
+
+    auto reloaded = Font::load(output.path);
+    CHECK(imagesOf(*reloaded) == expected);
+    for (const GlyphInfo& info : reloaded->listGlyphs()) {
+        CHECK(info.width == utils::ByteSpan(expected[info.name]).readUInt32(16));
+    }
+
+    // Повторное сохранение разобранного результата даёт те же байты
+    bool savedAgain = reloaded->save(again.path);
+    CHECK(savedAgain);
+    CHECK(test::readBytes(again.path) == written);
+
+    std::cout << "✓ CBLC writer edited round trip test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testUnchangedStrikeRoundTrip();
+        testEditedStrikeRoundTrip();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
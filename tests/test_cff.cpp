@@ -0,0 +1,280 @@
+#include "TestSupport.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/CFFCharstringInterpreter.h"
+#include "fontmaster/CFFParser.h"
+#include "fontmaster/ThreadPool.h"
+#include <cmath>
+#include <iostream>
+#include <optional>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+// INDEX с offSize 2: данных в тестах меньше 64 КБ
+Bytes indexBytes(const std::vector<Bytes>& items) {
+    ByteWriter writer;
+    writer.writeUInt16(static_cast<uint16_t>(items.size()));
+    if (items.empty()) {
+        return writer.take();
+    }
+    writer.writeUInt8(2);
+    uint16_t offset = 1;
+    writer.writeUInt16(offset);
+    for (const Bytes& item : items) {
+        offset = static_cast<uint16_t>(offset + item.size());
+        writer.writeUInt16(offset);
+    }
+    for (const Bytes& item : items) {
+        writer.writeBytes(item.data(), item.size());
+    }
+    return writer.take();
+}
+
+// Операнд DICT в пятибайтовой форме, чтобы размер DICT не зависел от значений
+void dictInt(ByteWriter& writer, int32_t value) {
+    writer.writeUInt8(29);
+    writer.writeInt32(value);
+}
+
+/// Минимальный CFF: один шрифт, без charset; смещения Private/Subrs можно подменить
+struct CFFSpec {
+    std::vector<Bytes> charStrings = {{14}};   // endchar
+    std::vector<Bytes> globalSubrs;
+    std::vector<Bytes> localSubrs;
+    int32_t defaultWidthX = 0;
+    int32_t nominalWidthX = 0;
+    std::optional<int32_t> privateSize;
+    std::optional<int32_t> privateOffset;
+    std::optional<int32_t> subrsOffset;
+};
+
+Bytes makeCFF(const CFFSpec& spec) {
+    Bytes names = indexBytes({{'A'}});
+    Bytes strings = indexBytes({});
+    Bytes globalSubrs = indexBytes(spec.globalSubrs);
+    Bytes charStrings = indexBytes(spec.charStrings);
+    Bytes localSubrs = indexBytes(spec.localSubrs);
+
+    // Top DICT: 3 операнда по 5 байт и 2 оператора
+    const size_t topDictSize = 17;
+    const size_t topDictIndexSize = 2 + 1 + 2 * 2 + topDictSize;
+    const size_t charStringsOffset = 4 + names.size() + topDictIndexSize + strings.size() + globalSubrs.size();
+    const size_t privateOffset = charStringsOffset + charStrings.size();
+    const size_t privateSize = spec.localSubrs.empty() ? 12 : 18;
+
+    ByteWriter privateDict;
+    dictInt(privateDict, spec.defaultWidthX);
+    privateDict.writeUInt8(20);
+    dictInt(privateDict, spec.nominalWidthX);
+    privateDict.writeUInt8(21);
+    if (!spec.localSubrs.empty()) {
+        dictInt(privateDict, spec.subrsOffset.value_or(static_cast<int32_t>(privateSize)));
+        privateDict.writeUInt8(19);
+    }
+
+    ByteWriter topDict;
+    dictInt(topDict, static_cast<int32_t>(charStringsOffset));
+    topDict.writeUInt8(17);
+    dictInt(topDict, spec.privateSize.value_or(static_cast<int32_t>(privateSize)));
+    dictInt(topDict, spec.privateOffset.value_or(static_cast<int32_t>(privateOffset)));
+    topDict.writeUInt8(18);
+    Bytes topDicts = indexBytes({topDict.take()});
+    CHECK(topDicts.size() == topDictIndexSize);
+
+    ByteWriter cff;
+    const uint8_t header[] = {1, 0, 4, 2};
+    cff.writeBytes(header, sizeof(header));
+    for (const Bytes* part : {&names, &topDicts, &strings, &globalSubrs, &charStrings}) {
+        cff.writeBytes(part->data(), part->size());
+    }
+    Bytes privateBytes = privateDict.take();
+    CHECK(privateBytes.size() == privateSize);
+    cff.writeBytes(privateBytes.data(), privateBytes.size());
+    if (!spec.localSubrs.empty()) {
+        cff.writeBytes(localSubrs.data(), localSubrs.size());
+    }
+    return cff.take();
+}
+
+// Charstring из операндов (в форме 28, int16) и операторов
+class CharString {
+public:
+    CharString& operator()(std::initializer_list<int> operands, uint8_t op) {
+        for (int operand : operands) {
+            bytes.push_back(28);
+            bytes.push_back(static_cast<uint8_t>((operand >> 8) & 0xFF));
+            bytes.push_back(static_cast<uint8_t>(operand & 0xFF));
+        }
+        bytes.push_back(op);
+        return *this;
+    }
+    operator Bytes() const { return bytes; }
+
+private:
+    Bytes bytes;
+};
+
+const uint8_t HLINETO = 6;
+const uint8_t VLINETO = 7;
+const uint8_t RRCURVETO = 8;
+const uint8_t CALLSUBR = 10;
+const uint8_t RETURN = 11;
+const uint8_t ENDCHAR = 14;
+const uint8_t RMOVETO = 21;
+const uint8_t CALLGSUBR = 29;
+// При числе подпрограмм меньше 1240 индекс в charstring смещён на -107
+const int SUBR_BIAS = 107;
+
+bool near(double actual, double expected) {
+    return std::fabs(actual - expected) < 1e-6;
+}
+
+void checkBounds(const CFFGlyphMetrics& metrics, double xMin, double yMin, double xMax, double yMax) {
+    CHECK(!metrics.isEmpty);
+    CHECK(near(metrics.xMin, xMin) && near(metrics.yMin, yMin));
+    CHECK(near(metrics.xMax, xMax) && near(metrics.yMax, yMax));
+}
+
+bool parses(const Bytes& cff) {
+    CFFParser parser{ByteSpan(cff)};
+    return parser.parse();
+}
+
+void testParsesValidFont() {
+    std::cout << "Testing CFF parse of a minimal font..." << std::endl;
+
+    CFFSpec spec;
+    spec.defaultWidthX = 600;
+    spec.localSubrs = {{11}};
+    Bytes cff = makeCFF(spec);
+
+    CFFParser parser{ByteSpan(cff)};
+    bool parsed = parser.parse();
+    CHECK(parsed);
+    CHECK(parser.getCharStrings().size() == 1);
+    CHECK(parser.getPrivateDict(0).defaultWidthX == 600);
+    CHECK(parser.getLocalSubrs(0).size() == 1);
+
+    std::cout << "✓ CFF minimal font test passed" << std::endl;
+}
+
+void testRejectsBadPrivateDict() {
+    std::cout << "Testing CFF Private DICT bounds..." << std::endl;
+
+    CFFSpec negativeSize;
+    negativeSize.privateSize = -1;
+    CHECK(!parses(makeCFF(negativeSize)));
+
+    CFFSpec negativeOffset;
+    negativeOffset.privateOffset = -12;
+    CHECK(!parses(makeCFF(negativeOffset)));
+
+    CFFSpec offsetBeyondTable;
+    offsetBeyondTable.privateOffset = 0x7FFFFFFF;
+    CHECK(!parses(makeCFF(offsetBeyondTable)));
+
+    CFFSpec sizeBeyondTable;
+    sizeBeyondTable.privateSize = 4096;
+    CHECK(!parses(makeCFF(sizeBeyondTable)));
+
+    CFFSpec negativeSubrs;
+    negativeSubrs.localSubrs = {{11}};
+    negativeSubrs.subrsOffset = -100000;
+    CHECK(!parses(makeCFF(negativeSubrs)));
+
+    std::cout << "✓ CFF Private DICT bounds test passed" << std::endl;
+}
+
+void testCharstringBounds() {
+    std::cout << "Testing Type 2 charstring bounds..." << std::endl;
+
+    CFFSpec spec;
+    spec.defaultWidthX = 600;
+    spec.nominalWidthX = 500;
+    spec.charStrings = {
+        // Прямоугольник 300x400 от (100, 200)
+        CharString()({100, 200}, RMOVETO)({300}, HLINETO)({400}, VLINETO)({-300}, HLINETO)({}, ENDCHAR),
+        // Дуга с контрольными точками на высоте 100: экстремум кривой 300 * t * (1 - t) = 75
+        CharString()({0, 0}, RMOVETO)({0, 100, 100, 0, 0, -100}, RRCURVETO)({}, ENDCHAR),
+        // Лишний операнд rmoveto - ширина относительно nominalWidthX
+        CharString()({50, 10, 20}, RMOVETO)({5}, HLINETO)({}, ENDCHAR),
+        CharString()({}, ENDCHAR),
+    };
+    Bytes cff = makeCFF(spec);
+    CFFParser parser{ByteSpan(cff)};
+    bool parsed = parser.parse();
+    CHECK(parsed);
+    CFFCharstringInterpreter interpreter(parser);
+
+    CFFGlyphMetrics rectangle = interpreter.analyzeGlyph(0);
+    checkBounds(rectangle, 100, 200, 400, 600);
+    CHECK(near(rectangle.advanceWidth, 600));
+    CHECK(rectangle.numContours == 1);
+
+    checkBounds(interpreter.analyzeGlyph(1), 0, 0, 100, 75);
+
+    CFFGlyphMetrics withWidth = interpreter.analyzeGlyph(2);
+    checkBounds(withWidth, 10, 20, 15, 20);
+    CHECK(near(withWidth.advanceWidth, 550));
+
+    CFFGlyphMetrics empty = interpreter.analyzeGlyph(3);
+    CHECK(empty.isEmpty);
+    CHECK(near(empty.advanceWidth, 600));
+
+    std::cout << "✓ Type 2 charstring bounds test passed" << std::endl;
+}
+
+void testCharstringSubroutines() {
+    std::cout << "Testing Type 2 charstring subroutines..." << std::endl;
+
+    CFFSpec spec;
+    spec.localSubrs = {CharString()({300}, HLINETO)({400}, VLINETO)({}, RETURN)};
+    spec.globalSubrs = {CharString()({-300}, HLINETO)({}, RETURN)};
+    // Одна и та же подпрограмма из разных точек: закэшированный вклад сдвигается вместе с ней
+    spec.charStrings = {
+        CharString()({100, 200}, RMOVETO)({-SUBR_BIAS}, CALLSUBR)({}, ENDCHAR),
+        CharString()({-50, -60}, RMOVETO)({-SUBR_BIAS}, CALLSUBR)({}, ENDCHAR),
+        CharString()({100, 200}, RMOVETO)({-SUBR_BIAS}, CALLSUBR)({-SUBR_BIAS}, CALLGSUBR)({}, ENDCHAR),
+    };
+    Bytes cff = makeCFF(spec);
+    CFFParser parser{ByteSpan(cff)};
+    bool parsed = parser.parse();
+    CHECK(parsed);
+
+    CFFCharstringInterpreter interpreter(parser);
+    checkBounds(interpreter.analyzeGlyph(0), 100, 200, 400, 600);
+    checkBounds(interpreter.analyzeGlyph(1), -50, -60, 250, 340);
+    checkBounds(interpreter.analyzeGlyph(2), 100, 200, 400, 600);
+    CHECK(interpreter.getCachedSubroutineCount() >= 1);
+
+    // Параллельный анализ с общим кэшем даёт то же
+    CFFCharstringInterpreter shared(parser);
+    ThreadPool pool(4);
+    std::vector<CFFGlyphMetrics> all = shared.analyzeAllGlyphs(&pool);
+    CHECK(all.size() == 3);
+    checkBounds(all[0], 100, 200, 400, 600);
+    checkBounds(all[1], -50, -60, 250, 340);
+    checkBounds(all[2], 100, 200, 400, 600);
+
+    std::cout << "✓ Type 2 charstring subroutines test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testParsesValidFont();
+        testRejectsBadPrivateDict();
+        testCharstringBounds();
+        testCharstringSubroutines();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
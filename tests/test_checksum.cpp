@@ -0,0 +1,79 @@
+#include "TestSupport.h"
+#include "fontmaster/Checksum.h"
+#include <iostream>
+#include <vector>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+// Определение из спецификации: по слову за раз
+uint32_t referenceChecksum(const uint8_t* data, size_t size) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t word = 0;
+        for (size_t j = 0; j < 4; ++j) {
+            word = (word << 8) | (i + j < size ? data[i + j] : 0);
+        }
+        sum += word;
+    }
+    return sum;
+}
+
+std::vector<uint8_t> pseudoRandomBytes(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    uint32_t state = 0x12345678;
+    for (uint8_t& byte : bytes) {
+        state = state * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(state >> 24);
+    }
+    return bytes;
+}
+
+void testKnownValues() {
+    std::cout << "Testing checksum known values..." << std::endl;
+
+    const uint8_t words[] = {0x00, 0x00, 0x00, 0x01, 0xFF, 0xFF, 0xFF, 0xFF};
+    CHECK(tableChecksum(ByteSpan(words, sizeof(words))) == 0);        // 1 + 0xFFFFFFFF по модулю 2^32
+    const uint8_t tail[] = {0x12, 0x34, 0x56, 0x78, 0x9A};
+    CHECK(tableChecksum(ByteSpan(tail, sizeof(tail))) == 0x12345678u + 0x9A000000u);
+    CHECK(tableChecksum(ByteSpan()) == 0);
+
+    std::cout << "✓ Checksum known values test passed" << std::endl;
+}
+
+void testMatchesScalarDefinition() {
+    std::cout << "Testing checksum against the scalar definition..." << std::endl;
+
+    // Длины вокруг границ блоков SIMD и невыровненные начала
+    std::vector<uint8_t> bytes = pseudoRandomBytes(4096 + 64);
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t size = 0; size <= 300; ++size) {
+            ByteSpan span(bytes.data() + offset, size);
+            CHECK(tableChecksum(span) == referenceChecksum(bytes.data() + offset, size));
+        }
+        ByteSpan large(bytes.data() + offset, 4096 + 61);
+        CHECK(tableChecksum(large) == referenceChecksum(bytes.data() + offset, large.size()));
+    }
+
+    // Переполнение сумм во всех дорожках
+    std::vector<uint8_t> ones(1 << 20, 0xFF);
+    CHECK(tableChecksum(ByteSpan(ones)) == referenceChecksum(ones.data(), ones.size()));
+
+    std::cout << "✓ Checksum scalar comparison test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testKnownValues();
+        testMatchesScalarDefinition();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,160 @@
+#include "TestSupport.h"
+#include "fontmaster/FileIO.h"
+#include <filesystem>
+#include <iostream>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+// Свой каталог: после записи в нём не должно остаться временных файлов
+struct TempDirectory {
+    std::filesystem::path path;
+
+    explicit TempDirectory(const std::string& name)
+        : path(std::filesystem::temp_directory_path() / ("fontmaster_test_" + name)) {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directory(path);
+    }
+    ~TempDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+
+    std::string file(const std::string& name) const { return (path / name).string(); }
+
+    size_t entries() const {
+        return static_cast<size_t>(std::distance(std::filesystem::directory_iterator(path),
+                                                 std::filesystem::directory_iterator()));
+    }
+};
+
+std::vector<uint8_t> concat(const std::vector<ByteSpan>& parts) {
+    std::vector<uint8_t> out;
+    for (ByteSpan part : parts) out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
+
+void testWriteReplacesFile() {
+    std::cout << "Testing writeFileAtomic over an existing file..." << std::endl;
+
+    TempDirectory directory("file_io_replace");
+    std::string path = directory.file("font.ttf");
+    test::writeBytes(path, test::bytesOf("old contents that are longer than the new ones"));
+
+    std::vector<uint8_t> first = test::bytesOf("head");
+    std::vector<uint8_t> second = test::bytesOf("");
+    std::vector<uint8_t> third(70000, 0x5A);
+    std::vector<ByteSpan> parts = {ByteSpan(first), ByteSpan(second), ByteSpan(third)};
+    bool written = writeFileAtomic(path, parts);
+    CHECK(written);
+    CHECK(test::readBytes(path) == concat(parts));
+    CHECK(directory.entries() == 1);
+
+    std::cout << "✓ writeFileAtomic replace test passed" << std::endl;
+}
+
+void testWriteCopiesFromSource() {
+    std::cout << "Testing writeFileAtomic with a source file..." << std::endl;
+
+    TempDirectory directory("file_io_source");
+    std::string sourcePath = directory.file("source.ttf");
+    std::string outputPath = directory.file("output.ttf");
+    std::vector<uint8_t> original(200000);
+    for (size_t i = 0; i < original.size(); ++i) original[i] = static_cast<uint8_t>(i * 31 + i / 251);
+    test::writeBytes(sourcePath, original);
+
+    std::vector<uint8_t> contents;
+    FileStamp stamp;
+    bool read = readFile(sourcePath, contents, &stamp);
+    CHECK(read && stamp.valid && contents == original);
+    SourceFile source{sourcePath, stamp, ByteSpan(contents)};
+
+    // Куски исходного файла вперемешку с новыми данными, в том числе не по границам страниц
+    std::vector<uint8_t> inserted = test::bytesOf("inserted");
+    ByteSpan all(contents);
+    std::vector<ByteSpan> parts = {all.subspan(4097, 90000), ByteSpan(inserted), all.subspan(0, 12),
+                                   all.subspan(150001, 49999)};
+    bool written = writeFileAtomic(outputPath, parts, &source);
+    CHECK(written);
+    CHECK(test::readBytes(outputPath) == concat(parts));
+
+    // Источник переписан после чтения: куски берутся из памяти, а не из нового файла
+    test::writeBytes(sourcePath, std::vector<uint8_t>(original.size() + 1, 0));
+    written = writeFileAtomic(outputPath, parts, &source);
+    CHECK(written);
+    CHECK(test::readBytes(outputPath) == concat(parts));
+    CHECK(directory.entries() == 2);
+
+    std::cout << "✓ writeFileAtomic source test passed" << std::endl;
+}
+
+void testFailedWriteLeavesNoTrace() {
+    std::cout << "Testing failed writeFileAtomic..." << std::endl;
+
+    TempDirectory directory("file_io_failure");
+    std::filesystem::create_directory(directory.path / "taken");
+    test::writeBytes(directory.file("taken/keep"), test::bytesOf("keep"));
+
+    // Файл не может заменить каталог; временный файл удаляется
+    std::vector<uint8_t> data = test::bytesOf("data");
+    bool written = writeFileAtomic(directory.file("taken"), {ByteSpan(data)});
+    CHECK(!written);
+    CHECK(std::filesystem::is_directory(directory.path / "taken"));
+    CHECK(directory.entries() == 1);
+
+    written = writeFileAtomic(directory.file("missing/font.ttf"), {ByteSpan(data)});
+    CHECK(!written);
+
+    std::cout << "✓ Failed writeFileAtomic test passed" << std::endl;
+}
+
+void testPatchFile() {
+    std::cout << "Testing patchFile..." << std::endl;
+
+    TempDirectory directory("file_io_patch");
+    std::string path = directory.file("font.ttf");
+    test::writeBytes(path, std::vector<uint8_t>(1000, 0x11));
+
+    std::vector<uint8_t> contents;
+    FileStamp stamp;
+    bool read = readFile(path, contents, &stamp);
+    CHECK(read);
+    SourceFile source{path, stamp, ByteSpan(contents)};
+
+    std::vector<uint8_t> first = test::bytesOf("AB");
+    std::vector<uint8_t> second = test::bytesOf("xyz");
+    bool patched = patchFile(source, {{0, ByteSpan(first)}, {997, ByteSpan(second)}});
+    CHECK(patched);
+    std::vector<uint8_t> expected(1000, 0x11);
+    std::copy(first.begin(), first.end(), expected.begin());
+    std::copy(second.begin(), second.end(), expected.begin() + 997);
+    CHECK(test::readBytes(path) == expected);
+    CHECK(FileStamp::of(path).inode == stamp.inode);
+
+    // Файл переписан после чтения (размер другой, время изменения может совпасть): не трогаем
+    std::vector<uint8_t> rewritten(1001, 0x22);
+    test::writeBytes(path, rewritten);
+    patched = patchFile(source, {{500, ByteSpan(first)}});
+    CHECK(!patched);
+    CHECK(test::readBytes(path) == rewritten);
+
+    std::cout << "✓ patchFile test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testWriteReplacesFile();
+        testWriteCopiesFromSource();
+        testFailedWriteLeavesNoTrace();
+        testPatchFile();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,150 @@
+#include "TestSupport.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/Checksum.h"
+#include "fontmaster/FileIO.h"
+#include "fontmaster/FontAssembler.h"
+#include <iostream>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+const uint32_t CHECKSUM_MAGIC = 0xB1B0AFBA;
+
+std::vector<uint8_t> filled(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) data[i] = static_cast<uint8_t>(seed + i * 7);
+    return data;
+}
+
+// head из 54 байт: checkSumAdjustment по смещению 8 заполняет сборщик
+std::vector<uint8_t> makeHead() {
+    std::vector<uint8_t> head = filled(54, 3);
+    storeUInt32(head.data() + 8, 0);
+    return head;
+}
+
+struct Tables {
+    std::vector<uint8_t> head = makeHead();
+    std::vector<uint8_t> glyf = filled(64 * 1024, 11);
+    std::vector<uint8_t> name = filled(37, 29);   // длина не кратна 4
+};
+
+FontAssembler makeAssembler(const Tables& tables) {
+    FontAssembler assembler;
+    assembler.addTable("name", ByteSpan(tables.name));
+    assembler.addTable("head", ByteSpan(tables.head));
+    assembler.addTable("glyf", ByteSpan(tables.glyf));
+    return assembler;
+}
+
+void testLayout() {
+    std::cout << "Testing FontAssembler layout..." << std::endl;
+
+    Tables tables;
+    FontAssembler assembler = makeAssembler(tables);
+    std::vector<uint8_t> font = assembler.assemble();
+    ByteSpan file(font);
+    CHECK(font.size() == assembler.size());
+    CHECK(file.readUInt16(4) == 3);
+
+    // Директория отсортирована по тегу, таблицы выровнены по 4 и лежат без пересечений
+    const char* expected[] = {"glyf", "head", "name"};
+    const std::vector<uint8_t>* data[] = {&tables.glyf, &tables.head, &tables.name};
+    for (size_t i = 0; i < 3; ++i) {
+        size_t record = 12 + i * 16;
+        CHECK(std::string(reinterpret_cast<const char*>(font.data() + record), 4) == expected[i]);
+        uint32_t offset = file.readUInt32(record + 8);
+        uint32_t length = file.readUInt32(record + 12);
+        CHECK(offset % 4 == 0);
+        CHECK(length == data[i]->size());
+        if (i != 1) {
+            CHECK(std::equal(data[i]->begin(), data[i]->end(), font.begin() + offset));
+            CHECK(file.readUInt32(record + 4) == tableChecksum(*data[i]));
+        }
+    }
+
+    // checkSumAdjustment сводит сумму файла к магическому числу
+    CHECK(tableChecksum(file) == CHECKSUM_MAGIC);
+
+    std::vector<uint8_t> joined;
+    for (ByteSpan slice : assembler.slices()) joined.insert(joined.end(), slice.begin(), slice.end());
+    CHECK(joined == font);
+
+    std::cout << "✓ FontAssembler layout test passed" << std::endl;
+}
+
+SourceFile writeSource(const test::TempFile& file, const std::vector<uint8_t>& font, std::vector<uint8_t>& contents) {
+    test::writeBytes(file.path, font);
+    FileStamp stamp;
+    bool read = readFile(file.path, contents, &stamp);
+    CHECK(read);
+    return SourceFile{file.path, stamp, contents};
+}
+
+void testPatchSmallEdit() {
+    std::cout << "Testing FontAssembler::patchFile small edit..." << std::endl;
+
+    test::TempFile file("assembler_patch.ttf");
+    Tables tables;
+    std::vector<uint8_t> contents;
+    SourceFile source = writeSource(file, makeAssembler(tables).assemble(), contents);
+    uint64_t inode = source.stamp.inode;
+
+    // Таблица той же длины с другими байтами в середине: переписывается только участок
+    Tables edited = tables;
+    edited.glyf[30000] ^= 0xFF;
+    edited.name[5] ^= 0x55;
+    FontAssembler assembler = makeAssembler(edited);
+    bool patched = assembler.patchFile(source);
+    CHECK(patched);
+
+    std::vector<uint8_t> result = test::readBytes(file.path);
+    CHECK(result == makeAssembler(edited).assemble());
+    CHECK(tableChecksum(result) == CHECKSUM_MAGIC);
+    CHECK(FileStamp::of(file.path).inode == inode);
+
+    std::cout << "✓ FontAssembler::patchFile small edit test passed" << std::endl;
+}
+
+void testPatchRefusesLargeOrGrowingEdits() {
+    std::cout << "Testing FontAssembler::patchFile limits..." << std::endl;
+
+    test::TempFile file("assembler_patch_limits.ttf");
+    Tables tables;
+    std::vector<uint8_t> original = makeAssembler(tables).assemble();
+    std::vector<uint8_t> contents;
+    SourceFile source = writeSource(file, original, contents);
+
+    // Переписать пришлось бы больше четверти файла - нужна атомарная запись
+    Tables rewritten = tables;
+    rewritten.glyf = filled(tables.glyf.size(), 101);
+    bool patched = makeAssembler(rewritten).patchFile(source);
+    CHECK(!patched);
+    CHECK(test::readBytes(file.path) == original);
+
+    // Таблица выросла и не помещается на старое место
+    Tables grown = tables;
+    grown.name.resize(grown.name.size() + 16, 1);
+    patched = makeAssembler(grown).patchFile(source);
+    CHECK(!patched);
+    CHECK(test::readBytes(file.path) == original);
+
+    std::cout << "✓ FontAssembler::patchFile limits test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testLayout();
+        testPatchSmallEdit();
+        testPatchRefusesLargeOrGrowingEdits();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
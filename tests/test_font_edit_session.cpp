@@ -0,0 +1,140 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/FontEditSession.h"
+#include "fontmaster/FontMaster.h"
+#include <iostream>
+
+using namespace fontmaster;
+
+namespace {
+
+const uint16_t NUM_GLYPHS = 16;
+
+// Имена и данные изображений всех глифов: по ним сравнивается состояние шрифта
+std::vector<std::pair<std::string, std::vector<uint8_t>>> snapshot(const Font& font) {
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> glyphs;
+    for (const GlyphInfo& info : font.listGlyphs()) {
+        glyphs.emplace_back(info.name, font.getGlyphInfo(info.name).image_data);
+    }
+    return glyphs;
+}
+
+void testFailedEditRollsBack() {
+    std::cout << "Testing edit session rollback..." << std::endl;
+
+    test::TempFile source("edit_session_source.ttf");
+    test::TempFile output("edit_session_output.ttf");
+    test::writeBytes(source.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC));
+
+    auto font = Font::load(source.path);
+    auto before = snapshot(*font);
+    CHECK(before.size() >= 3);
+
+    // Первые две правки проходят, третью CBDT отвергает: изображение не PNG
+    FontEditSession session(*font);
+    session.replace(GlyphSelector::byName(before[0].first), test::pngHeader(20, 20));
+    session.remove(GlyphSelector::byName(before[1].first));
+    session.replace(GlyphSelector::byName(before[2].first), test::bytesOf("not an image"));
+    CHECK(session.validate().empty());
+
+    bool failed = false;
+    try {
+        session.commit(output.path);
+    } catch (const FontException& e) {
+        failed = true;
+        std::string message = e.what();
+        CHECK(message.find("Edit 3 (replace " + before[2].first + ")") != std::string::npos);
+        CHECK(message.find("'" + before[2].first + "'") != std::string::npos);
+    }
+    CHECK(failed);
+    CHECK(snapshot(*font) == before);
+
+    // После отката шрифт правится и сохраняется как обычно
+    session.clear();
+    session.remove(GlyphSelector::byName(before[1].first));
+    size_t edited = session.commit(output.path);
+    CHECK(edited == 1);
+    auto reloaded = Font::load(output.path);
+    CHECK(reloaded->listGlyphs().size() == before.size() - 1);
+
+    std::cout << "✓ Edit session rollback test passed" << std::endl;
+}
+
+void testFailedSaveRollsBack() {
+    std::cout << "Testing edit session rollback after a failed save..." << std::endl;
+
+    test::TempFile source("edit_session_save_source.ttf");
+    test::TempFile output("edit_session_save_output.ttf");
+    test::writeBytes(source.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::CBDT_CBLC));
+
+    auto font = Font::load(source.path);
+    auto before = snapshot(*font);
+
+    FontEditSession session(*font);
+    session.replace(GlyphSelector::byName(before[0].first), test::pngHeader(20, 20));
+    session.remove(GlyphSelector::byName(before[1].first));
+
+    // Каталога нет: правки применяются, а сохранение падает
+    bool failed = false;
+    try {
+        session.commit(output.path + ".missing/font.ttf");
+    } catch (const FontSaveException& e) {
+        failed = true;
+        CHECK(std::string(e.what()).find("edits were rolled back") != std::string::npos);
+    }
+    CHECK(failed);
+    CHECK(snapshot(*font) == before);
+    CHECK(session.size() == 2);
+
+    // Операции не потеряны: повторный commit применяет их заново
+    size_t edited = session.commit(output.path);
+    CHECK(edited == 2);
+    CHECK(session.empty());
+    auto reloaded = Font::load(output.path);
+    CHECK(reloaded->listGlyphs().size() == before.size() - 1);
+    CHECK(reloaded->getGlyphInfo(before[0].first).width == 20);
+
+    std::cout << "✓ Edit session save rollback test passed" << std::endl;
+}
+
+void testGlyphEditStateRoundTrip() {
+    std::cout << "Testing sbix glyph edit state..." << std::endl;
+
+    test::TempFile source("edit_state_sbix.ttf");
+    test::writeBytes(source.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::SBIX));
+
+    auto font = Font::load(source.path);
+    auto before = snapshot(*font);
+    const std::string& replacedName = before[0].first;
+    const std::string& removedName = before[1].first;
+
+    auto replacedState = font->saveGlyphEditState(replacedName);
+    auto removedState = font->saveGlyphEditState(removedName);
+    bool replaced = font->replaceGlyphImage(replacedName, test::pngHeader(32, 32));
+    bool removed = font->removeGlyph(removedName);
+    CHECK(replaced && removed);
+    CHECK(font->listGlyphs().size() == before.size() - 1);
+    CHECK(font->getGlyphInfo(replacedName).width == 32);
+
+    font->restoreGlyphEditState(*removedState);
+    font->restoreGlyphEditState(*replacedState);
+    CHECK(snapshot(*font) == before);
+    CHECK(font->getGlyphInfo(replacedName).width == 16);
+
+    std::cout << "✓ sbix glyph edit state test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testFailedEditRollsBack();
+        testFailedSaveRollsBack();
+        testGlyphEditStateRoundTrip();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,91 @@
+#include "TestSupport.h"
+#include "fontmaster/ImageHeader.h"
+#include <iostream>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+// Минимальный TIFF: заголовок и IFD с ImageWidth (LONG), ImageLength (SHORT) и SamplesPerPixel
+std::vector<uint8_t> makeTIFF(bool littleEndian, uint32_t width, uint16_t height) {
+    std::vector<uint8_t> tiff;
+    auto put16 = [&](uint16_t value) {
+        uint8_t hi = static_cast<uint8_t>(value >> 8), lo = static_cast<uint8_t>(value);
+        tiff.insert(tiff.end(), littleEndian ? std::initializer_list<uint8_t>{lo, hi}
+                                             : std::initializer_list<uint8_t>{hi, lo});
+    };
+    auto put32 = [&](uint32_t value) {
+        if (littleEndian) {
+            put16(static_cast<uint16_t>(value));
+            put16(static_cast<uint16_t>(value >> 16));
+        } else {
+            put16(static_cast<uint16_t>(value >> 16));
+            put16(static_cast<uint16_t>(value));
+        }
+    };
+
+    tiff.push_back(littleEndian ? 'I' : 'M');
+    tiff.push_back(littleEndian ? 'I' : 'M');
+    put16(42);
+    put32(8);
+    put16(3);
+    put16(256); put16(4); put32(1); put32(width);
+    put16(257); put16(3); put32(1); put16(height); put16(0);
+    put16(277); put16(3); put32(1); put16(4); put16(0);
+    put32(0);
+    return tiff;
+}
+
+void testPNGAndJPEG() {
+    std::cout << "Testing PNG/JPEG header probe..." << std::endl;
+
+    ImageHeader png = probeImageHeader(test::pngHeader(300, 200));
+    CHECK(png.format == "png");
+    CHECK(png.width == 300 && png.height == 200);
+    CHECK(png.bitDepth == 8 && png.channels == 4);
+
+    // SOI, APP0 из 4 байт, SOF0: P=8, Y=0x0102, X=0x0304, Nf=3
+    const std::vector<uint8_t> jpeg = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x04, 0x00, 0x00,
+                                       0xFF, 0xC0, 0x00, 0x11, 0x08, 0x01, 0x02, 0x03, 0x04, 0x03};
+    ImageHeader jpg = probeImageHeader(jpeg);
+    CHECK(jpg.format == "jpg");
+    CHECK(jpg.width == 0x0304 && jpg.height == 0x0102);
+    CHECK(jpg.bitDepth == 8 && jpg.channels == 3);
+
+    std::cout << "✓ PNG/JPEG header probe test passed" << std::endl;
+}
+
+void testTIFFByteOrders() {
+    std::cout << "Testing TIFF header probe..." << std::endl;
+
+    for (bool littleEndian : {true, false}) {
+        ImageHeader header = probeImageHeader(makeTIFF(littleEndian, 70000, 513));
+        CHECK(header.format == "tiff");
+        CHECK(header.width == 70000 && header.height == 513);
+        CHECK(header.bitDepth == 1 && header.channels == 4);
+    }
+
+    // Обрезанный IFD: формат распознан, размеры нулевые
+    std::vector<uint8_t> truncated = makeTIFF(true, 64, 64);
+    truncated.resize(14);
+    ImageHeader broken = probeImageHeader(truncated);
+    CHECK(broken.format == "tiff");
+    CHECK(broken.width == 0 && broken.height == 0);
+
+    std::cout << "✓ TIFF header probe test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testPNGAndJPEG();
+        testTIFFByteOrders();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
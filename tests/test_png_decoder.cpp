@@ -0,0 +1,322 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/PNGDecoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+void putUInt32(Bytes& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+void putChunk(Bytes& png, const char* type, const Bytes& data) {
+    putUInt32(png, static_cast<uint32_t>(data.size()));
+    size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    putUInt32(png, crc32(png.data() + start, png.size() - start));
+}
+
+// zlib-поток из несжатых блоков deflate: сжатие декодеру не важно, важны фильтры и раскладка
+Bytes zlibStored(const Bytes& data) {
+    Bytes out = {0x78, 0x01};
+    size_t pos = 0;
+    do {
+        size_t length = std::min<size_t>(data.size() - pos, 0xFFFF);
+        bool last = pos + length == data.size();
+        out.push_back(last ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(length));
+        out.push_back(static_cast<uint8_t>(length >> 8));
+        out.push_back(static_cast<uint8_t>(~length));
+        out.push_back(static_cast<uint8_t>(~length >> 8));
+        out.insert(out.end(), data.begin() + pos, data.begin() + pos + length);
+        pos += length;
+    } while (pos < data.size());
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putUInt32(out, (b << 16) | a);
+    return out;
+}
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Прямое применение фильтра к строке: декодер должен восстановить row
+Bytes filterRow(uint8_t filter, const Bytes& row, const Bytes& previous, size_t bytesPerPixel) {
+    Bytes out = {filter};
+    for (size_t i = 0; i < row.size(); ++i) {
+        int left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+        int up = previous.empty() ? 0 : previous[i];
+        int upLeft = previous.empty() || i < bytesPerPixel ? 0 : previous[i - bytesPerPixel];
+        int predictor = 0;
+        switch (filter) {
+            case 1: predictor = left; break;
+            case 2: predictor = up; break;
+            case 3: predictor = (left + up) / 2; break;
+            case 4: predictor = paeth(left, up, upLeft); break;
+        }
+        out.push_back(static_cast<uint8_t>(row[i] - predictor));
+    }
+    return out;
+}
+
+struct PNGSpec {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 8;
+    uint8_t colorType = 6;
+    bool interlace = false;
+    Bytes palette;
+    Bytes transparency;
+    size_t idatChunks = 1;
+};
+
+Bytes encodePNG(const PNGSpec& spec, const Bytes& filtered) {
+    Bytes png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    Bytes header;
+    putUInt32(header, spec.width);
+    putUInt32(header, spec.height);
+    header.push_back(spec.bitDepth);
+    header.push_back(spec.colorType);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(spec.interlace ? 1 : 0);
+    putChunk(png, "IHDR", header);
+    if (!spec.palette.empty()) putChunk(png, "PLTE", spec.palette);
+    if (!spec.transparency.empty()) putChunk(png, "tRNS", spec.transparency);
+    // Поток можно резать на IDAT где угодно
+    Bytes stream = zlibStored(filtered);
+    size_t step = stream.size() / spec.idatChunks + 1;
+    for (size_t pos = 0; pos < stream.size(); pos += step) {
+        putChunk(png, "IDAT", Bytes(stream.begin() + pos, stream.begin() + std::min(stream.size(), pos + step)));
+    }
+    putChunk(png, "IEND", {});
+    return png;
+}
+
+Bytes pseudoRandomBytes(size_t size, uint32_t seed) {
+    Bytes bytes(size);
+    for (uint8_t& byte : bytes) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return bytes;
+}
+
+// Строки изображения с фильтрами 0-4 по очереди
+Bytes filterImage(const Bytes& pixels, uint32_t width, uint32_t height, size_t bytesPerPixel) {
+    Bytes filtered;
+    Bytes previous;
+    size_t stride = width * bytesPerPixel;
+    for (uint32_t y = 0; y < height; ++y) {
+        Bytes row(pixels.begin() + y * stride, pixels.begin() + (y + 1) * stride);
+        Bytes line = filterRow(static_cast<uint8_t>(y % 5), row, previous, bytesPerPixel);
+        filtered.insert(filtered.end(), line.begin(), line.end());
+        previous = row;
+    }
+    return filtered;
+}
+
+void testTrueColorFilters() {
+    std::cout << "Testing PNG filters for RGBA and RGB..." << std::endl;
+
+    // Ширины вокруг 16-байтовых блоков SIMD; все пять фильтров в каждом изображении
+    for (uint32_t width : {1u, 2u, 3u, 5u, 8u, 17u, 33u}) {
+        const uint32_t height = 10;
+
+        PNGSpec rgba;
+        rgba.width = width;
+        rgba.height = height;
+        Bytes pixels = pseudoRandomBytes(width * height * 4, width);
+        RGBAImage decoded = decodePNG(ByteSpan(encodePNG(rgba, filterImage(pixels, width, height, 4))));
+        CHECK(decoded.width == width && decoded.height == height);
+        CHECK(decoded.pixels == pixels);
+
+        PNGSpec rgb = rgba;
+        rgb.colorType = 2;
+        rgb.idatChunks = 3;
+        Bytes colors = pseudoRandomBytes(width * height * 3, width + 100);
+        decoded = decodePNG(ByteSpan(encodePNG(rgb, filterImage(colors, width, height, 3))));
+        for (size_t i = 0; i < size_t(width) * height; ++i) {
+            for (size_t c = 0; c < 3; ++c) CHECK(decoded.pixels[i * 4 + c] == colors[i * 3 + c]);
+            CHECK(decoded.pixels[i * 4 + 3] == 255);
+        }
+    }
+
+    std::cout << "✓ PNG filter test passed" << std::endl;
+}
+
+void testPaletteWithTransparency() {
+    std::cout << "Testing PNG palette with tRNS..." << std::endl;
+
+    // 4 бита на пиксель, 5 пикселей в строке: последний байт строки заполнен наполовину
+    PNGSpec spec;
+    spec.width = 5;
+    spec.height = 2;
+    spec.bitDepth = 4;
+    spec.colorType = 3;
+    spec.palette = {255, 0, 0, 0, 255, 0, 0, 0, 255};
+    spec.transparency = {0};                      // только у первого цвета
+    const uint8_t indexes[2][5] = {{0, 1, 2, 1, 0}, {2, 2, 1, 0, 1}};
+    Bytes filtered;
+    for (const auto& row : indexes) {
+        filtered.push_back(0);
+        filtered.push_back(static_cast<uint8_t>(row[0] << 4 | row[1]));
+        filtered.push_back(static_cast<uint8_t>(row[2] << 4 | row[3]));
+        filtered.push_back(static_cast<uint8_t>(row[4] << 4));
+    }
+
+    RGBAImage decoded = decodePNG(ByteSpan(encodePNG(spec, filtered)));
+    CHECK(decoded.width == 5 && decoded.height == 2);
+    for (size_t y = 0; y < 2; ++y) {
+        for (size_t x = 0; x < 5; ++x) {
+            const uint8_t* pixel = &decoded.pixels[(y * 5 + x) * 4];
+            uint8_t index = indexes[y][x];
+            for (size_t c = 0; c < 3; ++c) CHECK(pixel[c] == spec.palette[index * 3 + c]);
+            CHECK(pixel[3] == (index == 0 ? 0 : 255));
+        }
+    }
+
+    std::cout << "✓ PNG palette test passed" << std::endl;
+}
+
+void testAdam7() {
+    std::cout << "Testing PNG Adam7 interlacing..." << std::endl;
+
+    static const uint32_t PASSES[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+                                          {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    for (uint32_t size : {1u, 3u, 9u, 13u}) {
+        PNGSpec spec;
+        spec.width = size;
+        spec.height = size + 2;
+        spec.interlace = true;
+        Bytes pixels = pseudoRandomBytes(spec.width * spec.height * 4, size);
+
+        // Каждый проход - отдельное изображение со своими строками и фильтрами; пустые пропускаются
+        Bytes filtered;
+        for (const auto& pass : PASSES) {
+            Bytes reduced;
+            uint32_t passWidth = 0, passHeight = 0;
+            for (uint32_t y = pass[1]; y < spec.height; y += pass[3], ++passHeight) {
+                passWidth = 0;
+                for (uint32_t x = pass[0]; x < spec.width; x += pass[2], ++passWidth) {
+                    const uint8_t* pixel = &pixels[(y * spec.width + x) * 4];
+                    reduced.insert(reduced.end(), pixel, pixel + 4);
+                }
+            }
+            if (passWidth == 0 || passHeight == 0) continue;
+            Bytes lines = filterImage(reduced, passWidth, passHeight, 4);
+            filtered.insert(filtered.end(), lines.begin(), lines.end());
+        }
+
+        RGBAImage decoded = decodePNG(ByteSpan(encodePNG(spec, filtered)));
+        CHECK(decoded.pixels == pixels);
+    }
+
+    std::cout << "✓ PNG Adam7 test passed" << std::endl;
+}
+
+void testRejectsBrokenData() {
+    std::cout << "Testing PNG errors..." << std::endl;
+
+    PNGSpec spec;
+    spec.width = 4;
+    spec.height = 4;
+    Bytes pixels = pseudoRandomBytes(4 * 4 * 4, 7);
+    Bytes png = encodePNG(spec, filterImage(pixels, 4, 4, 4));
+    PNGInfo info = readPNGInfo(ByteSpan(png));
+    CHECK(info.width == 4 && info.height == 4 && info.colorType == 6 && info.bitDepth == 8);
+
+    auto throws = [](const Bytes& data, size_t maxPixels) {
+        try {
+            decodePNG(ByteSpan(data), maxPixels);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(throws(Bytes(png.begin(), png.begin() + png.size() / 2), 1 << 20));
+    CHECK(throws(png, 15));                                  // 16 пикселей больше предела
+    Bytes badFilter = filterImage(pixels, 4, 4, 4);
+    badFilter[0] = 5;
+    CHECK(throws(encodePNG(spec, badFilter), 1 << 20));
+    Bytes notPNG = png;
+    notPNG[1] = 'X';
+    CHECK(!isPNGData(ByteSpan(notPNG)));
+    CHECK(throws(notPNG, 1 << 20));
+
+    std::cout << "✓ PNG error test passed" << std::endl;
+}
+
+void testDecodedGlyphCacheFollowsEdits() {
+    std::cout << "Testing decoded glyph cache across edits..." << std::endl;
+
+    test::TempFile file("decoded_cache.ttf");
+    test::writeBytes(file.path, bench::makeSyntheticFont(16, bench::ColorTables::CBDT_CBLC));
+    auto font = Font::load(file.path);
+    GlyphInfo glyph = font->listGlyphs().front();
+
+    PNGSpec spec;
+    spec.width = 3;
+    spec.height = 2;
+    Bytes first = pseudoRandomBytes(3 * 2 * 4, 11);
+    Bytes second = pseudoRandomBytes(3 * 2 * 4, 12);
+    bool replaced = font->replaceGlyphImage(glyph.name, encodePNG(spec, filterImage(first, 3, 2, 4)));
+    CHECK(replaced);
+
+    // Повторное чтение без правок берётся из кэша
+    auto decoded = font->decodeGlyph(glyph.glyph_id);
+    CHECK(decoded->pixels == first);
+    CHECK(font->decodeGlyph(glyph.glyph_id) == decoded);
+
+    // Правка меняет поколение шрифта: старое изображение больше не находится
+    replaced = font->replaceGlyphImage(glyph.name, encodePNG(spec, filterImage(second, 3, 2, 4)));
+    CHECK(replaced);
+    auto redecoded = font->decodeGlyph(glyph.glyph_id);
+    CHECK(redecoded->pixels == second);
+    CHECK(decoded->pixels == first);
+
+    std::cout << "✓ Decoded glyph cache test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testTrueColorFilters();
+        testPaletteWithTransparency();
+        testAdam7();
+        testRejectsBrokenData();
+        testDecodedGlyphCacheFollowsEdits();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
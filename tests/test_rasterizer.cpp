@@ -0,0 +1,198 @@
+#include "TestSupport.h"
+#include "fontmaster/Rasterizer.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace fontmaster;
+using namespace fontmaster::utils;
+
+namespace {
+
+// Ширина не кратна 4: хвост строки проходит скалярной веткой
+const uint32_t WIDTH = 13;
+const uint32_t HEIGHT = 9;
+
+std::vector<uint8_t> resolve(Rasterizer& rasterizer) {
+    std::vector<uint8_t> coverage(rasterizer.getWidth() * rasterizer.getHeight(), 0xAA);
+    rasterizer.resolve(coverage.data());
+    return coverage;
+}
+
+void drawRectangle(Rasterizer& rasterizer, float x0, float y0, float x1, float y1, bool clockwise) {
+    if (clockwise) {
+        rasterizer.drawLine(x0, y0, x1, y0);
+        rasterizer.drawLine(x1, y0, x1, y1);
+        rasterizer.drawLine(x1, y1, x0, y1);
+        rasterizer.drawLine(x0, y1, x0, y0);
+    } else {
+        rasterizer.drawLine(x0, y0, x0, y1);
+        rasterizer.drawLine(x0, y1, x1, y1);
+        rasterizer.drawLine(x1, y1, x1, y0);
+        rasterizer.drawLine(x1, y0, x0, y0);
+    }
+}
+
+size_t coverageSum(const std::vector<uint8_t>& coverage) {
+    size_t sum = 0;
+    for (uint8_t value : coverage) sum += value;
+    return sum;
+}
+
+void testAlignedRectangle() {
+    std::cout << "Testing rasterizer on a pixel-aligned rectangle..." << std::endl;
+
+    Rasterizer rasterizer(WIDTH, HEIGHT);
+    for (bool clockwise : {true, false}) {
+        drawRectangle(rasterizer, 2, 1, 11, 7, clockwise);
+        std::vector<uint8_t> coverage = resolve(rasterizer);
+        for (uint32_t y = 0; y < HEIGHT; ++y) {
+            for (uint32_t x = 0; x < WIDTH; ++x) {
+                bool inside = x >= 2 && x < 11 && y >= 1 && y < 7;
+                CHECK(coverage[y * WIDTH + x] == (inside ? 255 : 0));
+            }
+        }
+    }
+
+    // resolve очищает накопление: следующий кадр пустой
+    std::vector<uint8_t> empty = resolve(rasterizer);
+    CHECK(coverageSum(empty) == 0);
+
+    // Перекрытие контуров одного направления не даёт больше 255
+    drawRectangle(rasterizer, 0, 0, 8, 8, true);
+    drawRectangle(rasterizer, 4, 4, 12, 9, true);
+    std::vector<uint8_t> overlapped = resolve(rasterizer);
+    CHECK(overlapped[5 * WIDTH + 5] == 255);
+    CHECK(overlapped[8 * WIDTH + 2] == 0);
+
+    std::cout << "✓ Aligned rectangle test passed" << std::endl;
+}
+
+void testPartialCoverage() {
+    std::cout << "Testing rasterizer partial coverage..." << std::endl;
+
+    // Края на середине пикселя: половинное покрытие
+    Rasterizer rasterizer(WIDTH, HEIGHT);
+    drawRectangle(rasterizer, 1.5f, 2, 9.5f, 5, true);
+    std::vector<uint8_t> coverage = resolve(rasterizer);
+    for (uint32_t y = 2; y < 5; ++y) {
+        CHECK(std::abs(coverage[y * WIDTH + 1] - 128) <= 1);
+        for (uint32_t x = 2; x < 9; ++x) CHECK(coverage[y * WIDTH + x] == 255);
+        CHECK(std::abs(coverage[y * WIDTH + 9] - 128) <= 1);
+        CHECK(coverage[y * WIDTH + 10] == 0);
+    }
+
+    // Треугольник: сумма покрытия равна площади
+    rasterizer.drawLine(1, 1, 12, 2.5f);
+    rasterizer.drawLine(12, 2.5f, 4.25f, 8.75f);
+    rasterizer.drawLine(4.25f, 8.75f, 1, 1);
+    coverage = resolve(rasterizer);
+    double area = std::abs((12 - 1) * (8.75 - 1) - (4.25 - 1) * (2.5 - 1)) / 2;
+    CHECK(std::abs(static_cast<double>(coverageSum(coverage)) - area * 255) < 255 * 0.5);
+
+    // Сегмент параболы - 2/3 треугольника контрольных точек; ломаная из n отрезков теряет 1/n^2 площади
+    rasterizer.drawQuad(1, 8, 6.5f, 0, 12, 8);
+    rasterizer.drawLine(12, 8, 1, 8);
+    coverage = resolve(rasterizer);
+    double curveArea = 2.0 / 3.0 * 11 * 4;
+    CHECK(std::abs(static_cast<double>(coverageSum(coverage)) - curveArea * 255) < curveArea * 255 * 0.04);
+
+    std::cout << "✓ Partial coverage test passed" << std::endl;
+}
+
+void testOutline() {
+    std::cout << "Testing rasterizer TrueType outlines..." << std::endl;
+
+    // Квадрат 0..1000 в единицах шрифта при масштабе 0.008: пиксели 2..10 по x, 1..9 по y
+    GlyphOutline outline;
+    outline.points = {{0, 0, true}, {0, 1000, true}, {1000, 1000, true}, {1000, 0, true}};
+    outline.contourEnds = {3};
+    Rasterizer rasterizer(WIDTH, HEIGHT);
+    rasterizer.addOutline(outline, 0.008f, 2, 9);
+    std::vector<uint8_t> coverage = resolve(rasterizer);
+    for (uint32_t y = 0; y < HEIGHT; ++y) {
+        for (uint32_t x = 0; x < WIDTH; ++x) {
+            bool inside = x >= 2 && x < 10 && y >= 1;
+            CHECK(coverage[y * WIDTH + x] == (inside ? 255 : 0));
+        }
+    }
+
+    // Только off-curve точки: on-curve посередине восстанавливаются, площадь - между ромбом и квадратом
+    outline.points = {{0, 0, false}, {0, 1000, false}, {1000, 1000, false}, {1000, 0, false}};
+    rasterizer.addOutline(outline, 0.008f, 2, 9);
+    size_t sum = coverageSum(resolve(rasterizer));
+    double diamond = 32, square = 64;
+    double rounded = diamond + 4 * (2.0 / 3.0 * 8);
+    CHECK(sum > diamond * 255 && sum < square * 255);
+    CHECK(std::abs(static_cast<double>(sum) - rounded * 255) < rounded * 255 * 0.04);
+
+    std::cout << "✓ Outline test passed" << std::endl;
+}
+
+uint32_t div255(uint32_t value) {
+    return (value + 127) / 255;
+}
+
+void testBlendAndUnpremultiply() {
+    std::cout << "Testing blendSolidColor and unpremultiplyAlpha..." << std::endl;
+
+    // Длина не кратна блокам SIMD; покрытие и фон перебирают значения
+    const size_t count = 67;
+    std::vector<uint8_t> coverage(count);
+    std::vector<uint8_t> background(count * 4);
+    for (size_t i = 0; i < count; ++i) {
+        coverage[i] = static_cast<uint8_t>(i * 37 % 256);
+        if (i % 9 == 4) coverage[i] = 0;
+        uint8_t alpha = static_cast<uint8_t>(i * 53 % 256);
+        for (size_t c = 0; c < 3; ++c) background[i * 4 + c] = static_cast<uint8_t>(alpha * ((i + c) % 5) / 4);
+        background[i * 4 + 3] = alpha;
+    }
+
+    for (uint32_t color : {0xFF8000FFu, 0x20C0F080u, 0x12345600u}) {
+        std::vector<uint8_t> pixels = background;
+        blendSolidColor(pixels.data(), coverage.data(), count, color);
+
+        uint32_t alpha = color & 0xFF;
+        uint32_t source[4] = {div255((color >> 24) * alpha), div255(((color >> 16) & 0xFF) * alpha),
+                              div255(((color >> 8) & 0xFF) * alpha), alpha};
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t sa = div255(alpha * coverage[i]);
+            for (size_t c = 0; c < 4; ++c) {
+                // Целочисленное округление в SIMD-ветках допускает расхождение на единицу
+                int expected = static_cast<int>(div255(source[c] * coverage[i]) +
+                                                div255(background[i * 4 + c] * (255 - sa)));
+                CHECK(std::abs(pixels[i * 4 + c] - expected) <= 1);
+                if (coverage[i] == 0 || alpha == 0) CHECK(pixels[i * 4 + c] == background[i * 4 + c]);
+            }
+        }
+    }
+
+    // Непрозрачный цвет при полном покрытии закрашивает пиксель точно
+    std::vector<uint8_t> pixel = {10, 20, 30, 40};
+    const uint8_t full = 255;
+    blendSolidColor(pixel.data(), &full, 1, 0x112233FFu);
+    CHECK((pixel == std::vector<uint8_t>{0x11, 0x22, 0x33, 0xFF}));
+
+    std::vector<uint8_t> premultiplied = {64, 32, 0, 128, 7, 8, 9, 0, 1, 2, 3, 255, 200, 255, 10, 200};
+    unpremultiplyAlpha(premultiplied.data(), 4);
+    CHECK((premultiplied == std::vector<uint8_t>{128, 64, 0, 128, 7, 8, 9, 0, 1, 2, 3, 255, 255, 255, 13, 200}));
+
+    std::cout << "✓ Blend test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testAlignedRectangle();
+        testPartialCoverage();
+        testOutline();
+        testBlendAndUnpremultiply();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
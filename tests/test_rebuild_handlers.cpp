@@ -0,0 +1,209 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/TTFRebuilder.h"
+#include "fontmaster/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace fontmaster;
+
+namespace {
+
+class TestRebuilder : public TTFRebuilder {
+public:
+    using TTFRebuilder::TTFRebuilder;
+    std::vector<uint8_t> rebuild() override { return assembleTables().assemble(); }
+};
+
+// Сколько обработчиков выполняется одновременно и в каком порядке они стартовали
+struct StageProbe {
+    std::atomic<int> active{0};
+    std::atomic<int> maxActive{0};
+    std::mutex mutex;
+    std::vector<std::string> started;
+
+    std::function<void(const std::string&)> handler() {
+        return [this](const std::string& tag) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                started.push_back(tag);
+            }
+            int now = ++active;
+            int seen = maxActive.load();
+            while (now > seen && !maxActive.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            --active;
+        };
+    }
+};
+
+void testUndeclaredHandlerRunsAlone() {
+    std::cout << "Testing rebuild handler without dependencies..." << std::endl;
+
+    std::vector<uint8_t> font = bench::makeSyntheticFont(16, bench::ColorTables::SBIX);
+    utils::ThreadPool pool(4);
+    StageProbe probe;
+
+    TestRebuilder rebuilder(font);
+    rebuilder.setThreadPool(&pool);
+    // cmap и sbix не пересекаются по объявленным данным, но у sbix объявлений нет
+    rebuilder.setTableRebuildHandler("cmap", probe.handler(), {"cmap"}, {"cmap"});
+    rebuilder.setTableRebuildHandler("sbix", probe.handler());
+    rebuilder.markTableModified("cmap");
+    rebuilder.markTableModified("sbix");
+    rebuilder.markTableModified("glyf");
+    rebuilder.rebuild();
+
+    CHECK(probe.started.size() == 2);
+    CHECK(probe.maxActive.load() == 1);
+
+    std::cout << "✓ Rebuild handler without dependencies test passed" << std::endl;
+}
+
+void testDeclaredHandlersMayOverlap() {
+    std::cout << "Testing rebuild handlers with dependencies..." << std::endl;
+
+    std::vector<uint8_t> font = bench::makeSyntheticFont(16, bench::ColorTables::SBIX);
+    utils::ThreadPool pool(4);
+    StageProbe probe;
+
+    // Объявленные независимые этапы в графе не связаны; оба должны выполниться
+    TestRebuilder rebuilder(font);
+    rebuilder.setThreadPool(&pool);
+    rebuilder.setTableRebuildHandler("cmap", probe.handler(), {"cmap"}, {"cmap"});
+    rebuilder.setTableRebuildHandler("sbix", probe.handler(), {"sbix"}, {"sbix"});
+    rebuilder.markTableModified("cmap");
+    rebuilder.markTableModified("sbix");
+    std::vector<uint8_t> rebuilt = rebuilder.rebuild();
+
+    CHECK(probe.started.size() == 2);
+    CHECK(rebuilt.size() == font.size());
+
+    std::cout << "✓ Rebuild handlers with dependencies test passed" << std::endl;
+}
+
+void testPostNamesAreDeterministic() {
+    std::cout << "Testing post names for new glyphs..." << std::endl;
+
+    // Индексы имён генерируются только для глифов от 258
+    std::vector<uint8_t> font = bench::makeSyntheticFont(300, bench::ColorTables::SBIX);
+    auto rebuildPost = [&font]() {
+        TestRebuilder rebuilder(font);
+        rebuilder.setNumGlyphs(304);
+        rebuilder.rebuild();
+        utils::ByteSpan post = rebuilder.getTableData("post");
+        return std::vector<uint8_t>(post.begin(), post.end());
+    };
+
+    // Вторая пересборка того же шрифта не продолжает нумерацию первой
+    std::vector<uint8_t> first = rebuildPost();
+    std::vector<uint8_t> second = rebuildPost();
+    CHECK(first.size() >= 34 + 304 * 2);
+    CHECK(first == second);
+
+    std::cout << "✓ post names test passed" << std::endl;
+}
+
+void testHeadKeepsRevisionAfterGlyphEdit() {
+    std::cout << "Testing head after a glyph edit..." << std::endl;
+
+    std::vector<uint8_t> font = bench::makeSyntheticFont(16, bench::ColorTables::SBIX);
+    TestRebuilder rebuilder(font);
+    utils::ByteSpan original = rebuilder.getTableData("head");
+    const uint32_t fontRevision = original.readUInt32(4);
+    const std::vector<uint8_t> created(original.begin() + 20, original.begin() + 28);
+    const std::vector<uint8_t> modified(original.begin() + 28, original.begin() + 36);
+
+    // Пустой глиф: метрики меняются, значит пересобирается и head
+    rebuilder.replaceGlyph(3, utils::ByteSpan());
+    rebuilder.rebuild();
+
+    utils::ByteSpan head = rebuilder.getTableData("head");
+    CHECK(head.readUInt32(4) == fontRevision);
+    CHECK(std::vector<uint8_t>(head.begin() + 20, head.begin() + 28) == created);
+    CHECK(std::vector<uint8_t>(head.begin() + 28, head.begin() + 36) != modified);
+    uint64_t seconds = (static_cast<uint64_t>(head.readUInt32(28)) << 32) | head.readUInt32(32);
+    CHECK(seconds > 2082844800);   // позже 1970 года в отсчёте от 1904
+
+    std::cout << "✓ head after glyph edit test passed" << std::endl;
+}
+
+// Вывод rebuilder'а: по нему видно, какие расчёты выполнялись
+std::string captureOutput(const std::function<void()>& body) {
+    std::ostringstream captured;
+    struct Restore {
+        std::streambuf* previous;
+        ~Restore() { std::cout.rdbuf(previous); }
+    } restore{std::cout.rdbuf(captured.rdbuf())};
+    body();
+    return captured.str();
+}
+
+void testGlyphMetricsAreLazy() {
+    std::cout << "Testing lazy glyph metrics..." << std::endl;
+
+    std::vector<uint8_t> font = bench::makeSyntheticFont(64, bench::ColorTables::SBIX);
+
+    // Правка post без новых глифов не разбирает ни смещения, ни контуры
+    std::string log = captureOutput([&] {
+        TestRebuilder rebuilder(font);
+        rebuilder.markTableModified("post");
+        rebuilder.rebuild();
+    });
+    CHECK(log.find("glyph offsets") == std::string::npos);
+    CHECK(log.find("Calculated metrics") == std::string::npos);
+
+    // Замена глифа до и после полного расчёта метрик даёт одни и те же таблицы.
+    // В исходном шрифте lsb в hmtx не совпадают с контурами: сначала согласуем их
+    std::vector<uint8_t> consistent;
+    captureOutput([&] {
+        TestRebuilder rebuilder(font);
+        rebuilder.markTableModified("hmtx");
+        consistent = rebuilder.rebuild();
+    });
+    auto rebuildAfterEdit = [&consistent](bool metricsFirst) {
+        std::map<std::string, std::vector<uint8_t>> result;
+        captureOutput([&] {
+            TestRebuilder rebuilder(consistent);
+            if (metricsFirst) {
+                rebuilder.markTableModified("hmtx");
+                rebuilder.rebuild();
+            }
+            rebuilder.replaceGlyph(3, utils::ByteSpan());
+            rebuilder.rebuild();
+            for (const char* tag : {"glyf", "loca", "hmtx", "hhea", "OS/2"}) {
+                utils::ByteSpan table = rebuilder.getTableData(tag);
+                result[tag].assign(table.begin(), table.end());
+            }
+            utils::ByteSpan head = rebuilder.getTableData("head");
+            result["head bounds"].assign(head.begin() + 36, head.begin() + 44);
+        });
+        return result;
+    };
+    CHECK(rebuildAfterEdit(false) == rebuildAfterEdit(true));
+
+    std::cout << "✓ Lazy glyph metrics test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testUndeclaredHandlerRunsAlone();
+        testDeclaredHandlersMayOverlap();
+        testPostNamesAreDeterministic();
+        testHeadKeepsRevisionAfterGlyphEdit();
+        testGlyphMetricsAreLazy();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
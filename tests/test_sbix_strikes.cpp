@@ -0,0 +1,121 @@
+#include "TestSupport.h"
+#include "SyntheticFont.h"
+#include "fontmaster/FontMaster.h"
+#include "fontmaster/TTFUtils.h"
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+using namespace fontmaster;
+
+namespace {
+
+// Синтетический sbix: страйки 32 и 64 ppem, все изображения 16x16
+const uint16_t NUM_GLYPHS = 8;
+
+std::unique_ptr<Font> loadSyntheticSbix(const test::TempFile& file) {
+    test::writeBytes(file.path, bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::SBIX));
+    auto font = Font::load(file.path);
+    CHECK(font->getFormat() == FontFormat::SBIX);
+    return font;
+}
+
+// Сообщения о несовпадении размеров идут в std::cerr
+std::string captureErrors(const std::function<void()>& body) {
+    std::ostringstream captured;
+    std::streambuf* previous = std::cerr.rdbuf(captured.rdbuf());
+    body();
+    std::cerr.rdbuf(previous);
+    return captured.str();
+}
+
+void testInfoComesFromImageStrike() {
+    std::cout << "Testing sbix image info per strike..." << std::endl;
+
+    test::TempFile file("sbix_info.ttf");
+    auto font = loadSyntheticSbix(file);
+    std::string name = font->listGlyphs().front().name;
+
+    GlyphInfo info = font->getGlyphInfo(name);
+    CHECK(info.format == "png");
+    CHECK(info.width == 16 && info.height == 16);
+    CHECK(info.ppem == 64);
+
+    // Та же картинка, что была во всех страйках, - сообщать не о чем
+    std::string errors = captureErrors([&]() {
+        bool replaced = font->replaceGlyphImage(name, test::pngHeader(16, 16));
+        CHECK(replaced);
+    });
+    CHECK(errors.empty());
+
+    std::cout << "✓ sbix image info test passed" << std::endl;
+}
+
+void testReplacementReportsEachStrike() {
+    std::cout << "Testing sbix size mismatch report..." << std::endl;
+
+    test::TempFile file("sbix_mismatch.ttf");
+    auto font = loadSyntheticSbix(file);
+    std::string name = font->listGlyphs().front().name;
+
+    std::string errors = captureErrors([&]() {
+        bool replaced = font->replaceGlyphImage(name, test::pngHeader(48, 48));
+        CHECK(replaced);
+    });
+    CHECK(errors.find("strike 0 (32 ppem) expects 16x16") != std::string::npos);
+    CHECK(errors.find("strike 1 (64 ppem) expects 16x16") != std::string::npos);
+
+    GlyphInfo info = font->getGlyphInfo(name);
+    CHECK(info.width == 48 && info.height == 48);
+    CHECK(info.ppem == 64);
+
+    // Следующая замена сравнивается уже с новым изображением
+    errors = captureErrors([&]() {
+        bool replaced = font->replaceGlyphImage(name, test::pngHeader(48, 48));
+        CHECK(replaced);
+    });
+    CHECK(errors.empty());
+
+    std::cout << "✓ sbix size mismatch test passed" << std::endl;
+}
+
+void testRejectsOversizedStrikeCount() {
+    std::cout << "Testing sbix with a corrupt strike count..." << std::endl;
+
+    // numStrikes далеко за пределами таблицы: отказ без выделения памяти под страйки
+    std::vector<uint8_t> font = bench::makeSyntheticFont(NUM_GLYPHS, bench::ColorTables::SBIX);
+    auto tables = utils::parseTTFTables(font);
+    const utils::TableRecord* sbix = utils::findTable(tables, "sbix");
+    CHECK(sbix);
+    for (size_t i = 0; i < 4; ++i) font[sbix->offset + 4 + i] = 0xFF;
+
+    test::TempFile file("sbix_corrupt.ttf");
+    test::writeBytes(file.path, font);
+    bool rejected = false;
+    std::string errors = captureErrors([&] {
+        try {
+            Font::load(file.path);
+        } catch (const FontException&) {
+            rejected = true;
+        }
+    });
+    CHECK(rejected);
+    CHECK(errors.find("strike count") != std::string::npos);
+
+    std::cout << "✓ sbix corrupt strike count test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testInfoComesFromImageStrike();
+        testReplacementReportsEachStrike();
+        testRejectsOversizedStrikeCount();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
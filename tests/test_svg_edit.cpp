@@ -0,0 +1,159 @@
+#include "TestSupport.h"
+#include "fontmaster/ByteWriter.h"
+#include "fontmaster/FontAssembler.h"
+#include "fontmaster/FontMaster.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace fontmaster;
+
+namespace {
+
+// Глифы 1-3 делят документ A, у 4 и 5 свои; документы длинные, чтобы файл прошёл canHandle
+const std::string DOCUMENT_A = "<svg id='glyph1'>" + std::string(600, ' ') + "</svg>";
+const std::string DOCUMENT_B = "<svg id='glyph4'><rect width='10' height='10'/></svg>";
+const std::string DOCUMENT_C = "<svg id='glyph5'>" + std::string(400, ' ') + "</svg>";
+
+struct Record { uint16_t first, last; const std::string* document; };
+
+std::vector<uint8_t> makeSVGFont(const std::vector<Record>& records = {{1, 3, &DOCUMENT_A},
+                                                                      {4, 4, &DOCUMENT_B},
+                                                                      {5, 5, &DOCUMENT_C}}) {
+    utils::ByteWriter svg;
+    svg.writeUInt16(0);
+    svg.writeUInt32(10);
+    svg.writeUInt32(0);
+    svg.writeUInt16(static_cast<uint16_t>(records.size()));
+    uint32_t offset = 2 + static_cast<uint32_t>(records.size()) * 12;
+    for (const Record& record : records) {
+        svg.writeUInt16(record.first);
+        svg.writeUInt16(record.last);
+        svg.writeUInt32(offset);
+        svg.writeUInt32(static_cast<uint32_t>(record.document->size()));
+        offset += static_cast<uint32_t>(record.document->size());
+    }
+    for (const Record& record : records) {
+        svg.writeBytes(record.document->data(), record.document->size());
+    }
+
+    utils::ByteWriter maxp;
+    maxp.writeUInt32(0x00005000);
+    maxp.writeUInt16(6);
+
+    utils::FontAssembler assembler;
+    assembler.addTable("SVG ", svg.take());
+    assembler.addTable("maxp", maxp.take());
+    return assembler.assemble();
+}
+
+std::string documentOf(const Font& font, const std::string& glyphName) {
+    GlyphInfo info = font.getGlyphInfo(glyphName);
+    return std::string(info.image_data.begin(), info.image_data.end());
+}
+
+void testSaveAppliesEdits() {
+    std::cout << "Testing SVG edit round trip..." << std::endl;
+
+    test::TempFile source("svg_source.ttf");
+    test::TempFile output("svg_output.ttf");
+    test::writeBytes(source.path, makeSVGFont());
+
+    auto font = Font::load(source.path);
+    CHECK(font->getFormat() == FontFormat::SVG);
+    CHECK(font->listGlyphs().size() == 5);
+
+    const std::string replacement = "<svg id='new'/>";
+    bool removed = font->removeGlyph("glyph2");
+    bool replaced = font->replaceGlyphImage("glyph4", test::bytesOf(replacement));
+    CHECK(removed && replaced);
+    bool saved = font->save(output.path);
+    CHECK(saved);
+
+    auto reloaded = Font::load(output.path);
+    std::vector<GlyphInfo> glyphs = reloaded->listGlyphs();
+    CHECK(glyphs.size() == 4);
+    CHECK(std::none_of(glyphs.begin(), glyphs.end(), [](const GlyphInfo& glyph) { return glyph.name == "glyph2"; }));
+    CHECK(documentOf(*reloaded, "glyph1") == DOCUMENT_A);
+    CHECK(documentOf(*reloaded, "glyph3") == DOCUMENT_A);
+    CHECK(documentOf(*reloaded, "glyph4") == replacement);
+    CHECK(documentOf(*reloaded, "glyph5") == DOCUMENT_C);
+
+    // Общий документ глифов 1 и 3 записан один раз
+    std::vector<uint8_t> bytes = test::readBytes(output.path);
+    std::string text(bytes.begin(), bytes.end());
+    CHECK(text.find(DOCUMENT_A) == text.rfind(DOCUMENT_A));
+    CHECK(text.find(DOCUMENT_B) == std::string::npos);
+
+    std::cout << "✓ SVG edit round trip test passed" << std::endl;
+}
+
+void testSaveWithoutEditsCopiesFile() {
+    std::cout << "Testing SVG save without edits..." << std::endl;
+
+    test::TempFile source("svg_unchanged.ttf");
+    test::TempFile output("svg_unchanged_out.ttf");
+    std::vector<uint8_t> original = makeSVGFont();
+    test::writeBytes(source.path, original);
+
+    auto font = Font::load(source.path);
+    bool saved = font->save(output.path);
+    CHECK(saved);
+    CHECK(test::readBytes(output.path) == original);
+
+    std::cout << "✓ SVG save without edits test passed" << std::endl;
+}
+
+void testOverlappingRecords() {
+    std::cout << "Testing SVG records with overlapping ranges..." << std::endl;
+
+    // Глифы 2 и 3 покрыты обеими записями и берутся из первой
+    test::TempFile source("svg_overlap.ttf");
+    test::TempFile output("svg_overlap_out.ttf");
+    test::writeBytes(source.path, makeSVGFont({{1, 3, &DOCUMENT_A}, {2, 5, &DOCUMENT_C}}));
+
+    auto font = Font::load(source.path);
+    std::vector<GlyphInfo> glyphs = font->listGlyphs();
+    CHECK(glyphs.size() == 5);
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        CHECK(glyphs[i].glyph_id == i + 1);
+        std::string document(glyphs[i].image_data.begin(), glyphs[i].image_data.end());
+        CHECK(document == (i < 3 ? DOCUMENT_A : DOCUMENT_C));
+        CHECK(document == documentOf(*font, glyphs[i].name));
+    }
+
+    // Правки видны сразу и совпадают с тем, что попадёт в файл
+    const std::string replacement = "<svg id='new'/>";
+    bool removed = font->removeGlyph("glyph1");
+    bool replaced = font->replaceGlyphImage("glyph3", test::bytesOf(replacement));
+    CHECK(removed && replaced);
+    CHECK(documentOf(*font, "glyph3") == replacement);
+    bool saved = font->save(output.path);
+    CHECK(saved);
+
+    auto reloaded = Font::load(output.path);
+    std::vector<GlyphInfo> before = font->listGlyphs();
+    std::vector<GlyphInfo> after = reloaded->listGlyphs();
+    CHECK(before.size() == 4 && after.size() == before.size());
+    for (size_t i = 0; i < before.size(); ++i) {
+        CHECK(after[i].glyph_id == before[i].glyph_id);
+        CHECK(after[i].image_data == before[i].image_data);
+    }
+    CHECK(documentOf(*reloaded, "glyph2") == DOCUMENT_A);
+
+    std::cout << "✓ SVG overlapping records test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testSaveAppliesEdits();
+        testSaveWithoutEditsCopiesFile();
+        testOverlappingRecords();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}
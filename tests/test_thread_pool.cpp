@@ -0,0 +1,113 @@
+#include "TestSupport.h"
+#include "fontmaster/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace fontmaster::utils;
+
+namespace {
+
+void testParallelForCoversRange() {
+    std::cout << "Testing ThreadPool::parallelFor..." << std::endl;
+
+    ThreadPool pool(4);
+    const size_t count = 10007;
+    std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count]);
+    for (size_t i = 0; i < count; ++i) visits[i] = 0;
+    pool.parallelFor(3, count, 64, [&](size_t begin, size_t end) {
+        CHECK(end - begin <= 64);
+        for (size_t i = begin; i < end; ++i) ++visits[i];
+    });
+    for (size_t i = 0; i < count; ++i) CHECK(visits[i] == (i < 3 ? 0 : 1));
+
+    std::cout << "✓ parallelFor test passed" << std::endl;
+}
+
+void testGraphRespectsDependencies() {
+    std::cout << "Testing ThreadPool::runGraph ordering..." << std::endl;
+
+    // Ромбы и цепочка: 0 -> {1, 2} -> 3, 3 -> 4 .. 9, независимые 10 .. 15
+    std::vector<std::vector<size_t>> dependencies(16);
+    dependencies[1] = {0};
+    dependencies[2] = {0};
+    dependencies[3] = {1, 2};
+    for (size_t node = 4; node < 10; ++node) dependencies[node] = {node - 1};
+
+    ThreadPool pool(4);
+    for (int round = 0; round < 20; ++round) {
+        std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[dependencies.size()]);
+        for (size_t node = 0; node < dependencies.size(); ++node) done[node] = false;
+        std::atomic<int> active{0};
+        std::atomic<int> maxActive{0};
+
+        pool.runGraph(dependencies, [&](size_t node) {
+            for (size_t dependency : dependencies[node]) CHECK(done[dependency]);
+            int now = ++active;
+            int seen = maxActive.load();
+            while (now > seen && !maxActive.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            --active;
+            done[node] = true;
+        });
+        for (size_t node = 0; node < dependencies.size(); ++node) CHECK(done[node]);
+        CHECK(maxActive.load() <= static_cast<int>(pool.size()));
+    }
+
+    std::cout << "✓ runGraph ordering test passed" << std::endl;
+}
+
+void testGraphPropagatesException() {
+    std::cout << "Testing ThreadPool::runGraph exceptions..." << std::endl;
+
+    // Вершина 2 падает: зависящие от неё 3 и 4 не запускаются
+    std::vector<std::vector<size_t>> dependencies = {{}, {0}, {0}, {2}, {3}};
+    for (size_t threads : {1, 4}) {
+        ThreadPool pool(threads);
+        std::atomic<bool> dependentRan{false};
+        bool caught = false;
+        try {
+            pool.runGraph(dependencies, [&](size_t node) {
+                if (node == 2) throw std::runtime_error("node 2 failed");
+                if (node >= 3) dependentRan = true;
+            });
+        } catch (const std::runtime_error& e) {
+            caught = std::string(e.what()) == "node 2 failed";
+        }
+        CHECK(caught);
+        CHECK(!dependentRan);
+
+        // Пул после исключения работоспособен
+        std::atomic<size_t> visited{0};
+        pool.runGraph(dependencies, [&](size_t) { ++visited; });
+        CHECK(visited == dependencies.size());
+    }
+
+    bool rejected = false;
+    try {
+        ThreadPool(2).runGraph({{}, {1}}, [](size_t) {});
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+
+    std::cout << "✓ runGraph exception test passed" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    try {
+        testParallelForCoversRange();
+        testGraphRespectsDependencies();
+        testGraphPropagatesException();
+        std::cout << "All tests passed!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ " << e.what() << std::endl;
+        return 1;
+    }
+}